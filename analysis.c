@@ -0,0 +1,802 @@
+//
+// Created by flimsy on 3/15/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sqlite3.h>
+
+#include "analysis.h"
+#include "database.h"
+#include "context.h"
+
+/* ********** ENGINE ANALYSIS **********
+ * The positions of the stored games are analysed by a pool of local UCI engines, one engine
+ * process per worker thread, talking over pipes. The calling thread reads the games shard by
+ * shard in chunks, replays them and queues every position not analysed yet; the queue is bounded,
+ * the calling thread waits while it is full. A worker takes a position, lets its engine search
+ * it within the budget and hands back the evaluation. The evaluations are written by the calling
+ * thread after every chunk in one transaction, SQLite having one writer.
+ * Evaluations are kept in the table evaluation of chess.db (also with sharding), keyed by the
+ * position hash (see board_hash): a position reached in many games is analysed once. Positions
+ * analysed before at least as deep (for time budgets: at all) are skipped.
+ * Every reply is awaited until a deadline. A search running past the budget's timeout is stopped
+ * and keeps the depth it reached; an engine that does not answer the stop either is killed, and
+ * its worker ends as if the engine had exited.                                                    */
+
+const char tableEvaluation[] = "CREATE TABLE IF NOT EXISTS evaluation("
+                               "hash INTEGER PRIMARY KEY,"
+                               "fen TEXT,"
+                               "depth INTEGER,"
+                               "score_cp INTEGER,"
+                               "mate INTEGER,"
+                               "best_move TEXT,"
+                               "engine TEXT"
+                               ");";
+
+const char selectAnalysedHashes[] = "SELECT hash FROM evaluation WHERE depth >= ?;";
+
+const char insertEvaluation[] = "INSERT OR REPLACE INTO evaluation VALUES (?, ?, ?, ?, NULLIF(?, 0), ?, ?);";
+
+const char selectEvaluation[] = "SELECT depth, score_cp, IFNULL(mate, 0), best_move FROM evaluation WHERE hash = ?;";
+
+typedef struct Engine {
+    pid_t pid;
+    FILE *in;                   // commands to the engine...
+    int out;                    // replies of the engine, read (and polled) by read_reply...
+    char buffer[ENGINE_LINE_MAX];
+    int buffered;
+    char name[NAME_MAX];
+} Engine;
+
+typedef struct Position {
+    long long hash;
+    Board board;
+} Position;
+
+typedef struct Result {
+    Evaluation evaluation;
+    char fen[FEN_MAX];
+} Result;
+
+/* Set of position hashes (open addressing, 0 marks a free slot and is kept apart).               */
+typedef struct HashSet {
+    long long *slots;
+    size_t capacity;
+    size_t count;
+    int has_zero;
+} HashSet;
+
+typedef struct AnalysisJob {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    Position queue[ANALYSIS_QUEUE_MAX];
+    int head;
+    int count;
+    int closed;                 // no more positions will be queued...
+    int running;                // workers with a live engine...
+    Result *results;            // evaluations not written yet...
+    int num_of_results;
+    int results_capacity;
+    int failed;
+    AnalysisBudget budget;
+    char engine_name[NAME_MAX];
+} AnalysisJob;
+
+typedef struct Worker {
+    AnalysisJob *job;
+    Engine engine;
+    pthread_t thread;
+} Worker;
+
+static double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - start->tv_sec) + (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Adds hash to set. Returns TRUE if it was added, FALSE if it was in set already and ERROR if
+ * memory ran out.                                                                                 */
+static int add_hash(HashSet *set, long long hash)
+{
+    size_t slot;
+
+    if (hash == 0) {
+        int added = !set->has_zero;
+        set->has_zero = TRUE;
+        return added;
+    }
+
+    // growing at half load...
+    if ((set->count + 1) * 2 > set->capacity) {
+        size_t capacity = (set->capacity == 0) ? 1024 : set->capacity * 2;
+        long long *slots = calloc(capacity, sizeof(long long));
+        if (slots == NULL)
+            return ERROR;
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i] == 0)
+                continue;
+            for (slot = (size_t)set->slots[i] & (capacity - 1); slots[slot] != 0; slot = (slot + 1) & (capacity - 1))
+                ;
+            slots[slot] = set->slots[i];
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->capacity = capacity;
+    }
+
+    for (slot = (size_t)hash & (set->capacity - 1); set->slots[slot] != 0; slot = (slot + 1) & (set->capacity - 1)) {
+        if (set->slots[slot] == hash)
+            return FALSE;
+    }
+    set->slots[slot] = hash;
+    set->count++;
+    return TRUE;
+}
+
+/* Creates the evaluation table in chess.db if needed and adds the hashes of the positions
+ * analysed at least depth plies deep to analysed. Returns TRUE on success and FALSE on error.    */
+static int load_analysed(HashSet *analysed, int depth)
+{
+    char *err_msg = 0;
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    int status;
+
+    if (!open_database_path(current_db()->catalog_path, &db, FALSE))
+        return FALSE;
+
+    status = sqlite3_exec(db, tableEvaluation, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_prepare_v2(db, selectAnalysedHashes, -1, &stmt, 0);
+    if (is_statement_error(&db, &stmt, status, FALSE))
+        return FALSE;
+
+    sqlite3_bind_int(stmt, 1, depth);
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (add_hash(analysed, sqlite3_column_int64(stmt, 0)) == ERROR) {
+            status = SQLITE_NOMEM;
+            break;
+        }
+    }
+
+    if (is_statement_step_error(&db, &stmt, status, FALSE))
+        return FALSE;
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return TRUE;
+}
+
+/* Sends the command (printf format) to engine. Returns TRUE on success, FALSE if the engine is
+ * gone.                                                                                           */
+static int send_command(Engine *engine, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(engine->in, format, args);
+    va_end(args);
+    fputc('\n', engine->in);
+    return fflush(engine->in) == 0 && !ferror(engine->in);
+}
+
+/* Sets deadline to milliseconds from now.                                                         */
+static void set_deadline(struct timespec *deadline, int milliseconds)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += milliseconds / 1000;
+    deadline->tv_nsec += (long)(milliseconds % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/* Reads the next line of engine into line (ENGINE_LINE_MAX), without the line break, waiting until
+ * deadline at most. Returns TRUE on success, FALSE if the engine is gone and ERROR if the deadline
+ * passed.                                                                                         */
+static int read_reply(Engine *engine, char line[ENGINE_LINE_MAX], const struct timespec *deadline)
+{
+    for (;;) {
+        char *end = memchr(engine->buffer, '\n', (size_t)engine->buffered);
+        struct pollfd ready = {engine->out, POLLIN, 0};
+        struct timespec now;
+        ssize_t count;
+        int wait_ms;
+
+        // a whole line, or as much of a line as fits...
+        if (end != NULL || engine->buffered == ENGINE_LINE_MAX - 1) {
+            int length = (end != NULL) ? (int)(end - engine->buffer) : engine->buffered;
+            memcpy(line, engine->buffer, (size_t)length);
+            line[length] = '\0';
+            line[strcspn(line, "\r")] = '\0';
+
+            length += (end != NULL);
+            engine->buffered -= length;
+            memmove(engine->buffer, engine->buffer + length, (size_t)engine->buffered);
+            return TRUE;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        wait_ms = (int)((deadline->tv_sec - now.tv_sec) * 1000 + (deadline->tv_nsec - now.tv_nsec) / 1000000);
+        if (wait_ms <= 0)
+            return ERROR;
+
+        switch (poll(&ready, 1, wait_ms)) {
+            case -1:
+                if (errno != EINTR)
+                    return FALSE;
+                continue;
+            case 0:
+                return ERROR;
+            default:
+                count = read(engine->out, engine->buffer + engine->buffered,
+                             (size_t)(ENGINE_LINE_MAX - 1 - engine->buffered));
+                if (count <= 0)
+                    return FALSE;
+                engine->buffered += (int)count;
+        }
+    }
+}
+
+/* Reads the replies of engine up to the line starting with reply, waiting until deadline at most.
+ * Returns TRUE if it came, FALSE if the engine is gone and ERROR if the deadline passed.          */
+static int wait_for_reply(Engine *engine, const char *reply, char line[ENGINE_LINE_MAX],
+                          const struct timespec *deadline)
+{
+    int status;
+
+    while ((status = read_reply(engine, line, deadline)) == TRUE) {
+        if (strncmp(line, reply, strlen(reply)) == 0)
+            return TRUE;
+    }
+    return status;
+}
+
+/* Tells engine to quit and waits ANALYSIS_STOP_MS for it to exit, then kills it.                  */
+static void stop_engine(Engine *engine)
+{
+    send_command(engine, "quit");
+    fclose(engine->in);
+    close(engine->out);
+
+    for (int waited_ms = 0; waitpid(engine->pid, NULL, WNOHANG) == 0; waited_ms += 10) {
+        if (waited_ms >= ANALYSIS_STOP_MS) {
+            kill(engine->pid, SIGKILL);
+            waitpid(engine->pid, NULL, 0);
+            break;
+        }
+        sqlite3_sleep(10);
+    }
+}
+
+/* Starts the UCI engine executable path as engine, connected through two pipes, and waits until
+ * it is ready (timeout_ms at most). Returns TRUE on success and FALSE on error.                   */
+static int start_engine(const char *path, Engine *engine, int timeout_ms)
+{
+    char line[ENGINE_LINE_MAX];
+    int to_engine[2], from_engine[2], status;
+    struct timespec deadline;
+
+    if (pipe(to_engine) != 0)
+        return FALSE;
+    if (pipe(from_engine) != 0) {
+        close(to_engine[0]);
+        close(to_engine[1]);
+        return FALSE;
+    }
+
+    // engines started later must not inherit the pipes of this one...
+    fcntl(to_engine[1], F_SETFD, FD_CLOEXEC);
+    fcntl(from_engine[0], F_SETFD, FD_CLOEXEC);
+
+    if ((engine->pid = fork()) == 0) {
+        dup2(to_engine[0], STDIN_FILENO);
+        dup2(from_engine[1], STDOUT_FILENO);
+        close(to_engine[0]);
+        close(to_engine[1]);
+        close(from_engine[0]);
+        close(from_engine[1]);
+        execlp(path, path, (char *)NULL);
+        _exit(127);
+    }
+
+    close(to_engine[0]);
+    close(from_engine[1]);
+    if (engine->pid < 0) {
+        close(to_engine[1]);
+        close(from_engine[0]);
+        return FALSE;
+    }
+    engine->in = fdopen(to_engine[1], "w");
+    engine->out = from_engine[0];
+    engine->buffered = 0;
+    strcpy(engine->name, "unknown");
+
+    // handshake: uci ... id name ... uciok, isready ... readyok...
+    set_deadline(&deadline, timeout_ms);
+    if (!send_command(engine, "uci")) {
+        stop_engine(engine);
+        return FALSE;
+    }
+    while ((status = read_reply(engine, line, &deadline)) == TRUE && strcmp(line, "uciok") != 0) {
+        if (strncmp(line, "id name ", 8) == 0 && snprintf(engine->name, NAME_MAX, "%s", line + 8) >= NAME_MAX)
+            printf("INFO: engine name cut to '%s'...\n", engine->name);
+    }
+    if (status != TRUE || !send_command(engine, "isready") ||
+        wait_for_reply(engine, "readyok", line, &deadline) != TRUE) {
+        stop_engine(engine);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Takes the depth and score of the UCI info line into evaluation, sign turning the score of the
+ * side to move into the score for white.                                                          */
+static void read_info(const char *line, Evaluation *evaluation, int sign)
+{
+    const char *depth = strstr(line, " depth "), *score = strstr(line, " score ");
+    int value;
+
+    if (depth == NULL || score == NULL)
+        return;
+
+    if (sscanf(score, " score cp %d", &value) == 1) {
+        evaluation->score_cp = sign * value;
+        evaluation->mate = 0;
+    }
+    else if (sscanf(score, " score mate %d", &value) == 1) {
+        evaluation->score_cp = 0;
+        evaluation->mate = sign * value;
+    }
+    else
+        return;
+    evaluation->depth = atoi(depth + 7);
+}
+
+/* Lets engine search position within budget, the evaluation goes to result. A search past the
+ * timeout is stopped, its evaluation is the one of the depth reached.
+ * Returns TRUE on success, FALSE if the reply was not understood (or a stopped search had none)
+ * and ERROR if the engine is gone or does not answer.                                             */
+static int analyse_position(Engine *engine, const Position *position, AnalysisBudget budget, Result *result)
+{
+    char line[ENGINE_LINE_MAX], uci_move[8];
+    int sign = (position->board.side_to_move == WHITE_PLAYER) ? 1 : -1, status, stopped = FALSE;
+    struct timespec deadline;
+    Move move;
+
+    memset(result, 0, sizeof(Result));
+    result->evaluation.hash = position->hash;
+    board_to_fen(&position->board, result->fen);
+
+    if (!send_command(engine, "position fen %s", result->fen))
+        return ERROR;
+    if (!((budget.movetime_ms > 0) ? send_command(engine, "go movetime %d", budget.movetime_ms)
+                                   : send_command(engine, "go depth %d", budget.depth)))
+        return ERROR;
+
+    set_deadline(&deadline, budget.movetime_ms + ((budget.timeout_ms > 0) ? budget.timeout_ms : ANALYSIS_TIMEOUT_MS));
+    while ((status = read_reply(engine, line, &deadline)) != FALSE) {
+        if (status == ERROR) {
+            // past the timeout: stop, then the engine counts as gone...
+            if (stopped || !send_command(engine, "stop"))
+                return ERROR;
+            set_deadline(&deadline, ANALYSIS_STOP_MS);
+            stopped = TRUE;
+        }
+        else if (strncmp(line, "info ", 5) == 0)
+            read_info(line, &result->evaluation, sign);
+        else if (sscanf(line, "bestmove %7s", uci_move) == 1) {
+            if ((stopped && result->evaluation.depth == 0) || !parse_uci(&position->board, uci_move, &move))
+                return FALSE;
+            move_to_san(&position->board, move, result->evaluation.best_move);
+            return TRUE;
+        }
+    }
+    return ERROR;
+}
+
+/* Adds result to the evaluations not written yet (job->lock held).                                */
+static void add_result(AnalysisJob *job, const Result *result)
+{
+    if (job->num_of_results == job->results_capacity) {
+        int capacity = (job->results_capacity == 0) ? ANALYSIS_QUEUE_MAX : job->results_capacity * 2;
+        Result *grown = realloc(job->results, sizeof(Result) * capacity);
+        if (grown == NULL) {
+            job->failed++;
+            return;
+        }
+        job->results = grown;
+        job->results_capacity = capacity;
+    }
+    job->results[job->num_of_results++] = *result;
+}
+
+static void *analysis_worker(void *arg)
+{
+    Worker *worker = arg;
+    AnalysisJob *job = worker->job;
+    Position position;
+    Result result;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        while (job->count == 0 && !job->closed)
+            pthread_cond_wait(&job->not_empty, &job->lock);
+        if (job->count == 0) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        position = job->queue[job->head];
+        job->head = (job->head + 1) % ANALYSIS_QUEUE_MAX;
+        job->count--;
+        pthread_cond_signal(&job->not_full);
+        pthread_mutex_unlock(&job->lock);
+
+        int status = analyse_position(&worker->engine, &position, job->budget, &result);
+
+        pthread_mutex_lock(&job->lock);
+        if (status == TRUE)
+            add_result(job, &result);
+        else
+            job->failed++;
+        pthread_mutex_unlock(&job->lock);
+
+        if (status == ERROR) {
+            eprintf("ERROR: engine %d stopped responding...\n", (int)worker->engine.pid);
+            break;
+        }
+    }
+
+    // the calling thread must not wait for a full queue without workers...
+    pthread_mutex_lock(&job->lock);
+    job->running--;
+    pthread_cond_broadcast(&job->not_full);
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/* Queues position, waiting while the queue is full. Returns TRUE on success, FALSE if no worker
+ * is left.                                                                                        */
+static int queue_position(AnalysisJob *job, const Position *position)
+{
+    pthread_mutex_lock(&job->lock);
+    while (job->count == ANALYSIS_QUEUE_MAX && job->running > 0)
+        pthread_cond_wait(&job->not_full, &job->lock);
+    if (job->running == 0) {
+        pthread_mutex_unlock(&job->lock);
+        return FALSE;
+    }
+    job->queue[(job->head + job->count) % ANALYSIS_QUEUE_MAX] = *position;
+    job->count++;
+    pthread_cond_signal(&job->not_empty);
+    pthread_mutex_unlock(&job->lock);
+    return TRUE;
+}
+
+/* Replays game and queues its positions (up to its last readable move) that are not in analysed.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int queue_game(AnalysisJob *job, HashSet *analysed, const GameInfo *game, AnalysisStats *stats)
+{
+    char plies[LINE_PLIES_MAX][S_MOVE_MAX];
+    int num_of_plies = game_plies(&game->game_moves, game->game_moves.move_number, plies);
+    Position position;
+    Move move;
+
+    board_init(&position.board);
+    for (int ply = 0; ply <= num_of_plies; ply++) {
+        // game ends (mate, stalemate) have nothing to search...
+        if (!has_legal_moves(&position.board))
+            break;
+
+        position.hash = board_hash(&position.board);
+        stats->positions++;
+        switch (add_hash(analysed, position.hash)) {
+            case ERROR:
+                eprintf("ERROR: could not allocate memory for the analysed positions...\n");
+                return FALSE;
+            case FALSE:
+                stats->skipped++;
+                break;
+            default:
+                if (!queue_position(job, &position)) {
+                    eprintf("ERROR: no engine left to analyse...\n");
+                    return FALSE;
+                }
+        }
+
+        if (ply == num_of_plies || !parse_san(&position.board, plies[ply], &move))
+            break;
+        make_move(&position.board, move);
+    }
+    return TRUE;
+}
+
+/* Writes the evaluations finished so far into chess.db in one transaction.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int write_results(AnalysisJob *job, AnalysisStats *stats)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    Result *results;
+    int count, status;
+
+    pthread_mutex_lock(&job->lock);
+    results = job->results;
+    count = job->num_of_results;
+    job->results = NULL;
+    job->num_of_results = job->results_capacity = 0;
+    pthread_mutex_unlock(&job->lock);
+
+    if (count == 0) {
+        free(results);
+        return TRUE;
+    }
+
+    if (!open_database_path(current_db()->catalog_path, &db, FALSE) ||
+        !do_statement(db, NULL, NULL, NULL, FALSE, beginTransaction, NULL)) {
+        free(results);
+        return FALSE;
+    }
+
+    status = sqlite3_prepare_v2(db, insertEvaluation, -1, &stmt, 0);
+    if (is_statement_error(&db, &stmt, status, TRUE)) {
+        free(results);
+        return FALSE;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const Evaluation *evaluation = &results[i].evaluation;
+        sqlite3_reset(stmt);
+        sqlite3_bind_int64(stmt, 1, evaluation->hash);
+        sqlite3_bind_text(stmt, 2, results[i].fen, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 3, evaluation->depth);
+        sqlite3_bind_int(stmt, 4, evaluation->score_cp);
+        sqlite3_bind_int(stmt, 5, evaluation->mate);
+        sqlite3_bind_text(stmt, 6, evaluation->best_move, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 7, job->engine_name, -1, SQLITE_STATIC);
+        status = sqlite3_step(stmt);
+        if (is_statement_step_error(&db, &stmt, status, TRUE)) {
+            free(results);
+            return FALSE;
+        }
+    }
+    sqlite3_finalize(stmt);
+    free(results);
+
+    if (!do_statement(db, NULL, NULL, NULL, TRUE, commitTransaction, NULL))
+        return FALSE;
+    sqlite3_close(db);
+
+    stats->analysed += count;
+    return TRUE;
+}
+
+/* Queues the positions of all games of the routed database, games chunk by chunk, writing the
+ * evaluations finished after every chunk. Returns TRUE on success and FALSE on error.            */
+static int analyse_shard(AnalysisJob *job, HashSet *analysed, GameInfo *games, AnalysisStats *stats)
+{
+    sqlite3 *db;
+    int min_id, max_id, success = TRUE;
+
+    if (!get_id_range(&min_id, &max_id))
+        return TRUE;
+    if (!open_database_readonly(&db))
+        return FALSE;
+
+    for (int from = min_id; from <= max_id && success; from += ANALYSIS_CHUNK_IDS) {
+        int count = get_games_in_range(db, games, from, from + ANALYSIS_CHUNK_IDS - 1, NULL);
+        if (count == ERROR) {
+            success = FALSE;
+            break;
+        }
+
+        for (int i = 0; i < count && success; i++)
+            success = queue_game(job, analysed, &games[i], stats);
+        stats->games += count;
+
+        if (success)
+            success = write_results(job, stats);
+    }
+
+    sqlite3_close(db);
+    return success;
+}
+
+/* Analyses the positions of all games with num_of_engines processes of the UCI engine executable
+ * engine_path, each position searched within budget, and stores the evaluations. The statistics
+ * of the run go to stats. SIGPIPE is ignored while the engines run, its handler restored after.
+ * Returns the number of positions analysed, or ERROR on error.                                    */
+int analyse_games(const char *engine_path, int num_of_engines, AnalysisBudget budget, AnalysisStats *stats)
+{
+    int numbers[SHARDS_MAX + 1], num_of_shards, started = 0, success = TRUE;
+    struct timespec start;
+    HashSet analysed = {NULL, 0, 0, FALSE};
+    AnalysisJob *job;
+    Worker workers[ANALYSIS_ENGINES_MAX];
+    struct sigaction ignore = {.sa_handler = SIG_IGN}, previous;
+    GameInfo *games;
+
+    if (num_of_engines < 1 || num_of_engines > ANALYSIS_ENGINES_MAX) {
+        eprintf("ERROR: number of engines must be between 1 and %d...\n", ANALYSIS_ENGINES_MAX);
+        return ERROR;
+    }
+    if (budget.depth < 1 && budget.movetime_ms < 1) {
+        eprintf("ERROR: the search needs a depth or a time...\n");
+        return ERROR;
+    }
+
+    memset(stats, 0, sizeof(AnalysisStats));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!load_analysed(&analysed, (budget.movetime_ms > 0) ? 0 : budget.depth))
+        return ERROR;
+
+    job = calloc(1, sizeof(AnalysisJob));
+    games = malloc(sizeof(GameInfo) * ANALYSIS_CHUNK_IDS);
+    if (job == NULL || games == NULL) {
+        eprintf("ERROR: could not allocate memory for the analysis...\n");
+        free(job);
+        free(games);
+        free(analysed.slots);
+        return ERROR;
+    }
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->not_empty, NULL);
+    pthread_cond_init(&job->not_full, NULL);
+    job->budget = budget;
+
+    // a dead engine must not take the program with it (SIGPIPE), until the engines are stopped...
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPIPE, &ignore, &previous);
+
+    // the engines are started before any worker thread, forking from one thread only...
+    for (int i = 0; i < num_of_engines; i++) {
+        workers[started].job = job;
+        if (!start_engine(engine_path, &workers[started].engine,
+                          (budget.timeout_ms > 0) ? budget.timeout_ms : ANALYSIS_TIMEOUT_MS)) {
+            eprintf("ERROR: could not start engine '%s'...\n", engine_path);
+            break;
+        }
+        started++;
+    }
+    if (started > 0)
+        strcpy(job->engine_name, workers[0].engine.name);
+
+    job->running = started;
+    for (int i = 0; i < started; i++) {
+        if (pthread_create(&workers[i].thread, NULL, analysis_worker, &workers[i]) != 0) {
+            eprintf("ERROR: could not start analysis thread...\n");
+            stop_engine(&workers[i].engine);
+            for (int j = i + 1; j < started; j++)
+                stop_engine(&workers[j].engine);
+            job->running = started = i;
+            break;
+        }
+    }
+    success = (started > 0);
+
+    if (success)
+        printf("INFO: analysing with %d x %s, %s %d per position...\n", started, job->engine_name,
+               (budget.movetime_ms > 0) ? "ms" : "depth",
+               (budget.movetime_ms > 0) ? budget.movetime_ms : budget.depth);
+
+    num_of_shards = get_shard_numbers(numbers);
+    for (int i = 0; i < num_of_shards && success; i++) {
+        route_to_shard(numbers[i]);
+        success = analyse_shard(job, &analysed, games, stats);
+    }
+    route_to_shard(0);
+
+    // the workers finish the queue (or drop it on error) and stop...
+    pthread_mutex_lock(&job->lock);
+    job->closed = TRUE;
+    if (!success)
+        job->count = 0;
+    pthread_cond_broadcast(&job->not_empty);
+    pthread_mutex_unlock(&job->lock);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        stop_engine(&workers[i].engine);
+    }
+    sigaction(SIGPIPE, &previous, NULL);
+
+    // positions left when the last engine stopped...
+    if (job->count > 0) {
+        eprintf("ERROR: no engine left to analyse %d positions...\n", job->count);
+        job->failed += job->count;
+        success = FALSE;
+    }
+
+    // what was analysed is kept, even after an error...
+    if (!write_results(job, stats))
+        success = FALSE;
+
+    stats->failed = job->failed;
+    stats->seconds = elapsed_seconds(&start);
+    if (started > 0)
+        printf("INFO: %d positions of %d games, %d analysed (%.1f per second), %d skipped, %d failed...\n",
+               stats->positions, stats->games, stats->analysed,
+               (stats->seconds > 0) ? stats->analysed / stats->seconds : 0, stats->skipped, stats->failed);
+
+    pthread_mutex_destroy(&job->lock);
+    pthread_cond_destroy(&job->not_empty);
+    pthread_cond_destroy(&job->not_full);
+    free(job->results);
+    free(job);
+    free(games);
+    free(analysed.slots);
+    return (success) ? stats->analysed : ERROR;
+}
+
+/* Prints the moves of the game with game_id with the stored evaluation of the position after
+ * every move. Returns TRUE on success and FALSE on error.                                         */
+int print_game_evaluations(int game_id)
+{
+    char plies[LINE_PLIES_MAX][S_MOVE_MAX], score[16];
+    int num_of_plies, status;
+    GameInfo *game = calloc(1, sizeof(GameInfo));
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    Board board;
+    Move move;
+
+    if (game == NULL)
+        return FALSE;
+    game->game_id = game_id;
+    if (!get_game_by_id(game)) {
+        free(game);
+        return FALSE;
+    }
+    route_to_shard(0);
+    num_of_plies = game_plies(&game->game_moves, game->game_moves.move_number, plies);
+    free(game);
+
+    if (!open_database_path(current_db()->catalog_path, &db, TRUE))
+        return FALSE;
+    status = sqlite3_prepare_v2(db, selectEvaluation, -1, &stmt, 0);
+    if (status != SQLITE_OK) {
+        printf("INFO: no positions were analysed yet...\n");
+        sqlite3_close(db);
+        return TRUE;
+    }
+
+    board_init(&board);
+    for (int ply = 0; ply < num_of_plies && parse_san(&board, plies[ply], &move); ply++) {
+        make_move(&board, move);
+
+        sqlite3_reset(stmt);
+        sqlite3_bind_int64(stmt, 1, board_hash(&board));
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            printf("\t%3d%-3s %-6s %8s\n", ply / 2 + 1, (ply % 2) ? "..." : ".", plies[ply], "-");
+            continue;
+        }
+
+        if (sqlite3_column_int(stmt, 2) != 0)
+            snprintf(score, sizeof(score), "#%d", sqlite3_column_int(stmt, 2));
+        else
+            snprintf(score, sizeof(score), "%+.2f", sqlite3_column_int(stmt, 1) / 100.0);
+        printf("\t%3d%-3s %-6s %8s  depth %2d  best %s\n", ply / 2 + 1, (ply % 2) ? "..." : ".", plies[ply],
+               score, sqlite3_column_int(stmt, 0), sqlite3_column_text(stmt, 3));
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return TRUE;
+}
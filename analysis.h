@@ -0,0 +1,53 @@
+//
+// Created by flimsy on 3/15/22.
+//
+
+#ifndef CHESSDATABASE_ANALYSIS_H
+#define CHESSDATABASE_ANALYSIS_H
+
+#include "helperFunctions.h"
+#include "chess.h"
+
+// Default values.
+#define ANALYSIS_DEPTH 12
+#define ANALYSIS_ENGINES 4
+#define ANALYSIS_TIMEOUT_MS 30000
+
+// Size values.
+#define ANALYSIS_ENGINES_MAX 32
+#define ANALYSIS_QUEUE_MAX 256
+#define ANALYSIS_CHUNK_IDS 64
+#define ENGINE_LINE_MAX 4096
+
+// Time values. A stopped engine has ANALYSIS_STOP_MS for its best move, a quitting one to exit.
+#define ANALYSIS_STOP_MS 1000
+
+// Search limit of every position: depth plies, or movetime_ms milliseconds if not 0. A search not
+// done timeout_ms after that (ANALYSIS_TIMEOUT_MS if 0) is stopped.
+typedef struct AnalysisBudget {
+    int depth;
+    int movetime_ms;
+    int timeout_ms;
+} AnalysisBudget;
+
+typedef struct AnalysisStats {
+    int games;
+    int positions;              // positions of the games, game ends not counted...
+    int skipped;                // already analysed (at least as deep), or repeated...
+    int analysed;
+    int failed;
+    double seconds;
+} AnalysisStats;
+
+typedef struct Evaluation {
+    long long hash;             // board_hash of the position...
+    int depth;
+    int score_cp;               // centipawns, from white's point of view...
+    int mate;                   // moves to mate (negative: black mates), 0 if none...
+    char best_move[SAN_MAX];
+} Evaluation;
+
+int analyse_games(const char *engine_path, int num_of_engines, AnalysisBudget budget, AnalysisStats *stats);
+int print_game_evaluations(int game_id);
+
+#endif //CHESSDATABASE_ANALYSIS_H
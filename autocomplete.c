@@ -0,0 +1,336 @@
+//
+// Created by flimsy on 3/12/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "autocomplete.h"
+#include "database.h"
+#include "context.h"
+
+/* ********** NAME COMPLETION **********
+ * Every dictionary (player names, tournament names) is a sorted array of names, compared without
+ * regard to case, with the number of games per name. The names are packed into one string pool,
+ * an entry is only the offset of its name and its count. All names starting with a prefix form
+ * one run of the array, found by two binary searches.
+ * To get the most used names of a run without visiting it, a segment tree over the counts holds
+ * the entry with the highest count of every subtree. The best entry of the run splits it in two
+ * smaller runs, whose best entries are the next candidates, and so on until enough names were
+ * taken: a completion costs O(k log n) whatever the length of the run.
+ * The dictionaries are loaded at startup. A game insert adds its names, a new name is inserted
+ * into the array and the tree rebuilt (linear in the number of names).                           */
+
+#define NO_ENTRY -1
+#define POOL_MIN 4096
+
+typedef struct Entry {
+    int offset;
+    int count;
+} Entry;
+
+
+/* Compares the first n characters of s1 and s2 without regard to (ASCII) case.                   */
+static int compare_prefix(const char *s1, const char *s2, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        int c1 = tolower((unsigned char)s1[i]), c2 = tolower((unsigned char)s2[i]);
+        if (c1 != c2 || c1 == '\0')
+            return c1 - c2;
+    }
+    return 0;
+}
+
+/* Dictionary order: without regard to case, names only differing in case in byte order.          */
+static int compare_names(const char *s1, const char *s2)
+{
+    int result = compare_prefix(s1, s2, (size_t)-1);
+    return (result != 0) ? result : strcmp(s1, s2);
+}
+
+static int compare_name_counts(const void *a, const void *b)
+{
+    return compare_names(((const NameCount *)a)->name, ((const NameCount *)b)->name);
+}
+
+static const char *entry_name(const Dictionary *dict, int entry)
+{
+    return dict->pool + dict->entries[entry].offset;
+}
+
+/* Returns the better of the entries a and b: the higher count, or the first in order.             */
+static int better_entry(const Dictionary *dict, int a, int b)
+{
+    if (a == NO_ENTRY)
+        return b;
+    if (b == NO_ENTRY)
+        return a;
+    if (dict->entries[a].count != dict->entries[b].count)
+        return (dict->entries[a].count > dict->entries[b].count) ? a : b;
+    return (a < b) ? a : b;
+}
+
+/* Rebuilds the segment tree of dict. Returns TRUE on success and FALSE on error.                  */
+static int build_tree(Dictionary *dict)
+{
+    int size = 1;
+
+    while (size < dict->num_of_entries)
+        size *= 2;
+
+    if (size != dict->tree_size || dict->tree == NULL) {
+        int *tree = realloc(dict->tree, sizeof(int) * 2 * size);
+        if (tree == NULL)
+            return FALSE;
+        dict->tree = tree;
+        dict->tree_size = size;
+    }
+
+    for (int i = 0; i < size; i++)
+        dict->tree[size + i] = (i < dict->num_of_entries) ? i : NO_ENTRY;
+    for (int node = size - 1; node > 0; node--)
+        dict->tree[node] = better_entry(dict, dict->tree[2 * node], dict->tree[2 * node + 1]);
+    return TRUE;
+}
+
+/* Updates the tree after the count of entry changed.                                              */
+static void update_tree(Dictionary *dict, int entry)
+{
+    for (int node = (dict->tree_size + entry) / 2; node > 0; node /= 2)
+        dict->tree[node] = better_entry(dict, dict->tree[2 * node], dict->tree[2 * node + 1]);
+}
+
+/* Returns the best entry of the run [from, to), or NO_ENTRY if the run is empty.                  */
+static int best_in_run(const Dictionary *dict, int from, int to)
+{
+    int best = NO_ENTRY;
+
+    for (from += dict->tree_size, to += dict->tree_size; from < to; from /= 2, to /= 2) {
+        if (from & 1)
+            best = better_entry(dict, best, dict->tree[from++]);
+        if (to & 1)
+            best = better_entry(dict, best, dict->tree[--to]);
+    }
+    return best;
+}
+
+/* Returns the first entry not ordered before prefix, or (if after is TRUE) after all entries
+ * starting with prefix.                                                                           */
+static int find_entry(const Dictionary *dict, const char *prefix, size_t length, int after)
+{
+    int low = 0, high = dict->num_of_entries;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        int result = compare_prefix(entry_name(dict, middle), prefix, length);
+        if (result < 0 || (after && result == 0))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/* Appends name to the pool of dict. Returns its offset, or ERROR on error.                        */
+static int add_to_pool(Dictionary *dict, const char *name)
+{
+    size_t length = strlen(name) + 1;
+
+    if (dict->pool_size + length > dict->pool_capacity) {
+        size_t capacity = (dict->pool_capacity < POOL_MIN) ? POOL_MIN : dict->pool_capacity;
+        while (capacity < dict->pool_size + length)
+            capacity *= 2;
+
+        char *pool = realloc(dict->pool, capacity);
+        if (pool == NULL)
+            return ERROR;
+        dict->pool = pool;
+        dict->pool_capacity = capacity;
+    }
+
+    memcpy(dict->pool + dict->pool_size, name, length);
+    dict->pool_size += length;
+    return (int)(dict->pool_size - length);
+}
+
+static void free_dictionary(Dictionary *dict)
+{
+    free(dict->pool);
+    free(dict->entries);
+    free(dict->tree);
+    memset(dict, 0, sizeof(Dictionary));
+}
+
+/* Builds the dictionary kind from the names in the database. Returns TRUE on success and FALSE
+ * on error.                                                                                       */
+static int load_dictionary(int kind)
+{
+    Dictionary *dict = &current_db()->completions.dictionaries[kind];
+    NameCount *names;
+    int count;
+
+    if ((count = get_name_counts(kind, &names)) == ERROR)
+        return FALSE;
+
+    // names of several shards are merged...
+    qsort(names, (size_t)count, sizeof(NameCount), compare_name_counts);
+
+    dict->entries = malloc(sizeof(Entry) * (count + 1));
+    dict->entries_capacity = count + 1;
+    if (dict->entries == NULL) {
+        free(names);
+        return FALSE;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (dict->num_of_entries > 0 && strcmp(entry_name(dict, dict->num_of_entries - 1), names[i].name) == 0) {
+            dict->entries[dict->num_of_entries - 1].count += names[i].count;
+            continue;
+        }
+
+        int offset = add_to_pool(dict, names[i].name);
+        if (offset == ERROR) {
+            free(names);
+            return FALSE;
+        }
+        dict->entries[dict->num_of_entries++] = (Entry){offset, names[i].count};
+    }
+    free(names);
+
+    return build_tree(dict);
+}
+
+/* Loads the player and tournament names of the database into the completion dictionaries.
+ * Returns TRUE on success and FALSE on error.                                                     */
+int load_completions()
+{
+    Completions *completions = &current_db()->completions;
+    struct timespec start, end;
+
+    free_completions();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int kind = 0; kind < COMPLETE_KINDS; kind++) {
+        if (!load_dictionary(kind)) {
+            eprintf("ERROR: could not load the completion names...\n");
+            free_completions();
+            return FALSE;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    completions->build_ms = (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+    completions->loaded = TRUE;
+    return TRUE;
+}
+
+void free_completions()
+{
+    Completions *completions = &current_db()->completions;
+
+    for (int kind = 0; kind < COMPLETE_KINDS; kind++)
+        free_dictionary(&completions->dictionaries[kind]);
+    completions->loaded = FALSE;
+}
+
+/* Adds a game with name to the dictionary kind (nothing if the dictionaries are not loaded).      */
+void add_completion(int kind, const char *name)
+{
+    Completions *completions = &current_db()->completions;
+    Dictionary *dict = &completions->dictionaries[kind];
+    int entry, offset;
+
+    if (!completions->loaded || strcmp(name, "-") == 0 || *name == '\0')
+        return;
+
+    entry = find_entry(dict, name, (size_t)-1, FALSE);
+    while (entry < dict->num_of_entries && compare_names(entry_name(dict, entry), name) < 0)
+        entry++;
+
+    if (entry < dict->num_of_entries && strcmp(entry_name(dict, entry), name) == 0) {
+        dict->entries[entry].count++;
+        update_tree(dict, entry);
+        return;
+    }
+
+    // a new name...
+    if (dict->num_of_entries == dict->entries_capacity) {
+        Entry *grown = realloc(dict->entries, sizeof(Entry) * (dict->entries_capacity * 2 + 1));
+        if (grown == NULL)
+            return;
+        dict->entries = grown;
+        dict->entries_capacity = dict->entries_capacity * 2 + 1;
+    }
+    if ((offset = add_to_pool(dict, name)) == ERROR)
+        return;
+
+    memmove(&dict->entries[entry + 1], &dict->entries[entry], sizeof(Entry) * (dict->num_of_entries - entry));
+    dict->entries[entry] = (Entry){offset, 1};
+    dict->num_of_entries++;
+    build_tree(dict);
+}
+
+/* Stores at most max_completions names of the dictionary kind starting with prefix (without
+ * regard to case) in completions, the names with the most games first. The names stay valid
+ * until the next add_completion or free_completions on the same database handle.
+ * Returns the number of completions.                                                              */
+int complete_name(int kind, const char *prefix, const char *completions[], int max_completions)
+{
+    const Dictionary *dict = &current_db()->completions.dictionaries[kind];
+    int from[COMPLETIONS_MAX * 2 + 1], to[COMPLETIONS_MAX * 2 + 1], best[COMPLETIONS_MAX * 2 + 1];
+    int num_of_runs = 0, count = 0;
+    size_t length = strlen(prefix);
+
+    if (!current_db()->completions.loaded || dict->num_of_entries == 0)
+        return 0;
+    if (max_completions > COMPLETIONS_MAX)
+        max_completions = COMPLETIONS_MAX;
+
+    from[0] = find_entry(dict, prefix, length, FALSE);
+    to[0] = find_entry(dict, prefix, length, TRUE);
+    if ((best[0] = best_in_run(dict, from[0], to[0])) != NO_ENTRY)
+        num_of_runs = 1;
+
+    while (count < max_completions && num_of_runs > 0) {
+        int run = 0;
+
+        for (int i = 1; i < num_of_runs; i++) {
+            if (better_entry(dict, best[run], best[i]) == best[i])
+                run = i;
+        }
+
+        int entry = best[run], run_from = from[run], run_to = to[run];
+        completions[count++] = entry_name(dict, entry);
+
+        // the run is replaced by the runs before and after its best entry...
+        num_of_runs--;
+        from[run] = from[num_of_runs], to[run] = to[num_of_runs], best[run] = best[num_of_runs];
+        if ((best[num_of_runs] = best_in_run(dict, run_from, entry)) != NO_ENTRY) {
+            from[num_of_runs] = run_from, to[num_of_runs] = entry;
+            num_of_runs++;
+        }
+        if ((best[num_of_runs] = best_in_run(dict, entry + 1, run_to)) != NO_ENTRY) {
+            from[num_of_runs] = entry + 1, to[num_of_runs] = run_to;
+            num_of_runs++;
+        }
+    }
+    return count;
+}
+
+/* Stores the number of names, the memory used and the time the last load took in stats.          */
+void get_completion_stats(CompletionStats *stats)
+{
+    const Completions *completions = &current_db()->completions;
+
+    stats->bytes_used = 0;
+    for (int kind = 0; kind < COMPLETE_KINDS; kind++) {
+        const Dictionary *dict = &completions->dictionaries[kind];
+        stats->names[kind] = dict->num_of_entries;
+        stats->bytes_used += dict->pool_capacity + sizeof(Entry) * dict->entries_capacity +
+                             sizeof(int) * 2 * dict->tree_size;
+    }
+    stats->build_ms = completions->build_ms;
+}
@@ -0,0 +1,54 @@
+//
+// Created by flimsy on 3/12/22.
+//
+
+#ifndef CHESSDATABASE_AUTOCOMPLETE_H
+#define CHESSDATABASE_AUTOCOMPLETE_H
+
+#include <stddef.h>
+
+#include "helperFunctions.h"
+
+// Name dictionaries.
+#define COMPLETE_PLAYER 0
+#define COMPLETE_TOURNAMENT 1
+#define COMPLETE_KINDS 2
+
+// Size values.
+#define COMPLETIONS_MAX 8
+
+typedef struct NameCount {
+    char name[NAME_MAX];
+    int count;                  // number of games with the name...
+} NameCount;
+
+typedef struct CompletionStats {
+    int names[COMPLETE_KINDS];
+    size_t bytes_used;
+    double build_ms;
+} CompletionStats;
+
+/* A sorted name dictionary (entries are private to autocomplete.c).                               */
+typedef struct Dictionary {
+    char *pool;
+    size_t pool_size, pool_capacity;
+    struct Entry *entries;
+    int num_of_entries, entries_capacity;
+    int *tree;                  // entry with the highest count of every subtree, leaves from tree_size...
+    int tree_size;
+} Dictionary;
+
+/* The name completions of one database handle.                                                    */
+typedef struct Completions {
+    Dictionary dictionaries[COMPLETE_KINDS];
+    int loaded;
+    double build_ms;
+} Completions;
+
+int load_completions();
+void free_completions();
+void add_completion(int kind, const char *name);
+int complete_name(int kind, const char *prefix, const char *completions[], int max_completions);
+void get_completion_stats(CompletionStats *stats);
+
+#endif //CHESSDATABASE_AUTOCOMPLETE_H
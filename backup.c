@@ -0,0 +1,281 @@
+//
+// Created by flimsy on 3/7/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+
+#include "helperFunctions.h"
+#include "database.h"
+#include "context.h"
+#include "backup.h"
+
+/* ********** ONLINE BACKUP **********
+ * The backup is copied with the SQLite backup API a few pages at a time. The read lock on the
+ * database is only held during a step, between the steps the backup sleeps so writers can commit.
+ * If the database is written by another connection during the backup, SQLite restarts the copy
+ * on the next step, so the result is always a consistent snapshot. The copy is written to
+ * '<path>.tmp' and renamed when complete, an existing backup is never left half written. With
+ * sharding the shard files are copied next to the copy of chess.db, under their own names, so
+ * the copy opens as a database of its own.                                                        */
+
+static double elapsed_ms(const struct timespec *from, const struct timespec *to)
+{
+    return (double)(to->tv_sec - from->tv_sec) * 1e3 + (double)(to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/* Returns the integer result of the PRAGMA statement sql on db, or ERROR on error.
+ * (PRAGMA data_version changes whenever another connection commits a write.)                      */
+static int get_pragma_int(sqlite3 *db, const char *sql)
+{
+    sqlite3_stmt *stmt;
+    int value = ERROR;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+/* Copies the (open) database src to path, pages_per_step pages per step with sleep_ms
+ * milliseconds pause between steps. Returns TRUE on success and FALSE on error.                   */
+static int copy_database(sqlite3 *src, const char *path, int pages_per_step, int sleep_ms)
+{
+    char tmp_path[BACKUP_PATH_MAX];
+    sqlite3 *dest;
+    sqlite3_backup *backup;
+    struct timespec start, step_start, step_end;
+    double longest_step = 0;
+    int status, steps = 0, restarts = 0, last_remaining = -1, reported = -1, page_count;
+
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        eprintf("ERROR: backup path too long...\n");
+        return FALSE;
+    }
+    remove(tmp_path);
+
+    if (sqlite3_open(tmp_path, &dest) != SQLITE_OK) {
+        eprintf("Cannot open backup: %s\n", sqlite3_errmsg(dest));
+        sqlite3_close(dest);
+        return FALSE;
+    }
+
+    backup = sqlite3_backup_init(dest, "main", src, "main");
+    if (backup == NULL) {
+        eprintf("Cannot start backup: %s\n", sqlite3_errmsg(dest));
+        sqlite3_close(dest);
+        remove(tmp_path);
+        return FALSE;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &step_start);
+        status = sqlite3_backup_step(backup, pages_per_step);
+        clock_gettime(CLOCK_MONOTONIC, &step_end);
+
+        if (elapsed_ms(&step_start, &step_end) > longest_step)
+            longest_step = elapsed_ms(&step_start, &step_end);
+        steps++;
+
+        int remaining = sqlite3_backup_remaining(backup);
+        page_count = sqlite3_backup_pagecount(backup);
+
+        // the database was written by someone else, SQLite started over...
+        if (last_remaining >= 0 && remaining > last_remaining)
+            restarts++;
+        last_remaining = remaining;
+
+        int percent = (page_count > 0) ? (page_count - remaining) * 100 / page_count : 100;
+        if (percent / 10 != reported / 10) {
+            printf("\rINFO: backup %3d%% (%d/%d pages)...", percent, page_count - remaining, page_count);
+            fflush(stdout);
+            reported = percent;
+        }
+
+        if (status == SQLITE_OK || status == SQLITE_BUSY || status == SQLITE_LOCKED)
+            sqlite3_sleep(sleep_ms);
+    } while (status == SQLITE_OK || status == SQLITE_BUSY || status == SQLITE_LOCKED);
+    printf("\n");
+
+    sqlite3_backup_finish(backup);
+    status = sqlite3_errcode(dest);
+    sqlite3_close(dest);
+
+    if (status != SQLITE_OK) {
+        eprintf("Backup failed: %s\n", sqlite3_errstr(status));
+        remove(tmp_path);
+        return FALSE;
+    }
+
+    if (rename(tmp_path, path) != 0) {
+        eprintf("ERROR: cannot rename %s to %s...\n", tmp_path, path);
+        remove(tmp_path);
+        return FALSE;
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = elapsed_ms(&start, &end) / 1e3;
+    double megabytes = (double)page_count * get_pragma_int(src, "PRAGMA page_size;") / (1024.0 * 1024.0);
+    printf("INFO: backup written to %s: %.2f MiB in %.3f s (%.1f MiB/s), %d steps, "
+           "longest step %.2f ms, %d restart(s)...\n", path, megabytes, seconds,
+           (seconds > 0) ? megabytes / seconds : 0.0, steps, longest_step, restarts);
+    return TRUE;
+}
+
+/* Returns TRUE if the directories a and b ("" for the working directory) are the same.            */
+static int same_directory(const char *a, const char *b)
+{
+    struct stat stat_a, stat_b;
+
+    return stat((*a != '\0') ? a : ".", &stat_a) == 0 && stat((*b != '\0') ? b : ".", &stat_b) == 0 &&
+           stat_a.st_dev == stat_b.st_dev && stat_a.st_ino == stat_b.st_ino;
+}
+
+/* Opens a read only connection to each database file of the current handle in files, chess.db
+ * first and then the shards in order. Returns their number, or ERROR on error.                    */
+static int open_files(sqlite3 *files[SHARDS_MAX + 1])
+{
+    int num_of_files = 0;
+
+    if (!open_database_path(current_db()->catalog_path, &files[num_of_files++], TRUE))
+        return ERROR;
+
+    for (int i = 0; i < get_num_of_shards(); i++) {
+        if (!open_database_path(get_shard(i)->path, &files[num_of_files], TRUE)) {
+            while (num_of_files > 0)
+                sqlite3_close(files[--num_of_files]);
+            return ERROR;
+        }
+        num_of_files++;
+    }
+    return num_of_files;
+}
+
+/* Copies the open database files (see open_files) to path and, for the shards, to their file
+ * names in the directory of path. Refuses to write shards over those of the database.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int copy_files(sqlite3 *files[], int num_of_files, const char *path, int pages_per_step, int sleep_ms)
+{
+    char directory[BACKUP_PATH_MAX], shard_path[BACKUP_PATH_MAX];
+    const char *slash = strrchr(path, '/');
+
+    snprintf(directory, sizeof(directory), "%.*s", (slash != NULL) ? (int)(slash - path + 1) : 0, path);
+    if (num_of_files > 1 && same_directory(directory, current_db()->directory)) {
+        eprintf("ERROR: the shards of the backup would overwrite those of the database, "
+                "choose another directory...\n");
+        return FALSE;
+    }
+
+    for (int i = 1; i < num_of_files; i++) {
+        const char *file = strrchr(get_shard(i - 1)->path, '/');
+
+        file = (file != NULL) ? file + 1 : get_shard(i - 1)->path;
+        if (snprintf(shard_path, sizeof(shard_path), "%s%s", directory, file) >= (int)sizeof(shard_path)) {
+            eprintf("ERROR: backup path too long...\n");
+            return FALSE;
+        }
+        if (!copy_database(files[i], shard_path, pages_per_step, sleep_ms))
+            return FALSE;
+    }
+
+    // (the catalog last, it only names shards that were copied)...
+    return copy_database(files[0], path, pages_per_step, sleep_ms);
+}
+
+/* Writes a consistent copy of the database (of every file, with sharding) to path while it stays
+ * in use, pages_per_step pages at a time with sleep_ms milliseconds for writers between the steps.
+ * Returns TRUE on success and FALSE on error.                                                     */
+int backup_database(const char *path, int pages_per_step, int sleep_ms)
+{
+    sqlite3 *files[SHARDS_MAX + 1];
+    int num_of_files, success;
+
+    if (pages_per_step < 1 || sleep_ms < 0) {
+        eprintf("ERROR: invalid number of pages per step or sleep time...\n");
+        return FALSE;
+    }
+
+    if ((num_of_files = open_files(files)) == ERROR)
+        return FALSE;
+
+    success = copy_files(files, num_of_files, path, pages_per_step, sleep_ms);
+    for (int i = 0; i < num_of_files; i++)
+        sqlite3_close(files[i]);
+    return success;
+}
+
+/* Starts a snapshot schedule in snapshots, nothing is opened yet.                                 */
+void init_snapshots(Snapshots *snapshots)
+{
+    memset(snapshots, 0, sizeof(Snapshots));
+}
+
+/* Takes a snapshot of the database in directory - directory/chess-yyyymmdd-hhmmss.db, or with
+ * sharding chess.db and the shards in directory/chess-yyyymmdd-hhmmss/ - unless no file was written
+ * since the last one of snapshots. Returns TRUE if it was taken, FALSE if skipped and ERROR on
+ * error.                                                                                          */
+int take_snapshot(Snapshots *snapshots, const char *directory)
+{
+    char path[BACKUP_PATH_MAX], stamp[32];
+    int changed = FALSE;
+
+    // the connections are kept open, data_version is relative to them (reopened for new shards)...
+    if (snapshots->num_of_files != get_num_of_shards() + 1) {
+        close_snapshots(snapshots);
+        if ((snapshots->num_of_files = open_files(snapshots->files)) == ERROR) {
+            snapshots->num_of_files = 0;
+            return ERROR;
+        }
+        changed = TRUE;
+    }
+
+    for (int i = 0; i < snapshots->num_of_files; i++) {
+        int version = get_pragma_int(snapshots->files[i], "PRAGMA data_version;");
+        if (version == ERROR) {
+            eprintf("Failed to read data version: %s\n", sqlite3_errmsg(snapshots->files[i]));
+            return ERROR;
+        }
+        changed = changed || version != snapshots->versions[i];
+        snapshots->versions[i] = version;
+    }
+
+    if (!changed) {
+        printf("INFO: no changes since the last snapshot, skipping...\n");
+        return FALSE;
+    }
+
+    time_t now = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+    if (snapshots->num_of_files == 1) {
+        snprintf(path, sizeof(path), "%s/chess-%s.db", directory, stamp);
+    } else {
+        snprintf(path, sizeof(path), "%s/chess-%s", directory, stamp);
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            eprintf("ERROR: cannot create %s...\n", path);
+            return ERROR;
+        }
+        snprintf(path, sizeof(path), "%s/chess-%s/%s", directory, stamp, DATABASE_FILE);
+    }
+
+    if (!copy_files(snapshots->files, snapshots->num_of_files, path, BACKUP_PAGES_PER_STEP, BACKUP_SLEEP_MS))
+        return ERROR;
+    snapshots->taken++;
+    return TRUE;
+}
+
+/* Closes the connections of snapshots.                                                            */
+void close_snapshots(Snapshots *snapshots)
+{
+    for (int i = 0; i < snapshots->num_of_files; i++)
+        sqlite3_close(snapshots->files[i]);
+    snapshots->num_of_files = 0;
+}
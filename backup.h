@@ -0,0 +1,35 @@
+//
+// Created by flimsy on 3/7/22.
+//
+
+#ifndef CHESSDATABASE_BACKUP_H
+#define CHESSDATABASE_BACKUP_H
+
+#include <sqlite3.h>
+
+#include "shard.h"
+
+// Default values. A step copies BACKUP_PAGES_PER_STEP pages under the read lock, writers may
+// proceed during the BACKUP_SLEEP_MS pause between steps.
+#define BACKUP_PAGES_PER_STEP 64
+#define BACKUP_SLEEP_MS 5
+#define SNAPSHOT_INTERVAL_S 60
+
+// Size values.
+#define BACKUP_PATH_MAX 512
+
+/* The state of a snapshot schedule between its rounds: a read only connection to each database
+ * file (chess.db, then the shards) and the PRAGMA data_version it last read.                      */
+typedef struct Snapshots {
+    sqlite3 *files[SHARDS_MAX + 1];
+    int versions[SHARDS_MAX + 1];
+    int num_of_files;
+    int taken;
+} Snapshots;
+
+int backup_database(const char *path, int pages_per_step, int sleep_ms);
+void init_snapshots(Snapshots *snapshots);
+int take_snapshot(Snapshots *snapshots, const char *directory);
+void close_snapshots(Snapshots *snapshots);
+
+#endif //CHESSDATABASE_BACKUP_H
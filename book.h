@@ -0,0 +1,59 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#ifndef CHESSDATABASE_BOOK_H
+#define CHESSDATABASE_BOOK_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "helperFunctions.h"
+#include "chess.h"
+
+// Size values.
+#define BOOK_ENTRY_SIZE 16
+#define BOOK_PLIES 24
+#define BOOK_MIN_GAMES 1
+#define BOOK_MEMORY_MB 64
+#define BOOK_CHUNK_IDS 256
+#define BOOK_MOVES_MAX 64
+
+/* An entry of a Polyglot book: a move played in the position with the key, and its weight.        */
+typedef struct BookEntry {
+    uint64_t key;
+    uint16_t move;              // to file, to rank, from file, from rank, promotion: 3 bits each...
+    uint16_t weight;
+    uint32_t learn;
+} BookEntry;
+
+typedef struct BookOptions {
+    int max_plies;              // positions after more plies are not in the book...
+    int min_games;              // moves played in fewer games are left out...
+    size_t memory_budget;       // bytes of the table counting the moves, spilled to disk when full...
+} BookOptions;
+
+typedef struct BookStats {
+    long games;
+    long moves;                 // (position, move) counts, before min_games...
+    long entries;
+    int runs;                   // sorted runs spilled to disk, 0 if the table never filled...
+    double milliseconds;
+} BookStats;
+
+/* A book file opened for lookups.                                                                 */
+typedef struct Book {
+    FILE *file;
+    long num_of_entries;
+} Book;
+
+uint64_t polyglot_key(const Board *board);
+uint16_t polyglot_move(Move move);
+int book_move(const Board *board, uint16_t encoded, Move *move);
+void book_default_options(BookOptions *options);
+int build_book(const char *path, const BookOptions *options, BookStats *stats);
+int open_book(const char *path, Book *book);
+int book_lookup(const Book *book, uint64_t key, BookEntry entries[], int max_entries);
+void close_book(Book *book);
+
+#endif //CHESSDATABASE_BOOK_H
@@ -0,0 +1,394 @@
+//
+// Created by flimsy on 3/18/22.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "browser.h"
+#include "terminal.h"
+
+/* ********** GAME BROWSER **********
+ * A full screen list of all games, scrolled with the arrow keys, page up/down, home and end.
+ * Only the rows on screen are kept: scrolling reads the rows next to the first or last row on
+ * screen through chessdb_list_window, so neither memory nor the time per key grow with the
+ * length of the list. Typing '/' starts a search narrowing the list with every key typed, 'o'
+ * changes the order, Enter opens the highlighted game and 'g' a game by its id.                  */
+
+// Input modes.
+#define MODE_LIST 0
+#define MODE_SEARCH 1
+#define MODE_GOTO 2
+
+// Columns of a row: id and date, the rest is shared by the names.
+#define ID_WIDTH 9
+#define DATE_WIDTH 10
+
+static const char *order_names[] = {"id", "tournament", "white", "black", "date"};
+
+typedef struct Browser {
+    ChessDb *db;
+    ListRow rows[BROWSER_ROWS_MAX];     // the rows on screen, in list order...
+    ListRow fetched[BROWSER_ROWS_MAX];
+    int num_of_rows;
+    int visible;                        // rows of the list on screen...
+    int cols;
+    int selected;
+    int top;                            // position of rows[0] in the list, -1 if unknown (after end)...
+    int after;                          // rows in the list after the screen, -1 if unknown...
+    int column;                         // the order, see get_sorted_list (0 for id)...
+    int mode;
+    char search[NAME_MAX - 2];
+    char term[NAME_MAX];
+    char input[12];
+    char message[80];
+} Browser;
+
+/* Reads the window of count rows after (before, if backward) from into b->fetched.
+ * Returns the number of rows read, 0 on error (with a message).                                   */
+static int fetch(Browser *b, int count, const ListRow *from, int backward)
+{
+    int n = chessdb_list_window(b->db, b->fetched, count, b->column, (b->term[0] != '\0') ? b->term : NULL,
+                                from, backward);
+    if (n == ERROR) {
+        snprintf(b->message, sizeof(b->message), "could not read the games");
+        return 0;
+    }
+    return n;
+}
+
+static void load_first(Browser *b)
+{
+    b->num_of_rows = fetch(b, b->visible, NULL, FALSE);
+    memcpy(b->rows, b->fetched, sizeof(ListRow) * b->num_of_rows);
+    b->top = 0;
+    b->after = (b->num_of_rows < b->visible) ? 0 : -1;
+    b->selected = 0;
+}
+
+static void load_last(Browser *b)
+{
+    b->num_of_rows = fetch(b, b->visible, NULL, TRUE);
+    memcpy(b->rows, b->fetched, sizeof(ListRow) * b->num_of_rows);
+    b->top = (b->num_of_rows < b->visible) ? 0 : -1;
+    b->after = 0;
+    b->selected = (b->num_of_rows > 0) ? b->num_of_rows - 1 : 0;
+}
+
+/* Reads the screen again from its first row on (after a change of the games or of the size).   */
+static void reload(Browser *b)
+{
+    int top = b->top, selected = b->selected;
+
+    if (b->num_of_rows == 0) {
+        load_first(b);
+        return;
+    }
+
+    // from the row before the first one, which is read again (it may be gone)...
+    if (fetch(b, 1, &b->rows[0], TRUE) == 1) {
+        ListRow before = b->fetched[0];
+        b->num_of_rows = fetch(b, b->visible, &before, FALSE);
+        memcpy(b->rows, b->fetched, sizeof(ListRow) * b->num_of_rows);
+        b->top = top;
+        b->selected = (selected < b->num_of_rows) ? selected : b->num_of_rows - 1;
+        if (b->selected < 0)
+            b->selected = 0;
+    } else {
+        load_first(b);
+        b->selected = (selected < b->num_of_rows) ? selected : 0;
+    }
+}
+
+/* Scrolls the screen count rows down. Returns the number of rows scrolled.                        */
+static int scroll_down(Browser *b, int count)
+{
+    int n, drop;
+
+    if (b->num_of_rows == 0)
+        return 0;
+    if ((n = fetch(b, count, &b->rows[b->num_of_rows - 1], FALSE)) < count)
+        b->after = 0;           // the end of the list is reached...
+    else if (b->after > 0)
+        b->after = (b->after > n) ? b->after - n : 0;
+    if (n == 0)
+        return 0;
+
+    drop = b->num_of_rows + n - b->visible;
+    if (drop > 0) {
+        memmove(b->rows, b->rows + drop, sizeof(ListRow) * (b->num_of_rows - drop));
+        b->num_of_rows -= drop;
+        if (b->top >= 0)
+            b->top += drop;
+    }
+    memcpy(b->rows + b->num_of_rows, b->fetched, sizeof(ListRow) * n);
+    b->num_of_rows += n;
+    return n;
+}
+
+/* Scrolls the screen count rows up. Returns the number of rows scrolled.                          */
+static int scroll_up(Browser *b, int count)
+{
+    int n, keep;
+
+    if (b->num_of_rows == 0)
+        return 0;
+    if ((n = fetch(b, count, &b->rows[0], TRUE)) < count)
+        b->top = n;             // the start of the list is reached...
+    if (n == 0)
+        return 0;
+
+    keep = (b->num_of_rows < b->visible - n) ? b->num_of_rows : b->visible - n;
+    if (b->after >= 0)
+        b->after += b->num_of_rows - keep;
+    memmove(b->rows + n, b->rows, sizeof(ListRow) * keep);
+    memcpy(b->rows, b->fetched, sizeof(ListRow) * n);
+    b->num_of_rows = n + keep;
+    if (b->top >= 0)
+        b->top -= n;
+    return n;
+}
+
+/* Appends text to line (at *length), cut or padded to width characters (UTF-8).                  */
+static void append_field(char *line, int *length, const char *text, int width)
+{
+    int chars = 0;
+
+    for (; *text != '\0'; text++) {
+        if ((*text & 0xC0) != 0x80 && chars++ == width)
+            break;
+        line[(*length)++] = *text;
+    }
+    for (; chars < width; chars++)
+        line[(*length)++] = ' ';
+}
+
+/* Draws the whole screen with one write.                                                          */
+static void draw(const Browser *b, char *frame)
+{
+    int length = 0, names = b->cols - ID_WIDTH - DATE_WIDTH, player_width = names / 3;
+    char number[16], status[NAME_MAX + 120];
+
+    if (player_width < 1)
+        player_width = 1;
+
+    length += sprintf(frame, "\033[H\033[7m");
+    append_field(frame, &length, "      Id", ID_WIDTH);
+    append_field(frame, &length, " Date", DATE_WIDTH);
+    append_field(frame, &length, "White", player_width);
+    append_field(frame, &length, "Black", player_width);
+    append_field(frame, &length, "Tournament", names - 2 * player_width);
+    length += sprintf(frame + length, "\033[0m\r\n");
+
+    for (int i = 0; i < b->visible; i++) {
+        if (i < b->num_of_rows) {
+            const SampleInfo *sample = &b->rows[i].sample;
+            if (i == b->selected)
+                length += sprintf(frame + length, "\033[7m");
+            snprintf(number, sizeof(number), "%8d", sample->id);
+            append_field(frame, &length, number, ID_WIDTH);
+            append_field(frame, &length, sample->date, DATE_WIDTH);
+            append_field(frame, &length, sample->white_name, player_width);
+            append_field(frame, &length, sample->black_name, player_width);
+            append_field(frame, &length, sample->name, names - 2 * player_width);
+            if (i == b->selected)
+                length += sprintf(frame + length, "\033[0m");
+        }
+        length += sprintf(frame + length, "\033[K\r\n");
+    }
+
+    // status line, short of the last column (the terminal would scroll)...
+    if (b->mode == MODE_SEARCH)
+        snprintf(status, sizeof(status), "Search: %s_", b->search);
+    else if (b->mode == MODE_GOTO)
+        snprintf(status, sizeof(status), "Open game id: %s_", b->input);
+    else if (b->message[0] != '\0')
+        snprintf(status, sizeof(status), "%s", b->message);
+    else if (b->num_of_rows == 0)
+        snprintf(status, sizeof(status), "no games  (/ search, o order, g id, q quit)");
+    else
+        snprintf(status, sizeof(status), "row %d%s by %s%s%s%s  (/ search, o order, g id, Enter open, q quit)",
+                 (b->top >= 0) ? b->top + b->selected + 1 : b->after + b->num_of_rows - b->selected,
+                 (b->top >= 0) ? "" : " from the end",
+                 order_names[b->column], (b->term[0] != '\0') ? ", matching '" : "", b->search,
+                 (b->term[0] != '\0') ? "'" : "");
+    append_field(frame, &length, status, b->cols - 1);
+
+    fwrite(frame, 1, (size_t)length, stdout);
+    fflush(stdout);
+}
+
+/* Sets the search pattern from the search text, the list starts over.                            */
+static void apply_search(Browser *b)
+{
+    if (b->search[0] != '\0')
+        snprintf(b->term, sizeof(b->term), "%%%s%%", b->search);
+    else
+        b->term[0] = '\0';
+}
+
+/* Handles key in the list mode. Returns the id of a game to open, FALSE to go on or ERROR to
+ * leave the browser.                                                                              */
+static int list_key(Browser *b, int key)
+{
+    switch (key) {
+        case KEY_DOWN:
+            if (b->selected < b->num_of_rows - 1)
+                b->selected++;
+            else
+                scroll_down(b, 1);
+            break;
+        case KEY_UP:
+            if (b->selected > 0)
+                b->selected--;
+            else
+                scroll_up(b, 1);
+            break;
+        case KEY_PAGE_DOWN:
+            if (scroll_down(b, b->visible) < b->visible)
+                b->selected = b->num_of_rows - 1;
+            break;
+        case KEY_PAGE_UP:
+            if (scroll_up(b, b->visible) < b->visible)
+                b->selected = 0;
+            break;
+        case KEY_HOME:
+            load_first(b);
+            break;
+        case KEY_END:
+            load_last(b);
+            break;
+        case KEY_ENTER:
+            return (b->num_of_rows > 0) ? b->rows[b->selected].sample.id : FALSE;
+        case '/':
+            b->mode = MODE_SEARCH;
+            break;
+        case 'g':
+            b->mode = MODE_GOTO;
+            b->input[0] = '\0';
+            break;
+        case 'o':
+            b->column = (b->column + 1) % 5;
+            load_first(b);
+            break;
+        case 'q':
+        case KEY_ESCAPE:
+        case KEY_CTRL_C:
+            return ERROR;
+        default:
+            break;
+    }
+    return FALSE;
+}
+
+/* Handles key while a search or a game id is typed. Returns as list_key, *changed is set to TRUE
+ * if the search text changed.                                                                     */
+static int input_key(Browser *b, int key, int *changed)
+{
+    char *text = (b->mode == MODE_SEARCH) ? b->search : b->input;
+    size_t size = (b->mode == MODE_SEARCH) ? sizeof(b->search) : sizeof(b->input);
+    size_t length = strlen(text);
+
+    if (key == KEY_CTRL_C)
+        return ERROR;
+
+    if (key == KEY_ENTER || key == KEY_ESCAPE) {
+        int id = (b->mode == MODE_GOTO && key == KEY_ENTER && length > 0) ? atoi(text) : FALSE;
+        if (b->mode == MODE_SEARCH && key == KEY_ESCAPE && length > 0) {
+            text[0] = '\0';
+            *changed = TRUE;
+        }
+        b->mode = MODE_LIST;
+        return id;
+    }
+
+    if (key == KEY_BACKSPACE && length > 0) {
+        // a whole UTF-8 character...
+        while (length > 0 && (text[--length] & 0xC0) == 0x80)
+            ;
+        text[length] = '\0';
+        *changed = (b->mode == MODE_SEARCH);
+    } else if (key >= 32 && key < 256 && key != 127 && length + 1 < size &&
+               (b->mode == MODE_SEARCH || (key >= '0' && key <= '9'))) {
+        text[length] = (char)key;
+        text[length + 1] = '\0';
+        *changed = (b->mode == MODE_SEARCH);
+    }
+    return FALSE;
+}
+
+/* Runs the game browser on db until the user leaves it. A game chosen by the user is passed to
+ * open_game, with the terminal back in its normal mode.
+ * Returns TRUE when the user left, FALSE if the terminal does not support the browser.            */
+int browse_games(ChessDb *db, void (*open_game)(int game_id))
+{
+    Browser *b = calloc(1, sizeof(Browser));
+    char *frame = malloc((size_t)(BROWSER_ROWS_MAX + 2) * (BROWSER_COLS_MAX * 4 + 32));
+    int rows, cols, key, opened, id = FALSE;
+
+    if (b == NULL || frame == NULL) {
+        eprintf("ERROR: could not allocate memory for the browser...\n");
+        free(b);
+        free(frame);
+        return FALSE;
+    }
+    if (!enter_full_screen()) {
+        eprintf("ERROR: the browser needs a terminal...\n");
+        free(b);
+        free(frame);
+        return FALSE;
+    }
+
+    b->db = db;
+    get_terminal_size(&rows, &cols);
+    b->visible = (rows - 2 < BROWSER_ROWS_MAX) ? rows - 2 : BROWSER_ROWS_MAX;
+    b->cols = (cols < BROWSER_COLS_MAX) ? cols : BROWSER_COLS_MAX;
+    if (b->visible < 1)
+        b->visible = 1;
+    load_first(b);
+
+    while (id != ERROR) {
+        int search_changed = FALSE;
+
+        draw(b, frame);
+        if ((key = read_key()) == KEY_EOF)
+            break;
+        b->message[0] = '\0';
+
+        // handling all keys typed meanwhile before reading the list again (fast typing)...
+        do {
+            id = (b->mode == MODE_LIST) ? list_key(b, key) : input_key(b, key, &search_changed);
+        } while (id == FALSE && is_key_pending() && (key = read_key()) != KEY_EOF);
+
+        if (search_changed) {
+            apply_search(b);
+            load_first(b);
+        }
+
+        if ((opened = (id > 0))) {
+            leave_full_screen();
+            open_game(id);
+            enter_full_screen();
+            id = FALSE;
+        }
+
+        // the size may have changed, the games as well if one was opened...
+        get_terminal_size(&rows, &cols);
+        rows = (rows - 2 < BROWSER_ROWS_MAX) ? rows - 2 : BROWSER_ROWS_MAX;
+        cols = (cols < BROWSER_COLS_MAX) ? cols : BROWSER_COLS_MAX;
+        if (rows < 1)
+            rows = 1;
+        if (rows != b->visible || cols != b->cols || opened) {
+            b->visible = rows;
+            b->cols = cols;
+            if (b->mode == MODE_LIST)
+                reload(b);
+            fputs("\033[2J", stdout);
+        }
+    }
+
+    leave_full_screen();
+    free(b);
+    free(frame);
+    return TRUE;
+}
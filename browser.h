@@ -0,0 +1,16 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#ifndef CHESSDATABASE_BROWSER_H
+#define CHESSDATABASE_BROWSER_H
+
+#include "chessdb.h"
+
+// Size values (a larger terminal shows this much of the list).
+#define BROWSER_ROWS_MAX 200
+#define BROWSER_COLS_MAX 400
+
+int browse_games(ChessDb *db, void (*open_game)(int game_id));
+
+#endif //CHESSDATABASE_BROWSER_H
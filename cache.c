@@ -0,0 +1,359 @@
+//
+// Created by flimsy on 2/10/22.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "context.h"
+#include "database.h"
+
+/* ********** RESULT CACHE **********
+ * Listings and searches are cached by (query kind, sort column, search term, page). Every entry
+ * remembers the data generation it was read at, the generation is bumped by every write to the
+ * database, so any entry read before a write is stale and is dropped on its next lookup.
+ * Entries are kept in a hash table for lookups and in a doubly linked list in order of use,
+ * the least recently used entries are evicted whenever the memory budget is exceeded.
+ * Every database handle has its own cache (see context.h).                                        */
+
+typedef struct CacheEntry {
+    int kind;
+    int column;
+    int page;
+    char *term;
+    unsigned long hash;
+    unsigned long generation;
+    int num_of_samples;
+    SampleInfo *samples;
+    size_t size;
+    struct CacheEntry *next_in_bucket;
+    struct CacheEntry *newer;
+    struct CacheEntry *older;
+} CacheEntry;
+
+/* FNV-1a hash over the cache key.                                                                 */
+static unsigned long hash_key(int kind, int column, const char *term, int page)
+{
+    unsigned long hash = 2166136261UL;
+    int values[3] = {kind, column, page};
+
+    for (int i = 0; i < 3; i++) {
+        hash ^= (unsigned long)values[i];
+        hash *= 16777619UL;
+    }
+    for (const char *c = (term == NULL) ? "" : term; *c != '\0'; c++) {
+        hash ^= (unsigned char)*c;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+static int is_same_key(const CacheEntry *entry, unsigned long hash, int kind, int column,
+                       const char *term, int page)
+{
+    return entry->hash == hash && entry->kind == kind && entry->column == column &&
+           entry->page == page && strcmp(entry->term, (term == NULL) ? "" : term) == 0;
+}
+
+/* Unlinks entry from the use order list.                                                          */
+static void unlink_entry(ResultCache *cache, CacheEntry *entry)
+{
+    if (entry->newer != NULL)
+        entry->newer->older = entry->older;
+    else
+        cache->newest = entry->older;
+
+    if (entry->older != NULL)
+        entry->older->newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+
+    entry->newer = entry->older = NULL;
+}
+
+/* Links entry in as the most recently used.                                                       */
+static void link_newest(ResultCache *cache, CacheEntry *entry)
+{
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    if (cache->newest != NULL)
+        cache->newest->newer = entry;
+    cache->newest = entry;
+    if (cache->oldest == NULL)
+        cache->oldest = entry;
+}
+
+/* Removes entry from the cache and releases its memory.                                           */
+static void remove_entry(ResultCache *cache, CacheEntry *entry)
+{
+    CacheEntry **link = &cache->buckets[entry->hash % RESULT_CACHE_BUCKETS];
+
+    while (*link != entry)
+        link = &(*link)->next_in_bucket;
+    *link = entry->next_in_bucket;
+
+    unlink_entry(cache, entry);
+    cache->stats.bytes_used -= entry->size;
+    cache->stats.entries--;
+
+    free(entry->term);
+    free(entry->samples);
+    free(entry);
+}
+
+/* Evicts least recently used entries until needed bytes fits in the budget.                       */
+static void evict_for(ResultCache *cache, size_t needed)
+{
+    while (cache->oldest != NULL && cache->stats.bytes_used + needed > cache->stats.budget) {
+        remove_entry(cache, cache->oldest);
+        cache->stats.evictions++;
+    }
+}
+
+/* Marks all cached results as outdated. Must be called on every write to the database.            */
+void bump_data_generation()
+{
+    current_db()->cache.data_generation++;
+}
+
+unsigned long get_data_generation()
+{
+    return current_db()->cache.data_generation;
+}
+
+/* Sets the memory budget (in bytes) of the result cache, evicting entries if required.
+ * A budget of 0 disables the cache.                                                               */
+void set_result_cache_budget(size_t budget)
+{
+    ResultCache *cache = &current_db()->cache;
+
+    cache->stats.budget = budget;
+    evict_for(cache, 0);
+}
+
+/* Removes all entries from the result cache. Hit and miss counters are kept.                      */
+void clear_result_cache()
+{
+    ResultCache *cache = &current_db()->cache;
+
+    while (cache->oldest != NULL)
+        remove_entry(cache, cache->oldest);
+}
+
+/* Copies the cache counters into stats.                                                           */
+void get_result_cache_stats(CacheStats *stats)
+{
+    ResultCache *cache = &current_db()->cache;
+
+    *stats = cache->stats;
+    stats->generation = cache->data_generation;
+    stats->statement_hits = current_db()->statements.hits;
+    stats->statement_misses = current_db()->statements.misses;
+}
+
+/* Looks up a cached result. On a hit the samples are copied into arr_sample and the number of
+ * samples is returned, on a miss (or an outdated entry) 0 (FALSE) is returned.                    */
+int lookup_cached_result(int kind, int column, const char *term, int page, SampleInfo arr_sample[])
+{
+    ResultCache *cache = &current_db()->cache;
+    unsigned long hash = hash_key(kind, column, term, page);
+    CacheEntry *entry = cache->buckets[hash % RESULT_CACHE_BUCKETS];
+
+    while (entry != NULL && !is_same_key(entry, hash, kind, column, term, page))
+        entry = entry->next_in_bucket;
+
+    if (entry == NULL) {
+        cache->stats.misses++;
+        return FALSE;
+    }
+
+    if (entry->generation != cache->data_generation) {
+        remove_entry(cache, entry);
+        cache->stats.misses++;
+        return FALSE;
+    }
+
+    unlink_entry(cache, entry);
+    link_newest(cache, entry);
+    memcpy(arr_sample, entry->samples, sizeof(SampleInfo) * entry->num_of_samples);
+    cache->stats.hits++;
+    return entry->num_of_samples;
+}
+
+/* Stores the result of a query in the cache, replacing an older result with the same key.         */
+void store_cached_result(int kind, int column, const char *term, int page,
+                         const SampleInfo arr_sample[], int num_of_samples)
+{
+    ResultCache *cache = &current_db()->cache;
+    unsigned long hash = hash_key(kind, column, term, page);
+    const char *key_term = (term == NULL) ? "" : term;
+    size_t size = sizeof(CacheEntry) + strlen(key_term) + 1 + sizeof(SampleInfo) * num_of_samples;
+    CacheEntry *entry;
+
+    if (num_of_samples <= 0 || size > cache->stats.budget)
+        return;
+
+    for (entry = cache->buckets[hash % RESULT_CACHE_BUCKETS]; entry != NULL; entry = entry->next_in_bucket) {
+        if (is_same_key(entry, hash, kind, column, term, page)) {
+            remove_entry(cache, entry);
+            break;
+        }
+    }
+
+    evict_for(cache, size);
+
+    entry = calloc(1, sizeof(CacheEntry));
+    if (entry == NULL)
+        return;
+    entry->term = malloc(strlen(key_term) + 1);
+    entry->samples = malloc(sizeof(SampleInfo) * num_of_samples);
+    if (entry->term == NULL || entry->samples == NULL) {
+        free(entry->term);
+        free(entry->samples);
+        free(entry);
+        return;
+    }
+
+    strcpy(entry->term, key_term);
+    memcpy(entry->samples, arr_sample, sizeof(SampleInfo) * num_of_samples);
+    entry->kind = kind;
+    entry->column = column;
+    entry->page = page;
+    entry->hash = hash;
+    entry->generation = cache->data_generation;
+    entry->num_of_samples = num_of_samples;
+    entry->size = size;
+
+    entry->next_in_bucket = cache->buckets[hash % RESULT_CACHE_BUCKETS];
+    cache->buckets[hash % RESULT_CACHE_BUCKETS] = entry;
+    link_newest(cache, entry);
+
+    cache->stats.bytes_used += size;
+    cache->stats.entries++;
+}
+
+/* ********** STATEMENT CACHE **********
+ * Every database handle keeps one connection to its routed file, and the statements do_statement
+ * prepared on it, until the handle is closed or routed to another file. Only the thread holding
+ * the handle (inside a chessdb_ call) uses them, worker threads and the maintenance thread open
+ * connections of their own. A statement is found by the address and the text of its SQL, so one
+ * formatted into a reused buffer is prepared again when its text differs. After an error the
+ * connection and all its statements are dropped.                                                  */
+
+/* Returns the statement cache of the current handle, or NULL if the calling thread does not
+ * hold the handle.                                                                                */
+static StatementCache *own_statement_cache()
+{
+    ChessDb *handle = current_db();
+
+    if (!handle->owned || !pthread_equal(handle->owner, pthread_self()))
+        return NULL;
+    return &handle->statements;
+}
+
+/* Opens the cached connection to the routed file, unless it is open already.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int open_statement_connection(StatementCache *statements)
+{
+    const char *routed_path = current_db()->routed_path;
+
+    if (statements->db != NULL && strcmp(statements->path, routed_path) != 0)
+        clear_statement_cache();
+    if (statements->db != NULL)
+        return TRUE;
+
+    if (!open_database_path(routed_path, &statements->db, FALSE)) {
+        statements->db = NULL;
+        return FALSE;
+    }
+    strcpy(statements->path, routed_path);
+    return TRUE;
+}
+
+/* Stores the connection to the routed file in db: the cached one if the calling thread holds the
+ * handle, otherwise a new one. Close it with close_cached_connection.
+ * Returns TRUE on success and FALSE on error.                                                     */
+int open_cached_connection(sqlite3 **db)
+{
+    StatementCache *statements = own_statement_cache();
+
+    if (statements == NULL || !open_statement_connection(statements))
+        return open_database_path(current_db()->routed_path, db, FALSE);
+
+    // (a call failing halfway may have left its transaction open)...
+    if (!sqlite3_get_autocommit(statements->db))
+        sqlite3_exec(statements->db, "ROLLBACK;", NULL, NULL, NULL);
+    *db = statements->db;
+    return TRUE;
+}
+
+/* Closes db, unless it is the cached connection.                                                  */
+void close_cached_connection(sqlite3 *db)
+{
+    if (!is_cached_connection(db))
+        sqlite3_close(db);
+}
+
+/* Returns the cached statement of sql, ready for binding, and stores its connection in db. db is
+ * either NULL or the cached connection (see open_cached_connection).
+ * Returns NULL if the cache can not be used, or on error: the caller has to prepare the statement
+ * itself then.                                                                                    */
+sqlite3_stmt *get_cached_statement(const char *sql, sqlite3 **db)
+{
+    StatementCache *statements = own_statement_cache();
+    sqlite3_stmt *stmt;
+    int slot;
+
+    if (statements == NULL)
+        return NULL;
+    // (a connection in use is never replaced)...
+    if (*db != NULL && (*db != statements->db || strcmp(statements->path, current_db()->routed_path) != 0))
+        return NULL;
+    if (!open_statement_connection(statements))
+        return NULL;
+
+    for (slot = 0; slot < statements->num_of_stmts; slot++) {
+        if (statements->sql[slot] == sql && strcmp(sqlite3_sql(statements->stmts[slot]), sql) == 0) {
+            statements->hits++;
+            *db = statements->db;
+            return statements->stmts[slot];
+        }
+    }
+
+    if (sqlite3_prepare_v2(statements->db, sql, -1, &stmt, 0) != SQLITE_OK)
+        return NULL;
+    statements->misses++;
+
+    // a full cache replaces its statements in turn...
+    if (statements->num_of_stmts < STATEMENT_CACHE_MAX) {
+        slot = statements->num_of_stmts++;
+    } else {
+        slot = statements->next_replaced;
+        statements->next_replaced = (slot + 1) % STATEMENT_CACHE_MAX;
+        sqlite3_finalize(statements->stmts[slot]);
+    }
+    statements->stmts[slot] = stmt;
+    statements->sql[slot] = sql;
+    *db = statements->db;
+    return stmt;
+}
+
+/* Returns TRUE if db is the cached connection of the current handle.                              */
+int is_cached_connection(sqlite3 *db)
+{
+    return db != NULL && db == current_db()->statements.db;
+}
+
+/* Finalizes all cached statements and closes their connection. Hit and miss counters are kept.    */
+void clear_statement_cache()
+{
+    StatementCache *statements = &current_db()->statements;
+
+    for (int i = 0; i < statements->num_of_stmts; i++)
+        sqlite3_finalize(statements->stmts[i]);
+    sqlite3_close(statements->db);
+    statements->db = NULL;
+    statements->num_of_stmts = 0;
+    statements->next_replaced = 0;
+}
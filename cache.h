@@ -0,0 +1,72 @@
+//
+// Created by flimsy on 2/10/22.
+//
+
+#ifndef CHESSDATABASE_CACHE_H
+#define CHESSDATABASE_CACHE_H
+
+#include <stddef.h>
+#include <sqlite3.h>
+
+#include "helperFunctions.h"
+#include "shard.h"
+
+// Query kinds.
+#define QUERY_UNSORTED 1
+#define QUERY_SORTED 2
+#define QUERY_SEARCH 3
+#define QUERY_DATE_RANGE 4
+
+// Size values.
+#define RESULT_CACHE_BUDGET (4 * 1024 * 1024)
+#define RESULT_CACHE_BUCKETS 256
+#define STATEMENT_CACHE_MAX 32
+
+typedef struct CacheStats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long generation;
+    int entries;
+    size_t bytes_used;
+    size_t budget;
+    unsigned long statement_hits;
+    unsigned long statement_misses;
+} CacheStats;
+
+/* The result cache of one database handle (entries are private to cache.c).                       */
+typedef struct ResultCache {
+    struct CacheEntry *buckets[RESULT_CACHE_BUCKETS];
+    struct CacheEntry *newest;
+    struct CacheEntry *oldest;
+    unsigned long data_generation;
+    CacheStats stats;
+} ResultCache;
+
+/* The prepared statements of one database handle, all on its connection to the file at path.      */
+typedef struct StatementCache {
+    sqlite3 *db;
+    char path[SHARD_PATH_MAX];
+    sqlite3_stmt *stmts[STATEMENT_CACHE_MAX];
+    const char *sql[STATEMENT_CACHE_MAX];
+    int num_of_stmts;
+    int next_replaced;
+    unsigned long hits;
+    unsigned long misses;
+} StatementCache;
+
+void bump_data_generation();
+unsigned long get_data_generation();
+void set_result_cache_budget(size_t budget);
+void clear_result_cache();
+void get_result_cache_stats(CacheStats *stats);
+int lookup_cached_result(int kind, int column, const char *term, int page, SampleInfo arr_sample[]);
+void store_cached_result(int kind, int column, const char *term, int page,
+                         const SampleInfo arr_sample[], int num_of_samples);
+int open_cached_connection(sqlite3 **db);
+void close_cached_connection(sqlite3 *db);
+sqlite3_stmt *get_cached_statement(const char *sql, sqlite3 **db);
+int is_cached_connection(sqlite3 *db);
+void clear_statement_cache();
+
+#endif //CHESSDATABASE_CACHE_H
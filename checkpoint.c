@@ -0,0 +1,111 @@
+//
+// Created by flimsy on 3/16/22.
+//
+#include <string.h>
+
+#include "checkpoint.h"
+
+/* ********** BOARD CHECKPOINTS **********
+ * The position after every CHECKPOINT_PLIES plies of a game is kept with its moves (moves.checkpoints,
+ * the packed boards one after another), so the position at any ply is the nearest checkpoint
+ * before it and at most CHECKPOINT_PLIES - 1 plies replayed, however long the game.
+ * A board is packed into CHECKPOINT_SIZE bytes: the 64 squares two per byte (a piece fits in a
+ * nibble), side to move and castling rights, en passant square + 1 (0 for none), halfmove clock
+ * and fullmove number (2 bytes, little endian).                                                   */
+
+static void pack_board(const Board *board, unsigned char packed[CHECKPOINT_SIZE])
+{
+    for (int square = 0; square < 64; square += 2)
+        packed[square / 2] = (unsigned char)(board->squares[square] | (board->squares[square + 1] << 4));
+    packed[32] = (unsigned char)(board->side_to_move | (board->castling << 1));
+    packed[33] = (unsigned char)(board->en_passant + 1);
+    packed[34] = (unsigned char)((board->halfmove_clock < 255) ? board->halfmove_clock : 255);
+    packed[35] = (unsigned char)(board->fullmove_number & 0xff);
+    packed[36] = (unsigned char)(board->fullmove_number >> 8);
+}
+
+static void unpack_board(const unsigned char packed[CHECKPOINT_SIZE], Board *board)
+{
+    for (int square = 0; square < 64; square += 2) {
+        board->squares[square] = packed[square / 2] & 0x0f;
+        board->squares[square + 1] = packed[square / 2] >> 4;
+    }
+    board->side_to_move = packed[32] & 1;
+    board->castling = packed[32] >> 1;
+    board->en_passant = packed[33] - 1;
+    board->halfmove_clock = packed[34];
+    board->fullmove_number = packed[35] | (packed[36] << 8);
+}
+
+/* Returns the move of ply (0 is white's first move) of game_moves, or NULL if the game has no
+ * such ply.                                                                                       */
+static const char *ply_move(const GameMoves *game_moves, int ply)
+{
+    const char *move;
+
+    if (ply / 2 >= game_moves->move_number || ply / 2 >= MOVES_MAX)
+        return NULL;
+    move = game_moves->moves[ply / 2][ply % 2];
+    return (*move == '\0' || strcmp(move, "-") == 0 || strcmp(move, "end") == 0) ? NULL : move;
+}
+
+/* Replays the first move_count moves of game_moves and stores a checkpoint after every
+ * CHECKPOINT_PLIES plies, up to the first missing or illegal move.
+ * Returns the number of checkpoints.                                                              */
+int build_checkpoints(GameMoves *game_moves, int move_count)
+{
+    int saved_count = game_moves->move_number, ply;
+    const char *san;
+    Board board;
+    Move move;
+
+    game_moves->move_number = move_count;
+    game_moves->num_of_checkpoints = 0;
+    board_init(&board);
+
+    for (ply = 0; (san = ply_move(game_moves, ply)) != NULL && parse_san(&board, san, &move); ply++) {
+        make_move(&board, move);
+        if ((ply + 1) % CHECKPOINT_PLIES == 0 && game_moves->num_of_checkpoints < CHECKPOINTS_MAX)
+            pack_board(&board, game_moves->checkpoints[game_moves->num_of_checkpoints++]);
+    }
+
+    game_moves->move_number = saved_count;
+    return game_moves->num_of_checkpoints;
+}
+
+/* Takes the checkpoints stored as blob (size bytes, NULL if never built) into game_moves.           */
+void load_checkpoints(GameMoves *game_moves, const void *blob, int size)
+{
+    int count = (blob != NULL) ? size / CHECKPOINT_SIZE : 0;
+
+    game_moves->num_of_checkpoints = (count < CHECKPOINTS_MAX) ? count : CHECKPOINTS_MAX;
+    if (game_moves->num_of_checkpoints > 0)
+        memcpy(game_moves->checkpoints, blob, (size_t)game_moves->num_of_checkpoints * CHECKPOINT_SIZE);
+}
+
+/* Stores the position after ply plies (0: the starting position) of game_moves in board, restored
+ * from the nearest checkpoint. Returns TRUE on success, FALSE if the game has no such ply (or an
+ * illegal move before it).                                                                        */
+int get_position_at_ply(const GameMoves *game_moves, int ply, Board *board)
+{
+    int checkpoint = ply / CHECKPOINT_PLIES;
+    const char *san;
+    Move move;
+
+    if (ply < 0)
+        return FALSE;
+
+    if (checkpoint > game_moves->num_of_checkpoints)
+        checkpoint = game_moves->num_of_checkpoints;
+    if (checkpoint > 0)
+        unpack_board(game_moves->checkpoints[checkpoint - 1], board);
+    else
+        board_init(board);
+
+    for (int from = checkpoint * CHECKPOINT_PLIES; from < ply; from++) {
+        if ((san = ply_move(game_moves, from)) == NULL || !parse_san(board, san, &move))
+            return FALSE;
+        make_move(board, move);
+    }
+    return TRUE;
+}
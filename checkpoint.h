@@ -0,0 +1,15 @@
+//
+// Created by flimsy on 3/16/22.
+//
+
+#ifndef CHESSDATABASE_CHECKPOINT_H
+#define CHESSDATABASE_CHECKPOINT_H
+
+#include "helperFunctions.h"
+#include "chess.h"
+
+int build_checkpoints(GameMoves *game_moves, int move_count);
+void load_checkpoints(GameMoves *game_moves, const void *blob, int size);
+int get_position_at_ply(const GameMoves *game_moves, int ply, Board *board);
+
+#endif //CHESSDATABASE_CHECKPOINT_H
@@ -0,0 +1,601 @@
+//
+// Created by flimsy on 2/17/22.
+//
+#include <stdio.h>
+#include <string.h>
+
+#include "chess.h"
+
+/* ********** BOARD AND MOVE GENERATION **********                                                 */
+
+static const int knight_steps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2},
+                                       {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+static const int king_steps[8][2] = {{0, 1}, {1, 1}, {1, 0}, {1, -1},
+                                     {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}};
+static const int rook_steps[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
+static const int bishop_steps[4][2] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+
+static const char piece_letters[] = " PNBRQK";
+
+/* Returns the square file/rank steps away from square, or NO_SQUARE if off the board.            */
+static int step_square(int square, int file_step, int rank_step)
+{
+    int file = FILE_OF(square) + file_step, rank = RANK_OF(square) + rank_step;
+
+    if (file < 0 || file > 7 || rank < 0 || rank > 7)
+        return NO_SQUARE;
+    return SQUARE(file, rank);
+}
+
+static unsigned char colored(int type, int color)
+{
+    return (unsigned char)((color == BLACK_PLAYER) ? (type | BLACK_PIECE) : type);
+}
+
+/* Sets up the standard starting position.                                                         */
+void board_init(Board *board)
+{
+    static const int back_rank[8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
+
+    memset(board, 0, sizeof(Board));
+    for (int file = 0; file < 8; file++) {
+        board->squares[SQUARE(file, 0)] = colored(back_rank[file], WHITE_PLAYER);
+        board->squares[SQUARE(file, 1)] = colored(PAWN, WHITE_PLAYER);
+        board->squares[SQUARE(file, 6)] = colored(PAWN, BLACK_PLAYER);
+        board->squares[SQUARE(file, 7)] = colored(back_rank[file], BLACK_PLAYER);
+    }
+    board->side_to_move = WHITE_PLAYER;
+    board->castling = CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN | CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN;
+    board->en_passant = NO_SQUARE;
+    board->halfmove_clock = 0;
+    board->fullmove_number = 1;
+}
+
+/* Returns TRUE if any piece of by_color attacks square, FALSE otherwise.                          */
+int is_square_attacked(const Board *board, int square, int by_color)
+{
+    const unsigned char *sq = board->squares;
+    int from, pawn_rank_step = (by_color == WHITE_PLAYER) ? -1 : 1;
+
+    // pawns attack diagonally forward, so look diagonally backwards from the square...
+    for (int file_step = -1; file_step <= 1; file_step += 2) {
+        from = step_square(square, file_step, pawn_rank_step);
+        if (from != NO_SQUARE && sq[from] == colored(PAWN, by_color))
+            return TRUE;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        from = step_square(square, knight_steps[i][0], knight_steps[i][1]);
+        if (from != NO_SQUARE && sq[from] == colored(KNIGHT, by_color))
+            return TRUE;
+        from = step_square(square, king_steps[i][0], king_steps[i][1]);
+        if (from != NO_SQUARE && sq[from] == colored(KING, by_color))
+            return TRUE;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        from = square;
+        while ((from = step_square(from, rook_steps[i][0], rook_steps[i][1])) != NO_SQUARE) {
+            if (sq[from] == EMPTY)
+                continue;
+            if (sq[from] == colored(ROOK, by_color) || sq[from] == colored(QUEEN, by_color))
+                return TRUE;
+            break;
+        }
+
+        from = square;
+        while ((from = step_square(from, bishop_steps[i][0], bishop_steps[i][1])) != NO_SQUARE) {
+            if (sq[from] == EMPTY)
+                continue;
+            if (sq[from] == colored(BISHOP, by_color) || sq[from] == colored(QUEEN, by_color))
+                return TRUE;
+            break;
+        }
+    }
+    return FALSE;
+}
+
+/* Returns TRUE if the king of color is in check, FALSE otherwise (also if there is no king).      */
+int is_in_check(const Board *board, int color)
+{
+    unsigned char king = colored(KING, color);
+
+    for (int square = 0; square < 64; square++) {
+        if (board->squares[square] == king)
+            return is_square_attacked(board, square, !color);
+    }
+    return FALSE;
+}
+
+static int add_move(Move moves[], int count, int from, int to, int promotion, int flags)
+{
+    moves[count].from = (unsigned char)from;
+    moves[count].to = (unsigned char)to;
+    moves[count].promotion = (unsigned char)promotion;
+    moves[count].flags = (unsigned char)flags;
+    return count + 1;
+}
+
+/* Adds a pawn move, expanded into the four promotions (Q, R, B, N) when reaching the last rank.   */
+static int add_pawn_move(Move moves[], int count, int from, int to, int flags)
+{
+    if (RANK_OF(to) == 0 || RANK_OF(to) == 7) {
+        count = add_move(moves, count, from, to, QUEEN, flags);
+        count = add_move(moves, count, from, to, ROOK, flags);
+        count = add_move(moves, count, from, to, BISHOP, flags);
+        return add_move(moves, count, from, to, KNIGHT, flags);
+    }
+    return add_move(moves, count, from, to, EMPTY, flags);
+}
+
+/* Generates all pseudo-legal moves (own king may be left in check) of the side to move,
+ * ordered by from square, then in a fixed direction order. Returns the number of moves.           */
+static int generate_pseudo_moves(const Board *board, Move moves[])
+{
+    const unsigned char *sq = board->squares;
+    int color = board->side_to_move, count = 0, to;
+
+    for (int from = 0; from < 64; from++) {
+        int piece = sq[from];
+        if (piece == EMPTY || PIECE_COLOR(piece) != color)
+            continue;
+
+        switch (PIECE_TYPE(piece)) {
+            case PAWN: {
+                int forward = (color == WHITE_PLAYER) ? 1 : -1;
+                int start_rank = (color == WHITE_PLAYER) ? 1 : 6;
+
+                to = step_square(from, 0, forward);
+                if (to != NO_SQUARE && sq[to] == EMPTY) {
+                    count = add_pawn_move(moves, count, from, to, 0);
+                    if (RANK_OF(from) == start_rank && sq[to + forward * 8] == EMPTY)
+                        count = add_move(moves, count, from, to + forward * 8, EMPTY, MOVE_DOUBLE_PUSH);
+                }
+                for (int file_step = -1; file_step <= 1; file_step += 2) {
+                    to = step_square(from, file_step, forward);
+                    if (to == NO_SQUARE)
+                        continue;
+                    if (sq[to] != EMPTY && PIECE_COLOR(sq[to]) != color)
+                        count = add_pawn_move(moves, count, from, to, MOVE_CAPTURE);
+                    else if (to == board->en_passant)
+                        count = add_move(moves, count, from, to, EMPTY, MOVE_CAPTURE | MOVE_EN_PASSANT);
+                }
+                break;
+            }
+            case KNIGHT:
+            case KING: {
+                const int (*steps)[2] = (PIECE_TYPE(piece) == KNIGHT) ? knight_steps : king_steps;
+                for (int i = 0; i < 8; i++) {
+                    to = step_square(from, steps[i][0], steps[i][1]);
+                    if (to == NO_SQUARE)
+                        continue;
+                    if (sq[to] == EMPTY)
+                        count = add_move(moves, count, from, to, EMPTY, 0);
+                    else if (PIECE_COLOR(sq[to]) != color)
+                        count = add_move(moves, count, from, to, EMPTY, MOVE_CAPTURE);
+                }
+                break;
+            }
+            default: {
+                int type = PIECE_TYPE(piece);
+                for (int i = 0; i < 8; i++) {
+                    const int *step;
+                    if (i < 4) {
+                        if (type == BISHOP)
+                            continue;
+                        step = rook_steps[i];
+                    } else {
+                        if (type == ROOK)
+                            continue;
+                        step = bishop_steps[i - 4];
+                    }
+
+                    to = from;
+                    while ((to = step_square(to, step[0], step[1])) != NO_SQUARE) {
+                        if (sq[to] == EMPTY) {
+                            count = add_move(moves, count, from, to, EMPTY, 0);
+                            continue;
+                        }
+                        if (PIECE_COLOR(sq[to]) != color)
+                            count = add_move(moves, count, from, to, EMPTY, MOVE_CAPTURE);
+                        break;
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    // castling, the king may not castle out of, through or into check...
+    int rank = (color == WHITE_PLAYER) ? 0 : 7;
+    int king_side = (color == WHITE_PLAYER) ? CASTLE_WHITE_KING : CASTLE_BLACK_KING;
+    int queen_side = (color == WHITE_PLAYER) ? CASTLE_WHITE_QUEEN : CASTLE_BLACK_QUEEN;
+    int e = SQUARE(4, rank);
+
+    if (sq[e] == colored(KING, color) && (board->castling & (king_side | queen_side)) &&
+        !is_square_attacked(board, e, !color)) {
+        if ((board->castling & king_side) && sq[SQUARE(7, rank)] == colored(ROOK, color) &&
+            sq[e + 1] == EMPTY && sq[e + 2] == EMPTY &&
+            !is_square_attacked(board, e + 1, !color) && !is_square_attacked(board, e + 2, !color))
+            count = add_move(moves, count, e, e + 2, EMPTY, MOVE_CASTLE);
+
+        if ((board->castling & queen_side) && sq[SQUARE(0, rank)] == colored(ROOK, color) &&
+            sq[e - 1] == EMPTY && sq[e - 2] == EMPTY && sq[e - 3] == EMPTY &&
+            !is_square_attacked(board, e - 1, !color) && !is_square_attacked(board, e - 2, !color))
+            count = add_move(moves, count, e, e - 2, EMPTY, MOVE_CASTLE);
+    }
+    return count;
+}
+
+/* Marks the squares of pieces of the side to move that are pinned against their king
+ * (king_square) in pinned. A pinned piece is the first own piece on a ray from the king,
+ * followed by an enemy rook/queen (orthogonal) or bishop/queen (diagonal).                        */
+static void find_pinned(const Board *board, int king_square, char pinned[64])
+{
+    const unsigned char *sq = board->squares;
+    int color = board->side_to_move;
+
+    memset(pinned, FALSE, 64);
+    for (int i = 0; i < 8; i++) {
+        const int *step = (i < 4) ? rook_steps[i] : bishop_steps[i - 4];
+        int slider = (i < 4) ? ROOK : BISHOP, square = king_square, own = NO_SQUARE;
+
+        while ((square = step_square(square, step[0], step[1])) != NO_SQUARE) {
+            if (sq[square] == EMPTY)
+                continue;
+            if (PIECE_COLOR(sq[square]) == color) {
+                if (own != NO_SQUARE)
+                    break;
+                own = square;
+                continue;
+            }
+            if (own != NO_SQUARE && (sq[square] == colored(slider, !color) || sq[square] == colored(QUEEN, !color)))
+                pinned[own] = TRUE;
+            break;
+        }
+    }
+}
+
+/* Filters pseudo-legal moves, keeping those that do not leave the own king in check.
+ * Only moves that can expose the king (king moves, en passant, pinned pieces or any move
+ * while in check) are played out and tested.
+ * If first_only is TRUE, stops after the first legal move. Returns the number of moves kept.      */
+static int filter_legal_moves(const Board *board, const Move pseudo[], int num_of_pseudo,
+                              Move moves[], int first_only)
+{
+    int color = board->side_to_move, king_square = NO_SQUARE, in_check = FALSE, count = 0;
+    unsigned char king = colored(KING, color);
+    char pinned[64];
+
+    for (int square = 0; square < 64; square++) {
+        if (board->squares[square] == king) {
+            king_square = square;
+            in_check = is_square_attacked(board, square, !color);
+            find_pinned(board, king_square, pinned);
+            break;
+        }
+    }
+
+    for (int i = 0; i < num_of_pseudo; i++) {
+        Move move = pseudo[i];
+
+        if (king_square == NO_SQUARE || in_check || move.from == king_square ||
+            (move.flags & MOVE_EN_PASSANT) || pinned[move.from]) {
+            Board copy = *board;
+            make_move(&copy, move);
+            int square = (move.from == king_square) ? move.to : king_square;
+            if (king_square != NO_SQUARE && is_square_attacked(&copy, square, !color))
+                continue;
+        }
+
+        moves[count++] = move;
+        if (first_only)
+            break;
+    }
+    return count;
+}
+
+/* Generates all legal moves of the side to move into moves (at least LEGAL_MOVES_MAX elements).
+ * The order is deterministic for a given position. Returns the number of legal moves.            */
+int generate_legal_moves(const Board *board, Move moves[])
+{
+    Move pseudo[LEGAL_MOVES_MAX];
+    int num_of_pseudo = generate_pseudo_moves(board, pseudo);
+
+    return filter_legal_moves(board, pseudo, num_of_pseudo, moves, FALSE);
+}
+
+/* Returns TRUE if the side to move has at least one legal move, FALSE otherwise.                  */
+int has_legal_moves(const Board *board)
+{
+    Move pseudo[LEGAL_MOVES_MAX], legal[1];
+    int num_of_pseudo = generate_pseudo_moves(board, pseudo);
+
+    return filter_legal_moves(board, pseudo, num_of_pseudo, legal, TRUE) > 0;
+}
+
+/* Removes the castling right tied to a rook's home square, if square is one.                      */
+static int clear_rook_right(int castling, int square)
+{
+    switch (square) {
+        case SQUARE(0, 0): return castling & ~CASTLE_WHITE_QUEEN;
+        case SQUARE(7, 0): return castling & ~CASTLE_WHITE_KING;
+        case SQUARE(0, 7): return castling & ~CASTLE_BLACK_QUEEN;
+        case SQUARE(7, 7): return castling & ~CASTLE_BLACK_KING;
+        default: return castling;
+    }
+}
+
+/* Plays move (assumed legal) on board.                                                            */
+void make_move(Board *board, Move move)
+{
+    unsigned char *sq = board->squares;
+    int piece = sq[move.from], color = board->side_to_move;
+
+    if (move.flags & MOVE_EN_PASSANT)
+        sq[SQUARE(FILE_OF(move.to), RANK_OF(move.from))] = EMPTY;
+
+    if (move.flags & MOVE_CASTLE) {
+        int rank = RANK_OF(move.from);
+        if (FILE_OF(move.to) == 6) {
+            sq[SQUARE(5, rank)] = sq[SQUARE(7, rank)];
+            sq[SQUARE(7, rank)] = EMPTY;
+        } else {
+            sq[SQUARE(3, rank)] = sq[SQUARE(0, rank)];
+            sq[SQUARE(0, rank)] = EMPTY;
+        }
+    }
+
+    board->halfmove_clock = (PIECE_TYPE(piece) == PAWN || sq[move.to] != EMPTY) ? 0 : board->halfmove_clock + 1;
+
+    sq[move.to] = (move.promotion != EMPTY) ? colored(move.promotion, color) : (unsigned char)piece;
+    sq[move.from] = EMPTY;
+
+    if (PIECE_TYPE(piece) == KING)
+        board->castling &= (color == WHITE_PLAYER) ? ~(CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN)
+                                                   : ~(CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN);
+    board->castling = clear_rook_right(board->castling, move.from);
+    board->castling = clear_rook_right(board->castling, move.to);
+
+    board->en_passant = (move.flags & MOVE_DOUBLE_PUSH) ? (move.from + move.to) / 2 : NO_SQUARE;
+
+    if (color == BLACK_PLAYER)
+        board->fullmove_number++;
+    board->side_to_move = !color;
+}
+
+int is_same_move(Move m1, Move m2)
+{
+    return m1.from == m2.from && m1.to == m2.to && m1.promotion == m2.promotion;
+}
+
+/* ********** STANDARD ALGEBRAIC NOTATION **********                                               */
+
+/* Writes the SAN of move into san, including '+' or '#' suffix. legal must hold all
+ * num_of_legal legal moves of board (as from generate_legal_moves), they are used to
+ * disambiguate piece moves.                                                                       */
+void move_to_san_from_list(const Board *board, Move move, const Move legal[], int num_of_legal,
+                           char san[SAN_MAX])
+{
+    int type = PIECE_TYPE(board->squares[move.from]), pos = 0;
+
+    if (move.flags & MOVE_CASTLE) {
+        strcpy(san, (FILE_OF(move.to) == 6) ? "O-O" : "O-O-O");
+        pos = (int)strlen(san);
+    } else if (type == PAWN) {
+        if (move.flags & MOVE_CAPTURE) {
+            san[pos++] = (char)('a' + FILE_OF(move.from));
+            san[pos++] = 'x';
+        }
+        san[pos++] = (char)('a' + FILE_OF(move.to));
+        san[pos++] = (char)('1' + RANK_OF(move.to));
+        if (move.promotion != EMPTY) {
+            san[pos++] = '=';
+            san[pos++] = piece_letters[move.promotion];
+        }
+    } else {
+        int ambiguous = FALSE, same_file = FALSE, same_rank = FALSE;
+
+        for (int i = 0; i < num_of_legal; i++) {
+            if (legal[i].to != move.to || legal[i].from == move.from ||
+                PIECE_TYPE(board->squares[legal[i].from]) != type)
+                continue;
+            ambiguous = TRUE;
+            if (FILE_OF(legal[i].from) == FILE_OF(move.from))
+                same_file = TRUE;
+            if (RANK_OF(legal[i].from) == RANK_OF(move.from))
+                same_rank = TRUE;
+        }
+
+        san[pos++] = piece_letters[type];
+        if (ambiguous && (!same_file || same_rank))
+            san[pos++] = (char)('a' + FILE_OF(move.from));
+        if (ambiguous && same_file)
+            san[pos++] = (char)('1' + RANK_OF(move.from));
+        if (move.flags & MOVE_CAPTURE)
+            san[pos++] = 'x';
+        san[pos++] = (char)('a' + FILE_OF(move.to));
+        san[pos++] = (char)('1' + RANK_OF(move.to));
+    }
+
+    Board after = *board;
+    make_move(&after, move);
+    if (is_in_check(&after, after.side_to_move))
+        san[pos++] = (char)(has_legal_moves(&after) ? '+' : '#');
+    san[pos] = '\0';
+}
+
+/* Writes the SAN of move (legal on board) into san, including '+' or '#' suffix.                  */
+void move_to_san(const Board *board, Move move, char san[SAN_MAX])
+{
+    Move legal[LEGAL_MOVES_MAX];
+    int num_of_legal = 0;
+
+    // only piece moves need the legal moves for disambiguation...
+    if (PIECE_TYPE(board->squares[move.from]) != PAWN && !(move.flags & MOVE_CASTLE))
+        num_of_legal = generate_legal_moves(board, legal);
+    move_to_san_from_list(board, move, legal, num_of_legal, san);
+}
+
+/* Parses san (leniently: check marks, annotations, '0-0' castling and promotions without '='
+ * are accepted) into the matching legal move on board.
+ * Returns TRUE if exactly one legal move matches, FALSE otherwise.                                */
+int parse_san(const Board *board, const char *san, Move *move)
+{
+    Move legal[LEGAL_MOVES_MAX];
+    char text[SAN_MAX + 4];
+    int len, type = PAWN, promotion = EMPTY, from_file = -1, from_rank = -1, to, matches = 0;
+    int num_of_legal = generate_legal_moves(board, legal);
+
+    len = snprintf(text, sizeof(text), "%s", san);
+    if (len <= 0 || len >= (int)sizeof(text))
+        return FALSE;
+    while (len > 0 && strchr("+#!?", text[len - 1]) != NULL)
+        text[--len] = '\0';
+
+    if (strcmp(text, "O-O") == 0 || strcmp(text, "0-0") == 0 ||
+        strcmp(text, "O-O-O") == 0 || strcmp(text, "0-0-0") == 0) {
+        int file = (len == 3) ? 6 : 2;
+        for (int i = 0; i < num_of_legal; i++) {
+            if ((legal[i].flags & MOVE_CASTLE) && FILE_OF(legal[i].to) == file) {
+                *move = legal[i];
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+
+    // promotion: "e8=Q" or "e8Q"...
+    if (len >= 3 && strchr("NBRQ", text[len - 1]) != NULL) {
+        promotion = (int)(strchr(piece_letters, text[len - 1]) - piece_letters);
+        len -= (text[len - 2] == '=') ? 2 : 1;
+        text[len] = '\0';
+    }
+
+    int pos = 0;
+    if (strchr("NBRQK", text[0]) != NULL) {
+        type = (int)(strchr(piece_letters, text[0]) - piece_letters);
+        pos = 1;
+    }
+
+    if (len - pos < 2 || text[len - 2] < 'a' || text[len - 2] > 'h' || text[len - 1] < '1' || text[len - 1] > '8')
+        return FALSE;
+    to = SQUARE(text[len - 2] - 'a', text[len - 1] - '1');
+
+    // disambiguation (and capture mark) between piece letter and destination...
+    for (; pos < len - 2; pos++) {
+        if (text[pos] >= 'a' && text[pos] <= 'h')
+            from_file = text[pos] - 'a';
+        else if (text[pos] >= '1' && text[pos] <= '8')
+            from_rank = text[pos] - '1';
+        else if (text[pos] != 'x' && text[pos] != ':' && text[pos] != '-')
+            return FALSE;
+    }
+
+    for (int i = 0; i < num_of_legal; i++) {
+        if (legal[i].to != to || PIECE_TYPE(board->squares[legal[i].from]) != type ||
+            legal[i].promotion != promotion || (legal[i].flags & MOVE_CASTLE))
+            continue;
+        if ((from_file >= 0 && FILE_OF(legal[i].from) != from_file) ||
+            (from_rank >= 0 && RANK_OF(legal[i].from) != from_rank))
+            continue;
+        *move = legal[i];
+        matches++;
+    }
+    return matches == 1;
+}
+
+/* ********** POSITION TEXT AND HASH **********                                                    */
+
+/* Writes the position on board in Forsyth-Edwards notation to fen.                                */
+void board_to_fen(const Board *board, char fen[FEN_MAX])
+{
+    static const char fen_letters[] = " PNBRQK  pnbrqk";
+    int length = 0;
+
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            int piece = board->squares[SQUARE(file, rank)];
+            if (piece == EMPTY) {
+                empty++;
+                continue;
+            }
+            if (empty > 0)
+                fen[length++] = (char)('0' + empty);
+            fen[length++] = fen_letters[piece];
+            empty = 0;
+        }
+        if (empty > 0)
+            fen[length++] = (char)('0' + empty);
+        if (rank > 0)
+            fen[length++] = '/';
+    }
+
+    fen[length++] = ' ';
+    fen[length++] = (board->side_to_move == WHITE_PLAYER) ? 'w' : 'b';
+    fen[length++] = ' ';
+    if (board->castling == 0)
+        fen[length++] = '-';
+    if (board->castling & CASTLE_WHITE_KING)
+        fen[length++] = 'K';
+    if (board->castling & CASTLE_WHITE_QUEEN)
+        fen[length++] = 'Q';
+    if (board->castling & CASTLE_BLACK_KING)
+        fen[length++] = 'k';
+    if (board->castling & CASTLE_BLACK_QUEEN)
+        fen[length++] = 'q';
+    fen[length++] = ' ';
+    if (board->en_passant == NO_SQUARE)
+        fen[length++] = '-';
+    else {
+        fen[length++] = (char)('a' + FILE_OF(board->en_passant));
+        fen[length++] = (char)('1' + RANK_OF(board->en_passant));
+    }
+    snprintf(fen + length, FEN_MAX - length, " %d %d", board->halfmove_clock, board->fullmove_number);
+}
+
+/* Returns a 64 bit hash (FNV-1a) of the position on board: pieces, side to move, castling rights
+ * and en passant square. The move counters are left out, the same position reached at another
+ * move has the same hash.                                                                         */
+long long board_hash(const Board *board)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    unsigned char state[64 + 3];
+
+    memcpy(state, board->squares, 64);
+    state[64] = (unsigned char)board->side_to_move;
+    state[65] = (unsigned char)board->castling;
+    state[66] = (unsigned char)(board->en_passant + 1);
+
+    for (size_t i = 0; i < sizeof(state); i++) {
+        hash ^= state[i];
+        hash *= 1099511628211ULL;
+    }
+    return (long long)hash;
+}
+
+/* Parses a move in UCI notation ("e2e4", "e7e8q") into the matching legal move on board.
+ * Returns TRUE if it is legal, FALSE otherwise.                                                   */
+int parse_uci(const Board *board, const char *text, Move *move)
+{
+    Move legal[LEGAL_MOVES_MAX];
+    int num_of_legal, from, to, promotion = EMPTY;
+
+    if (strlen(text) < 4 || text[0] < 'a' || text[0] > 'h' || text[1] < '1' || text[1] > '8' ||
+        text[2] < 'a' || text[2] > 'h' || text[3] < '1' || text[3] > '8')
+        return FALSE;
+    from = SQUARE(text[0] - 'a', text[1] - '1');
+    to = SQUARE(text[2] - 'a', text[3] - '1');
+    if (text[4] != '\0' && strchr("nbrq", text[4]) != NULL)
+        promotion = (int)(strchr(" pnbrqk", text[4]) - " pnbrqk");
+
+    num_of_legal = generate_legal_moves(board, legal);
+    for (int i = 0; i < num_of_legal; i++) {
+        if (legal[i].from == from && legal[i].to == to && legal[i].promotion == promotion) {
+            *move = legal[i];
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
@@ -0,0 +1,76 @@
+//
+// Created by flimsy on 2/17/22.
+//
+
+#ifndef CHESSDATABASE_CHESS_H
+#define CHESSDATABASE_CHESS_H
+
+#include "helperFunctions.h"
+
+// Piece values. A piece on the board is its type, or'ed with BLACK_PIECE for black pieces.
+#define EMPTY 0
+#define PAWN 1
+#define KNIGHT 2
+#define BISHOP 3
+#define ROOK 4
+#define QUEEN 5
+#define KING 6
+#define BLACK_PIECE 8
+#define PIECE_TYPE(piece) ((piece) & 7)
+#define PIECE_COLOR(piece) (((piece) & BLACK_PIECE) ? BLACK_PLAYER : WHITE_PLAYER)
+
+// Castling rights.
+#define CASTLE_WHITE_KING 1
+#define CASTLE_WHITE_QUEEN 2
+#define CASTLE_BLACK_KING 4
+#define CASTLE_BLACK_QUEEN 8
+
+// Move flags.
+#define MOVE_CAPTURE 1
+#define MOVE_EN_PASSANT 2
+#define MOVE_CASTLE 4
+#define MOVE_DOUBLE_PUSH 8
+
+// Size values.
+#define LEGAL_MOVES_MAX 256
+#define SAN_MAX 8
+#define FEN_MAX 96
+
+// Squares are numbered a1 = 0, b1 = 1, ..., h8 = 63.
+#define SQUARE(file, rank) ((rank) * 8 + (file))
+#define FILE_OF(square) ((square) & 7)
+#define RANK_OF(square) ((square) >> 3)
+#define NO_SQUARE -1
+
+typedef struct Move {
+    unsigned char from;
+    unsigned char to;
+    unsigned char promotion;
+    unsigned char flags;
+} Move;
+
+typedef struct Board {
+    unsigned char squares[64];
+    int side_to_move;
+    int castling;
+    int en_passant;
+    int halfmove_clock;
+    int fullmove_number;
+} Board;
+
+void board_init(Board *board);
+int is_square_attacked(const Board *board, int square, int by_color);
+int is_in_check(const Board *board, int color);
+int generate_legal_moves(const Board *board, Move moves[]);
+int has_legal_moves(const Board *board);
+void make_move(Board *board, Move move);
+int is_same_move(Move m1, Move m2);
+int parse_san(const Board *board, const char *san, Move *move);
+void move_to_san(const Board *board, Move move, char san[SAN_MAX]);
+void move_to_san_from_list(const Board *board, Move move, const Move legal[], int num_of_legal,
+                           char san[SAN_MAX]);
+void board_to_fen(const Board *board, char fen[FEN_MAX]);
+long long board_hash(const Board *board);
+int parse_uci(const Board *board, const char *text, Move *move);
+
+#endif //CHESSDATABASE_CHESS_H
@@ -0,0 +1,456 @@
+//
+// Created by flimsy on 3/17/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chessdb.h"
+#include "context.h"
+#include "database.h"
+
+/* ********** HANDLE CALLS **********
+ * Every call locks the handle and makes it the handle of the calling thread until it returns,
+ * the handle used before is restored afterwards (so calls may be nested across handles).
+ * If an observer is set, it is told the name and duration (lock wait included) of every call.    */
+
+static OperationObserver operation_observer = NULL;
+static pthread_once_t openings_once = PTHREAD_ONCE_INIT;
+static int openings_loaded = FALSE;
+
+static ChessDb *enter_db(ChessDb *db)
+{
+    struct timespec started = {0, 0};
+
+    if (operation_observer != NULL)
+        clock_gettime(CLOCK_MONOTONIC, &started);
+    pthread_mutex_lock(&db->lock);
+    db->call_started = started;
+    db->owner = pthread_self();
+    db->owned = TRUE;
+    return use_db(db);
+}
+
+static void leave_db(ChessDb *db, ChessDb *previous, const char *operation)
+{
+    struct timespec started = db->call_started, ended;
+
+    use_db(previous);
+    db->owned = FALSE;
+    pthread_mutex_unlock(&db->lock);
+    if (operation_observer != NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &ended);
+        operation_observer(operation, (double)(ended.tv_sec - started.tv_sec) * 1e3 +
+                                      (double)(ended.tv_nsec - started.tv_nsec) / 1e6);
+    }
+}
+
+/* Sets the observer of all calls on any handle (NULL for none). Set it before opening handles.    */
+void chessdb_observe_operations(OperationObserver observer)
+{
+    operation_observer = observer;
+}
+
+/* Loads the opening table (ECO_FILE, or the built-in table if there is none) for all handles.     */
+static void load_default_openings()
+{
+    openings_loaded = load_openings(ECO_FILE);
+}
+
+/* Stores the default options in options.                                                          */
+void chessdb_default_options(ChessDbOptions *options)
+{
+    options->busy_timeout_ms = CHESSDB_BUSY_TIMEOUT_MS;
+    options->cache_budget = RESULT_CACHE_BUDGET;
+    options->load_completions = FALSE;
+    options->maintenance.analyze_writes = MAINTENANCE_ANALYZE_WRITES;
+    options->maintenance.optimize_writes = MAINTENANCE_OPTIMIZE_WRITES;
+    options->maintenance.free_percent = MAINTENANCE_FREE_PERCENT;
+    options->maintenance.slice_ms = MAINTENANCE_SLICE_MS;
+    options->maintenance.interval_ms = MAINTENANCE_INTERVAL_MS;
+}
+
+/* Opens (creating or upgrading it if needed) the database file path with options (the defaults
+ * if NULL) and stores its handle in db. Returns TRUE on success and FALSE on error.               */
+int chessdb_open(const char *path, const ChessDbOptions *options, ChessDb **db)
+{
+    ChessDb *handle;
+    ChessDb *previous;
+    int success;
+
+    // the opening table is loaded once, before the first handle classifies games...
+    pthread_once(&openings_once, load_default_openings);
+    if (!openings_loaded) {
+        eprintf("ERROR: loading the opening table failed...\n");
+        return FALSE;
+    }
+
+    handle = malloc(sizeof(ChessDb));
+    if (handle == NULL) {
+        eprintf("ERROR: could not allocate memory for the database handle...\n");
+        return FALSE;
+    }
+    if (strlen(path) >= SHARD_PATH_MAX) {
+        eprintf("ERROR: database path too long: %s\n", path);
+        free(handle);
+        return FALSE;
+    }
+    init_db(handle, path, options);
+
+    previous = enter_db(handle);
+    success = prepare_database();
+    if (success && handle->options.load_completions)
+        load_completions();
+    leave_db(handle, previous, __func__);
+
+    if (success)
+        success = start_maintenance(handle);
+
+    if (!success) {
+        chessdb_close(handle);
+        return FALSE;
+    }
+    *db = handle;
+    return TRUE;
+}
+
+/* Closes the handle db, freeing everything kept for it.                                           */
+void chessdb_close(ChessDb *db)
+{
+    ChessDb *previous;
+
+    // (the maintenance thread takes the lock for its slices)...
+    stop_maintenance(db);
+    previous = enter_db(db);
+
+    clear_result_cache();
+    clear_statement_cache();
+    clear_standings_cache();
+    free_player_index();
+    free_completions();
+    free_header_store();
+    leave_db(db, previous, __func__);
+
+    pthread_mutex_destroy(&db->lock);
+    free(db);
+}
+
+/* Returns the path db was opened with.                                                            */
+const char *chessdb_path(const ChessDb *db)
+{
+    return db->catalog_path;
+}
+
+int chessdb_insert_game(ChessDb *db, GameInfo *data)
+{
+    ChessDb *previous = enter_db(db);
+    int result = insert_data(data);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_update_game(ChessDb *db, GameInfo *data)
+{
+    ChessDb *previous = enter_db(db);
+    int result = update_data(data);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_update_moves(ChessDb *db, GameInfo *data, int new_move_count)
+{
+    ChessDb *previous = enter_db(db);
+    int result = update_moves(data, new_move_count);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_delete_game(ChessDb *db, GameInfo *data)
+{
+    ChessDb *previous = enter_db(db);
+    int result = delete_game(data);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_get_game(ChessDb *db, GameInfo *data)
+{
+    ChessDb *previous = enter_db(db);
+    int result = get_game_by_id(data);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_get_games(ChessDb *db, GameBatch *batch, const int game_ids[], int count)
+{
+    ChessDb *previous = enter_db(db);
+    int result = get_games_by_ids(batch, game_ids, count);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+/* batch must have been fetched through db.                                                        */
+GameMoves *chessdb_get_batch_moves(ChessDb *db, GameBatch *batch, int index)
+{
+    ChessDb *previous = enter_db(db);
+    GameMoves *result = get_batch_moves(batch, index);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+void chessdb_free_batch(GameBatch *batch)
+{
+    free_game_batch(batch);
+}
+
+int chessdb_search(ChessDb *db, SampleInfo arr_sample[], const char search_word[], int page)
+{
+    ChessDb *previous = enter_db(db);
+    int result = search_data(arr_sample, search_word, page);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_list(ChessDb *db, SampleInfo arr_sample[], int page)
+{
+    ChessDb *previous = enter_db(db);
+    int result = get_unsorted_list(arr_sample, page);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_list_sorted(ChessDb *db, SampleInfo arr_sample[], int column, int page)
+{
+    ChessDb *previous = enter_db(db);
+    int result = get_sorted_list(arr_sample, column, page);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_list_by_date(ChessDb *db, SampleInfo arr_sample[], int from_date, int to_date, int page)
+{
+    ChessDb *previous = enter_db(db);
+    int result = get_games_by_date(arr_sample, from_date, to_date, page);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_list_window(ChessDb *db, ListRow rows[], int count, int column, const char *term, const ListRow *from,
+                        int backward)
+{
+    ChessDb *previous = enter_db(db);
+    int result = get_list_window(rows, count, column, term, from, backward);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+/* The standings are a copy, to be freed with free_standings.                                     */
+int chessdb_get_standings(ChessDb *db, Standings *standings, const char *name, const char *class,
+                          const char *group)
+{
+    ChessDb *previous = enter_db(db);
+    int result = get_standings(standings, name, class, group);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_find_similar_players(ChessDb *db, const char *query, PlayerMatch matches[], int max_matches)
+{
+    ChessDb *previous = enter_db(db);
+    int result = find_similar_players(query, matches, max_matches);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+/* The completions stay valid until the next game is added through db.                             */
+int chessdb_complete_name(ChessDb *db, int kind, const char *prefix, const char *completions[],
+                          int max_completions)
+{
+    ChessDb *previous = enter_db(db);
+    int result = complete_name(kind, prefix, completions, max_completions);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+void chessdb_completion_stats(ChessDb *db, CompletionStats *stats)
+{
+    ChessDb *previous = enter_db(db);
+    get_completion_stats(stats);
+    leave_db(db, previous, __func__);
+}
+
+void chessdb_cache_stats(ChessDb *db, CacheStats *stats)
+{
+    ChessDb *previous = enter_db(db);
+    get_result_cache_stats(stats);
+    leave_db(db, previous, __func__);
+}
+
+int chessdb_find_games_with_line(ChessDb *db, const char *line, int use_index, int **game_ids,
+                                 LineSearchStats *stats)
+{
+    ChessDb *previous = enter_db(db);
+    int result = find_games_with_line(line, use_index, game_ids, stats);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_find_similar_games(ChessDb *db, int game_id, SimilarGame matches[], int max_matches,
+                               SimilarSearchStats *stats)
+{
+    ChessDb *previous = enter_db(db);
+    int result = find_similar_games(game_id, matches, max_matches, stats);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_filter_headers(ChessDb *db, const HeaderFilter *filter, int **game_ids, HeaderFilterStats *stats)
+{
+    ChessDb *previous = enter_db(db);
+    int result = filter_headers(filter, game_ids, stats);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_delete_games_matching(ChessDb *db, const char *tournament, const char *player, int from_date,
+                                  int to_date, BulkCounts *counts)
+{
+    ChessDb *previous = enter_db(db);
+    int result = delete_games_matching(tournament, player, from_date, to_date, counts);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_rename(ChessDb *db, int kind, const char *old_name, const char *new_name, BulkCounts *counts)
+{
+    ChessDb *previous = enter_db(db);
+    int result = rename_in_games(kind, old_name, new_name, counts);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_build_book(ChessDb *db, const char *path, const BookOptions *options, BookStats *stats)
+{
+    ChessDb *previous = enter_db(db);
+    int result = build_book(path, options, stats);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_export(ChessDb *db, const char *path, int format, const char *search_word, int num_of_threads)
+{
+    ChessDb *previous = enter_db(db);
+    int result = export_games(path, format, search_word, num_of_threads);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_import(ChessDb *db, const char *pgn_path, int num_of_processes, ImportStats *stats)
+{
+    ChessDb *previous = enter_db(db);
+    int result = import_pgn(pgn_path, num_of_processes, stats);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_reclassify(ChessDb *db, int num_of_threads)
+{
+    ChessDb *previous = enter_db(db);
+    int result = reclassify_games(num_of_threads);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_analyse(ChessDb *db, const char *engine_path, int num_of_engines, AnalysisBudget budget,
+                    AnalysisStats *stats)
+{
+    ChessDb *previous = enter_db(db);
+    int result = analyse_games(engine_path, num_of_engines, budget, stats);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_print_evaluations(ChessDb *db, int game_id)
+{
+    ChessDb *previous = enter_db(db);
+    int result = print_game_evaluations(game_id);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_backup(ChessDb *db, const char *path, int pages_per_step, int sleep_ms)
+{
+    ChessDb *previous = enter_db(db);
+    int result = backup_database(path, pages_per_step, sleep_ms);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+/* Takes a snapshot of db every interval_s seconds, skipping it if nothing was written since the
+ * last one. Stops after num_of_rounds intervals, runs until interrupted if num_of_rounds is 0. The
+ * handle is held while a snapshot is copied only, calls on db from other threads run between.
+ * Returns the number of snapshots taken, or ERROR on error.                                       */
+int chessdb_snapshot(ChessDb *db, const char *directory, int interval_s, int num_of_rounds)
+{
+    Snapshots snapshots;
+    ChessDb *previous;
+    int result = FALSE;
+
+    if (interval_s < 1 || num_of_rounds < 0) {
+        eprintf("ERROR: invalid snapshot interval or count...\n");
+        return ERROR;
+    }
+
+    init_snapshots(&snapshots);
+    for (int round = 1; result != ERROR && (num_of_rounds == 0 || round <= num_of_rounds); round++) {
+        previous = enter_db(db);
+        result = take_snapshot(&snapshots, directory);
+        leave_db(db, previous, __func__);
+
+        if (result != ERROR && round != num_of_rounds)
+            sqlite3_sleep(interval_s * 1000);
+    }
+    close_snapshots(&snapshots);
+    return (result == ERROR) ? ERROR : snapshots.taken;
+}
+
+int chessdb_enable_sharding(ChessDb *db, int mode)
+{
+    ChessDb *previous = enter_db(db);
+    int result = enable_sharding(mode);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_print_shards(ChessDb *db)
+{
+    ChessDb *previous = enter_db(db);
+    int result = print_shards();
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_vacuum(ChessDb *db, const char *key)
+{
+    ChessDb *previous = enter_db(db);
+    int result = vacuum_shards(key);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+int chessdb_maintain(ChessDb *db, int force)
+{
+    ChessDb *previous = enter_db(db);
+    int result = run_maintenance(force);
+    leave_db(db, previous, __func__);
+    return result;
+}
+
+void chessdb_maintenance_stats(ChessDb *db, MaintenanceStats *stats)
+{
+    ChessDb *previous = enter_db(db);
+    *stats = db->maintenance.stats;
+    leave_db(db, previous, __func__);
+}
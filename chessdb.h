@@ -0,0 +1,99 @@
+//
+// Created by flimsy on 3/17/22.
+//
+
+#ifndef CHESSDATABASE_CHESSDB_H
+#define CHESSDATABASE_CHESSDB_H
+
+#include <stddef.h>
+
+#include "helperFunctions.h"
+#include "tournament.h"
+#include "fuzzy.h"
+#include "autocomplete.h"
+#include "lineindex.h"
+#include "headerstore.h"
+#include "similar.h"
+#include "book.h"
+#include "analysis.h"
+#include "cache.h"
+#include "export.h"
+#include "import.h"
+#include "backup.h"
+#include "shard.h"
+#include "maintenance.h"
+
+// Default options.
+#define CHESSDB_BUSY_TIMEOUT_MS 2000
+
+/* ********** CHESSDB LIBRARY **********
+ * A database is used through a handle returned by chessdb_open. The handle holds everything the
+ * library keeps about one database: its path, shard catalog, routed shard, result and standings
+ * caches, player index, name completions and header store. Any number of handles may be open at
+ * once, also on the same file. Calls on one handle are serialized by the handle's lock, so a
+ * handle may be shared by threads, calls on different handles run in parallel.
+ * The functions return what the functions they wrap return (see database.h and friends).          */
+
+typedef struct ChessDb ChessDb;
+
+/* Told the name of a call (the chessdb_ function) and how long it took.                           */
+typedef void (*OperationObserver)(const char *operation, double milliseconds);
+
+typedef struct ChessDbOptions {
+    int busy_timeout_ms;        // how long a connection waits for a locked database...
+    size_t cache_budget;        // bytes of the result cache...
+    int load_completions;       // load the name completions when opening...
+    MaintenancePolicy maintenance;
+} ChessDbOptions;
+
+void chessdb_default_options(ChessDbOptions *options);
+void chessdb_observe_operations(OperationObserver observer);
+int chessdb_open(const char *path, const ChessDbOptions *options, ChessDb **db);
+void chessdb_close(ChessDb *db);
+const char *chessdb_path(const ChessDb *db);
+
+int chessdb_insert_game(ChessDb *db, GameInfo *data);
+int chessdb_update_game(ChessDb *db, GameInfo *data);
+int chessdb_update_moves(ChessDb *db, GameInfo *data, int new_move_count);
+int chessdb_delete_game(ChessDb *db, GameInfo *data);
+int chessdb_get_game(ChessDb *db, GameInfo *data);
+int chessdb_get_games(ChessDb *db, GameBatch *batch, const int game_ids[], int count);
+GameMoves *chessdb_get_batch_moves(ChessDb *db, GameBatch *batch, int index);
+void chessdb_free_batch(GameBatch *batch);
+int chessdb_search(ChessDb *db, SampleInfo arr_sample[], const char search_word[], int page);
+int chessdb_list(ChessDb *db, SampleInfo arr_sample[], int page);
+int chessdb_list_sorted(ChessDb *db, SampleInfo arr_sample[], int column, int page);
+int chessdb_list_by_date(ChessDb *db, SampleInfo arr_sample[], int from_date, int to_date, int page);
+int chessdb_list_window(ChessDb *db, ListRow rows[], int count, int column, const char *term, const ListRow *from,
+                        int backward);
+int chessdb_get_standings(ChessDb *db, Standings *standings, const char *name, const char *class,
+                          const char *group);
+int chessdb_find_similar_players(ChessDb *db, const char *query, PlayerMatch matches[], int max_matches);
+int chessdb_complete_name(ChessDb *db, int kind, const char *prefix, const char *completions[],
+                          int max_completions);
+void chessdb_completion_stats(ChessDb *db, CompletionStats *stats);
+void chessdb_cache_stats(ChessDb *db, CacheStats *stats);
+int chessdb_find_games_with_line(ChessDb *db, const char *line, int use_index, int **game_ids,
+                                 LineSearchStats *stats);
+int chessdb_find_similar_games(ChessDb *db, int game_id, SimilarGame matches[], int max_matches,
+                               SimilarSearchStats *stats);
+int chessdb_filter_headers(ChessDb *db, const HeaderFilter *filter, int **game_ids, HeaderFilterStats *stats);
+int chessdb_delete_games_matching(ChessDb *db, const char *tournament, const char *player, int from_date,
+                                  int to_date, BulkCounts *counts);
+int chessdb_rename(ChessDb *db, int kind, const char *old_name, const char *new_name, BulkCounts *counts);
+int chessdb_build_book(ChessDb *db, const char *path, const BookOptions *options, BookStats *stats);
+int chessdb_export(ChessDb *db, const char *path, int format, const char *search_word, int num_of_threads);
+int chessdb_import(ChessDb *db, const char *pgn_path, int num_of_processes, ImportStats *stats);
+int chessdb_reclassify(ChessDb *db, int num_of_threads);
+int chessdb_analyse(ChessDb *db, const char *engine_path, int num_of_engines, AnalysisBudget budget,
+                    AnalysisStats *stats);
+int chessdb_print_evaluations(ChessDb *db, int game_id);
+int chessdb_backup(ChessDb *db, const char *path, int pages_per_step, int sleep_ms);
+int chessdb_snapshot(ChessDb *db, const char *directory, int interval_s, int num_of_rounds);
+int chessdb_enable_sharding(ChessDb *db, int mode);
+int chessdb_print_shards(ChessDb *db);
+int chessdb_vacuum(ChessDb *db, const char *key);
+int chessdb_maintain(ChessDb *db, int force);
+void chessdb_maintenance_stats(ChessDb *db, MaintenanceStats *stats);
+
+#endif //CHESSDATABASE_CHESSDB_H
@@ -0,0 +1,662 @@
+//
+// Created by flimsy on 3/18/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "chessdb.h"
+#include "schema.h"
+
+/* ********** TESTS **********
+ * ctest runs every test as 'chessdb_test <name> [argument]', the argument being the path of the
+ * stub engine for the analysis tests and of ChessDatabase for the replay test. A test works on a
+ * database of its own in a new temporary directory, filled by importing the games its writer puts
+ * in a PGN file. A failed check prints its line and the test returns FALSE; the directory is
+ * removed either way.                                                                             */
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            eprintf("FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition);                   \
+            return FALSE;                                                                   \
+        }                                                                                   \
+    } while (0)
+
+typedef struct Test {
+    const char *name;
+    int (*run)(const char *argument);
+} Test;
+
+static char test_directory[] = "/tmp/chessdb-test-XXXXXX";
+
+/* Writes a short game of tournament event played at date (PGN format, yyyy.mm.dd) to pgn.         */
+static void write_game(FILE *pgn, const char *event, const char *date, const char *white, const char *black)
+{
+    fprintf(pgn, "[Event \"%s\"]\n[Date \"%s\"]\n[White \"%s\"]\n[Black \"%s\"]\n[Result \"1-0\"]\n\n"
+                 "1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 1-0\n\n", event, date, white, black);
+}
+
+/* Opens a new database file in the test directory with options (the defaults if NULL) and imports
+ * the games written by write_games into it with num_of_processes processes, keeping what was
+ * imported in stats. Returns the handle, or NULL on error.                                        */
+static ChessDb *import_test_db(const char *file, void (*write_games)(FILE *pgn), const ChessDbOptions *options,
+                               int num_of_processes, ImportStats *stats)
+{
+    char path[SHARD_PATH_MAX];
+    ChessDb *db;
+    FILE *pgn;
+
+    snprintf(path, sizeof(path), "%s/games.pgn", test_directory);
+    if ((pgn = fopen(path, "w")) == NULL)
+        return NULL;
+    write_games(pgn);
+    fclose(pgn);
+
+    snprintf(path, sizeof(path), "%s/%s", test_directory, file);
+    if (!chessdb_open(path, options, &db))
+        return NULL;
+
+    snprintf(path, sizeof(path), "%s/games.pgn", test_directory);
+    if (!chessdb_import(db, path, num_of_processes, stats)) {
+        chessdb_close(db);
+        return NULL;
+    }
+    return db;
+}
+
+/* Opens a new chess.db in the test directory with options (the defaults if NULL) and imports the
+ * games written by write_games into it. Returns the handle, or NULL on error.                     */
+static ChessDb *open_test_db_with(void (*write_games)(FILE *pgn), const ChessDbOptions *options)
+{
+    ImportStats stats;
+
+    return import_test_db(DATABASE_FILE, write_games, options, 1, &stats);
+}
+
+static ChessDb *open_test_db(void (*write_games)(FILE *pgn))
+{
+    return open_test_db_with(write_games, NULL);
+}
+
+/* Returns the first column of the first row of the query sql on db, or ERROR on error.            */
+static int query_int(sqlite3 *db, const char *sql)
+{
+    sqlite3_stmt *stmt;
+    int value = ERROR;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK)
+        return ERROR;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        value = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+/* Removes the test directory and the files in it.                                                 */
+static void remove_test_directory()
+{
+    char path[SHARD_PATH_MAX];
+    struct dirent *entry;
+    DIR *directory = opendir(test_directory);
+
+    if (directory == NULL)
+        return;
+    while ((entry = readdir(directory)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", test_directory, entry->d_name);
+        unlink(path);
+    }
+    closedir(directory);
+    rmdir(test_directory);
+}
+
+static void write_players(FILE *pgn)
+{
+    write_game(pgn, "Candidates", "2022.06.17", "Nepomniachtchi, Ian", "Caruana, Fabiano");
+    write_game(pgn, "Candidates", "2022.06.18", "Carlsen, Magnus", "Ding, Liren");
+}
+
+/* A transliteration of a surname finds the full name of the player, and only that.                */
+static int test_fuzzy_transliteration(const char *argument)
+{
+    PlayerMatch matches[FUZZY_MATCHES_MAX];
+    ChessDb *db = open_test_db(write_players);
+    int count;
+
+    (void)argument;
+    CHECK(db != NULL);
+    count = chessdb_find_similar_players(db, "Nepomnyashchy", matches, FUZZY_MATCHES_MAX);
+    chessdb_close(db);
+
+    CHECK(count == 1);
+    CHECK(strcmp(matches[0].name, "Nepomniachtchi, Ian") == 0);
+    CHECK(matches[0].similarity >= FUZZY_THRESHOLD);
+    return TRUE;
+}
+
+static void write_years(FILE *pgn)
+{
+    write_game(pgn, "Open 2020", "2020.12.31", "Player, A", "Player, B");
+    write_game(pgn, "Open 2021", "2021.01.01", "Player, A", "Player, B");
+    write_game(pgn, "Open 2021", "2021.06.15", "Player, A", "Player, B");
+    write_game(pgn, "Open 2022", "2022.??.??", "Player, A", "Player, B");
+    write_game(pgn, "Open 2022", "2022.03.??", "Player, A", "Player, B");
+    write_game(pgn, "Open 2022", "2022.12.31", "Player, A", "Player, B");
+    write_game(pgn, "Open 2023", "2023.01.01", "Player, A", "Player, B");
+}
+
+/* A bulk delete up to a bare year deletes the games of that whole year.                           */
+static int test_delete_year_range(const char *argument)
+{
+    SampleInfo samples[SAMPLE_MAX];
+    BulkCounts counts;
+    ChessDb *db = open_test_db(write_years);
+    int deleted, count;
+
+    (void)argument;
+    CHECK(db != NULL);
+    deleted = chessdb_delete_games_matching(db, NULL, NULL, pack_date("2021"), pack_date("2022"), &counts);
+    count = chessdb_list_by_date(db, samples, 0, 99991231, 0);
+    chessdb_close(db);
+
+    CHECK(deleted);
+    CHECK(counts.games == 5);
+    CHECK(count == 2);
+    CHECK(strcmp(samples[0].name, "Open 2020") == 0 && strcmp(samples[1].name, "Open 2023") == 0);
+    return TRUE;
+}
+
+static void write_undated(FILE *pgn)
+{
+    write_years(pgn);
+    write_game(pgn, "Open", "????.??.??", "Player, A", "Player, B");
+}
+
+/* A bulk delete up to a date from date 0 keeps the games without a date.                          */
+static int test_delete_keeps_undated(const char *argument)
+{
+    BulkCounts counts;
+    ChessDb *db = open_test_db(write_undated);
+    char path[SHARD_PATH_MAX];
+    int deleted, left;
+    sqlite3 *raw;
+
+    (void)argument;
+    CHECK(db != NULL);
+    deleted = chessdb_delete_games_matching(db, NULL, NULL, 0, pack_date("2021"), &counts);
+    chessdb_close(db);
+
+    snprintf(path, sizeof(path), "%s/%s", test_directory, DATABASE_FILE);
+    CHECK(sqlite3_open(path, &raw) == SQLITE_OK);
+    left = query_int(raw, "SELECT COUNT(*) FROM game WHERE date_int = 0;");
+    sqlite3_close(raw);
+
+    CHECK(deleted);
+    CHECK(counts.games == 3);
+    CHECK(left == 1);
+    return TRUE;
+}
+
+/* The header store filter finds the games of the years from and to, the same as the date query.   */
+static int test_filter_year_range(const char *argument)
+{
+    SampleInfo samples[SAMPLE_MAX];
+    HeaderFilter filter = {0};
+    HeaderFilterStats stats;
+    ChessDb *db = open_test_db(write_years);
+    int *game_ids = NULL, count, listed, found = 0;
+
+    (void)argument;
+    CHECK(db != NULL);
+    filter.from_date = pack_date("2021");
+    filter.to_date = pack_date("2022");
+    count = chessdb_filter_headers(db, &filter, &game_ids, &stats);
+    listed = chessdb_list_by_date(db, samples, filter.from_date, filter.to_date, 0);
+    chessdb_close(db);
+
+    for (int i = 0; i < listed; i++) {
+        for (int j = 0; j < count; j++)
+            found += (samples[i].id == game_ids[j]);
+    }
+    free(game_ids);
+
+    CHECK(count == 5);
+    CHECK(listed == count && found == count);
+    return TRUE;
+}
+
+/* Games imported into a new handle are classified, without loading the opening table first.       */
+static int test_openings_loaded(const char *argument)
+{
+    SampleInfo samples[SAMPLE_MAX];
+    GameInfo game;
+    ChessDb *db = open_test_db(write_players);
+    int count, found;
+
+    (void)argument;
+    CHECK(db != NULL);
+    count = chessdb_list_by_date(db, samples, 0, 99991231, 0);
+    memset(&game, 0, sizeof(game));
+    game.game_id = samples[0].id;
+    found = chessdb_get_game(db, &game);
+    chessdb_close(db);
+
+    CHECK(count == 2 && found);
+    CHECK(strcmp(game.eco, "C68") == 0);
+    return TRUE;
+}
+
+/* Reading a game again reuses the prepared statements of its first read.                          */
+static int test_statement_cache(const char *argument)
+{
+    SampleInfo samples[SAMPLE_MAX];
+    CacheStats first, second;
+    GameInfo game;
+    ChessDb *db = open_test_db(write_players);
+    int found;
+
+    (void)argument;
+    CHECK(db != NULL);
+    CHECK(chessdb_list_by_date(db, samples, 0, 99991231, 0) == 2);
+    memset(&game, 0, sizeof(game));
+    game.game_id = samples[1].id;
+    chessdb_get_game(db, &game);
+    chessdb_cache_stats(db, &first);
+    found = chessdb_get_game(db, &game);
+    chessdb_cache_stats(db, &second);
+    chessdb_close(db);
+
+    CHECK(found);
+    CHECK(second.statement_misses == first.statement_misses);
+    CHECK(second.statement_hits > first.statement_hits);
+    return TRUE;
+}
+
+/* Reading a game that does not exist leaves the database unlocked for the next write.             */
+static int test_missing_game_unlocks(const char *argument)
+{
+    SampleInfo samples[SAMPLE_MAX];
+    GameInfo game, missing;
+    ChessDb *db = open_test_db(write_players);
+    int found, inserted;
+
+    (void)argument;
+    CHECK(db != NULL);
+    CHECK(chessdb_list_by_date(db, samples, 0, 99991231, 0) == 2);
+    memset(&game, 0, sizeof(game));
+    game.game_id = samples[0].id;
+    CHECK(chessdb_get_game(db, &game));
+
+    memset(&missing, 0, sizeof(missing));
+    missing.game_id = 999;
+    found = chessdb_get_game(db, &missing);
+    inserted = chessdb_insert_game(db, &game);
+    chessdb_close(db);
+
+    CHECK(!found);
+    CHECK(inserted);
+    return TRUE;
+}
+
+/* Maintenance finding the database locked by another connection leaves its work for later, and
+ * does it once the lock is gone.                                                                  */
+static int test_maintenance_locked(const char *argument)
+{
+    char path[SHARD_PATH_MAX];
+    ChessDbOptions options;
+    MaintenanceStats locked, unlocked;
+    sqlite3 *other;
+    ChessDb *db;
+    int deferred, done;
+
+    (void)argument;
+    chessdb_default_options(&options);
+    options.busy_timeout_ms = 50;
+    options.maintenance.interval_ms = 0;
+    db = open_test_db_with(write_years, &options);
+    CHECK(db != NULL);
+
+    snprintf(path, sizeof(path), "%s/%s", test_directory, DATABASE_FILE);
+    CHECK(sqlite3_open(path, &other) == SQLITE_OK);
+    CHECK(sqlite3_exec(other, "BEGIN IMMEDIATE;", NULL, NULL, NULL) == SQLITE_OK);
+    deferred = chessdb_maintain(db, TRUE);
+    chessdb_maintenance_stats(db, &locked);
+
+    sqlite3_exec(other, "COMMIT;", NULL, NULL, NULL);
+    sqlite3_close(other);
+    done = chessdb_maintain(db, TRUE);
+    chessdb_maintenance_stats(db, &unlocked);
+    chessdb_close(db);
+
+    CHECK(deferred && locked.busy_slices > 0 && locked.analyzed_tables == 0);
+    CHECK(done && unlocked.busy_slices == locked.busy_slices && unlocked.analyzed_tables > 0);
+    return TRUE;
+}
+
+/* Ends the transaction of the connection arg after a while.                                       */
+static void *commit_later(void *arg)
+{
+    sqlite3_sleep(300);
+    sqlite3_exec(arg, "COMMIT;", NULL, NULL, NULL);
+    return NULL;
+}
+
+/* A file of version 0 is brought up to the current version, its packed dates, line and signature
+ * indexes and checkpoints filled in, after waiting for another connection holding it.             */
+static int test_migration(const char *argument)
+{
+    char path[SHARD_PATH_MAX];
+    ChessDbOptions options;
+    pthread_t thread;
+    sqlite3 *other;
+    ChessDb *db = open_test_db(write_years);
+    int opened;
+
+    (void)argument;
+    CHECK(db != NULL);
+    chessdb_close(db);
+
+    snprintf(path, sizeof(path), "%s/%s", test_directory, DATABASE_FILE);
+    CHECK(sqlite3_open(path, &other) == SQLITE_OK);
+    CHECK(sqlite3_exec(other, "UPDATE game SET date_int = NULL; DELETE FROM ply_gram; DELETE FROM game_signature; "
+                              "UPDATE moves SET checkpoints = NULL; PRAGMA user_version = 0;",
+                       NULL, NULL, NULL) == SQLITE_OK);
+
+    // (the migration has to wait for this transaction)...
+    CHECK(sqlite3_exec(other, "BEGIN IMMEDIATE;", NULL, NULL, NULL) == SQLITE_OK);
+    CHECK(pthread_create(&thread, NULL, commit_later, other) == 0);
+    chessdb_default_options(&options);
+    options.busy_timeout_ms = 50;
+    options.maintenance.interval_ms = 0;
+    opened = chessdb_open(path, &options, &db);
+    pthread_join(thread, NULL);
+    if (opened)
+        chessdb_close(db);
+
+    CHECK(opened);
+    CHECK(query_int(other, "PRAGMA user_version;") == SCHEMA_VERSION);
+    CHECK(query_int(other, "SELECT COUNT(*) FROM game WHERE date_int IS NULL;") == 0);
+    CHECK(query_int(other, "SELECT date_int FROM game WHERE date = '202203';") == 20220300);
+    CHECK(query_int(other, "SELECT COUNT(*) FROM ply_gram;") > 0);
+    CHECK(query_int(other, "SELECT COUNT(DISTINCT game_id) FROM game_signature;") == 7);
+    CHECK(query_int(other, "SELECT COUNT(*) FROM moves WHERE checkpoints IS NULL;") == 0);
+    CHECK(query_int(other, "SELECT COUNT(*) FROM schema_migration;") == 0);
+    sqlite3_close(other);
+    return TRUE;
+}
+
+static void write_rounds(FILE *pgn)
+{
+    char event[NAME_MAX], white[NAME_MAX], black[NAME_MAX];
+
+    for (int i = 0; i < 24; i++) {
+        snprintf(event, sizeof(event), "Open %d", i % 5);
+        snprintf(white, sizeof(white), "Player %d", i * 7 % 11);
+        snprintf(black, sizeof(black), "Player %d", (i * 3 + 1) % 11);
+        write_game(pgn, event, "2021.05.01", white, black);
+    }
+    write_game(pgn, "Championship of the Federation of the Very Long Tournament Names", "2021.05.02",
+               "Player 1", "Player 2");
+}
+
+/* Importing with several processes stores the same game, player and tournament ids as one process,
+ * and the games with a tag value cut are counted.                                                 */
+static int test_import_processes(const char *argument)
+{
+    ImportStats stats, single_stats;
+    ChessDb *db = import_test_db(DATABASE_FILE, write_rounds, NULL, 3, &stats);
+    char path[SHARD_PATH_MAX], *attach;
+    int games, differences;
+    sqlite3 *raw;
+
+    (void)argument;
+    CHECK(db != NULL);
+    chessdb_close(db);
+    CHECK((db = import_test_db("single.db", write_rounds, NULL, 1, &single_stats)) != NULL);
+    chessdb_close(db);
+
+    snprintf(path, sizeof(path), "%s/single.db", test_directory);
+    CHECK(sqlite3_open(path, &raw) == SQLITE_OK);
+    snprintf(path, sizeof(path), "%s/%s", test_directory, DATABASE_FILE);
+    attach = sqlite3_mprintf("ATTACH DATABASE %Q AS parallel;", path);
+    sqlite3_exec(raw, attach, 0, 0, NULL);
+    sqlite3_free(attach);
+    games = query_int(raw, "SELECT COUNT(*) FROM parallel.game;");
+    differences =
+        query_int(raw, "SELECT COUNT(*) FROM (SELECT id, event_id, white_id, black_id FROM main.game "
+                       "EXCEPT SELECT id, event_id, white_id, black_id FROM parallel.game);") +
+        query_int(raw, "SELECT COUNT(*) FROM (SELECT id, name FROM main.player "
+                       "EXCEPT SELECT id, name FROM parallel.player);") +
+        query_int(raw, "SELECT COUNT(*) FROM (SELECT id, name, class, group_name FROM main.event "
+                       "EXCEPT SELECT id, name, class, group_name FROM parallel.event);") +
+        query_int(raw, "SELECT COUNT(*) FROM main.game") - games;
+    sqlite3_close(raw);
+
+    CHECK(stats.processes == 3 && single_stats.processes == 1);
+    CHECK(games == 25 && stats.games == 25);
+    CHECK(differences == 0);
+    CHECK(stats.cut == 1 && single_stats.cut == 1);
+    return TRUE;
+}
+
+/* Sharding by year moves every game into the shard of its year, where the date query finds them.  */
+static int test_shard_by_year(const char *argument)
+{
+    SampleInfo samples[SAMPLE_MAX];
+    ChessDb *db = open_test_db(write_years);
+    char path[SHARD_PATH_MAX];
+    int enabled, listed, left, mode, moved;
+    sqlite3 *raw;
+
+    (void)argument;
+    CHECK(db != NULL);
+    enabled = chessdb_enable_sharding(db, SHARD_BY_YEAR);
+    listed = chessdb_list_by_date(db, samples, 0, 99991231, 0);
+    chessdb_close(db);
+
+    snprintf(path, sizeof(path), "%s/%s", test_directory, DATABASE_FILE);
+    CHECK(sqlite3_open(path, &raw) == SQLITE_OK);
+    left = query_int(raw, "SELECT COUNT(*) FROM game;");
+    mode = query_int(raw, "SELECT mode FROM shard_mode;");
+    sqlite3_close(raw);
+    snprintf(path, sizeof(path), "%s/chess-2022.db", test_directory);
+    CHECK(sqlite3_open(path, &raw) == SQLITE_OK);
+    moved = query_int(raw, "SELECT COUNT(*) FROM game;");
+    sqlite3_close(raw);
+
+    CHECK(enabled);
+    CHECK(left == 0 && mode == SHARD_BY_YEAR);
+    CHECK(moved == 3);
+    CHECK(listed == 7);
+    return TRUE;
+}
+
+static void write_centuries(FILE *pgn)
+{
+    char date[16];
+
+    for (int year = 1700; year <= 1700 + SHARDS_MAX; year++) {
+        snprintf(date, sizeof(date), "%d.01.01", year);
+        write_game(pgn, "Open", date, "Player, A", "Player, B");
+    }
+}
+
+/* More years than shards fails before any game is moved, and the database stays unsharded.        */
+static int test_shard_too_many_keys(const char *argument)
+{
+    ChessDb *db = open_test_db(write_centuries);
+    char path[SHARD_PATH_MAX];
+    int enabled, left, modes, shards;
+    sqlite3 *raw;
+
+    (void)argument;
+    CHECK(db != NULL);
+    enabled = chessdb_enable_sharding(db, SHARD_BY_YEAR);
+    chessdb_close(db);
+
+    snprintf(path, sizeof(path), "%s/%s", test_directory, DATABASE_FILE);
+    CHECK(sqlite3_open(path, &raw) == SQLITE_OK);
+    left = query_int(raw, "SELECT COUNT(*) FROM game;");
+    modes = query_int(raw, "SELECT COUNT(*) FROM shard_mode;");
+    shards = query_int(raw, "SELECT COUNT(*) FROM shard;");
+    sqlite3_close(raw);
+
+    CHECK(!enabled);
+    CHECK(left == SHARDS_MAX + 1);
+    CHECK(modes == 0 && shards == 0);
+    return TRUE;
+}
+
+/* A trace replayed by two processes of ChessDatabase (program) times the calls of both sessions.  */
+static int test_session_replay(const char *program)
+{
+    char path[SHARD_PATH_MAX], command[3 * SHARD_PATH_MAX], line[256];
+    ChessDb *db = open_test_db(write_years);
+    int sessions = FALSE, standings = 0, status;
+    FILE *file;
+
+    CHECK(db != NULL && program != NULL);
+    chessdb_close(db);
+
+    // (tournament standings of Open 2021, class and group "-", then quit)...
+    snprintf(path, sizeof(path), "%s/session.trace", test_directory);
+    CHECK((file = fopen(path, "w")) != NULL);
+    fprintf(file, "# chessdb session trace\n0\t3\n10\tOpen 2021\n20\t-\n30\t-\n40\t\n50\t5\n");
+    fclose(file);
+
+    snprintf(command, sizeof(command), "cd '%s' && '%s' replay session.trace 2 0", test_directory, program);
+    CHECK((file = popen(command, "r")) != NULL);
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strstr(line, "INFO: 2 sessions (0 failed)") != NULL)
+            sessions = TRUE;
+        sscanf(line, " chessdb_get_standings %d", &standings);
+    }
+    status = pclose(file);
+
+    CHECK(status == 0);
+    CHECK(sessions);
+    CHECK(standings == 2);
+    return TRUE;
+}
+
+/* The stub engine analyses every distinct position once, a second run skips them all.             */
+static int test_analysis_stub_engine(const char *engine_path)
+{
+    AnalysisBudget budget = {1, 0, 0};
+    AnalysisStats first, second;
+    ChessDb *db = open_test_db(write_years);
+    int analysed, reanalysed;
+
+    CHECK(db != NULL && engine_path != NULL);
+    unsetenv("STUB_ENGINE_MODE");
+    analysed = chessdb_analyse(db, engine_path, 2, budget, &first);
+    reanalysed = chessdb_analyse(db, engine_path, 2, budget, &second);
+    chessdb_close(db);
+
+    CHECK(analysed > 0 && analysed == first.analysed);
+    CHECK(first.analysed + first.skipped == first.positions && first.failed == 0);
+    CHECK(reanalysed == 0 && second.skipped == second.positions);
+    return TRUE;
+}
+
+/* A search past the timeout is stopped and keeps its evaluation; an engine ignoring the stop is
+ * killed and the run fails within bounded time.                                                   */
+static int test_analysis_timeout(const char *engine_path)
+{
+    AnalysisBudget stopped = {1, 0, 50}, hanging = {2, 0, 50};
+    AnalysisStats stats, hung_stats;
+    ChessDb *db = open_test_db(write_years);
+    time_t start;
+    int analysed, hung;
+
+    CHECK(db != NULL && engine_path != NULL);
+    setenv("STUB_ENGINE_MODE", "slow", 1);
+    analysed = chessdb_analyse(db, engine_path, 1, stopped, &stats);
+
+    // (all positions are analysed at depth 1, depth 2 searches them again)...
+    setenv("STUB_ENGINE_MODE", "hang", 1);
+    start = time(NULL);
+    hung = chessdb_analyse(db, engine_path, 1, hanging, &hung_stats);
+    chessdb_close(db);
+
+    CHECK(analysed > 0 && stats.failed == 0 && stats.analysed + stats.skipped == stats.positions);
+    CHECK(hung == ERROR && hung_stats.analysed == 0 && hung_stats.failed > 0);
+    CHECK(time(NULL) - start < 10);
+    return TRUE;
+}
+
+/* An engine exiting in the middle of a run fails the run, the evaluations it gave are kept, and
+ * SIGPIPE is no longer ignored after the run.                                                     */
+static int test_analysis_engine_exit(const char *engine_path)
+{
+    AnalysisBudget budget = {1, 0, 0};
+    AnalysisStats stats;
+    struct sigaction action;
+    ChessDb *db = open_test_db(write_years);
+    int analysed;
+
+    CHECK(db != NULL && engine_path != NULL);
+    setenv("STUB_ENGINE_MODE", "exit", 1);
+    analysed = chessdb_analyse(db, engine_path, 1, budget, &stats);
+    chessdb_close(db);
+    sigaction(SIGPIPE, NULL, &action);
+
+    CHECK(analysed == ERROR);
+    CHECK(action.sa_handler == SIG_DFL);
+    CHECK(stats.analysed == 2 && stats.failed > 0);
+    return TRUE;
+}
+
+static const Test tests[] = {
+        {"fuzzy_transliteration", test_fuzzy_transliteration},
+        {"delete_year_range", test_delete_year_range},
+        {"delete_keeps_undated", test_delete_keeps_undated},
+        {"filter_year_range", test_filter_year_range},
+        {"openings_loaded", test_openings_loaded},
+        {"statement_cache", test_statement_cache},
+        {"missing_game_unlocks", test_missing_game_unlocks},
+        {"maintenance_locked", test_maintenance_locked},
+        {"migration", test_migration},
+        {"import_processes", test_import_processes},
+        {"shard_by_year", test_shard_by_year},
+        {"shard_too_many_keys", test_shard_too_many_keys},
+        {"session_replay", test_session_replay},
+        {"analysis_stub_engine", test_analysis_stub_engine},
+        {"analysis_timeout", test_analysis_timeout},
+        {"analysis_engine_exit", test_analysis_engine_exit},
+};
+
+int main(int argc, char *argv[])
+{
+    int passed;
+
+    if (argc < 2) {
+        eprintf("Usage: %s <test> [argument]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < (int)(sizeof(tests) / sizeof(tests[0])); i++) {
+        if (strcmp(argv[1], tests[i].name) != 0)
+            continue;
+
+        if (mkdtemp(test_directory) == NULL) {
+            eprintf("ERROR: cannot create a test directory...\n");
+            return EXIT_FAILURE;
+        }
+        passed = tests[i].run((argc > 2) ? argv[2] : NULL);
+        remove_test_directory();
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    eprintf("ERROR: no test named %s...\n", argv[1]);
+    return EXIT_FAILURE;
+}
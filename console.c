@@ -5,10 +5,16 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "database.h"
+#include "chessdb.h"
 #include "helperFunctions.h"
+#include "tournament.h"
+#include "fuzzy.h"
 #include "console.h"
+#include "terminal.h"
+#include "browser.h"
 
+// the database the terminal edition works on...
+static ChessDb *console_db = NULL;
 
 /* PRINT FUNCTIONS: DISPLAY MENU, INFORMATION, SAMPLE DATA OR FULL GAME... */
 
@@ -16,7 +22,7 @@
  * which will be stored and returned through choice.                                                 */
 void print_simplified_list(const SampleInfo arr_sample[], int num_of_games)
 {
-    system("clear");
+    clear_screen();
     printf("\n\tId |      Name     |   White Name  |   Black Name  |      Date     |\n");
     for (int i = 0; i < num_of_games; i++) {
         printf("\t %d | %10.10s%s | %10.10s%s | %10.10s%s | %10.10s%s |\n",
@@ -31,7 +37,7 @@ void print_simplified_list(const SampleInfo arr_sample[], int num_of_games)
 /* Prints out full game information including moves.                                                 */
 void print_full_game(const GameInfo *game)
 {
-    system("clear");
+    clear_screen();
     printf("\t**************** Game Information ****************\n");
     printf("\n\tName/Tournament: %33s\n", game->name);
     printf("\tClass:           %33s\n", game->class);
@@ -40,6 +46,8 @@ void print_full_game(const GameInfo *game)
     printf("\tDate:            %33s\n", game->date);
     printf("\tWhite:           %33s\n", game->white_name);
     printf("\tBlack:           %33s\n", game->black_name);
+    if (game->eco[0] != '\0')
+        printf("\tOpening:         %33s\n\t                 %33s\n", game->eco, game->opening);
     printf("\t--------------------------------------------------\n");
     printf("\t           White %s    | mv |     Black %s \n", game->white_result, game->black_result);
     printf("\t----------------------|----|----------------------\n");
@@ -54,33 +62,77 @@ void print_full_game(const GameInfo *game)
     printf("\t--------------------------------------------------\n");
 }
 
-/* Print out the main menu. Note - 3 items in menu.                                                  */
+/* Prints out the standings of a tournament, followed by the crosstable.
+ * Crosstable cells: points scored by the row player against the column player,
+ * 'X' on the diagonal and '.' for players that never met.                                           */
+void print_standings(const Standings *standings)
+{
+    int n = standings->num_of_players;
+
+    clear_screen();
+    printf("\t**************** Standings ****************\n");
+    printf("\n\tName/Tournament: %s\n", standings->name);
+    printf("\tClass:           %s\n", standings->class);
+    printf("\tGroup:           %s\n\n", standings->group);
+    printf("\t  # |     Player    | Gms |  W |  D |  L | Score | Buchholz |  S-B  |\n");
+    for (int i = 0; i < n; i++) {
+        const PlayerStanding *p = &standings->players[i];
+        printf("\t%3d | %10.10s%s | %3d | %2d | %2d | %2d | %5.1f |  %6.2f  | %5.2f |\n",
+               p->rank, p->name, (strlen(p->name) <= 10) ? "   " : "...",
+               p->games, p->wins, p->draws, p->losses, p->score, p->buchholz, p->sonneborn_berger);
+    }
+
+    printf("\n\tCrosstable:\n\t    ");
+    for (int col = 0; col < n; col++)
+        printf(" %4d", col + 1);
+    printf("\n");
+    for (int row = 0; row < n; row++) {
+        printf("\t%3d ", row + 1);
+        for (int col = 0; col < n; col++) {
+            double points = standings->crosstable[row * n + col];
+            if (row == col)
+                printf("    X");
+            else if (points == NOT_PAIRED)
+                printf("    .");
+            else
+                printf(" %4.1f", points);
+        }
+        printf("\n");
+    }
+}
+
+/* Print out the main menu. Note - 5 items in menu.                                                  */
 void print_main_menu()
 {
-    system("clear");
+    clear_screen();
     printf("\t********** Chess Database **********\n\n");
     printf("\t(1) Add new game to database.\n");
     printf("\t(2) View game.\n");
-    printf("\t(3) Quit.\n");
+    printf("\t(3) Tournament standings.\n");
+    printf("\t(4) Browse games.\n");
+    printf("\t(5) Quit.\n");
     printf("\t>> ");
 }
 
-/* Print out the submenu used in view_game. Note - 4 items in menu.                                  */
+/* Print out the submenu used in view_game. Note - 7 items in menu.                                  */
 void print_view_game_submenu()
 {
-    system("clear");
+    clear_screen();
     printf("\t********** View Game **********\n");
     printf("\t(1) View Unsorted list.\n");
     printf("\t(2) View sorted list.\n");
     printf("\t(3) Custom search.\n");
-    printf("\t(4) Back to main menu.\n");
+    printf("\t(4) Date range.\n");
+    printf("\t(5) Similar player names.\n");
+    printf("\t(6) Similar games.\n");
+    printf("\t(7) Back to main menu.\n");
     printf("\t>> ");
 }
 
 /* Print out the sorting selection menu. Note - 5 items in menu.                                     */
 void print_sorting_menu()
 {
-    system("clear");
+    clear_screen();
     printf("\t********** Sort by: **********\n");
     printf("\t(1) Name.\n");
     printf("\t(2) White name.\n");
@@ -101,7 +153,7 @@ void print_pre_edit_menu()
 /* Print out the edit selection menu. Note - 4 items in menu.                                        */
 void print_edit_menu()
 {
-    system("clear");
+    clear_screen();
     printf("\t********** Edit Menu **********\n");
     printf("\t(1) Change game information "
            "(name, class, group, game nr., date, player names, result).\n");
@@ -125,7 +177,7 @@ void print_scan_moves_information()
 /* Print information sheet (guidelines) for altering information in an existing game.                */
 void print_edit_information()
 {
-    system("clear");
+    clear_screen();
     printf("\t****************************** Info *******************************\n");
     printf("\t* To keep already listed text: Press return without input.        *\n");
     printf("\t* To erase text without new input: Enter '-' and press return.    *\n");
@@ -136,7 +188,7 @@ void print_edit_information()
 /* Print information sheet (guidelines) for altering the moves of an existing game.                  */
 void print_edit_moves_information()
 {
-    system("clear");
+    clear_screen();
     printf("\t****************************** Info *******************************\n");
     printf("\t* To keep already listed moves: Press return without input.       *\n");
     printf("\t* To erase move and all following moves: Enter 'end' and          *\n");
@@ -197,32 +249,70 @@ void scan_moves(GameMoves *moves) {
     moves->move_number = move_num;
 }
 
+/* Informs the user if date is not recognized as a date, as the game is then left out of date ranges. */
+void warn_unrecognized_date(const char *date)
+{
+    if (strcmp(date, "-") != 0 && !pack_date(date))
+        printf("\tINFO: date '%s' not recognized (yyyymmdd, yyyymm or yyyy), "
+               "the game will not show up in date ranges.\n", date);
+}
+
+/* Like get_string_input, but if the input ends with '?' the most used names of the dictionary
+ * kind (COMPLETE_PLAYER or COMPLETE_TOURNAMENT) starting with the input are listed, and the user
+ * may choose one by number or type again.                                                           */
+void get_name_input(const char *label, char *input_string, int max_size, int kind)
+{
+    const char *completions[COMPLETIONS_MAX];
+    int count = 0;
+
+    while (TRUE) {
+        get_string_input(label, input_string, max_size);
+        size_t length = strlen(input_string);
+
+        if (count > 0 && is_number(input_string) && atoi(input_string) >= 1 && atoi(input_string) <= count) {
+            snprintf(input_string, max_size, "%s", completions[atoi(input_string) - 1]);
+            return;
+        }
+        if (length == 0 || input_string[length - 1] != '?')
+            return;
+
+        input_string[length - 1] = '\0';
+        count = chessdb_complete_name(console_db, kind, input_string, completions, COMPLETIONS_MAX);
+        if (count == 0)
+            printf("\tNo suggestions for '%s'...\n", input_string);
+        for (int i = 0; i < count; i++)
+            printf("\t  (%d) %s\n", i + 1, completions[i]);
+    }
+}
+
 /* Prompts the user for information about the game and stores
  * the data in game.                                                                                 */
 void scan_game(GameInfo *game) {
-    system("clear");
+    clear_screen();
     printf("\t********** Game Info **********\n");
-    get_string_input("\tName: ",game->name,NAME_MAX);
+    printf("\t(end a name with '?' for suggestions)\n");
+    get_name_input("\tName: ",game->name,NAME_MAX,COMPLETE_TOURNAMENT);
     get_string_input("\tClass: ",game->class,NAME_MAX);
     get_string_input("\tGroup: ",game->group,NAME_MAX);
     get_string_input("\tGame Nr.: ",game->game_number,NAME_MAX);
-    get_string_input("\tDate: ",game->date,DATE_MAX);
-    get_string_input("\tWhite: ",game->white_name,NAME_MAX);
-    get_string_input("\tBlack: ",game->black_name,NAME_MAX);
+    get_string_input("\tDate (yyyymmdd): ",game->date,DATE_MAX);
+    warn_unrecognized_date(game->date);
+    get_name_input("\tWhite: ",game->white_name,NAME_MAX,COMPLETE_PLAYER);
+    get_name_input("\tBlack: ",game->black_name,NAME_MAX,COMPLETE_PLAYER);
     get_string_input("\tWhite result (1, 0, 1/2, remis): ",game->white_result,RESULT_MAX);
     get_string_input("\tBlack result: ",game->black_result,RESULT_MAX);
 }
 
-/* Retrieves an unsorted list of chess games. Return TRUE if the data was
+/* Retrieves a page of an unsorted list of chess games. Return TRUE if the data was
  * retrieved successfully, FALSE otherwise.
  * Output arguments:
  *     arr_sample - Sample info suited for display.
  *     num_of_elements - Number of elements returned.                                                */
-int unsorted_list(SampleInfo arr_sample[], int *num_of_elements)
+int unsorted_list(SampleInfo arr_sample[], int *num_of_elements, int page)
 {
-    *num_of_elements = get_unsorted_list(arr_sample);
+    *num_of_elements = chessdb_list(console_db, arr_sample, page);
     if (!*num_of_elements) {
-        printf("\tNo games found in the database!\n");
+        printf("\tNo %sgames found in the database!\n", (page) ? "more " : "");
         printf("\tPress ENTER to continue...");
         getchar();
         return FALSE;
@@ -230,23 +320,16 @@ int unsorted_list(SampleInfo arr_sample[], int *num_of_elements)
     return TRUE;
 }
 
-/* Retrieves a sorted list of chess games. Return TRUE if the data was
+/* Retrieves a page of a list of chess games sorted by column. Return TRUE if the data was
  * retrieved successfully, FALSE otherwise.
  * Output arguments:
  *     arr_sample - Sample info suited for display.
  *     num_of_elements - Number of elements returned.                                                */
-int sorted_list(SampleInfo arr_sample[], int *num_of_elements)
+int sorted_list(SampleInfo arr_sample[], int *num_of_elements, int column, int page)
 {
-    int ch;
-
-    if (!(ch = standard_menu(print_sorting_menu, 5, 3))) {
-        printf("\tReturning to main menu...\n");
-        return TRUE; // hence, no errors were encountered, but max tries was exhausted...
-    }
-
-    *num_of_elements = get_sorted_list(arr_sample, ch);
+    *num_of_elements = chessdb_list_sorted(console_db, arr_sample, column, page);
     if (!*num_of_elements) {
-        printf("\tNo games found in the database!)\n");
+        printf("\tNo %sgames found in the database!)\n", (page) ? "more " : "");
         printf("\tPress ENTER to continue...");
         getchar();
         return FALSE;
@@ -254,15 +337,11 @@ int sorted_list(SampleInfo arr_sample[], int *num_of_elements)
     return TRUE;
 }
 
-/* Gets a string input from user and searches the database table 'game'
- * for entries that matches the search. Table columns that are searched:
- * g_name, g_class, g_group, game_number, white_name, black_name.
- * Returns TRUE if the transaction with database executed without errors,
- * otherwise FALSE.                                                                                  */
-int search(SampleInfo arr_sample[], int *num_of_elements)
+/* Prompts the user for a search word and stores it as a LIKE pattern ("%search_word%")
+ * in mod_src, which should be of size NAME_MAX.                                                     */
+void scan_search_word(char *mod_src)
 {
     char search_word[NAME_MAX-3];
-    char mod_src[NAME_MAX];
 
     // prompts for search input...
     get_string_input("\tSearch: ", search_word, NAME_MAX-3);
@@ -271,11 +350,93 @@ int search(SampleInfo arr_sample[], int *num_of_elements)
     strcpy(mod_src, "%");
     strcat(mod_src, search_word);
     strcat(mod_src, "%");
+}
 
-    *num_of_elements = search_data(arr_sample, mod_src);
+/* Prompts the user for a player name, lists the most similar player names (ignoring case,
+ * accents and spelling variants) and stores the chosen name as a search pattern in mod_src,
+ * which should be of size NAME_MAX. Returns TRUE if a name was chosen, FALSE otherwise.            */
+int scan_similar_player(char *mod_src)
+{
+    PlayerMatch matches[FUZZY_MATCHES_MAX];
+    char name[NAME_MAX], choice[5];
+    int count, max_tries = 3;
+
+    get_string_input("\tPlayer: ", name, NAME_MAX);
+    count = chessdb_find_similar_players(console_db, name, matches, FUZZY_MATCHES_MAX);
+    if (count <= 0) {
+        printf("\tNo player names similar to: '%s'!\n", name);
+        printf("\tPress ENTER to continue...");
+        getchar();
+        return FALSE;
+    }
+
+    for (int i = 0; i < count; i++)
+        printf("\t(%d) %-40s %3.0f%%\n", i + 1, matches[i].name, matches[i].similarity * 100);
+
+    while (max_tries-- > 0) {
+        printf("\n\t(choose a player or 'b' for menu) >> ");
+        scanf("%4s", choice);
+        flush_input();
+        if (strcmp(choice, "b") == 0)
+            return FALSE;
+        if (is_number(choice) && atoi(choice) >= 1 && atoi(choice) <= count) {
+            snprintf(mod_src, NAME_MAX, "%s", matches[atoi(choice) - 1].name);
+            return TRUE;
+        }
+        printf("\tInvalid choice, please try again...\n");
+    }
+    printf("\tMax tries used!\n");
+    return FALSE;
+}
+
+/* Searches the database table 'game' for a page of entries that matches the search
+ * pattern mod_src. Table columns that are searched:
+ * g_name, g_class, g_group, game_number, white_name, black_name.
+ * Returns TRUE if the transaction with database executed without errors,
+ * otherwise FALSE.                                                                                  */
+int search(SampleInfo arr_sample[], int *num_of_elements, const char *mod_src, int page)
+{
+    *num_of_elements = chessdb_search(console_db, arr_sample, mod_src, page);
+
+    if (!*num_of_elements) {
+        printf("\tNo %sentries fits the search: '%s'!\n", (page) ? "more " : "", mod_src);
+        printf("\tPress ENTER to continue...");
+        getchar();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Prompts the user for a date range and stores it as packed dates in from_date and to_date.
+ * Returns TRUE if both dates were recognized, FALSE otherwise.                                      */
+int scan_date_range(int *from_date, int *to_date)
+{
+    char date[DATE_MAX];
+
+    get_string_input("\tFrom (yyyy, yyyymm or yyyymmdd): ", date, DATE_MAX);
+    *from_date = pack_date(date);
+    get_string_input("\tTo (yyyy, yyyymm or yyyymmdd): ", date, DATE_MAX);
+    *to_date = pack_date(date);
+
+    if (!*from_date || !*to_date) {
+        printf("\tDate not recognized!\n");
+        printf("\tPress ENTER to continue...");
+        getchar();
+        return FALSE;
+    }
+    return TRUE;
+}
 
+/* Retrieves a page of the chess games played from from_date to to_date. Return TRUE if the
+ * data was retrieved successfully, FALSE otherwise.
+ * Output arguments:
+ *     arr_sample - Sample info suited for display.
+ *     num_of_elements - Number of elements returned.                                                */
+int date_range(SampleInfo arr_sample[], int *num_of_elements, int from_date, int to_date, int page)
+{
+    *num_of_elements = chessdb_list_by_date(console_db, arr_sample, from_date, to_date, page);
     if (!*num_of_elements) {
-        printf("\tNo entries fits the search: '%s'!\n", search_word);
+        printf("\tNo %sgames found in the date range!\n", (page) ? "more " : "");
         printf("\tPress ENTER to continue...");
         getchar();
         return FALSE;
@@ -283,15 +444,65 @@ int search(SampleInfo arr_sample[], int *num_of_elements)
     return TRUE;
 }
 
-/* Displays a sample list of all games in the database,
+/* Retrieves the games that followed the course most similar to the game with the id game_id,
+ * most similar first (one page). Return TRUE if games were found, FALSE otherwise.
+ * Output arguments:
+ *     arr_sample - Sample info suited for display.
+ *     num_of_elements - Number of elements returned.                                                */
+int similar_games(SampleInfo arr_sample[], int *num_of_elements, const char *game_id)
+{
+    SimilarGame matches[SIMILAR_MATCHES_MAX];
+    SimilarSearchStats stats;
+    GameBatch batch;
+    int game_ids[SIMILAR_MATCHES_MAX], count = 0;
+
+    if (is_number(game_id))
+        count = chessdb_find_similar_games(console_db, atoi(game_id), matches, SIMILAR_MATCHES_MAX, &stats);
+
+    if (count > 0) {
+        for (int i = 0; i < count; i++)
+            game_ids[i] = matches[i].game_id;
+        count = chessdb_get_games(console_db, &batch, game_ids, count);
+    }
+    if (count <= 0) {
+        printf("\tNo games similar to game '%s' found!\n", game_id);
+        printf("\tPress ENTER to continue...");
+        getchar();
+        return FALSE;
+    }
+
+    // the batch is in id order, the list in order of similarity...
+    *num_of_elements = 0;
+    for (int i = 0; i < SIMILAR_MATCHES_MAX && *num_of_elements < count; i++) {
+        for (int j = 0; j < batch.num_of_games; j++) {
+            const GameInfo *game = &batch.games[j];
+            SampleInfo *sample = &arr_sample[*num_of_elements];
+
+            if (game->game_id != game_ids[i])
+                continue;
+            sample->id = game->game_id;
+            snprintf(sample->name, NAME_MAX, "%s", game->name);
+            snprintf(sample->date, DATE_MAX, "%s", game->date);
+            snprintf(sample->white_name, NAME_MAX, "%s", game->white_name);
+            snprintf(sample->black_name, NAME_MAX, "%s", game->black_name);
+            (*num_of_elements)++;
+        }
+    }
+    chessdb_free_batch(&batch);
+    return TRUE;
+}
+
+/* Displays a sample list (one page) of games in the database,
  * prompt the user for a choice of game to display and returns result,
+ * NEXT_PAGE or PREVIOUS_PAGE if another page was requested,
  * 0 (FALSE) if 'back to menu' or 0 if max_tries has reached.                                        */
-int list_games(const SampleInfo arr_sample[], int num_of_elements) {
+int list_games(const SampleInfo arr_sample[], int num_of_elements, int page) {
     char choice[5];
     int max_tries = 3;
 
-    // printing list and asks for either a choice of game or 'b' for back to menu...
+    // printing list and asks for either a choice of game, another page or 'b' for back to menu...
     print_simplified_list(arr_sample, num_of_elements);
+    printf("\n\tPage %d%s\n", page + 1, (num_of_elements == SAMPLE_MAX) ? " (more: 'n')" : "");
     while (TRUE) {
         if (max_tries == 0) {
             printf("\tMax tries used!\n");
@@ -300,13 +511,17 @@ int list_games(const SampleInfo arr_sample[], int num_of_elements) {
             return FALSE;
         }
 
-        printf("\n\t(choose a game or 'b' for menu) >> ");
+        printf("\n\t(choose a game, 'n'/'p' for next/previous page or 'b' for menu) >> ");
         scanf("%4s", choice);
         flush_input();
         if (is_number(choice))
             return atoi(choice); // already checked successfully as a numeric value...
         else if (strcmp(choice, "b") == 0)
             return FALSE;
+        else if (strcmp(choice, "n") == 0 && num_of_elements == SAMPLE_MAX)
+            return NEXT_PAGE;
+        else if (strcmp(choice, "p") == 0 && page > 0)
+            return PREVIOUS_PAGE;
         else
             printf("\tInvalid choice, please try again...\n");
 
@@ -318,7 +533,7 @@ int list_games(const SampleInfo arr_sample[], int num_of_elements) {
  * return TRUE if all went accordingly, FALSE otherwise.                                             */
 int get_game(GameInfo *game)
 {
-    if (get_game_by_id(game))
+    if (chessdb_get_game(console_db, game))
         return TRUE;
     return FALSE;
 }
@@ -332,6 +547,7 @@ void edit_game_information(GameInfo *game)
     edit_existing_string("\tGroup: ",game->group,NAME_MAX);
     edit_existing_string("\tGame Nr.: ",game->game_number,NAME_MAX);
     edit_existing_string("\tDate: ",game->date,DATE_MAX);
+    warn_unrecognized_date(game->date);
     edit_existing_string("\tWhite: ",game->white_name,NAME_MAX);
     edit_existing_string("\tBlack: ",game->black_name,NAME_MAX);
     edit_existing_string("\tWhite result (1, 0, 1/2, remis): ",game->white_result,RESULT_MAX);
@@ -395,7 +611,7 @@ int input_game()
     GameInfo game;
     scan_game(&game);
     scan_moves(&game.game_moves);
-    return insert_data(&game);
+    return chessdb_insert_game(console_db, &game);
 }
 
 /* Pre edit game:
@@ -439,7 +655,7 @@ int edit_game(GameInfo *game)
     switch(ch) {
         case 1: // edit game information.
             edit_game_information(game);
-            if (!update_data(game))
+            if (!chessdb_update_game(console_db, game))
                 return FALSE;
             printf("INFO: data updated successfully...\n");
             return TRUE;
@@ -447,13 +663,13 @@ int edit_game(GameInfo *game)
         case 2: {// 2 edit game moves.
             int new_moves_count = edit_game_moves(game);
             printf("INFO: number of moves after editing: %d\n", new_moves_count);
-            if (!update_moves(game, new_moves_count))
+            if (!chessdb_update_moves(console_db, game, new_moves_count))
                 return FALSE;
             printf("INFO: moves updated successfully...\n");
             break;
         }
         case 3: // 3 delete game.
-            if (!delete_game(game))
+            if (!chessdb_delete_game(console_db, game))
                 return FALSE;
             printf("INFO: data deleted successfully...\n");
             break;
@@ -476,33 +692,69 @@ int edit_game(GameInfo *game)
 int view_game()
 {
     // insert options (submenu): 1. list games unsorted, 2. list game sorted by (..?..) or 3. search by (..?..)
-    SampleInfo arr_sample[100];
-    int ch, id, num_of_samples = 0;
+    SampleInfo arr_sample[SAMPLE_MAX];
+    char mod_src[NAME_MAX];
+    int ch, id, column = 0, page = 0, num_of_samples = 0, found, from_date = 0, to_date = 0;
 
-    if (!(ch = standard_menu(print_view_game_submenu, 4, 3))) {
+    if (!(ch = standard_menu(print_view_game_submenu, 7, 3))) {
         printf("\tReturning to main menu...\n");
         return TRUE; // hence, no errors were encountered, but max tries was exhausted...
     }
 
     // responding to choice...
-    if (ch == 1) {
-        if (!unsorted_list(arr_sample, &num_of_samples))  // unsorted list...
-            return FALSE;
-    }
-    else if (ch == 2) {
-        if (!sorted_list(arr_sample, &num_of_samples))    // sorted list...
-            return FALSE;
+    if (ch == 2) {
+        if (!(column = standard_menu(print_sorting_menu, 5, 3)) || column == 5) {
+            printf("\tReturning to main menu...\n");
+            return TRUE; // hence, no errors were encountered, but max tries was exhausted...
+        }
     }
     else if (ch == 3) {
-        if (!search(arr_sample, &num_of_samples))         // search list...
-            return FALSE;
+        scan_search_word(mod_src);
     }
     else if (ch == 4) {
+        if (!scan_date_range(&from_date, &to_date))
+            return TRUE;
+    }
+    else if (ch == 5) {
+        if (!scan_similar_player(mod_src))
+            return TRUE;
+        ch = 3;                                  // the games of the chosen player, as a search...
+    }
+    else if (ch == 6) {
+        get_string_input("\tGame id: ", mod_src, NAME_MAX);
+    }
+    else if (ch == 7) {
         return TRUE;                                                     // back to menu...
     }
 
-    // displaying simplified list of games and acting accordingly...
-    id = list_games(arr_sample, num_of_samples);
+    // displaying simplified list of games page by page and acting accordingly...
+    while (TRUE) {
+        if (ch == 1)
+            found = unsorted_list(arr_sample, &num_of_samples, page);            // unsorted list...
+        else if (ch == 2)
+            found = sorted_list(arr_sample, &num_of_samples, column, page);      // sorted list...
+        else if (ch == 3)
+            found = search(arr_sample, &num_of_samples, mod_src, page);          // search list...
+        else if (ch == 6)
+            found = similar_games(arr_sample, &num_of_samples, mod_src);         // similar games...
+        else
+            found = date_range(arr_sample, &num_of_samples, from_date, to_date, page); // date range...
+
+        if (!found) {
+            if (page == 0)
+                return FALSE;
+            page--;     // no more games, back to the last page...
+            continue;
+        }
+
+        id = list_games(arr_sample, num_of_samples, page);
+        if (id == NEXT_PAGE)
+            page++;
+        else if (id == PREVIOUS_PAGE)
+            page--;
+        else
+            break;
+    }
 
     if (id) {
         GameInfo game;
@@ -518,14 +770,62 @@ int view_game()
     return TRUE;
 }
 
-/* Main driver function.                                                                             */
-void run_terminal_edition() {
+/* Tournament Standings:
+ * Prompts the user for tournament, class and group and displays the standings and crosstable.
+ * Returns TRUE if the standings were displayed, FALSE otherwise.                                    */
+int tournament_standings()
+{
+    char name[NAME_MAX], class[NAME_MAX], group[NAME_MAX];
+    Standings standings;
+
+    clear_screen();
+    printf("\t********** Tournament **********\n");
+    get_name_input("\tName: ", name, NAME_MAX, COMPLETE_TOURNAMENT);
+    get_string_input("\tClass: ", class, NAME_MAX);
+    get_string_input("\tGroup: ", group, NAME_MAX);
+
+    if (!chessdb_get_standings(console_db, &standings, name, class, group)) {
+        printf("\tNo finished games found for: '%s' '%s' '%s'!\n", name, class, group);
+        printf("\tPress ENTER to continue...");
+        getchar();
+        return FALSE;
+    }
+
+    print_standings(&standings);
+    free_standings(&standings);
+
+    printf("\n\tPress ENTER to continue...");
+    getchar();
+    return TRUE;
+}
+
+/* Opens the game with game_id chosen in the game browser, as a game chosen in view_game.           */
+void open_browsed_game(int game_id)
+{
+    GameInfo game;
+
+    game.game_id = game_id;
+    if (!get_game(&game)) {
+        printf("\tNo game with id: %d!\n", game_id);
+        printf("\tPress ENTER to continue...");
+        getchar();
+        return;
+    }
+    if (edit_game(&game))
+        printf("INFO: edit game protocol executed successfully...\n");
+}
+
+/* Main driver function, working on the database handle db.                                        */
+void run_terminal_edition(ChessDb *db) {
     char choice[2];
     int ch;
 
+    console_db = db;
+
     while (TRUE) {
         print_main_menu();
-        scanf("%1s", choice);
+        if (scanf("%1s", choice) == EOF)
+            break;
         flush_input();
 
         ch = (int)strtol(choice, NULL, 10);
@@ -538,7 +838,15 @@ void run_terminal_edition() {
             if (view_game())
                 printf("INFO: view_game protocol executed without errors...\n");
         }
-        else if (ch == 3)
+        else if (ch == 3) {
+            if (tournament_standings())
+                printf("INFO: tournament_standings protocol executed without errors...\n");
+        }
+        else if (ch == 4) {
+            if (browse_games(console_db, open_browsed_game))
+                printf("INFO: browse_games protocol executed without errors...\n");
+        }
+        else if (ch == 5)
             break;
         else
             printf("\tInvalid choice: %d!\n\n", ch);
@@ -5,6 +5,8 @@
 #ifndef CHESSDATABASE_CONSOLE_H
 #define CHESSDATABASE_CONSOLE_H
 
-void run_terminal_edition();
+#include "chessdb.h"
+
+void run_terminal_edition(ChessDb *db);
 
 #endif //CHESSDATABASE_CONSOLE_H
@@ -0,0 +1,79 @@
+//
+// Created by flimsy on 3/17/22.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "context.h"
+
+/* ********** DATABASE HANDLES **********
+ * The handle the library works on is kept per thread. A thread that never chose one works on
+ * the default handle, chess.db in the working directory.                                         */
+
+static ChessDb default_db;
+static pthread_key_t current_key;
+static pthread_once_t context_once = PTHREAD_ONCE_INIT;
+
+static void init_context()
+{
+    pthread_key_create(&current_key, NULL);
+    init_db(&default_db, DATABASE_FILE, NULL);
+}
+
+/* Initializes db for the database file path with options (the defaults if NULL), nothing is
+ * opened or read yet.                                                                             */
+void init_db(ChessDb *db, const char *path, const ChessDbOptions *options)
+{
+    const char *slash = strrchr(path, '/');
+
+    memset(db, 0, sizeof(ChessDb));
+    pthread_mutex_init(&db->lock, NULL);
+    if (options != NULL)
+        db->options = *options;
+    else
+        chessdb_default_options(&db->options);
+
+    snprintf(db->catalog_path, SHARD_PATH_MAX, "%s", path);
+    snprintf(db->routed_path, SHARD_PATH_MAX, "%s", path);
+    if (slash != NULL)
+        snprintf(db->directory, SHARD_PATH_MAX, "%.*s", (int)(slash - path + 1), path);
+    db->cache.stats.budget = db->options.cache_budget;
+}
+
+/* Returns the database handle of the calling thread.                                              */
+ChessDb *current_db()
+{
+    ChessDb *db;
+
+    pthread_once(&context_once, init_context);
+    db = pthread_getspecific(current_key);
+    return (db != NULL) ? db : &default_db;
+}
+
+/* Makes db the database handle of the calling thread (NULL for the default handle).
+ * Returns the handle used before, to be restored by another use_db.                               */
+ChessDb *use_db(ChessDb *db)
+{
+    ChessDb *previous;
+
+    pthread_once(&context_once, init_context);
+    previous = pthread_getspecific(current_key);
+    pthread_setspecific(current_key, db);
+    return previous;
+}
+
+/* Stores the path of the database file next to the catalog database of the current handle in
+ * path (file itself if it is absolute). Returns TRUE on success, FALSE if the path is too long
+ * (path is cut).                                                                                  */
+int resolve_db_file(const char *file, char path[SHARD_PATH_MAX])
+{
+    int length;
+
+    if (file[0] == '/')
+        length = snprintf(path, SHARD_PATH_MAX, "%s", file);
+    else
+        length = snprintf(path, SHARD_PATH_MAX, "%s%s", current_db()->directory, file);
+    return length >= 0 && length < SHARD_PATH_MAX;
+}
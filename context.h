@@ -0,0 +1,48 @@
+//
+// Created by flimsy on 3/17/22.
+//
+
+#ifndef CHESSDATABASE_CONTEXT_H
+#define CHESSDATABASE_CONTEXT_H
+
+#include <pthread.h>
+#include <time.h>
+
+#include "chessdb.h"
+#include "shard.h"
+#include "cache.h"
+#include "tournament.h"
+#include "fuzzy.h"
+#include "autocomplete.h"
+#include "headerstore.h"
+
+/* Everything kept about one open database (see chessdb.h). The library functions work on the
+ * handle of the calling thread, current_db, which the chessdb_ functions set for the duration of
+ * a call and worker threads take over from the thread that started them.                         */
+struct ChessDb {
+    pthread_mutex_t lock;
+    pthread_t owner;                    // thread inside a chessdb_ call, if owned...
+    int owned;
+    ChessDbOptions options;
+    char directory[SHARD_PATH_MAX];     // of the catalog database, shard files are next to it...
+    char catalog_path[SHARD_PATH_MAX];
+    char routed_path[SHARD_PATH_MAX];
+    int routed_id_floor;
+    int merge_column;                   // merge order of the fanned out list queries...
+    ShardCatalog catalog;
+    ResultCache cache;
+    StatementCache statements;
+    StandingsCache standings;
+    PlayerIndex player_index;
+    Completions completions;
+    HeaderStore header_store;
+    struct timespec call_started;       // of the running call, if calls are observed...
+    Maintenance maintenance;
+};
+
+void init_db(ChessDb *db, const char *path, const ChessDbOptions *options);
+ChessDb *current_db();
+ChessDb *use_db(ChessDb *db);
+int resolve_db_file(const char *file, char path[SHARD_PATH_MAX]);
+
+#endif //CHESSDATABASE_CONTEXT_H
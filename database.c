@@ -2,11 +2,23 @@
 // Created by flimsy on 12/18/21.
 //
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <sqlite3.h>
 #include <string.h>
 
 #include "database.h"
+#include "tournament.h"
+#include "cache.h"
+#include "movecodec.h"
+#include "eco.h"
+#include "shard.h"
+#include "lineindex.h"
+#include "checkpoint.h"
+#include "headerstore.h"
+#include "context.h"
+#include "maintenance.h"
+#include "schema.h"
 
 /* ********** DATABASE QUERIES **********                                                          */
 
@@ -16,28 +28,103 @@ const char commitTransaction[] = "COMMIT;";
 
 const char rollbackTransaction[] = "ROLLBACK;";
 
-const char dropTables[] = "DROP TABLE IF EXISTS game;"
+const char dropTables[] = "DROP VIEW IF EXISTS game_view;"
+                          "DROP TABLE IF EXISTS ply_gram;"
+                          "DROP TABLE IF EXISTS signature_band;"
+                          "DROP TABLE IF EXISTS game_signature;"
+                          "DROP TABLE IF EXISTS game;"
                           "DROP TABLE IF EXISTS moves;"
-                          "DROP TABLE IF EXISTS single_move;";
+                          "DROP TABLE IF EXISTS single_move;"
+                          "DROP TABLE IF EXISTS player;"
+                          "DROP TABLE IF EXISTS event;";
+
+/* Player and tournament names are stored once, in player and event, games refer to them by id.
+ * The tournament (event) is the name, class and group together. A name is never NULL, so the
+ * games of one player come out of the index on white_id (black_id) in id order when listing by
+ * name.                                                                                           */
+const char tablePlayer[] = "CREATE TABLE IF NOT EXISTS player("
+                           "id INTEGER PRIMARY KEY,"
+                           "name TEXT NOT NULL UNIQUE"
+                           ");";
+
+const char tableEvent[] = "CREATE TABLE IF NOT EXISTS event("
+                          "id INTEGER PRIMARY KEY,"
+                          "name TEXT NOT NULL,"
+                          "class TEXT NOT NULL,"
+                          "group_name TEXT NOT NULL,"
+                          "UNIQUE(name, class, group_name)"
+                          ");";
 
 const char tableGame[] = "CREATE TABLE IF NOT EXISTS game("
                          "id INTEGER PRIMARY KEY,"
-                         "g_name TEXT,"
-                         "g_class TEXT,"
-                         "g_group TEXT,"
+                         "event_id INTEGER REFERENCES event(id),"
                          "game_number TEXT,"
                          "date TEXT,"
-                         "white_name TEXT,"
-                         "black_name TEXT,"
+                         "white_id INTEGER REFERENCES player(id),"
+                         "black_id INTEGER REFERENCES player(id),"
                          "white_result TEXT,"
-                         "black_result TEXT"
+                         "black_result TEXT,"
+                         "date_int INTEGER,"
+                         "eco TEXT,"
+                         "opening TEXT"
                          ");";
 
+/* The games with their names, in the column order game had before the names were interned
+ * (g_name ... opening), followed by the ids. Queries read games through it.                       */
+const char viewGame[] = "CREATE VIEW IF NOT EXISTS game_view AS "
+                        "SELECT game.id AS id, event.name AS g_name, event.class AS g_class, "
+                        "event.group_name AS g_group, game_number, date, white.name AS white_name, "
+                        "black.name AS black_name, white_result, black_result, date_int, eco, opening, "
+                        "event_id, white_id, black_id "
+                        "FROM game "
+                        "INNER JOIN event ON event.id = game.event_id "
+                        "INNER JOIN player AS white ON white.id = game.white_id "
+                        "INNER JOIN player AS black ON black.id = game.black_id;";
+
+const char indexGamePlayers[] = "CREATE INDEX IF NOT EXISTS game_white_id ON game(white_id);"
+                                "CREATE INDEX IF NOT EXISTS game_black_id ON game(black_id);"
+                                "CREATE INDEX IF NOT EXISTS game_event_id ON game(event_id);";
+
+/* Games stored by older versions hold the names themselves, they are copied into a game table
+ * with ids (foreign keys must be off while game is replaced). Missing names become ''.           */
+const char internGameNames[] = "PRAGMA foreign_keys = OFF;"
+                               "BEGIN TRANSACTION;"
+                               "INSERT OR IGNORE INTO player (name) "
+                               "SELECT IFNULL(white_name, '') FROM game UNION SELECT IFNULL(black_name, '') FROM game;"
+                               "INSERT OR IGNORE INTO event (name, class, group_name) "
+                               "SELECT DISTINCT IFNULL(g_name, ''), IFNULL(g_class, ''), IFNULL(g_group, '') FROM game;"
+                               "CREATE TABLE game_interned("
+                               "id INTEGER PRIMARY KEY,"
+                               "event_id INTEGER REFERENCES event(id),"
+                               "game_number TEXT,"
+                               "date TEXT,"
+                               "white_id INTEGER REFERENCES player(id),"
+                               "black_id INTEGER REFERENCES player(id),"
+                               "white_result TEXT,"
+                               "black_result TEXT,"
+                               "date_int INTEGER,"
+                               "eco TEXT,"
+                               "opening TEXT"
+                               ");"
+                               "INSERT INTO game_interned "
+                               "SELECT g.id, e.id, g.game_number, g.date, w.id, b.id, g.white_result, "
+                               "g.black_result, g.date_int, g.eco, g.opening FROM game g "
+                               "INNER JOIN event e ON e.name = IFNULL(g.g_name, '') "
+                               "AND e.class = IFNULL(g.g_class, '') AND e.group_name = IFNULL(g.g_group, '') "
+                               "INNER JOIN player w ON w.name = IFNULL(g.white_name, '') "
+                               "INNER JOIN player b ON b.name = IFNULL(g.black_name, '');"
+                               "DROP TABLE game;"
+                               "ALTER TABLE game_interned RENAME TO game;"
+                               "COMMIT;"
+                               "PRAGMA foreign_keys = ON;";
+
 const char tableMoves[] = "CREATE TABLE IF NOT EXISTS moves("
                           "id INTEGER PRIMARY KEY,"
                           "number_of_moves INTEGER,"
                           "game_id INTEGER,"
-                          "FOREIGN KEY(game_id) REFERENCES game(id)"
+                          "packed_moves BLOB,"
+                          "checkpoints BLOB,"
+                          "FOREIGN KEY(game_id) REFERENCES game(id) ON DELETE CASCADE"
                           ");";
 
 const char tableSingleMove[] = "CREATE TABLE IF NOT EXISTS single_move("
@@ -46,58 +133,312 @@ const char tableSingleMove[] = "CREATE TABLE IF NOT EXISTS single_move("
                                "white_move TEXT,"
                                "black_move TEXT,"
                                "moves_id INTEGER,"
-                               "FOREIGN KEY(moves_id) REFERENCES moves(id)"
+                               "FOREIGN KEY(moves_id) REFERENCES moves(id) ON DELETE CASCADE"
                                ");";
 
-const char insertIntoGame[] = "INSERT INTO game VALUES ("
-                              "?, ?, ?, ?, ?, ?, ?, ?, ?, ?"
+/* Line index: one row per distinct window of LINE_PLIES plies of a game (see lineindex.c).          */
+const char tablePlyGram[] = "CREATE TABLE IF NOT EXISTS ply_gram("
+                            "hash INTEGER,"
+                            "game_id INTEGER,"
+                            "PRIMARY KEY(hash, game_id),"
+                            "FOREIGN KEY(game_id) REFERENCES game(id) ON DELETE CASCADE"
+                            ") WITHOUT ROWID;";
+
+const char indexPlyGramGameId[] = "CREATE INDEX IF NOT EXISTS ply_gram_game_id ON ply_gram(game_id);";
+
+const char insertPlyGram[] = "INSERT OR IGNORE INTO ply_gram VALUES (?, ?);";
+
+const char deletePlyGrams[] = "DELETE FROM ply_gram WHERE game_id = ?;";
+
+const char selectPlyGramPostings[] = "SELECT game_id FROM ply_gram WHERE hash = ? ORDER BY game_id;";
+
+/* Similar game index: the MinHash signature of every game long enough for a line index window,
+ * and one row per band of the signature (see similar.c).                                          */
+const char tableGameSignature[] = "CREATE TABLE IF NOT EXISTS game_signature("
+                                  "game_id INTEGER PRIMARY KEY,"
+                                  "signature BLOB,"
+                                  "FOREIGN KEY(game_id) REFERENCES game(id) ON DELETE CASCADE"
+                                  ");";
+
+const char tableSignatureBand[] = "CREATE TABLE IF NOT EXISTS signature_band("
+                                  "hash INTEGER,"
+                                  "game_id INTEGER,"
+                                  "PRIMARY KEY(hash, game_id),"
+                                  "FOREIGN KEY(game_id) REFERENCES game(id) ON DELETE CASCADE"
+                                  ") WITHOUT ROWID;";
+
+const char indexSignatureBandGameId[] = "CREATE INDEX IF NOT EXISTS signature_band_game_id ON signature_band(game_id);";
+
+const char insertGameSignature[] = "INSERT OR REPLACE INTO game_signature VALUES (?, ?);";
+
+const char insertSignatureBand[] = "INSERT OR IGNORE INTO signature_band VALUES (?, ?);";
+
+const char deleteGameSignature[] = "DELETE FROM game_signature WHERE game_id = ?;";
+
+const char deleteSignatureBands[] = "DELETE FROM signature_band WHERE game_id = ?;";
+
+const char selectGameSignature[] = "SELECT signature FROM game_signature WHERE game_id = ?;";
+
+// (one parameter per band, SIMILAR_BANDS)...
+const char selectBandCandidates[] = "SELECT game_id, signature FROM game_signature WHERE game_id IN "
+                                    "(SELECT game_id FROM signature_band WHERE hash IN "
+                                    "(?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, ?12, ?13, ?14, ?15, ?16, ?17, ?18, ?19, ?20));";
+
+const char enableForeignKeys[] = "PRAGMA foreign_keys = ON;";
+
+const char selectMovesOnDelete[] = "SELECT on_delete FROM pragma_foreign_key_list('moves');";
+
+/* Tables created by older versions have no ON DELETE CASCADE, SQLite can only add it by copying
+ * the table (foreign keys must be off during the copy).                                           */
+const char rebuildMovesTables[] = "PRAGMA foreign_keys = OFF;"
+                                  "BEGIN TRANSACTION;"
+                                  "CREATE TABLE moves_cascade("
+                                  "id INTEGER PRIMARY KEY,"
+                                  "number_of_moves INTEGER,"
+                                  "game_id INTEGER,"
+                                  "packed_moves BLOB,"
+                                  "FOREIGN KEY(game_id) REFERENCES game(id) ON DELETE CASCADE"
+                                  ");"
+                                  "INSERT INTO moves_cascade SELECT id, number_of_moves, game_id, packed_moves FROM moves;"
+                                  "CREATE TABLE single_move_cascade("
+                                  "id INTEGER PRIMARY KEY,"
+                                  "move_number INTEGER,"
+                                  "white_move TEXT,"
+                                  "black_move TEXT,"
+                                  "moves_id INTEGER,"
+                                  "FOREIGN KEY(moves_id) REFERENCES moves(id) ON DELETE CASCADE"
+                                  ");"
+                                  "INSERT INTO single_move_cascade "
+                                  "SELECT id, move_number, white_move, black_move, moves_id FROM single_move;"
+                                  "DROP TABLE single_move;"
+                                  "DROP TABLE moves;"
+                                  "ALTER TABLE moves_cascade RENAME TO moves;"
+                                  "ALTER TABLE single_move_cascade RENAME TO single_move;"
+                                  "COMMIT;"
+                                  "PRAGMA foreign_keys = ON;";
+
+const char indexMovesGameId[] = "CREATE INDEX IF NOT EXISTS moves_game_id ON moves(game_id);";
+
+/* date_int is the packed date (see pack_date), 0 if the date is unknown and NULL if not yet
+ * converted from date (databases from older versions).                                            */
+const char indexGameDate[] = "CREATE INDEX IF NOT EXISTS game_date ON game(date_int);";
+
+const char indexGameEco[] = "CREATE INDEX IF NOT EXISTS game_eco ON game(eco);";
+
+const char updateUnconvertedDates[] = "UPDATE game SET date_int = pack_date(date) WHERE id BETWEEN ? AND ? AND date_int IS NULL;";
+
+const char indexSingleMoveMovesId[] = "CREATE INDEX IF NOT EXISTS single_move_moves_id "
+                                      "ON single_move(moves_id, move_number);";
+
+/* Adds the tournament (name, class, group) and the two players of a game if they are new.         */
+const char insertEvent[] = "INSERT OR IGNORE INTO event (name, class, group_name) VALUES (?, ?, ?);";
+
+const char insertPlayers[] = "INSERT OR IGNORE INTO player (name) VALUES (?), (?);";
+
+/* The id is the next after the largest id, but at least the id floor of the shard (see shard.h).
+ * The names are looked up in event and player, insertEvent and insertPlayers must run first.      */
+const char insertIntoGame[] = "INSERT INTO game (id, event_id, game_number, date, "
+                              "white_id, black_id, white_result, black_result, date_int, eco, opening) VALUES ("
+                              "(SELECT MAX(IFNULL(MAX(id), 0), ?) + 1 FROM game), "
+                              "(SELECT id FROM event WHERE name = ? AND class = ? AND group_name = ?), ?, ?, "
+                              "(SELECT id FROM player WHERE name = ?), (SELECT id FROM player WHERE name = ?), "
+                              "?, ?, ?, NULLIF(?, ''), NULLIF(?, '')"
                               ");";
 
-const char insertIntoMoves[] = "INSERT INTO moves VALUES ("
-                               "?, ?, ?"
+const char insertIntoMoves[] = "INSERT INTO moves (id, number_of_moves, game_id, packed_moves, checkpoints) VALUES ("
+                               "?, ?, ?, ?, ?"
                                ");";
 
 const char insertIntoSingleMove[] = "INSERT INTO single_move VALUES("
                                     "?, ?, ?, ?, ?"
                                     ");";
 
-const char updateGame[] = "UPDATE game SET g_name = ?, "
-                          "g_class = ?, g_group = ?, game_number = ?, date = ?, white_name = ?, "
-                          "black_name = ?, white_result = ?, black_result = ? "
+const char updateGame[] = "UPDATE game SET "
+                          "event_id = (SELECT id FROM event WHERE name = ? AND class = ? AND group_name = ?), "
+                          "game_number = ?, date = ?, date_int = ?, "
+                          "white_id = (SELECT id FROM player WHERE name = ?), "
+                          "black_id = (SELECT id FROM player WHERE name = ?), white_result = ?, black_result = ? "
                           "WHERE id = ?;";
 
+const char updateGameOpening[] = "UPDATE game SET eco = NULLIF(?, ''), opening = NULLIF(?, '') WHERE id = ?;";
+
 const char updateMoveCount[] = "UPDATE moves SET number_of_moves = ? WHERE id = ?;";
 
+const char updatePackedMoves[] = "UPDATE moves SET number_of_moves = ?, packed_moves = ? WHERE id = ?;";
+
+const char updateCheckpoints[] = "UPDATE moves SET checkpoints = ? WHERE id = ?;";
+
 const char updateMove[] = "UPDATE single_move SET white_move = ?, black_move = ? "
                           "WHERE moves_id = ? AND move_number = ?;";
 
-const char deleteAllSingleMoves[] = "DELETE FROM single_move WHERE moves_id = ?;";
-
 const char deleteSingleMove[] = "DELETE FROM single_move WHERE moves_id = ? AND move_number = ?;";
 
-const char deleteMoves[] = "DELETE FROM moves WHERE game_id = ?;";
-
+/* The moves and single moves of the game are deleted by ON DELETE CASCADE.                        */
 const char deleteGameInformation[] = "DELETE FROM game WHERE id = ?;";
 
-const char selectAll[] = "SELECT * FROM game;";
+/* Bulk filter: every condition is left out if its parameter is NULL (or the date range is 0).     */
+const char deleteGamesMatching[] = "DELETE FROM game WHERE "
+                                   "(?1 IS NULL OR event_id IN (SELECT id FROM event WHERE name LIKE ?1)) AND "
+                                   "(?2 IS NULL OR white_id IN (SELECT id FROM player WHERE name LIKE ?2) OR "
+                                   "black_id IN (SELECT id FROM player WHERE name LIKE ?2)) AND "
+                                   "(?3 IS NULL OR date_int BETWEEN ?3 AND ?4);";
+
+/* Names no game refers to any more.                                                               */
+const char deleteUnusedPlayers[] = "DELETE FROM player WHERE "
+                                   "NOT EXISTS (SELECT 1 FROM game WHERE white_id = player.id) AND "
+                                   "NOT EXISTS (SELECT 1 FROM game WHERE black_id = player.id);";
+
+const char deleteUnusedEvents[] = "DELETE FROM event WHERE NOT EXISTS (SELECT 1 FROM game WHERE event_id = event.id);";
+
+const char selectTableCounts[] = "SELECT (SELECT COUNT(*) FROM moves), (SELECT COUNT(*) FROM single_move);";
+
+/* A rename adds the new name (?2), points the games at it and removes the old name (?1), the new
+ * name may already exist. Tournaments are renamed in every class and group.                       */
+const char insertRenamedPlayer[] = "INSERT OR IGNORE INTO player (name) SELECT ?2 FROM player WHERE name = ?1;";
+
+const char renamePlayer[] = "UPDATE game SET "
+                            "white_id = CASE WHEN white_id = (SELECT id FROM player WHERE name = ?1) "
+                            "THEN (SELECT id FROM player WHERE name = ?2) ELSE white_id END, "
+                            "black_id = CASE WHEN black_id = (SELECT id FROM player WHERE name = ?1) "
+                            "THEN (SELECT id FROM player WHERE name = ?2) ELSE black_id END "
+                            "WHERE white_id = (SELECT id FROM player WHERE name = ?1) "
+                            "OR black_id = (SELECT id FROM player WHERE name = ?1);";
+
+const char deleteRenamedPlayer[] = "DELETE FROM player WHERE name = ?1 AND ?1 <> ?2;";
+
+const char insertRenamedEvents[] = "INSERT OR IGNORE INTO event (name, class, group_name) "
+                                   "SELECT ?2, class, group_name FROM event WHERE name = ?1;";
 
-const char selectAllOrderByName[] = "SELECT * FROM game ORDER BY g_name;";
+const char renameTournament[] = "UPDATE game SET event_id = ("
+                                "SELECT renamed.id FROM event AS old INNER JOIN event AS renamed "
+                                "ON renamed.name = ?2 AND renamed.class = old.class "
+                                "AND renamed.group_name = old.group_name WHERE old.id = game.event_id) "
+                                "WHERE event_id IN (SELECT id FROM event WHERE name = ?1);";
 
-const char selectAllOrderByWhiteName[] = "SELECT * FROM game ORDER BY white_name;";
+const char deleteRenamedEvents[] = "DELETE FROM event WHERE name = ?1 AND ?1 <> ?2;";
 
-const char selectAllOrderByBlackName[] = "SELECT * FROM game ORDER BY black_name;";
+const char selectAll[] = "SELECT * FROM game_view ORDER BY id LIMIT ? OFFSET ?;";
 
-const char selectAllOrderByDate[] = "SELECT * FROM game ORDER BY date;";
+const char selectAllOrderByName[] = "SELECT * FROM game_view ORDER BY g_name, id LIMIT ? OFFSET ?;";
 
-const char selectGameById[] = "SELECT * FROM game "
+const char selectAllOrderByWhiteName[] = "SELECT * FROM game_view ORDER BY white_name, id LIMIT ? OFFSET ?;";
+
+const char selectAllOrderByBlackName[] = "SELECT * FROM game_view ORDER BY black_name, id LIMIT ? OFFSET ?;";
+
+const char selectAllOrderByDate[] = "SELECT * FROM game_view ORDER BY date_int, id LIMIT ? OFFSET ?;";
+
+const char selectDateRange[] = "SELECT * FROM game_view WHERE date_int BETWEEN ? AND ? "
+                               "ORDER BY date_int, id LIMIT ? OFFSET ?;";
+
+const char selectGameById[] = "SELECT game.id, g_name, g_class, g_group, game_number, date, white_name, "
+                              "black_name, white_result, black_result, moves.id, number_of_moves, packed_moves, "
+                              "eco, opening, checkpoints "
+                              "FROM game_view AS game "
                               "INNER JOIN moves ON game.id = moves.game_id "
                               "WHERE game.id = ?;";
 
 const char selectSingleMovesById[] = "SELECT * FROM single_move WHERE moves_id = ?;";
 
-const char selectSearch[] = "SELECT * FROM game WHERE ("
+const char selectIdRange[] = "SELECT MIN(id), MAX(id) FROM game;";
+
+const char selectPlayerNames[] = "SELECT name FROM player WHERE "
+                                 "EXISTS (SELECT 1 FROM game WHERE white_id = player.id) OR "
+                                 "EXISTS (SELECT 1 FROM game WHERE black_id = player.id);";
+
+const char selectPlayerCounts[] = "SELECT name, (SELECT COUNT(*) FROM game WHERE white_id = player.id) + "
+                                  "(SELECT COUNT(*) FROM game WHERE black_id = player.id) AS games "
+                                  "FROM player WHERE name <> '-' AND games > 0;";
+
+const char selectTournamentCounts[] = "SELECT event.name, COUNT(*) FROM event "
+                                      "INNER JOIN game ON game.event_id = event.id "
+                                      "WHERE event.name <> '-' GROUP BY event.name;";
+
+const char selectPlayerIds[] = "SELECT id, name FROM player;";
+
+const char selectEventIds[] = "SELECT id, name FROM event;";
+
+const char selectGameHeaders[] = "SELECT id, IFNULL(date_int, 0), white_id, black_id, event_id, CASE "
+                                 "WHEN white_result = '1' THEN 2 "
+                                 "WHEN white_result IN ('1/2', '0.5') OR lower(white_result) = 'remis' THEN 1 "
+                                 "WHEN white_result = '0' THEN 0 "
+                                 "WHEN black_result = '1' THEN 0 "
+                                 "WHEN black_result IN ('1/2', '0.5') OR lower(black_result) = 'remis' THEN 1 "
+                                 "WHEN black_result = '0' THEN 2 "
+                                 "ELSE 3 END "
+                                 "FROM game ORDER BY id;";
+
+const char selectGamesInRange[] = "SELECT game.id, g_name, g_class, g_group, game_number, date, white_name, "
+                                  "black_name, white_result, black_result, moves.id, number_of_moves, packed_moves, "
+                                  "eco, opening, checkpoints "
+                                  "FROM game_view AS game "
+                                  "INNER JOIN moves ON game.id = moves.game_id "
+                                  "WHERE game.id BETWEEN ?1 AND ?2 AND (?3 IS NULL OR "
+                                  "g_name LIKE ?3 OR g_class LIKE ?3 OR g_group LIKE ?3 OR "
+                                  "game_number LIKE ?3 OR white_name LIKE ?3 OR black_name LIKE ?3 OR "
+                                  "eco LIKE ?3 OR opening LIKE ?3) "
+                                  "ORDER BY game.id;";
+
+// the ids are bound as one JSON array, "[1,2,3]"...
+const char selectGameHeadersByIds[] = "SELECT game.id, g_name, g_class, g_group, game_number, date, white_name, "
+                                      "black_name, white_result, black_result, moves.id, number_of_moves, "
+                                      "NULL, eco, opening, NULL "
+                                      "FROM game_view AS game "
+                                      "INNER JOIN moves ON game.id = moves.game_id "
+                                      "WHERE game.id IN (SELECT value FROM json_each(?)) "
+                                      "ORDER BY game.id;";
+
+const char selectMovesByGameIds[] = "SELECT moves.game_id, packed_moves, checkpoints, move_number, white_move, "
+                                    "black_move "
+                                    "FROM moves "
+                                    "LEFT JOIN single_move ON single_move.moves_id = moves.id "
+                                    "AND packed_moves IS NULL "
+                                    "WHERE moves.game_id IN (SELECT value FROM json_each(?)) "
+                                    "ORDER BY moves.game_id, move_number;";
+
+const char selectSearch[] = "SELECT * FROM game_view WHERE ("
                             "g_name LIKE ? OR g_class LIKE ? OR g_group LIKE ? OR "
-                            "game_number LIKE ? OR white_name LIKE ? OR black_name LIKE ?);";
+                            "game_number LIKE ? OR white_name LIKE ? OR black_name LIKE ? OR "
+                            "eco LIKE ? OR opening LIKE ?) "
+                            "ORDER BY id LIMIT ? OFFSET ?;";
+
+/* List windows (see get_list_window): the rows after (before) the row with sort key ?2 and id ?3
+ * in one list order, matching the search pattern ?1 if not NULL, at most ?4.                      */
+#define WINDOW_FILTER "SELECT * FROM game_view WHERE (?1 IS NULL OR " \
+                      "g_name LIKE ?1 OR g_class LIKE ?1 OR g_group LIKE ?1 OR game_number LIKE ?1 OR " \
+                      "white_name LIKE ?1 OR black_name LIKE ?1 OR eco LIKE ?1 OR opening LIKE ?1) AND "
+#define WINDOW_KEY_MAX 0x7fffffff        // an id or date after all stored ones...
+
+const char *selectWindow[][2] = {
+        {WINDOW_FILTER "id > ?3 ORDER BY id LIMIT ?4;",
+         WINDOW_FILTER "id < ?3 ORDER BY id DESC LIMIT ?4;"},
+        {WINDOW_FILTER "(g_name, id) > (?2, ?3) ORDER BY g_name, id LIMIT ?4;",
+         WINDOW_FILTER "(g_name, id) < (?2, ?3) ORDER BY g_name DESC, id DESC LIMIT ?4;"},
+        {WINDOW_FILTER "(white_name, id) > (?2, ?3) ORDER BY white_name, id LIMIT ?4;",
+         WINDOW_FILTER "(white_name, id) < (?2, ?3) ORDER BY white_name DESC, id DESC LIMIT ?4;"},
+        {WINDOW_FILTER "(black_name, id) > (?2, ?3) ORDER BY black_name, id LIMIT ?4;",
+         WINDOW_FILTER "(black_name, id) < (?2, ?3) ORDER BY black_name DESC, id DESC LIMIT ?4;"},
+        {WINDOW_FILTER "(date_int, id) > (?2, ?3) ORDER BY date_int, id LIMIT ?4;",
+         WINDOW_FILTER "(date_int, id) < (?2, ?3) ORDER BY date_int DESC, id DESC LIMIT ?4;"},
+};
+
+const char selectTournamentById[] = "SELECT g_name, g_class, g_group FROM game_view WHERE id = ?;";
+
+/* White's result in half-points (2 = white won, 1 = draw, 0 = black won), taken from white_result
+ * and, if that is not a recognized result, from black_result. NULL for unfinished games.          */
+const char selectTournamentPairings[] = "SELECT white_name, black_name, COUNT(*), "
+                                        "SUM(outcome = 2), SUM(outcome = 1), SUM(outcome = 0) "
+                                        "FROM (SELECT white_name, black_name, CASE "
+                                        "WHEN white_result = '1' THEN 2 "
+                                        "WHEN white_result IN ('1/2', '0.5') OR lower(white_result) = 'remis' THEN 1 "
+                                        "WHEN white_result = '0' THEN 0 "
+                                        "WHEN black_result = '1' THEN 0 "
+                                        "WHEN black_result IN ('1/2', '0.5') OR lower(black_result) = 'remis' THEN 1 "
+                                        "WHEN black_result = '0' THEN 2 "
+                                        "END AS outcome "
+                                        "FROM game_view WHERE event_id = "
+                                        "(SELECT id FROM event WHERE name = ? AND class = ? AND group_name = ?)) "
+                                        "WHERE outcome IS NOT NULL "
+                                        "GROUP BY white_name, black_name;";
 
 /* *********** DATABASE FUNCTIONS **********                                                       */
 
@@ -115,6 +456,18 @@ void do_fast_rollback(sqlite3 **db)
     }
 }
 
+/* Finalizes stmt and closes db after an error. If db is the connection of the statement cache,
+ * the cache is dropped instead (stmt is one of its statements).                                   */
+static void close_statement(sqlite3 **db, sqlite3_stmt **stmt)
+{
+    if (is_cached_connection(*db)) {
+        clear_statement_cache();
+        return;
+    }
+    sqlite3_finalize(*stmt);
+    sqlite3_close(*db);
+}
+
 /* If status indicates an error - display error_msg,
  * frees the error_msg and closes the database.
  * returns FALSE on NO error and TRUE on error.                                                    */
@@ -122,7 +475,7 @@ int is_exec_error(sqlite3 **db, int status, char **error_msg)
 {
     if (status != SQLITE_OK) {
         eprintf("SQL error: %s\n", *error_msg);
-        sqlite3_free(error_msg);
+        sqlite3_free(*error_msg);
         sqlite3_close(*db);
         return TRUE;
     }
@@ -144,8 +497,7 @@ int is_statement_error(sqlite3 **db, sqlite3_stmt **stmt, int status, int transa
         if (transaction_flag)
             do_fast_rollback(db);
 
-        sqlite3_finalize(*stmt);
-        sqlite3_close(*db);
+        close_statement(db, stmt);
         return TRUE;
     }
     return FALSE;
@@ -166,8 +518,7 @@ int is_binding_error(sqlite3 **db, sqlite3_stmt **stmt, int status, int transact
         if (transaction_flag)
             do_fast_rollback(db);
 
-        sqlite3_finalize(*stmt);
-        sqlite3_close(*db);
+        close_statement(db, stmt);
         return TRUE;
     }
     return FALSE;
@@ -189,456 +540,2374 @@ int is_statement_step_error(sqlite3 **db, sqlite3_stmt **stmt, int status, int t
         if (transaction_flag)
             do_fast_rollback(db);
 
-        sqlite3_finalize(*stmt);
-        sqlite3_close(*db);
+        close_statement(db, stmt);
         return TRUE;
     }
     return FALSE;
 }
 
-/* Attempts to open database chess.db on the given sqlite3 database                                */
-int open_database_conn(sqlite3 **db)
+/* Copies the text of column col of the current row into dst (at most max_size - 1 characters).
+ * A NULL column is copied as an empty string.                                                     */
+void copy_column_text(char *dst, sqlite3_stmt *stmt, int col, int max_size)
+{
+    const char *text = (const char *)sqlite3_column_text(stmt, col);
+    snprintf(dst, max_size, "%s", (text == NULL) ? "" : text);
+}
+
+/* ********** SHARD ROUTING **********
+ * Writes and single game reads go to one database file: chess.db, or with sharding the shard
+ * of the game (see shard.c). The routed file is opened by open_database_conn and
+ * open_database_readonly. List, search and statistics queries fan out to all shards instead.
+ * The route is part of the database handle, as is the path of chess.db (see context.h).           */
+
+/* Routes to the shard with number, or to chess.db if number is 0 or no such shard exists.         */
+void route_to_shard(int number)
+{
+    ChessDb *handle = current_db();
+    const Shard *shard = (number > 0) ? find_shard(number) : NULL;
+
+    strcpy(handle->routed_path, (shard != NULL) ? shard->path : handle->catalog_path);
+    handle->routed_id_floor = (shard != NULL) ? shard->number * SHARD_ID_SPAN : 0;
+}
+
+/* Routes to the database holding the game with game_id.                                           */
+void route_by_id(int game_id)
+{
+    route_to_shard(SHARD_OF_ID(game_id));
+}
+
+/* Routes to the database a new game data belongs in, creating its shard if needed.
+ * Returns TRUE on success and FALSE on error.                                                     */
+int route_by_game(const GameInfo *data)
+{
+    char key[NAME_MAX];
+    const Shard *shard;
+
+    if (get_sharding_mode() == SHARD_NONE) {
+        route_to_shard(0);
+        return TRUE;
+    }
+
+    shard_key_of_game(data->name, pack_date(data->date), key);
+    if ((shard = get_or_create_shard(key)) == NULL)
+        return FALSE;
+    route_to_shard(shard->number);
+    return TRUE;
+}
+
+/* Attempts to open the database file path on the given sqlite3 database, read only if readonly
+ * is TRUE. A read only connection must only be used by one thread at a time. A locked database
+ * is waited for up to the busy timeout of the current database handle.                            */
+int open_database_path(const char *path, sqlite3 **db, int readonly)
 {
-    int status = sqlite3_open("chess.db", db);
+    int flags = (readonly) ? SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+    int status = sqlite3_open_v2(path, db, flags, NULL);
     if (status != SQLITE_OK) {
         eprintf("ERROR: cannot open database: %s\n", sqlite3_errmsg(*db));
         sqlite3_close(*db);
         return FALSE;
     }
+    sqlite3_busy_timeout(*db, current_db()->options.busy_timeout_ms);
+
+    // deleting a game deletes its moves (ON DELETE CASCADE)...
+    if (!readonly && sqlite3_exec(*db, enableForeignKeys, 0, 0, NULL) != SQLITE_OK) {
+        eprintf("ERROR: cannot enable foreign keys: %s\n", sqlite3_errmsg(*db));
+        sqlite3_close(*db);
+        return FALSE;
+    }
     return TRUE;
 }
 
-/* Prepares the database - creating the tables if they don't exist.
- * returns TRUE if preparations happened without errors, otherwise FALSE.                          */
-int prepare_database()
+/* Attempts to open the routed database (chess.db without sharding) on the given sqlite3 database */
+int open_database_conn(sqlite3 **db)
 {
-    char *err_msg = 0;
-    sqlite3 *db;
+    return open_database_path(current_db()->routed_path, db, FALSE);
+}
 
-    if (!open_database_conn(&db))
-        return FALSE;
+/* Attempts to open the routed database read only on the given sqlite3 database. The connection
+ * must only be used by one thread at a time, parallel readers should open one each.               */
+int open_database_readonly(sqlite3 **db)
+{
+    return open_database_path(current_db()->routed_path, db, TRUE);
+}
 
-    // setting up tables if not exist
-    int status = sqlite3_exec(db, tableGame, 0, 0, &err_msg);
-    if (is_exec_error(&db, status, &err_msg))
+/* Attaches the database file path to db as schema, both quoted into the statement. Returns TRUE
+ * on success and FALSE on error.                                                                  */
+int attach_database(sqlite3 *db, const char *path, const char *schema)
+{
+    char *sql = sqlite3_mprintf("ATTACH DATABASE %Q AS \"%w\";", path, schema);
+
+    if (sql == NULL) {
+        eprintf("ERROR: out of memory attaching %s...\n", path);
+        return FALSE;
+    }
+    if (sqlite3_exec(db, sql, 0, 0, NULL) != SQLITE_OK) {
+        eprintf("Cannot attach %s: %s\n", path, sqlite3_errmsg(db));
+        sqlite3_free(sql);
         return FALSE;
+    }
+    sqlite3_free(sql);
+    return TRUE;
+}
 
-    status = sqlite3_exec(db, tableMoves, 0, 0, &err_msg);
-    if (is_exec_error(&db, status, &err_msg))
+/* Returns TRUE if table has column, FALSE otherwise.                                              */
+static int has_column(sqlite3 *db, const char *table, const char *column)
+{
+    char sql[256];
+    sqlite3_stmt *stmt;
+
+    snprintf(sql, sizeof(sql), "SELECT %s FROM %s LIMIT 0;", column, table);
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK)
         return FALSE;
+    sqlite3_finalize(stmt);
+    return TRUE;
+}
 
-    status = sqlite3_exec(db, tableSingleMove, 0, 0, &err_msg);
+/* Adds column (with definition, e.g. "packed_moves BLOB") to table if an older database
+ * lacks it. Returns TRUE if the column exists afterwards, otherwise FALSE (db is closed).          */
+int add_column_if_missing(sqlite3 *db, const char *table, const char *column, const char *definition)
+{
+    char sql[256], *err_msg = 0;
+
+    if (has_column(db, table, column))
+        return TRUE;
+
+    printf("INFO: adding column %s to table %s...\n", column, table);
+    snprintf(sql, sizeof(sql), "ALTER TABLE %s ADD COLUMN %s;", table, definition);
+    int status = sqlite3_exec(db, sql, 0, 0, &err_msg);
     if (is_exec_error(&db, status, &err_msg))
         return FALSE;
-
-    sqlite3_close(db);
     return TRUE;
 }
 
-/* Drops all tables (game, moves, single_move) from database.
- * Returns TRUE on success and FALSE on error.                                                     */
-int clear_tables() {
+/* Rebuilds the moves and single_move tables with ON DELETE CASCADE if they were created without.
+ * Returns TRUE on success, FALSE on error (db is closed).                                         */
+int add_cascade_if_missing(sqlite3 *db)
+{
     char *err_msg = 0;
-    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    int cascade;
 
-    if (!open_database_conn(&db))
+    int status = sqlite3_prepare_v2(db, selectMovesOnDelete, -1, &stmt, 0);
+    if (is_statement_error(&db, &stmt, status, FALSE))
         return FALSE;
+    cascade = (sqlite3_step(stmt) == SQLITE_ROW &&
+               strcmp((const char *)sqlite3_column_text(stmt, 0), "CASCADE") == 0);
+    sqlite3_finalize(stmt);
 
-    int status = sqlite3_exec(db, dropTables, 0, 0, &err_msg);
+    if (cascade)
+        return TRUE;
+
+    printf("INFO: adding ON DELETE CASCADE to tables moves and single_move...\n");
+    status = sqlite3_exec(db, rebuildMovesTables, 0, 0, &err_msg);
+    if (status != SQLITE_OK)
+        sqlite3_exec(db, rollbackTransaction, 0, 0, NULL);
     if (is_exec_error(&db, status, &err_msg))
         return FALSE;
-
-    sqlite3_close(db);
     return TRUE;
 }
 
-/* db: if db is initialized as NULL, db is opened and closed automatic.
- *     if db is not NULL, it will be assumed to be open, and will NOT be closed at the end.
- *     */
-int do_statement(sqlite3 *db, SampleInfo arr_sample[], GameInfo *game, GameMoves *game_moves,
-                 int transaction_flag, const char *sql, const char *format, ...)
+/* SQL function pack_date(date), see pack_date in helperFunctions.c.                               */
+static void sql_pack_date(sqlite3_context *context, int argc, sqlite3_value **argv)
 {
-    if ((arr_sample != NULL && game != NULL) || (arr_sample != NULL && game_moves != NULL) ||
-        (game != NULL && game_moves != NULL)) {
-        eprintf("ERROR: only one, either arr_sample, game or game_moves, can be passed...\n");
+    const unsigned char *date = sqlite3_value_text(argv[0]);
+    (void)argc;
+    sqlite3_result_int(context, (date != NULL) ? pack_date((const char *)date) : FALSE);
+}
+
+/* Fills in date_int for the games from from_id to to_id stored before the column existed. Must be
+ * called inside a transaction on db.
+ * Returns TRUE on success and FALSE on error (the transaction is rolled back and db closed).      */
+int convert_dates(sqlite3 *db, int from_id, int to_id)
+{
+    int status = sqlite3_create_function(db, "pack_date", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                                         sql_pack_date, NULL, NULL);
+    if (status != SQLITE_OK) {
+        eprintf("Failed to create function: %s\n", sqlite3_errmsg(db));
+        do_fast_rollback(&db);
+        sqlite3_close(db);
         return FALSE;
     }
 
-    int len, status, close = FALSE, return_code = TRUE;
+    return do_statement(db, NULL, NULL, NULL, TRUE, updateUnconvertedDates, "%d%d", from_id, to_id);
+}
+
+/* Adds the line index rows of game_id (which has none, see unindex_game) for the windows of the
+ * first move_count moves of game_moves. Must be called inside a transaction on db.
+ * Returns TRUE on success and FALSE on error (the transaction is rolled back and db closed).      */
+int index_game_lines(sqlite3 *db, int game_id, const GameMoves *game_moves, int move_count)
+{
+    char plies[LINE_PLIES_MAX][S_MOVE_MAX];
+    int num_of_plies = game_plies(game_moves, move_count, plies), status;
     sqlite3_stmt *stmt;
 
-    // opening database...
-    if (db == NULL) {
-        if (!open_database_conn(&db))
+    status = sqlite3_prepare_v2(db, insertPlyGram, -1, &stmt, 0);
+    if (is_statement_error(&db, &stmt, status, TRUE))
+        return FALSE;
+
+    for (int start = 0; start + LINE_PLIES <= num_of_plies; start++) {
+        sqlite3_reset(stmt);
+        sqlite3_bind_int64(stmt, 1, hash_plies(plies + start, LINE_PLIES));
+        sqlite3_bind_int(stmt, 2, game_id);
+        status = sqlite3_step(stmt);
+        if (is_statement_step_error(&db, &stmt, status, TRUE))
             return FALSE;
-        close = TRUE;
     }
 
-    // preparing statement...
-    status = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
-    if (is_statement_error(&db, &stmt, status, transaction_flag))
-        return FALSE;
-
-    // handle bindings if any...
-    if (format != NULL) {
-        // HANDLE AS STATEMENT WITH BINDINGS...
-        // arguments expected...
-        va_list args;
-        len = (int)strlen(format);
-        char format_specifiers[((int) (len / 2)) + 1], c;
-        int number_arg = 0, flag = 0;
+    sqlite3_finalize(stmt);
+    return TRUE;
+}
 
-        while ((c = *format++) != '\0') {
-            if (c == '%' && flag == 0) {
-                flag = 1;
-                continue;
-            }
+/* Deletes the line and similar game index rows of game_id, before its moves are indexed again.
+ * Must be called inside a transaction on db.
+ * Returns TRUE on success and FALSE on error (the transaction is rolled back and db closed).      */
+static int unindex_game(sqlite3 *db, int game_id)
+{
+    return do_statement(db, NULL, NULL, NULL, TRUE, deletePlyGrams, "%d", game_id) &&
+           do_statement(db, NULL, NULL, NULL, TRUE, deleteSignatureBands, "%d", game_id) &&
+           do_statement(db, NULL, NULL, NULL, TRUE, deleteGameSignature, "%d", game_id);
+}
 
-            if (flag == 1) {
-                format_specifiers[number_arg] = c;
-                flag = 0;
-                number_arg++;
-            }
-        }
+/* Reads the games from from_id to to_id of db (at most LINE_CHUNK_IDS ids) into games, for a
+ * migration inside a transaction. Returns their number, or ERROR on error (the transaction is
+ * rolled back and db closed).                                                                     */
+static int read_games_to_migrate(sqlite3 *db, GameInfo games[LINE_CHUNK_IDS], int from_id, int to_id)
+{
+    int num_of_games = get_games_in_range(db, games, from_id, to_id, NULL);
 
-        va_start(args, format);
-        for (int i = 1, arr_pos = 0; i <= number_arg; i++, arr_pos++) {
-            c = format_specifiers[arr_pos];
-            if (c == 's') {
-                status = sqlite3_bind_text(stmt, i, va_arg(args, char *), -1, SQLITE_TRANSIENT);
-                if (is_binding_error(&db, &stmt, status, transaction_flag))
-                    return FALSE;
-            } else if (c == 'd') {
-                status = sqlite3_bind_int(stmt, i, va_arg(args, int));
-                if (is_binding_error(&db, &stmt, status, transaction_flag))
-                    return FALSE;
-            } else if (c == 'b') {
-                // skipping because this binding should be left blank (if INT PRIMARY KEY has to be invoked)
-            } else {
-                eprintf("ERROR: argument nr. %d, id of unknown type!\n", i);
-            }
-        }
-        va_end(args);
+    if (num_of_games == ERROR) {
+        do_fast_rollback(&db);
+        sqlite3_close(db);
     }
+    return num_of_games;
+}
 
-    // executing statement...
-    if (arr_sample != NULL) {
-        // getting row results if any and copies sample data into arr_sample...
-        int count = 0;
-        while((status = sqlite3_step(stmt)) == SQLITE_ROW) {
-            arr_sample[count].id = sqlite3_column_int(stmt, 0);
-            strcpy(arr_sample[count].name, (char *)sqlite3_column_text(stmt, 1));
-            strcpy(arr_sample[count].date, (char *)sqlite3_column_text(stmt, 5));
-            strcpy(arr_sample[count].white_name, (char *)sqlite3_column_text(stmt, 6));
-            strcpy(arr_sample[count].black_name, (char *)sqlite3_column_text(stmt, 7));
-            count++;
-        }
+/* Runs index_game on the moves of the games from from_id to to_id (at most LINE_CHUNK_IDS ids)
+ * stored in db. Must be called inside a transaction on db.
+ * Returns TRUE on success and FALSE on error (the transaction is rolled back and db closed).      */
+int index_games_in_range(sqlite3 *db, int from_id, int to_id,
+                         int (*index_game)(sqlite3 *, int, const GameMoves *, int))
+{
+    GameInfo *games;
+    int num_of_games;
 
-        if (is_statement_step_error(&db, &stmt, status, transaction_flag))
-            return FALSE;
+    if ((games = malloc(sizeof(GameInfo) * LINE_CHUNK_IDS)) == NULL) {
+        eprintf("ERROR: could not allocate memory for indexing the games...\n");
+        do_fast_rollback(&db);
+        sqlite3_close(db);
+        return FALSE;
+    }
 
-        // return_code = number of rows inserted into arr_sample...
-        return_code = count;
-    } else if (game != NULL) {
-        // since only one result is expected the steps are done manually
-        status = sqlite3_step(stmt);
-        if (status == SQLITE_ROW) {
-            strcpy(game->name, (char *)sqlite3_column_text(stmt, 1));
-            strcpy(game->class, (char *)sqlite3_column_text(stmt, 2));
-            strcpy(game->group, (char *)sqlite3_column_text(stmt, 3));
-            strcpy(game->game_number, (char *)sqlite3_column_text(stmt, 4));
-            strcpy(game->date, (char *)sqlite3_column_text(stmt, 5));
-            strcpy(game->white_name, (char *)sqlite3_column_text(stmt, 6));
-            strcpy(game->black_name, (char *)sqlite3_column_text(stmt, 7));
-            strcpy(game->white_result, (char *)sqlite3_column_text(stmt, 8));
-            strcpy(game->black_result, (char *)sqlite3_column_text(stmt, 9));
-            game->game_moves.moves_id = sqlite3_column_int(stmt, 10);
-            game->game_moves.move_number = sqlite3_column_int(stmt, 11);
-        } else {
-            eprintf("ERROR: no rows found by id(%d)...\n", game->game_id);
-            return FALSE;
-        }
+    if ((num_of_games = read_games_to_migrate(db, games, from_id, to_id)) == ERROR) {
+        free(games);
+        return FALSE;
+    }
 
-        status = sqlite3_step(stmt);
-        if (is_statement_step_error(&db, &stmt, status, transaction_flag))
+    for (int i = 0; i < num_of_games; i++) {
+        if (!index_game(db, games[i].game_id, &games[i].game_moves, games[i].game_moves.move_number)) {
+            free(games);
             return FALSE;
-
-    } else if (game_moves != NULL) {
-        // since GameMoves has been passed, we expect a number of moves to be store as a result of sql...
-        int move;
-        while((status = sqlite3_step(stmt)) == SQLITE_ROW) {
-            move = sqlite3_column_int(stmt, 1);
-            strcpy(game_moves->moves[move - 1][WHITE_PLAYER], (char *)sqlite3_column_text(stmt, 2));
-            strcpy(game_moves->moves[move - 1][BLACK_PLAYER], (char *)sqlite3_column_text(stmt, 3));
         }
-
-        if (is_statement_step_error(&db, &stmt, status, FALSE))
-            return FALSE;
-
-    } else {
-        // execute statement. Since arr_sample and game is NULL, no data is expected from database...
-        status = sqlite3_step(stmt);
-        if (is_statement_step_error(&db, &stmt, status, transaction_flag))
-            return FALSE;
     }
+    free(games);
+    return TRUE;
+}
 
-    // finalize stmt...
-    sqlite3_finalize(stmt);
+/* Creates the line index of db (filled for older databases by a migration, see schema.c).
+ * Returns TRUE on success and FALSE on error (db is closed).                                      */
+int create_line_index(sqlite3 *db)
+{
+    char *err_msg = 0;
 
-    // close db if required...
-    if (close)
-        sqlite3_close(db);
-    return return_code;
+    int status = sqlite3_exec(db, tablePlyGram, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, indexPlyGramGameId, 0, 0, &err_msg);
+    return !is_exec_error(&db, status, &err_msg);
 }
 
-/* Attempts to insert data into the database.
- * returns TRUE on success, otherwise FAlSE                                                        */
-int insert_data(GameInfo *data)
+/* Adds the similar game index rows of game_id (which has none, see unindex_game) for the signature
+ * of the first move_count moves of game_moves (none for games too short to have one). Must be
+ * called inside a transaction on db.
+ * Returns TRUE on success and FALSE on error (the transaction is rolled back and db closed).      */
+int index_game_signature(sqlite3 *db, int game_id, const GameMoves *game_moves, int move_count)
 {
-    sqlite3 *db;
-    int last_row;
+    uint32_t signature[SIMILAR_HASHES];
+    unsigned char packed[SIMILAR_SIGNATURE_SIZE];
+    long long bands[SIMILAR_BANDS];
+    sqlite3_stmt *stmt;
+    int status;
 
-    // opening database...
-    if (!open_database_conn(&db))
-        return FALSE;
+    if (!game_signature(game_moves, move_count, signature))
+        return TRUE;
 
-    // begin transaction... all or nothing...
-    if (!do_statement(db, NULL, NULL, NULL, FALSE,
-                      beginTransaction, NULL))
+    pack_signature(signature, packed);
+    if (!do_statement(db, NULL, NULL, NULL, TRUE, insertGameSignature, "%d%B", game_id, packed,
+                      SIMILAR_SIGNATURE_SIZE))
         return FALSE;
 
-    // execute statement insertIntoGame...
-    if (!do_statement(db, NULL, NULL, NULL,TRUE, insertIntoGame,
-                      "%b%s%s%s%s%s%s%s%s%s", data->name, data->class, data->group, data->game_number,
-                      data->date, data->white_name, data->black_name, data->white_result, data->black_result))
+    status = sqlite3_prepare_v2(db, insertSignatureBand, -1, &stmt, 0);
+    if (is_statement_error(&db, &stmt, status, TRUE))
         return FALSE;
 
-    // getting last row...
-    last_row = (int)sqlite3_last_insert_rowid(db);
+    signature_bands(signature, bands);
+    for (int band = 0; band < SIMILAR_BANDS; band++) {
+        sqlite3_reset(stmt);
+        sqlite3_bind_int64(stmt, 1, bands[band]);
+        sqlite3_bind_int(stmt, 2, game_id);
+        status = sqlite3_step(stmt);
+        if (is_statement_step_error(&db, &stmt, status, TRUE))
+            return FALSE;
+    }
+
+    sqlite3_finalize(stmt);
+    return TRUE;
+}
+
+/* Creates the similar game index of db (filled for older databases by a migration, see
+ * schema.c). Returns TRUE on success and FALSE on error (db is closed).                           */
+int create_similarity_index(sqlite3 *db)
+{
+    char *err_msg = 0;
+
+    int status = sqlite3_exec(db, tableGameSignature, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, tableSignatureBand, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, indexSignatureBandGameId, 0, 0, &err_msg);
+    return !is_exec_error(&db, status, &err_msg);
+}
+
+/* Builds the board checkpoints of the games from from_id to to_id (at most LINE_CHUNK_IDS ids) of
+ * db, stored by versions without them. Must be called inside a transaction on db.
+ * Returns TRUE on success and FALSE on error (the transaction is rolled back and db closed).      */
+int fill_checkpoints(sqlite3 *db, int from_id, int to_id)
+{
+    GameInfo *games;
+    int num_of_games;
+
+    if ((games = malloc(sizeof(GameInfo) * LINE_CHUNK_IDS)) == NULL) {
+        eprintf("ERROR: could not allocate memory for the checkpoints...\n");
+        do_fast_rollback(&db);
+        sqlite3_close(db);
+        return FALSE;
+    }
+
+    if ((num_of_games = read_games_to_migrate(db, games, from_id, to_id)) == ERROR) {
+        free(games);
+        return FALSE;
+    }
+
+    for (int i = 0; i < num_of_games; i++) {
+        GameMoves *game_moves = &games[i].game_moves;
+        build_checkpoints(game_moves, game_moves->move_number);
+        if (!do_statement(db, NULL, NULL, NULL, TRUE, updateCheckpoints, "%B%d", game_moves->checkpoints,
+                          game_moves->num_of_checkpoints * CHECKPOINT_SIZE, game_moves->moves_id)) {
+            free(games);
+            return FALSE;
+        }
+    }
+    free(games);
+    return TRUE;
+}
+
+/* Retrieves the ids of the games with a window hashed to hash from the line index of db into
+ * *game_ids (allocated here, freed by the caller), in id order.
+ * Returns the number of ids, or ERROR on error (db is left open).                                 */
+int get_line_postings(sqlite3 *db, long long hash, int **game_ids)
+{
+    sqlite3_stmt *stmt;
+    int status, count = 0, capacity = 64;
+
+    if ((*game_ids = malloc(sizeof(int) * capacity)) == NULL) {
+        eprintf("ERROR: could not allocate memory for postings...\n");
+        return ERROR;
+    }
+
+    if (sqlite3_prepare_v2(db, selectPlyGramPostings, -1, &stmt, 0) != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        free(*game_ids);
+        return ERROR;
+    }
+
+    sqlite3_bind_int64(stmt, 1, hash);
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (count == capacity) {
+            int *grown = realloc(*game_ids, sizeof(int) * capacity * 2);
+            if (grown == NULL) {
+                status = SQLITE_NOMEM;
+                break;
+            }
+            *game_ids = grown;
+            capacity *= 2;
+        }
+        (*game_ids)[count++] = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    if (status != SQLITE_DONE) {
+        eprintf("Failed to read postings: %s\n", sqlite3_errstr(status));
+        free(*game_ids);
+        return ERROR;
+    }
+    return count;
+}
+
+/* Retrieves the packed signature of game_id from the similar game index of db into signature.
+ * Returns TRUE if found, FALSE if the game has none, or ERROR on error (db is left open).         */
+int get_game_signature(sqlite3 *db, int game_id, unsigned char signature[SIMILAR_SIGNATURE_SIZE])
+{
+    sqlite3_stmt *stmt;
+    int status, found;
+
+    if (sqlite3_prepare_v2(db, selectGameSignature, -1, &stmt, 0) != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return ERROR;
+    }
+
+    sqlite3_bind_int(stmt, 1, game_id);
+    status = sqlite3_step(stmt);
+    found = (status == SQLITE_ROW && sqlite3_column_bytes(stmt, 0) == SIMILAR_SIGNATURE_SIZE);
+    if (found)
+        memcpy(signature, sqlite3_column_blob(stmt, 0), SIMILAR_SIGNATURE_SIZE);
+    sqlite3_finalize(stmt);
+
+    if (status != SQLITE_ROW && status != SQLITE_DONE) {
+        eprintf("Failed to read the signature: %s\n", sqlite3_errstr(status));
+        return ERROR;
+    }
+    return found;
+}
+
+/* Retrieves the games of db sharing at least one of bands (SIMILAR_BANDS) with their signatures
+ * into *rows (allocated here, freed by the caller).
+ * Returns the number of games, or ERROR on error (db is left open).                               */
+int get_band_candidates(sqlite3 *db, const long long bands[], SignatureRow **rows)
+{
+    sqlite3_stmt *stmt;
+    int status, count = 0, capacity = 64;
+
+    if ((*rows = malloc(sizeof(SignatureRow) * capacity)) == NULL) {
+        eprintf("ERROR: could not allocate memory for candidates...\n");
+        return ERROR;
+    }
+
+    if (sqlite3_prepare_v2(db, selectBandCandidates, -1, &stmt, 0) != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        free(*rows);
+        return ERROR;
+    }
+
+    for (int band = 0; band < SIMILAR_BANDS; band++)
+        sqlite3_bind_int64(stmt, band + 1, bands[band]);
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (sqlite3_column_bytes(stmt, 1) != SIMILAR_SIGNATURE_SIZE)
+            continue;
+        if (count == capacity) {
+            SignatureRow *grown = realloc(*rows, sizeof(SignatureRow) * capacity * 2);
+            if (grown == NULL) {
+                status = SQLITE_NOMEM;
+                break;
+            }
+            *rows = grown;
+            capacity *= 2;
+        }
+        (*rows)[count].game_id = sqlite3_column_int(stmt, 0);
+        memcpy((*rows)[count++].signature, sqlite3_column_blob(stmt, 1), SIMILAR_SIGNATURE_SIZE);
+    }
+    sqlite3_finalize(stmt);
+
+    if (status != SQLITE_DONE) {
+        eprintf("Failed to read candidates: %s\n", sqlite3_errstr(status));
+        free(*rows);
+        return ERROR;
+    }
+    return count;
+}
+
+/* Moves the names of the games of db stored by older versions into player and event, then creates
+ * the name id indexes and game_view. Returns TRUE on success and FALSE on error (db is closed).   */
+int intern_names_if_missing(sqlite3 *db)
+{
+    char *err_msg = 0;
+    int status;
+
+    if (has_column(db, "game", "white_name")) {
+        printf("INFO: moving player and tournament names into their own tables...\n");
+        status = sqlite3_exec(db, internGameNames, 0, 0, &err_msg);
+        if (status != SQLITE_OK) {
+            // leaving the transaction, if it was started, before closing...
+            sqlite3_exec(db, rollbackTransaction, NULL, NULL, NULL);
+            is_exec_error(&db, status, &err_msg);
+            return FALSE;
+        }
+    }
+
+    status = sqlite3_exec(db, indexGamePlayers, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, viewGame, 0, 0, &err_msg);
+    return !is_exec_error(&db, status, &err_msg);
+}
+
+/* Creates the tables, indexes and views of db that don't exist and upgrades the tables created by
+ * unversioned older versions (schema version 1, see schema.c). The games of those are migrated
+ * by the later versions. Returns TRUE on success, otherwise FALSE (db is closed).                 */
+int create_schema(sqlite3 *db)
+{
+    char *err_msg = 0;
+
+    // setting up tables if not exist
+    int status = sqlite3_exec(db, tablePlayer, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, tableEvent, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, tableGame, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, tableMoves, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, tableSingleMove, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    // upgrading tables created by older versions...
+    if (!add_column_if_missing(db, "moves", "packed_moves", "packed_moves BLOB"))
+        return FALSE;
+
+    if (!add_column_if_missing(db, "game", "date_int", "date_int INTEGER"))
+        return FALSE;
+
+    if (!add_column_if_missing(db, "game", "eco", "eco TEXT") ||
+        !add_column_if_missing(db, "game", "opening", "opening TEXT"))
+        return FALSE;
+
+    // (after the columns above, the copied game table has them all)...
+    if (!intern_names_if_missing(db))
+        return FALSE;
+
+    if (!add_cascade_if_missing(db))
+        return FALSE;
+
+    // (after the cascade upgrade, which copies the moves table without it)...
+    if (!add_column_if_missing(db, "moves", "checkpoints", "checkpoints BLOB"))
+        return FALSE;
+
+    status = sqlite3_exec(db, indexGameEco, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    // index for date sorting and date ranges...
+    status = sqlite3_exec(db, indexGameDate, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    // indexes for loading the moves of a game...
+    status = sqlite3_exec(db, indexMovesGameId, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, indexSingleMoveMovesId, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    return create_line_index(db) && create_similarity_index(db);
+}
+
+/* Prepares the database file path - creating or migrating its schema if it is not of the current
+ * version (see schema.c), nothing else if it is.
+ * returns TRUE if preparations happened without errors, otherwise FALSE.                          */
+int prepare_database_file(const char *path)
+{
+    sqlite3 *db;
+    int version;
+
+    if (!open_database_path(path, &db, FALSE))
+        return FALSE;
+
+    if ((version = get_schema_version(db)) == ERROR)
+        return FALSE;
+    if (version != SCHEMA_VERSION && !migrate_schema(db, version))
+        return FALSE;
+
+    sqlite3_close(db);
+    return TRUE;
+}
+
+/* Creates the tables of games (no indexes but those of their keys) on the open, empty database db,
+ * for a file that is filled in bulk and indexed later. Returns TRUE on success, otherwise FALSE
+ * (db is closed).                                                                                 */
+int create_game_tables(sqlite3 *db)
+{
+    const char *tables[] = {tablePlayer, tableEvent, tableGame, tableMoves, tableSingleMove, tablePlyGram,
+                            tableGameSignature, tableSignatureBand};
+    char *err_msg = 0;
+
+    for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); i++) {
+        int status = sqlite3_exec(db, tables[i], 0, 0, &err_msg);
+        if (is_exec_error(&db, status, &err_msg))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* Prepares the database - chess.db and, with sharding, every shard.
+ * returns TRUE if preparations happened without errors, otherwise FALSE.                          */
+int prepare_database()
+{
+    const char *path = current_db()->catalog_path;
+    sqlite3 *db;
+
+    if (!prepare_database_file(path))
+        return FALSE;
+
+    // reading the shard catalog...
+    if (!open_database_path(path, &db, FALSE) || !load_shard_catalog(db))
+        return FALSE;
+    sqlite3_close(db);
+
+    for (int i = 0; i < get_num_of_shards(); i++) {
+        if (!prepare_database_file(get_shard(i)->path))
+            return FALSE;
+    }
+
+    route_to_shard(0);
+    return TRUE;
+}
+
+/* Drops all tables (game, moves, single_move) from database.
+ * Returns TRUE on success and FALSE on error.                                                     */
+int clear_tables() {
+    char *err_msg = 0;
+    sqlite3 *db;
+
+    if (!open_database_conn(&db))
+        return FALSE;
+
+    int status = sqlite3_exec(db, dropTables, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    sqlite3_close(db);
+
+    bump_data_generation();
+    clear_standings_cache();
+    return TRUE;
+}
+
+/* db: if db is initialized as NULL, db is opened and closed automatic (inside a chessdb_ call the
+ *     connection and the prepared statement are taken from the statement cache and kept).
+ *     if db is not NULL, it will be assumed to be open, and will NOT be closed at the end (the
+ *     statements of the cached connection are taken from the cache too).
+ *     */
+int do_statement(sqlite3 *db, SampleInfo arr_sample[], GameInfo *game, GameMoves *game_moves,
+                 int transaction_flag, const char *sql, const char *format, ...)
+{
+    if ((arr_sample != NULL && game != NULL) || (arr_sample != NULL && game_moves != NULL) ||
+        (game != NULL && game_moves != NULL)) {
+        eprintf("ERROR: only one, either arr_sample, game or game_moves, can be passed...\n");
+        return FALSE;
+    }
+
+    int len, status, close = FALSE, cached = FALSE, return_code = TRUE;
+    sqlite3_stmt *stmt = NULL;
+
+    // opening database...
+    if ((db == NULL || is_cached_connection(db)) && (stmt = get_cached_statement(sql, &db)) != NULL) {
+        cached = TRUE;
+    } else if (db == NULL) {
+        if (!open_database_conn(&db))
+            return FALSE;
+        close = TRUE;
+    }
+
+    // preparing statement...
+    if (!cached) {
+        status = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+        if (is_statement_error(&db, &stmt, status, transaction_flag))
+            return FALSE;
+    }
+
+    // handle bindings if any...
+    if (format != NULL) {
+        // HANDLE AS STATEMENT WITH BINDINGS...
+        // arguments expected...
+        va_list args;
+        len = (int)strlen(format);
+        char format_specifiers[((int) (len / 2)) + 1], c;
+        int number_arg = 0, flag = 0;
+
+        while ((c = *format++) != '\0') {
+            if (c == '%' && flag == 0) {
+                flag = 1;
+                continue;
+            }
+
+            if (flag == 1) {
+                format_specifiers[number_arg] = c;
+                flag = 0;
+                number_arg++;
+            }
+        }
+
+        va_start(args, format);
+        for (int i = 1, arr_pos = 0; i <= number_arg; i++, arr_pos++) {
+            c = format_specifiers[arr_pos];
+            if (c == 's') {
+                status = sqlite3_bind_text(stmt, i, va_arg(args, char *), -1, SQLITE_TRANSIENT);
+                if (is_binding_error(&db, &stmt, status, transaction_flag))
+                    return FALSE;
+            } else if (c == 'd') {
+                status = sqlite3_bind_int(stmt, i, va_arg(args, int));
+                if (is_binding_error(&db, &stmt, status, transaction_flag))
+                    return FALSE;
+            } else if (c == 'B') {
+                // blob, passed as two arguments: pointer and size in bytes (NULL pointer binds NULL)...
+                const void *blob = va_arg(args, const void *);
+                int size = va_arg(args, int);
+                if (blob == NULL)
+                    status = sqlite3_bind_null(stmt, i);
+                else
+                    status = sqlite3_bind_blob(stmt, i, blob, size, SQLITE_TRANSIENT);
+                if (is_binding_error(&db, &stmt, status, transaction_flag))
+                    return FALSE;
+            } else if (c == 'b') {
+                // skipping because this binding should be left blank (if INT PRIMARY KEY has to be invoked)
+            } else {
+                eprintf("ERROR: argument nr. %d, id of unknown type!\n", i);
+            }
+        }
+        va_end(args);
+    }
+
+    // executing statement...
+    if (arr_sample != NULL) {
+        // getting row results if any and copies sample data into arr_sample...
+        int count = 0;
+        while((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+            arr_sample[count].id = sqlite3_column_int(stmt, 0);
+            strcpy(arr_sample[count].name, (char *)sqlite3_column_text(stmt, 1));
+            strcpy(arr_sample[count].date, (char *)sqlite3_column_text(stmt, 5));
+            strcpy(arr_sample[count].white_name, (char *)sqlite3_column_text(stmt, 6));
+            strcpy(arr_sample[count].black_name, (char *)sqlite3_column_text(stmt, 7));
+            count++;
+        }
+
+        if (is_statement_step_error(&db, &stmt, status, transaction_flag))
+            return FALSE;
+
+        // return_code = number of rows inserted into arr_sample...
+        return_code = count;
+    } else if (game != NULL) {
+        // since only one result is expected the steps are done manually
+        status = sqlite3_step(stmt);
+        if (status == SQLITE_ROW) {
+            strcpy(game->name, (char *)sqlite3_column_text(stmt, 1));
+            strcpy(game->class, (char *)sqlite3_column_text(stmt, 2));
+            strcpy(game->group, (char *)sqlite3_column_text(stmt, 3));
+            strcpy(game->game_number, (char *)sqlite3_column_text(stmt, 4));
+            strcpy(game->date, (char *)sqlite3_column_text(stmt, 5));
+            strcpy(game->white_name, (char *)sqlite3_column_text(stmt, 6));
+            strcpy(game->black_name, (char *)sqlite3_column_text(stmt, 7));
+            strcpy(game->white_result, (char *)sqlite3_column_text(stmt, 8));
+            strcpy(game->black_result, (char *)sqlite3_column_text(stmt, 9));
+            game->game_moves.moves_id = sqlite3_column_int(stmt, 10);
+            game->game_moves.move_number = sqlite3_column_int(stmt, 11);
+            copy_column_text(game->eco, stmt, 13, ECO_MAX);
+            copy_column_text(game->opening, stmt, 14, OPENING_MAX);
+            load_checkpoints(&game->game_moves, sqlite3_column_blob(stmt, 15), sqlite3_column_bytes(stmt, 15));
+
+            // packed moves are decoded right away, otherwise they are read from single_move...
+            game->game_moves.packed = sqlite3_column_type(stmt, 12) != SQLITE_NULL;
+            if (game->game_moves.packed &&
+                !decode_game_moves(sqlite3_column_blob(stmt, 12), sqlite3_column_bytes(stmt, 12),
+                                   &game->game_moves)) {
+                eprintf("ERROR: packed moves of game id(%d) are corrupt...\n", game->game_id);
+                if (transaction_flag)
+                    do_fast_rollback(&db);
+                close_statement(&db, &stmt);
+                return FALSE;
+            }
+        } else {
+            if (status == SQLITE_DONE)
+                eprintf("ERROR: no rows found by id(%d)...\n", game->game_id);
+            else
+                eprintf("Failed to execute statement step: %s\n", sqlite3_errmsg(db));
+
+            // (a transaction left open would keep the database locked for every writer)...
+            if (transaction_flag)
+                sqlite3_exec(db, rollbackTransaction, NULL, NULL, NULL);
+            if (cached)
+                sqlite3_reset(stmt);
+            else
+                close_statement(&db, &stmt);
+            return FALSE;
+        }
+
+        status = sqlite3_step(stmt);
+        if (is_statement_step_error(&db, &stmt, status, transaction_flag))
+            return FALSE;
+
+    } else if (game_moves != NULL) {
+        // since GameMoves has been passed, we expect a number of moves to be store as a result of sql...
+        int move;
+        while((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+            move = sqlite3_column_int(stmt, 1);
+            strcpy(game_moves->moves[move - 1][WHITE_PLAYER], (char *)sqlite3_column_text(stmt, 2));
+            strcpy(game_moves->moves[move - 1][BLACK_PLAYER], (char *)sqlite3_column_text(stmt, 3));
+        }
+
+        if (is_statement_step_error(&db, &stmt, status, FALSE))
+            return FALSE;
+
+    } else {
+        // execute statement. Since arr_sample and game is NULL, no data is expected from database...
+        status = sqlite3_step(stmt);
+        if (is_statement_step_error(&db, &stmt, status, transaction_flag))
+            return FALSE;
+    }
+
+    // finalize stmt (a cached one is only reset, for the next call)...
+    if (cached) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    } else {
+        sqlite3_finalize(stmt);
+    }
+
+    // close db if required...
+    if (close)
+        sqlite3_close(db);
+    return return_code;
+}
+
+/* Drops the cached standings of the tournament game_id currently belongs to.
+ * Errors are only reported, since the worst outcome is a recalculation.                           */
+void invalidate_standings_by_id(int game_id)
+{
+    char name[NAME_MAX], class[NAME_MAX], group[NAME_MAX];
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+
+    route_by_id(game_id);
+    if (!open_database_conn(&db))
+        return;
+
+    int status = sqlite3_prepare_v2(db, selectTournamentById, -1, &stmt, 0);
+    if (is_statement_error(&db, &stmt, status, FALSE))
+        return;
+
+    status = sqlite3_bind_int(stmt, 1, game_id);
+    if (is_binding_error(&db, &stmt, status, FALSE))
+        return;
+
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        copy_column_text(name, stmt, 0, NAME_MAX);
+        copy_column_text(class, stmt, 1, NAME_MAX);
+        copy_column_text(group, stmt, 2, NAME_MAX);
+        invalidate_standings(name, class, group);
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+/* Adds the tournament and player names of data to the open database db if they are new.
+ * Must be called inside a transaction. Returns TRUE on success and FALSE on error.               */
+static int intern_game_names(sqlite3 *db, const GameInfo *data)
+{
+    return do_statement(db, NULL, NULL, NULL, TRUE, insertEvent, "%s%s%s", data->name, data->class, data->group) &&
+           do_statement(db, NULL, NULL, NULL, TRUE, insertPlayers, "%s%s", data->white_name, data->black_name);
+}
+
+/* Inserts data (its names, game, moves and line and similarity index rows) on the open database
+ * db, the game getting the next id above id_floor, stored in data->game_id. Must be called inside
+ * a transaction. Returns TRUE on success and FALSE on error.                                      */
+int insert_game_rows(sqlite3 *db, GameInfo *data, int id_floor)
+{
+    int last_row, packed_size;
+    unsigned char packed[PACKED_MOVES_MAX];
+
+    // moves in canonical SAN are stored packed in moves, anything else move by move in single_move...
+    packed_size = encode_game_moves(&data->game_moves, data->game_moves.move_number, packed, PACKED_MOVES_MAX);
+    data->game_moves.packed = (packed_size > 0);
+    set_game_opening(data, data->game_moves.move_number);
+    build_checkpoints(&data->game_moves, data->game_moves.move_number);
+
+    // execute statement insertIntoGame (after adding its names)...
+    if (!intern_game_names(db, data) ||
+        !do_statement(db, NULL, NULL, NULL,TRUE, insertIntoGame,
+                      "%d%s%s%s%s%s%s%s%s%s%d%s%s", id_floor, data->name, data->class, data->group, data->game_number,
+                      data->date, data->white_name, data->black_name, data->white_result, data->black_result,
+                      pack_date(data->date), data->eco, data->opening))
+        return FALSE;
+
+    // getting last row...
+    last_row = (int)sqlite3_last_insert_rowid(db);
+    data->game_id = last_row;
+
+    // execute statement insertIntoMoves...
+    if (!do_statement(db, NULL,NULL,NULL,TRUE,
+                      insertIntoMoves, "%b%d%d%B%B", data->game_moves.move_number, last_row,
+                      (data->game_moves.packed) ? packed : NULL, packed_size,
+                      data->game_moves.checkpoints, data->game_moves.num_of_checkpoints * CHECKPOINT_SIZE))
+        return FALSE;
+
+    // getting last row...
+    last_row = (int)sqlite3_last_insert_rowid(db);
+
+    // execute statement(s) insertIntoSingleMove for every move inputted (if not packed)...
+    for (int move = 1, arr_pos = 0; !data->game_moves.packed && move <= data->game_moves.move_number;
+         move++, arr_pos++) {
+        if (!do_statement(db, NULL, NULL, NULL,TRUE, insertIntoSingleMove,
+                          "%b%d%s%s%d", move, data->game_moves.moves[arr_pos][WHITE_PLAYER],
+                          data->game_moves.moves[arr_pos][BLACK_PLAYER], last_row))
+            return FALSE;
+    }
+
+    // indexing the lines and the signature of the game...
+    return index_game_lines(db, data->game_id, &data->game_moves, data->game_moves.move_number) &&
+           index_game_signature(db, data->game_id, &data->game_moves, data->game_moves.move_number);
+}
+
+/* Attempts to insert data into the database. On success data->game_id is set to the new id.
+ * returns TRUE on success, otherwise FAlSE                                                        */
+int insert_data(GameInfo *data)
+{
+    sqlite3 *db;
+
+    // opening database (the shard of the game)...
+    if (!route_by_game(data) || !open_database_conn(&db))
+        return FALSE;
+
+    // begin transaction... all or nothing...
+    if (!do_statement(db, NULL, NULL, NULL, FALSE,
+                      beginTransaction, NULL))
+        return FALSE;
+
+    if (!insert_game_rows(db, data, current_db()->routed_id_floor))
+        return FALSE;
+
+    // commit transaction...
+    if (!do_statement(db, NULL, NULL, NULL, TRUE, commitTransaction, NULL))
+        return FALSE;
+
+    // closing database...
+    sqlite3_close(db);
+
+    bump_data_generation();
+    count_writes(1);
+    invalidate_standings(data->name, data->class, data->group);
+    add_completion(COMPLETE_TOURNAMENT, data->name);
+    add_completion(COMPLETE_PLAYER, data->white_name);
+    add_completion(COMPLETE_PLAYER, data->black_name);
+    return TRUE;
+}
+
+/* Moves the game data to the shard it belongs in (with a new id, stored in data->game_id).
+ * Returns FALSE (0) on error and TRUE on success.                                                 */
+static int move_game(GameInfo *data)
+{
+    GameInfo old = *data;
+
+    if (!insert_data(data))
+        return FALSE;
+    printf("INFO: game moved to another shard, new id(%d)...\n", data->game_id);
+    return delete_game(&old);
+}
+
+/* Updates data for game with game_id in game table.
+ * Returns FALSE (0) on error and TRUE on success.                                                 */
+int update_data(GameInfo *data)
+{
+    sqlite3 *db = NULL;
+
+    // the game may be moved to another tournament, standings of the old one are outdated as well...
+    invalidate_standings_by_id(data->game_id);
+
+    // a new year or tournament may belong in another shard, the game is moved there...
+    if (get_sharding_mode() != SHARD_NONE) {
+        char key[NAME_MAX];
+        const Shard *shard = find_shard(SHARD_OF_ID(data->game_id));
+
+        shard_key_of_game(data->name, pack_date(data->date), key);
+        if (shard != NULL && strcmp(shard->key, key) != 0)
+            return move_game(data);
+    }
+    route_by_id(data->game_id);
+    if (!open_database_conn(&db) || !do_statement(db, NULL, NULL, NULL, FALSE, beginTransaction, NULL))
+        return FALSE;
+
+    if (!intern_game_names(db, data) ||
+        !do_statement(db, NULL, NULL, NULL, TRUE, updateGame,
+                      "%s%s%s%s%s%d%s%s%s%s%d", data->name, data->class, data->group, data->game_number,
+                      data->date, pack_date(data->date), data->white_name, data->black_name, data->white_result,
+                      data->black_result, data->game_id) ||
+        !do_statement(db, NULL, NULL, NULL, TRUE, commitTransaction, NULL))
+        return FALSE;
+    sqlite3_close(db);
+
+    bump_data_generation();
+    count_writes(1);
+    invalidate_standings(data->name, data->class, data->group);
+    return TRUE;
+}
+
+/* Replaces the packed moves of a game with the first new_move_count moves of data.
+ * If the new moves can not be packed (not canonical SAN), they are unpacked into single_move.
+ * Must be called inside a transaction. Returns TRUE on success and FALSE on error.               */
+int update_packed_moves(sqlite3 *db, GameInfo *data, int new_move_count)
+{
+    unsigned char packed[PACKED_MOVES_MAX];
+    int packed_size = encode_game_moves(&data->game_moves, new_move_count, packed, PACKED_MOVES_MAX);
+
+    if (packed_size)
+        return do_statement(db, NULL, NULL, NULL, TRUE, updatePackedMoves, "%d%B%d",
+                            new_move_count, packed, packed_size, data->game_moves.moves_id);
+
+    for (int move_num = 1, arr_pos = 0; move_num <= new_move_count; move_num++, arr_pos++) {
+        if (!do_statement(db, NULL, NULL, NULL, TRUE,
+                          insertIntoSingleMove,"%b%d%s%s%d", move_num,
+                          data->game_moves.moves[arr_pos][WHITE_PLAYER],
+                          data->game_moves.moves[arr_pos][BLACK_PLAYER], data->game_moves.moves_id))
+            return FALSE;
+    }
+    data->game_moves.packed = FALSE;
+    return do_statement(db, NULL, NULL, NULL, TRUE, updatePackedMoves, "%d%B%d",
+                        new_move_count, NULL, 0, data->game_moves.moves_id);
+}
+
+/* Updates data for moves and single_move related to game_id.
+ * Returns FALSE (0) on error and TRUE on success.                                                 */
+int update_moves(GameInfo *data, int new_move_count)
+{
+    int old_move_count = data->game_moves.move_number;
+    int max_move = (new_move_count <= old_move_count) ? old_move_count : new_move_count;
+    sqlite3 *db = NULL;
+
+    // open database...
+    route_by_id(data->game_id);
+    if (!open_database_conn(&db))
+        return FALSE;
+
+    // beginning transaction. All or nothing...
+    if (!do_statement(db, NULL, NULL, NULL, FALSE,
+                      beginTransaction, NULL))
+        return FALSE;
+
+    // packed moves are replaced as a whole...
+    if (data->game_moves.packed) {
+        if (!update_packed_moves(db, data, new_move_count))
+            return FALSE;
+        max_move = 0;
+    }
+
+    for (int move_num = 1, arr_pos = 0; move_num <= max_move; move_num++, arr_pos++) {
+        if (old_move_count < new_move_count && old_move_count < move_num) {
+            // execute statement with insertIntoSingleMove...
+            if (!do_statement(db, NULL, NULL, NULL, TRUE,
+                              insertIntoSingleMove,"%b%d%s%s%d", move_num,
+                              data->game_moves.moves[arr_pos][WHITE_PLAYER],
+                              data->game_moves.moves[arr_pos][BLACK_PLAYER], data->game_moves.moves_id))
+                return FALSE;
+
+        } else if (strcmp(data->game_moves.moves[arr_pos][WHITE_PLAYER], "-") == 0) {
+            // execute statement with deleteSingleMove...
+            if (!do_statement(db, NULL, NULL, NULL, TRUE, deleteSingleMove,
+                              "%d%d", data->game_moves.moves_id, move_num))
+                return FALSE;
+
+        } else {
+            // execute statement with updateMove...
+            if (!do_statement(db, NULL, NULL, NULL, TRUE, updateMove,
+                              "%s%s%d%d", data->game_moves.moves[arr_pos][WHITE_PLAYER],
+                              data->game_moves.moves[arr_pos][BLACK_PLAYER],
+                              data->game_moves.moves_id, move_num))
+                return FALSE;
+        }
+    }
+
+    // the opening, the lines, the signature and the checkpoints may have changed...
+    if (!unindex_game(db, data->game_id) ||
+        !index_game_lines(db, data->game_id, &data->game_moves, new_move_count) ||
+        !index_game_signature(db, data->game_id, &data->game_moves, new_move_count))
+        return FALSE;
+
+    build_checkpoints(&data->game_moves, new_move_count);
+    if (!do_statement(db, NULL, NULL, NULL, TRUE, updateCheckpoints, "%B%d", data->game_moves.checkpoints,
+                      data->game_moves.num_of_checkpoints * CHECKPOINT_SIZE, data->game_moves.moves_id))
+        return FALSE;
+
+    set_game_opening(data, new_move_count);
+    if (!do_statement(db, NULL, NULL, NULL, TRUE, updateGameOpening,
+                      "%s%s%d", data->eco, data->opening, data->game_id))
+        return FALSE;
+
+    // execute statement for updateMoveCount...
+    if (!data->game_moves.packed &&
+        !do_statement(db, NULL, NULL, NULL, TRUE, updateMoveCount,
+                      "%d%d", new_move_count, data->game_moves.moves_id))
+        return FALSE;
+
+    // committing transaction...
+     if (!do_statement(db, NULL, NULL, NULL, TRUE,
+                       commitTransaction, NULL))
+         return FALSE;
+
+    // closing database connection...
+    sqlite3_close(db);
+
+    bump_data_generation();
+    count_writes(1);
+    return TRUE;
+}
+
+/* ********** FAN OUT QUERIES **********
+ * With sharding, a list query runs on every shard in parallel. Each shard returns the first
+ * (page + 1) * SAMPLE_MAX rows in the order of the query, the rows are merged into the same order
+ * and the page is cut out of the merged list.                                                     */
+
+typedef struct ListTask {
+    const char *sql;
+    const char *term;       // bound to all text parameters (searches)...
+    int from_date;          // bound to the first two integer parameters (date ranges)...
+    int to_date;
+    int limit;
+    ListRow *rows;
+    int count;
+} ListTask;
+
+/* Reads the current result row of a SELECT * query on game_view into row.                        */
+static void read_list_row(sqlite3_stmt *stmt, ListRow *row)
+{
+    SampleInfo *sample = &row->sample;
+
+    row->date_int = sqlite3_column_int(stmt, 10);
+    sample->id = sqlite3_column_int(stmt, 0);
+    copy_column_text(sample->name, stmt, 1, NAME_MAX);
+    copy_column_text(sample->date, stmt, 5, DATE_MAX);
+    copy_column_text(sample->white_name, stmt, 6, NAME_MAX);
+    copy_column_text(sample->black_name, stmt, 7, NAME_MAX);
+}
+
+/* Runs the list query of task (parameters followed by LIMIT and OFFSET) on one shard.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int run_list_task(sqlite3 *db, void *arg)
+{
+    ListTask *task = arg;
+    sqlite3_stmt *stmt;
+    int status, num_of_params;
+
+    task->count = 0;
+    if (sqlite3_prepare_v2(db, task->sql, -1, &stmt, 0) != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return FALSE;
+    }
+
+    num_of_params = sqlite3_bind_parameter_count(stmt);
+    for (int i = 1; i <= num_of_params - 2; i++) {
+        if (task->term != NULL)
+            sqlite3_bind_text(stmt, i, task->term, -1, SQLITE_TRANSIENT);
+        else
+            sqlite3_bind_int(stmt, i, (i == 1) ? task->from_date : task->to_date);
+    }
+    sqlite3_bind_int(stmt, num_of_params - 1, task->limit);
+    sqlite3_bind_int(stmt, num_of_params, 0);
+
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW && task->count < task->limit)
+        read_list_row(stmt, &task->rows[task->count++]);
+
+    if (status != SQLITE_ROW && status != SQLITE_DONE)
+        eprintf("Failed to execute statement step: %s\n", sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+    return status == SQLITE_ROW || status == SQLITE_DONE;
+}
+
+/* Compares two rows in the merge order of the current database handle (as the ORDER BY of the
+ * list queries): 0 for id order or the sort column of get_sorted_list.                            */
+static int compare_rows(const void *a, const void *b)
+{
+    const ListRow *r1 = a, *r2 = b;
+    const SampleInfo *s1 = &r1->sample, *s2 = &r2->sample;
+    int result = 0;
+
+    switch (current_db()->merge_column) {
+        case 1:
+            result = strcmp(s1->name, s2->name);
+            break;
+        case 2:
+            result = strcmp(s1->white_name, s2->white_name);
+            break;
+        case 3:
+            result = strcmp(s1->black_name, s2->black_name);
+            break;
+        case 4:
+            result = (r1->date_int > r2->date_int) - (r1->date_int < r2->date_int);
+            break;
+        default:
+            break;
+    }
+    return (result != 0) ? result : (s1->id > s2->id) - (s1->id < s2->id);
+}
+
+/* Runs the list query sql on all shards and stores page of the merged result in arr_sample,
+ * ordered by column (0 for id order). term or from_date/to_date are the query parameters.
+ * on success the number of elements retrieved is returned, on error 0 (FALSE)
+ * is returned.                                                                                    */
+static int fan_out_list(SampleInfo arr_sample[], const char *sql, int column, const char *term,
+                        int from_date, int to_date, int page)
+{
+    int num_of_shards = get_num_of_shards(), limit = (page + 1) * SAMPLE_MAX, total = 0, count = 0;
+    ListTask *tasks = calloc((size_t)num_of_shards, sizeof(ListTask));
+    ListRow *merged = malloc(sizeof(ListRow) * limit * (num_of_shards ? num_of_shards : 1));
+
+    if (tasks == NULL || merged == NULL) {
+        eprintf("ERROR: could not allocate memory for the shard results...\n");
+        free(tasks);
+        free(merged);
+        return FALSE;
+    }
+
+    for (int i = 0; i < num_of_shards; i++) {
+        tasks[i] = (ListTask){sql, term, from_date, to_date, limit, merged + (size_t)i * limit, 0};
+    }
+
+    if (fan_out(run_list_task, tasks, sizeof(ListTask))) {
+        // compacting the shard results, then merging...
+        for (int i = 0; i < num_of_shards; i++) {
+            memmove(merged + total, tasks[i].rows, sizeof(ListRow) * tasks[i].count);
+            total += tasks[i].count;
+        }
+        current_db()->merge_column = column;
+        qsort(merged, (size_t)total, sizeof(ListRow), compare_rows);
+
+        for (int i = page * SAMPLE_MAX; i < total && count < SAMPLE_MAX; i++)
+            arr_sample[count++] = merged[i].sample;
+    }
+
+    free(tasks);
+    free(merged);
+    return count;
+}
+
+/* Retrieves a page (at most SAMPLE_MAX elements) of a simplified list of all chess games
+ * from the database table that matches the search word.
+ * On success the number of elements retrieved is returned, on error 0 (FALSE)
+ * is returned.                                                                                    */
+int search_data(SampleInfo arr_sample[], const char search_word[], int page)
+{
+    sqlite3 *db = NULL;
+    int count;
+
+    if ((count = lookup_cached_result(QUERY_SEARCH, 0, search_word, page, arr_sample)))
+        return count;
+
+    if (get_sharding_mode() != SHARD_NONE)
+        count = fan_out_list(arr_sample, selectSearch, 0, search_word, 0, 0, page);
+    else
+        count = do_statement(db, arr_sample, NULL, NULL, FALSE, selectSearch,
+                             "%s%s%s%s%s%s%s%s%d%d", search_word, search_word, search_word, search_word,
+                             search_word, search_word, search_word, search_word, SAMPLE_MAX, page * SAMPLE_MAX);
+    store_cached_result(QUERY_SEARCH, 0, search_word, page, arr_sample, count);
+    return count;
+}
+
+/* Deletes game with game_id from the database.
+ * Return TRUE on successful deletion and FALSE on error executing request.                        */
+int delete_game(GameInfo *data)
+{
+    sqlite3 *db;
+
+    // opening database...
+    route_by_id(data->game_id);
+    if (!open_database_conn(&db))
+        return FALSE;
+
+    // deletes the entry in game table with game_id, its moves cascade...
+    if (!do_statement(db, NULL, NULL, NULL, FALSE,
+                      deleteGameInformation,"%d", data->game_id))
+        return FALSE;
+
+    // closing database...
+    sqlite3_close(db);
+
+    bump_data_generation();
+    count_writes(1);
+    invalidate_standings(data->name, data->class, data->group);
+    return TRUE;
+}
+
+/* Retrieves a page (at most SAMPLE_MAX elements) of a simplified (unsorted) list of all
+ * chess games in the database.
+ * on success the number of elements retrieved is returned, on error 0 (FALSE)
+ * is returned.                                                                                    */
+int get_unsorted_list(SampleInfo arr_sample[], int page)
+{
+    sqlite3 *db = NULL;
+    int count;
+
+    if ((count = lookup_cached_result(QUERY_UNSORTED, 0, NULL, page, arr_sample)))
+        return count;
+
+    if (get_sharding_mode() != SHARD_NONE)
+        count = fan_out_list(arr_sample, selectAll, 0, NULL, 0, 0, page);
+    else
+        count = do_statement(db, arr_sample, NULL, NULL, FALSE, selectAll,
+                             "%d%d", SAMPLE_MAX, page * SAMPLE_MAX);
+    store_cached_result(QUERY_UNSORTED, 0, NULL, page, arr_sample, count);
+    return count;
+}
+
+/* Retrieves a page (at most SAMPLE_MAX elements) of a simplified list of all chess games
+ * in the database sorted by either, name, white_name, black_name or date.
+ * on success the number of elements retrieved is returned, on error 0 (FALSE)
+ * is returned.                                                                                    */
+int get_sorted_list(SampleInfo arr_sample[], int column, int page)
+{
+    sqlite3 *db = NULL;
+    const char *sql;
+    int count;
+
+    switch (column) {
+        case 1:
+            sql = selectAllOrderByName;
+            break;
+        case 2:
+            sql = selectAllOrderByWhiteName;
+            break;
+        case 3:
+            sql = selectAllOrderByBlackName;
+            break;
+        case 4:
+            sql = selectAllOrderByDate;
+            break;
+        default:
+            eprintf("ERROR: invalid column got through first check.\n");
+            return FALSE;
+    }
+
+    if ((count = lookup_cached_result(QUERY_SORTED, column, NULL, page, arr_sample)))
+        return count;
+
+    if (get_sharding_mode() != SHARD_NONE)
+        count = fan_out_list(arr_sample, sql, column, NULL, 0, 0, page);
+    else
+        count = do_statement(db, arr_sample, NULL, NULL, FALSE, sql,
+                             "%d%d", SAMPLE_MAX, page * SAMPLE_MAX);
+    store_cached_result(QUERY_SORTED, column, NULL, page, arr_sample, count);
+    return count;
+}
+
+/* Retrieves a page (at most SAMPLE_MAX elements) of the games played from from_date to to_date
+ * (packed dates, see pack_date) ordered by date. A partial to_date covers its whole period, so
+ * 20190000 to 20210000 retrieves all games from 2019 to 2021. Games with an unknown date are
+ * never included.
+ * on success the number of elements retrieved is returned, on error 0 (FALSE)
+ * is returned.                                                                                    */
+int get_games_by_date(SampleInfo arr_sample[], int from_date, int to_date, int page)
+{
+    sqlite3 *db = NULL;
+    char term[24];
+    int count;
+
+    if (from_date < 1)
+        from_date = 1;
+    to_date = date_range_end(to_date);
+
+    snprintf(term, sizeof(term), "%d-%d", from_date, to_date);
+    if ((count = lookup_cached_result(QUERY_DATE_RANGE, 0, term, page, arr_sample)))
+        return count;
+
+    if (get_sharding_mode() != SHARD_NONE)
+        count = fan_out_list(arr_sample, selectDateRange, 4, NULL, from_date, to_date, page);
+    else
+        count = do_statement(db, arr_sample, NULL, NULL, FALSE, selectDateRange,
+                             "%d%d%d%d", from_date, to_date, SAMPLE_MAX, page * SAMPLE_MAX);
+    store_cached_result(QUERY_DATE_RANGE, 0, term, page, arr_sample, count);
+    return count;
+}
+
+/* ********** LIST WINDOWS **********
+ * A window is read relative to a row of the list (keyset paging): a query seeks to the sort key
+ * and id of that row through the index of the list order and reads count rows from there, so a
+ * window far down a list costs as much as the first one. With sharding, every shard returns its
+ * count rows after (before) the row and the nearest count of the merged rows are kept.           */
+
+typedef struct WindowTask {
+    const char *sql;
+    const char *term;
+    int column;
+    const ListRow *from;
+    int backward;
+    int limit;
+    ListRow *rows;
+    int count;
+} WindowTask;
+
+/* Runs the window query of task on one shard, the rows are stored in query order.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int run_window_task(sqlite3 *db, void *arg)
+{
+    WindowTask *task = arg;
+    const ListRow *from = task->from;
+    sqlite3_stmt *stmt;
+    int status;
+
+    task->count = 0;
+    if (sqlite3_prepare_v2(db, task->sql, -1, &stmt, 0) != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return FALSE;
+    }
+
+    if (task->term != NULL)
+        sqlite3_bind_text(stmt, 1, task->term, -1, SQLITE_TRANSIENT);
+
+    // the sort key, without a row before all (after all, a blob sorting after any text) rows...
+    if (task->column == 4)
+        sqlite3_bind_int(stmt, 2, (from != NULL) ? from->date_int : (task->backward) ? WINDOW_KEY_MAX : -1);
+    else if (from != NULL)
+        sqlite3_bind_text(stmt, 2, (task->column == 1) ? from->sample.name : (task->column == 2)
+                                   ? from->sample.white_name : from->sample.black_name, -1, SQLITE_TRANSIENT);
+    else if (task->backward)
+        sqlite3_bind_zeroblob(stmt, 2, 0);
+    else
+        sqlite3_bind_text(stmt, 2, "", -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, (from != NULL) ? from->sample.id : (task->backward) ? WINDOW_KEY_MAX : 0);
+    sqlite3_bind_int(stmt, 4, task->limit);
+
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW && task->count < task->limit)
+        read_list_row(stmt, &task->rows[task->count++]);
+
+    if (status != SQLITE_ROW && status != SQLITE_DONE)
+        eprintf("Failed to execute statement step: %s\n", sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+    return status == SQLITE_ROW || status == SQLITE_DONE;
+}
+
+/* Retrieves the window of at most count rows of the game list ordered by column (0 for id order,
+ * otherwise as get_sorted_list) and matching the search pattern term (all games if NULL) into
+ * rows, in list order: the rows following from (the first rows if NULL), or if backward is TRUE
+ * the rows preceding from (the last rows if NULL).
+ * Returns the number of rows, or ERROR on error.                                                  */
+int get_list_window(ListRow rows[], int count, int column, const char *term, const ListRow *from, int backward)
+{
+    int num_of_shards = get_num_of_shards(), total = 0;
+    WindowTask task = {NULL, term, column, from, backward, count, rows, 0};
+    WindowTask *tasks;
+    ListRow *merged;
+
+    if (column < 0 || column > 4 || count <= 0) {
+        eprintf("ERROR: invalid list window...\n");
+        return ERROR;
+    }
+    task.sql = selectWindow[column][backward ? 1 : 0];
+
+    if (get_sharding_mode() == SHARD_NONE) {
+        sqlite3 *db;
+
+        route_to_shard(0);
+        if (!open_database_readonly(&db))
+            return ERROR;
+        total = run_window_task(db, &task) ? task.count : ERROR;
+        sqlite3_close(db);
+
+        // backward windows are read in reverse order...
+        for (int i = 0; backward && i < total / 2; i++) {
+            ListRow swap = rows[i];
+            rows[i] = rows[total - 1 - i];
+            rows[total - 1 - i] = swap;
+        }
+        return total;
+    }
+
+    tasks = calloc((size_t)num_of_shards, sizeof(WindowTask));
+    merged = malloc(sizeof(ListRow) * count * num_of_shards);
+    if (tasks == NULL || merged == NULL) {
+        eprintf("ERROR: could not allocate memory for the shard results...\n");
+        free(tasks);
+        free(merged);
+        return ERROR;
+    }
+
+    for (int i = 0; i < num_of_shards; i++) {
+        tasks[i] = task;
+        tasks[i].rows = merged + (size_t)i * count;
+    }
+
+    if (fan_out(run_window_task, tasks, sizeof(WindowTask))) {
+        for (int i = 0; i < num_of_shards; i++) {
+            memmove(merged + total, tasks[i].rows, sizeof(ListRow) * tasks[i].count);
+            total += tasks[i].count;
+        }
+        current_db()->merge_column = column;
+        qsort(merged, (size_t)total, sizeof(ListRow), compare_rows);
+
+        // the count rows nearest to from...
+        if (total > count) {
+            if (backward)
+                memmove(merged, merged + total - count, sizeof(ListRow) * count);
+            total = count;
+        }
+        memcpy(rows, merged, sizeof(ListRow) * total);
+    } else {
+        total = ERROR;
+    }
+
+    free(tasks);
+    free(merged);
+    return total;
+}
+
+/* Gets a data from the database by id. If an error was encountered 0 (FALSE)
+ * is returned, TRUE is returned if everything went accordingly and the data
+ * information was stored in 'data', FALSE, otherwise.                                             */
+int get_game_by_id(GameInfo *data)
+{
+    sqlite3 *db;
+
+    route_by_id(data->game_id);
+    if(!open_cached_connection(&db))
+        return FALSE;
+
+    // begin transaction... all or nothing...
+    if (!do_statement(db, NULL, NULL, NULL, FALSE,
+                      beginTransaction, NULL))
+        return FALSE;
+
+    // retrieving game by id...
+    if (!do_statement(db, NULL, data, NULL, TRUE,
+                      selectGameById, "%d", data->game_id))
+        return FALSE;
+
+    // retrieving all moves related to game via moves_id (unless already unpacked)...
+    if (!data->game_moves.packed &&
+        !do_statement(db, NULL, NULL, &data->game_moves, TRUE,
+                      selectSingleMovesById, "%d", data->game_moves.moves_id))
+        return FALSE;
+
+    // committing transaction...
+    if (!do_statement(db, NULL, NULL, NULL, TRUE,
+                      commitTransaction, NULL))
+        return FALSE;
+
+    // closes...
+    close_cached_connection(db);
+    return TRUE;
+}
+
+
+
+
+/* Retrieves the finished games of a tournament (g_name), class (g_class) and group (g_group)
+ * grouped by pairing (white player, black player) in a single query. *pairings is allocated
+ * and must be freed by the caller.
+ * On success the number of pairings retrieved is returned, on error 0 (FALSE) is returned.        */
+static int read_pairings(sqlite3 *db, TournamentPairing **pairings, const char *name, const char *class,
+                         const char *group)
+{
+    sqlite3_stmt *stmt;
+    int status, count = 0, capacity = 64;
+
+    *pairings = malloc(sizeof(TournamentPairing) * capacity);
+    if (*pairings == NULL) {
+        eprintf("ERROR: could not allocate memory for pairings...\n");
+        return ERROR;
+    }
+
+    status = sqlite3_prepare_v2(db, selectTournamentPairings, -1, &stmt, 0);
+    if (status != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return ERROR;
+    }
+
+    const char *bindings[] = {name, class, group};
+    for (int i = 0; i < 3; i++)
+        sqlite3_bind_text(stmt, i + 1, bindings[i], -1, SQLITE_TRANSIENT);
+
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (count == capacity) {
+            TournamentPairing *grown = realloc(*pairings, sizeof(TournamentPairing) * capacity * 2);
+            if (grown == NULL) {
+                eprintf("ERROR: could not allocate memory for pairings...\n");
+                sqlite3_finalize(stmt);
+                return ERROR;
+            }
+            *pairings = grown;
+            capacity *= 2;
+        }
+
+        TournamentPairing *p = &(*pairings)[count++];
+        copy_column_text(p->white_name, stmt, 0, NAME_MAX);
+        copy_column_text(p->black_name, stmt, 1, NAME_MAX);
+        p->games = sqlite3_column_int(stmt, 2);
+        p->white_wins = sqlite3_column_int(stmt, 3);
+        p->draws = sqlite3_column_int(stmt, 4);
+        p->black_wins = sqlite3_column_int(stmt, 5);
+    }
+
+    if (status != SQLITE_DONE) {
+        eprintf("Failed to execute statement step: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return ERROR;
+    }
+
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+typedef struct PairingsTask {
+    const char *name;
+    const char *class;
+    const char *group;
+    TournamentPairing *pairings;
+    int count;
+} PairingsTask;
+
+static int run_pairings_task(sqlite3 *db, void *arg)
+{
+    PairingsTask *task = arg;
+    task->count = read_pairings(db, &task->pairings, task->name, task->class, task->group);
+    return task->count != ERROR;
+}
+
+static int compare_pairings(const void *a, const void *b)
+{
+    const TournamentPairing *p1 = a, *p2 = b;
+    int result = strcmp(p1->white_name, p2->white_name);
+    return (result != 0) ? result : strcmp(p1->black_name, p2->black_name);
+}
+
+/* Retrieves the pairings of a tournament from all shards and adds up the pairings found in
+ * more than one shard. Returns the number of pairings, or FALSE on error.                         */
+static int fan_out_pairings(TournamentPairing **pairings, const char *name, const char *class,
+                            const char *group)
+{
+    int num_of_shards = get_num_of_shards(), total = 0, count = 0, success;
+    PairingsTask *tasks = calloc((size_t)num_of_shards, sizeof(PairingsTask));
+
+    if (tasks == NULL)
+        return FALSE;
+    for (int i = 0; i < num_of_shards; i++)
+        tasks[i] = (PairingsTask){name, class, group, NULL, 0};
+
+    success = fan_out(run_pairings_task, tasks, sizeof(PairingsTask));
+    for (int i = 0; i < num_of_shards; i++)
+        total += (tasks[i].count > 0) ? tasks[i].count : 0;
+
+    *pairings = malloc(sizeof(TournamentPairing) * (total ? total : 1));
+    success = success && *pairings != NULL;
+
+    for (int i = 0; i < num_of_shards; i++) {
+        if (success && tasks[i].count > 0) {
+            memcpy(*pairings + count, tasks[i].pairings, sizeof(TournamentPairing) * tasks[i].count);
+            count += tasks[i].count;
+        }
+        free(tasks[i].pairings);
+    }
+    free(tasks);
+
+    if (!success)
+        return FALSE;
+
+    // adding up pairings of the same players...
+    qsort(*pairings, (size_t)count, sizeof(TournamentPairing), compare_pairings);
+    total = 0;
+    for (int i = 0; i < count; i++) {
+        TournamentPairing *last = (total > 0) ? &(*pairings)[total - 1] : NULL;
+        if (last != NULL && compare_pairings(last, &(*pairings)[i]) == 0) {
+            last->games += (*pairings)[i].games;
+            last->white_wins += (*pairings)[i].white_wins;
+            last->draws += (*pairings)[i].draws;
+            last->black_wins += (*pairings)[i].black_wins;
+        } else {
+            (*pairings)[total++] = (*pairings)[i];
+        }
+    }
+    return total;
+}
+
+int get_tournament_pairings(TournamentPairing **pairings, const char *name, const char *class,
+                            const char *group)
+{
+    sqlite3 *db;
+    int count;
+
+    if (get_sharding_mode() != SHARD_NONE)
+        return fan_out_pairings(pairings, name, class, group);
+
+    *pairings = NULL;
+    route_to_shard(0);
+    if (!open_database_conn(&db))
+        return FALSE;
+
+    count = read_pairings(db, pairings, name, class, group);
+    sqlite3_close(db);
+    return (count == ERROR) ? FALSE : count;
+}
+/* Reads the game columns, moves.id and number_of_moves of a row with the column layout of
+ * selectGameById into game.                                                                       */
+static void read_game_header(sqlite3_stmt *stmt, GameInfo *game)
+{
+    game->game_id = sqlite3_column_int(stmt, 0);
+    copy_column_text(game->name, stmt, 1, NAME_MAX);
+    copy_column_text(game->class, stmt, 2, NAME_MAX);
+    copy_column_text(game->group, stmt, 3, NAME_MAX);
+    copy_column_text(game->game_number, stmt, 4, NAME_MAX);
+    copy_column_text(game->date, stmt, 5, DATE_MAX);
+    copy_column_text(game->white_name, stmt, 6, NAME_MAX);
+    copy_column_text(game->black_name, stmt, 7, NAME_MAX);
+    copy_column_text(game->white_result, stmt, 8, RESULT_MAX);
+    copy_column_text(game->black_result, stmt, 9, RESULT_MAX);
+    game->game_moves.moves_id = sqlite3_column_int(stmt, 10);
+    game->game_moves.move_number = sqlite3_column_int(stmt, 11);
+    copy_column_text(game->eco, stmt, 13, ECO_MAX);
+    copy_column_text(game->opening, stmt, 14, OPENING_MAX);
+}
+
+/* Reads a row with the column layout of selectGameById (game columns, moves.id, number_of_moves,
+ * packed_moves, eco, opening, checkpoints) into game. Packed moves are decoded, otherwise game_moves.packed is FALSE and
+ * the moves must be read from single_move.
+ * Returns TRUE on success and FALSE if the packed moves are corrupt.                              */
+int read_game_row(sqlite3_stmt *stmt, GameInfo *game)
+{
+    read_game_header(stmt, game);
+    game->game_moves.packed = sqlite3_column_type(stmt, 12) != SQLITE_NULL;
+    load_checkpoints(&game->game_moves, sqlite3_column_blob(stmt, 15), sqlite3_column_bytes(stmt, 15));
+
+    if (game->game_moves.packed &&
+        !decode_game_moves(sqlite3_column_blob(stmt, 12), sqlite3_column_bytes(stmt, 12), &game->game_moves)) {
+        eprintf("ERROR: packed moves of game id(%d) are corrupt...\n", game->game_id);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Reads the single_move rows of game_moves->moves_id with the (prepared) statement
+ * selectSingleMovesById. Returns TRUE on success and FALSE on error.                              */
+int read_single_moves(sqlite3 *db, sqlite3_stmt *stmt, GameMoves *game_moves)
+{
+    int status, move;
+
+    sqlite3_reset(stmt);
+    status = sqlite3_bind_int(stmt, 1, game_moves->moves_id);
+    if (status != SQLITE_OK) {
+        eprintf("Failed to bind value: %s\n", sqlite3_errmsg(db));
+        return FALSE;
+    }
+
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        move = sqlite3_column_int(stmt, 1);
+        if (move < 1 || move > MOVES_MAX)
+            continue;
+        copy_column_text(game_moves->moves[move - 1][WHITE_PLAYER], stmt, 2, S_MOVE_MAX);
+        copy_column_text(game_moves->moves[move - 1][BLACK_PLAYER], stmt, 3, S_MOVE_MAX);
+    }
+
+    if (status != SQLITE_DONE) {
+        eprintf("Failed to execute statement step: %s\n", sqlite3_errmsg(db));
+        return FALSE;
+    }
+    return TRUE;
+}
 
-    // execute statement insertIntoMoves...
-    if (!do_statement(db, NULL,NULL,NULL,TRUE,
-                      insertIntoMoves, "%b%d%d", data->game_moves.move_number, last_row))
+/* Stores the openings results[i] (NULL if unknown) of the games game_ids[i] in one transaction.
+ * Returns TRUE on success and FALSE on error.                                                     */
+int update_game_openings(const int game_ids[], const Opening *results[], int count)
+{
+    sqlite3 *db;
+
+    if (!open_database_conn(&db))
         return FALSE;
 
-    // getting last row...
-    last_row = (int)sqlite3_last_insert_rowid(db);
+    if (!do_statement(db, NULL, NULL, NULL, FALSE, beginTransaction, NULL))
+        return FALSE;
 
-    // execute statement(s) insertIntoSingleMove for every move inputted...
-    for (int move = 1, arr_pos = 0; move <= data->game_moves.move_number; move++, arr_pos++) {
-        if (!do_statement(db, NULL, NULL, NULL,TRUE, insertIntoSingleMove,
-                          "%b%d%s%s%d", move, data->game_moves.moves[arr_pos][WHITE_PLAYER],
-                          data->game_moves.moves[arr_pos][BLACK_PLAYER], last_row))
+    for (int i = 0; i < count; i++) {
+        if (!do_statement(db, NULL, NULL, NULL, TRUE, updateGameOpening, "%s%s%d",
+                          (results[i] != NULL) ? results[i]->eco : "",
+                          (results[i] != NULL) ? results[i]->name : "", game_ids[i]))
             return FALSE;
     }
 
-    // commit transaction...
     if (!do_statement(db, NULL, NULL, NULL, TRUE, commitTransaction, NULL))
         return FALSE;
 
-    // closing database...
     sqlite3_close(db);
+
+    bump_data_generation();
+    count_writes(count);
     return TRUE;
 }
 
-/* Updates data for game with game_id in game table.
- * Returns FALSE (0) on error and TRUE on success.                                                 */
-int update_data(GameInfo *data)
+/* ********** BULK OPERATIONS **********
+ * Bulk deletes and renames run as set based statements per shard inside one transaction,
+ * the moves and single moves of deleted games go with them through ON DELETE CASCADE. Names left
+ * without games are removed from player and event in the same transaction.                        */
+
+/* Runs the bulk statement sql on db (in a transaction), binding the texts that are not NULL to
+ * ?1, ?2, ... and, if ints is not NULL, num_of_ints integers to the following parameters.
+ * Returns the number of changed rows, or ERROR on error (rolled back and db closed).              */
+static int run_bulk_statement(sqlite3 *db, const char *sql, const char *texts[], int num_of_texts,
+                              const int ints[], int num_of_ints)
 {
-    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt;
+    int status = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+
+    if (is_statement_error(&db, &stmt, status, TRUE))
+        return ERROR;
+
+    for (int i = 0; i < num_of_texts; i++) {
+        if (texts[i] != NULL)
+            sqlite3_bind_text(stmt, i + 1, texts[i], -1, SQLITE_TRANSIENT);
+    }
+    for (int i = 0; ints != NULL && i < num_of_ints; i++)
+        sqlite3_bind_int(stmt, num_of_texts + i + 1, ints[i]);
 
-    return do_statement(db, NULL, NULL, NULL, FALSE,updateGame,
-                        "%s%s%s%s%s%s%s%s%s%d", data->name, data->class, data->group, data->game_number,
-                        data->date, data->white_name, data->black_name, data->white_result, data->black_result,
-                        data->game_id);
+    status = sqlite3_step(stmt);
+    if (is_statement_step_error(&db, &stmt, status, TRUE))
+        return ERROR;
+
+    sqlite3_finalize(stmt);
+    return sqlite3_changes(db);
 }
 
-/* Updates data for moves and single_move related to game_id.
- * Returns FALSE (0) on error and TRUE on success.                                                 */
-int update_moves(GameInfo *data, int new_move_count)
+/* Stores the number of rows in moves and single_move of db in counts[0] and counts[1].
+ * Returns TRUE on success, FALSE on error (rolled back and db closed).                            */
+static int get_moves_counts(sqlite3 *db, int counts[2])
 {
-    int old_move_count = data->game_moves.move_number;
-    int max_move = (new_move_count <= old_move_count) ? old_move_count : new_move_count;
-    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt;
+    int status = sqlite3_prepare_v2(db, selectTableCounts, -1, &stmt, 0);
 
-    // open database...
-    if (!open_database_conn(&db))
+    if (is_statement_error(&db, &stmt, status, TRUE))
         return FALSE;
 
-    // beginning transaction. All or nothing...
-    if (!do_statement(db, NULL, NULL, NULL, FALSE,
-                      beginTransaction, NULL))
+    status = sqlite3_step(stmt);
+    if (status != SQLITE_ROW) {
+        is_statement_step_error(&db, &stmt, status, TRUE);
         return FALSE;
+    }
+    counts[0] = sqlite3_column_int(stmt, 0);
+    counts[1] = sqlite3_column_int(stmt, 1);
+    sqlite3_finalize(stmt);
+    return TRUE;
+}
 
-    for (int move_num = 1, arr_pos = 0; move_num <= max_move; move_num++, arr_pos++) {
-        if (old_move_count < new_move_count && old_move_count < move_num) {
-            // execute statement with insertIntoSingleMove...
-            if (!do_statement(db, NULL, NULL, NULL, TRUE,
-                              insertIntoSingleMove,"%b%d%s%s%d", move_num,
-                              data->game_moves.moves[arr_pos][WHITE_PLAYER],
-                              data->game_moves.moves[arr_pos][BLACK_PLAYER], data->game_moves.moves_id))
-                return FALSE;
+/* Deletes all games of tournaments matching the LIKE pattern tournament, with a player matching
+ * player and played between from_date and to_date (packed dates, a partial to_date covers its
+ * whole period, see date_range_end). A NULL pattern or a 0 date range leaves that condition out,
+ * at least one condition is required. Games without a date are never in a date range.
+ * The numbers of deleted rows are stored in counts.
+ * Returns TRUE on success and FALSE on error (the shard that failed is rolled back).              */
+int delete_games_matching(const char *tournament, const char *player, int from_date, int to_date,
+                          BulkCounts *counts)
+{
+    const char *texts[] = {tournament, player};
+    const int dates[] = {(from_date < 1) ? 1 : from_date, date_range_end(to_date)};
+    int numbers[SHARDS_MAX + 1], num_of_shards, success = TRUE;
 
-        } else if (strcmp(data->game_moves.moves[arr_pos][WHITE_PLAYER], "-") == 0) {
-            // execute statement with deleteSingleMove...
-            if (!do_statement(db, NULL, NULL, NULL, TRUE, deleteSingleMove,
-                              "%d%d", data->game_moves.moves_id, move_num))
-                return FALSE;
+    memset(counts, 0, sizeof(BulkCounts));
+    if (tournament == NULL && player == NULL && from_date == 0 && to_date == 0) {
+        eprintf("ERROR: a bulk delete needs a tournament, player or date filter...\n");
+        return FALSE;
+    }
 
-        } else {
-            // execute statement with updateMove...
-            if (!do_statement(db, NULL, NULL, NULL, TRUE, updateMove,
-                              "%s%s%d%d", data->game_moves.moves[arr_pos][WHITE_PLAYER],
-                              data->game_moves.moves[arr_pos][BLACK_PLAYER],
-                              data->game_moves.moves_id, move_num))
-                return FALSE;
+    num_of_shards = get_shard_numbers(numbers);
+    for (int i = 0; i < num_of_shards && success; i++) {
+        sqlite3 *db;
+        int before[2], after[2], deleted;
+
+        route_to_shard(numbers[i]);
+        if (!open_database_conn(&db) || !do_statement(db, NULL, NULL, NULL, FALSE, beginTransaction, NULL)) {
+            success = FALSE;
+            break;
+        }
+
+        if (!get_moves_counts(db, before) ||
+            (deleted = run_bulk_statement(db, deleteGamesMatching, texts, 2,
+                                          (from_date || to_date) ? dates : NULL, 2)) == ERROR ||
+            run_bulk_statement(db, deleteUnusedPlayers, NULL, 0, NULL, 0) == ERROR ||
+            run_bulk_statement(db, deleteUnusedEvents, NULL, 0, NULL, 0) == ERROR ||
+            !get_moves_counts(db, after) ||
+            !do_statement(db, NULL, NULL, NULL, TRUE, commitTransaction, NULL)) {
+            success = FALSE;
+            break;
         }
+        sqlite3_close(db);
+
+        counts->games += deleted;
+        counts->moves += before[0] - after[0];
+        counts->single_moves += before[1] - after[1];
     }
+    route_to_shard(0);
 
-    // execute statement for updateMoveCount...
-    if (!do_statement(db, NULL, NULL, NULL, TRUE, updateMoveCount,
-                      "%d%d", new_move_count, data->game_moves.moves_id))
-        return FALSE;
+    bump_data_generation();
+    count_writes(counts->games + counts->moves + counts->single_moves);
+    clear_standings_cache();
+    return success;
+}
 
-    // committing transaction...
-     if (!do_statement(db, NULL, NULL, NULL, TRUE,
-                       commitTransaction, NULL))
-         return FALSE;
+/* Renames every occurrence of old_name (exact match) to new_name: the white and black player
+ * names if kind is COMPLETE_PLAYER, the tournament name if COMPLETE_TOURNAMENT. The number of
+ * games changed is stored in counts.
+ * Returns TRUE on success and FALSE on error (the shard that failed is rolled back).              */
+int rename_in_games(int kind, const char *old_name, const char *new_name, BulkCounts *counts)
+{
+    const char *texts[] = {old_name, new_name};
+    const char *insert_sql = (kind == COMPLETE_PLAYER) ? insertRenamedPlayer : insertRenamedEvents;
+    const char *sql = (kind == COMPLETE_PLAYER) ? renamePlayer : renameTournament;
+    const char *delete_sql = (kind == COMPLETE_PLAYER) ? deleteRenamedPlayer : deleteRenamedEvents;
+    int numbers[SHARDS_MAX + 1], num_of_shards, success = TRUE;
+
+    memset(counts, 0, sizeof(BulkCounts));
+    num_of_shards = get_shard_numbers(numbers);
+    for (int i = 0; i < num_of_shards && success; i++) {
+        sqlite3 *db;
+        int changed;
+
+        route_to_shard(numbers[i]);
+        if (!open_database_conn(&db) || !do_statement(db, NULL, NULL, NULL, FALSE, beginTransaction, NULL)) {
+            success = FALSE;
+            break;
+        }
 
-    // closing database connection...
-    sqlite3_close(db);
-    return TRUE;
+        if (run_bulk_statement(db, insert_sql, texts, 2, NULL, 0) == ERROR ||
+            (changed = run_bulk_statement(db, sql, texts, 2, NULL, 0)) == ERROR ||
+            run_bulk_statement(db, delete_sql, texts, 2, NULL, 0) == ERROR ||
+            !do_statement(db, NULL, NULL, NULL, TRUE, commitTransaction, NULL)) {
+            success = FALSE;
+            break;
+        }
+        sqlite3_close(db);
+        counts->games += changed;
+    }
+    route_to_shard(0);
+
+    bump_data_generation();
+    count_writes(counts->games);
+    clear_standings_cache();
+    return success;
 }
 
-/* Retrieves a simplified list of all chess games from the database table that
- * matches the search word.
- * On success the number of elements retrieved is returned, on error 0 (FALSE)
- * is returned.                                                                                    */
-int search_data(SampleInfo arr_sample[], const char search_word[])
+/* Runs the query sql through the open connection db and appends each result row, read with
+ * read_row, to *rows (holding *count of *capacity elements of row_size, grown as needed).
+ * Returns SQLITE_DONE on success, the failing status otherwise (db is left open).                  */
+static int append_rows(sqlite3 *db, const char *sql, void **rows, size_t row_size, int *count, int *capacity,
+                       void (*read_row)(sqlite3_stmt *, void *))
 {
-    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt;
+    int status = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+
+    if (status != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return status;
+    }
+
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (*count == *capacity) {
+            void *grown = realloc(*rows, row_size * *capacity * 2);
+            if (grown == NULL) {
+                status = SQLITE_NOMEM;
+                break;
+            }
+            *rows = grown;
+            *capacity *= 2;
+        }
+        read_row(stmt, (char *)*rows + row_size * (*count)++);
+    }
 
-    return do_statement(db, arr_sample, NULL, NULL, FALSE, selectSearch,
-                        "%s%s%s%s%s%s", search_word, search_word, search_word, search_word,
-                        search_word, search_word);
+    if (status != SQLITE_DONE)
+        eprintf("Failed to execute statement step: %s\n", sqlite3_errstr(status));
+    sqlite3_finalize(stmt);
+    return status;
 }
 
-/* Deletes game with game_id from the database.
- * Return TRUE on successful deletion and FALSE on error executing request.                        */
-int delete_game(GameInfo *data)
+/* Runs the query sql through the open connection db and reads each result row with read_row into
+ * *rows, an array of row_size elements allocated here and freed by the caller.
+ * Returns the number of rows, or ERROR on error (db is left open).                                */
+static int read_rows(sqlite3 *db, const char *sql, void **rows, size_t row_size,
+                     void (*read_row)(sqlite3_stmt *, void *))
 {
-    sqlite3 *db;
+    int count = 0, capacity = 1024;
 
-    // opening database...
-    if (!open_database_conn(&db))
-        return FALSE;
+    if ((*rows = malloc(row_size * capacity)) == NULL) {
+        eprintf("ERROR: could not allocate memory for query results...\n");
+        return ERROR;
+    }
+    if (append_rows(db, sql, rows, row_size, &count, &capacity, read_row) != SQLITE_DONE) {
+        free(*rows);
+        *rows = NULL;
+        return ERROR;
+    }
+    return count;
+}
 
-    // begins transaction...
-    if (!do_statement(db, NULL, NULL, NULL, FALSE,
-                      beginTransaction, NULL))
-        return FALSE;
+/* Runs the query sql on every shard and reads each result row with read_row into *rows, an array
+ * of row_size elements allocated here and freed by the caller.
+ * Returns the number of rows, or ERROR on error.                                                  */
+static int read_all_shards(const char *sql, void **rows, size_t row_size, void (*read_row)(sqlite3_stmt *, void *))
+{
+    int numbers[SHARDS_MAX + 1], num_of_shards, count = 0, capacity = 1024, status = SQLITE_DONE;
 
-    // deletes single moves entries related to game...
-    if (!do_statement(db, NULL, NULL, NULL, TRUE,
-                      deleteAllSingleMoves, "%d", data->game_moves.moves_id))
-        return FALSE;
+    if ((*rows = malloc(row_size * capacity)) == NULL) {
+        eprintf("ERROR: could not allocate memory for query results...\n");
+        return ERROR;
+    }
 
+    num_of_shards = get_shard_numbers(numbers);
+    for (int i = 0; i < num_of_shards && status == SQLITE_DONE; i++) {
+        sqlite3 *db;
 
-    // deletes the entry in moves table related to game...
-    if (!do_statement(db, NULL, NULL, NULL, TRUE,
-                      deleteMoves, "%d", data->game_id))
-        return FALSE;
+        route_to_shard(numbers[i]);
+        if (!open_database_readonly(&db)) {
+            status = SQLITE_ERROR;
+            break;
+        }
+        status = append_rows(db, sql, rows, row_size, &count, &capacity, read_row);
+        sqlite3_close(db);
+    }
+    route_to_shard(0);
 
-    // deletes the entry in game table with game_id...
-    if (!do_statement(db, NULL, NULL, NULL, TRUE,
-                      deleteGameInformation,"%d", data->game_id))
+    if (status != SQLITE_DONE) {
+        free(*rows);
+        *rows = NULL;
+        return ERROR;
+    }
+    return count;
+}
+
+static void read_name(sqlite3_stmt *stmt, void *row)
+{
+    copy_column_text(row, stmt, 0, NAME_MAX);
+}
+
+static void read_name_count(sqlite3_stmt *stmt, void *row)
+{
+    NameCount *name_count = row;
+    copy_column_text(name_count->name, stmt, 0, NAME_MAX);
+    name_count->count = sqlite3_column_int(stmt, 1);
+}
+
+/* Retrieves the distinct player names (white and black) of all shards into *names, an array
+ * allocated here and freed by the caller. Names found in several shards appear once per shard.
+ * Returns the number of names, or ERROR on error.                                                 */
+int get_player_names(char (**names)[NAME_MAX])
+{
+    return read_all_shards(selectPlayerNames, (void **)names, NAME_MAX, read_name);
+}
+
+/* Retrieves the player (kind COMPLETE_PLAYER) or tournament names of all shards with their number
+ * of games into *names, an array allocated here and freed by the caller. Names found in several
+ * shards appear once per shard.
+ * Returns the number of names, or ERROR on error.                                                 */
+int get_name_counts(int kind, NameCount **names)
+{
+    const char *sql = (kind == COMPLETE_PLAYER) ? selectPlayerCounts : selectTournamentCounts;
+    return read_all_shards(sql, (void **)names, sizeof(NameCount), read_name_count);
+}
+
+static void read_name_id(sqlite3_stmt *stmt, void *row)
+{
+    NameId *name_id = row;
+    name_id->id = sqlite3_column_int(stmt, 0);
+    copy_column_text(name_id->name, stmt, 1, NAME_MAX);
+}
+
+static void read_header_row(sqlite3_stmt *stmt, void *row)
+{
+    GameHeader *header = row;
+    header->id = sqlite3_column_int(stmt, 0);
+    header->date_int = sqlite3_column_int(stmt, 1);
+    header->white_id = sqlite3_column_int(stmt, 2);
+    header->black_id = sqlite3_column_int(stmt, 3);
+    header->event_id = sqlite3_column_int(stmt, 4);
+    header->outcome = sqlite3_column_int(stmt, 5);
+}
+
+/* Retrieves the ids and names of the players (kind COMPLETE_PLAYER) or events of db into *names,
+ * an array allocated here and freed by the caller.
+ * Returns the number of names, or ERROR on error (db is left open).                               */
+int get_name_ids(sqlite3 *db, int kind, NameId **names)
+{
+    const char *sql = (kind == COMPLETE_PLAYER) ? selectPlayerIds : selectEventIds;
+    return read_rows(db, sql, (void **)names, sizeof(NameId), read_name_id);
+}
+
+/* Retrieves the headers of all games of db into *headers, an array allocated here and freed by
+ * the caller, in id order.
+ * Returns the number of games, or ERROR on error (db is left open).                               */
+int get_game_headers(sqlite3 *db, GameHeader **headers)
+{
+    return read_rows(db, selectGameHeaders, (void **)headers, sizeof(GameHeader), read_header_row);
+}
+
+/* Retrieves the smallest and largest game id in the database.
+ * Returns TRUE on success, FALSE on error or if there are no games.                               */
+int get_id_range(int *min_id, int *max_id)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    int status, found;
+
+    if (!open_database_conn(&db))
         return FALSE;
 
-    // commits transaction...
-    if (!do_statement(db, NULL, NULL, NULL, TRUE,
-                      commitTransaction, NULL))
+    status = sqlite3_prepare_v2(db, selectIdRange, -1, &stmt, 0);
+    if (is_statement_error(&db, &stmt, status, FALSE))
         return FALSE;
 
-    // closing database...
+    status = sqlite3_step(stmt);
+    found = (status == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL);
+    if (found) {
+        *min_id = sqlite3_column_int(stmt, 0);
+        *max_id = sqlite3_column_int(stmt, 1);
+    }
+
+    sqlite3_finalize(stmt);
     sqlite3_close(db);
-    return TRUE;
+    return found;
 }
 
-/* Retrieves a simplified (unsorted) list of all chess games in the database.
- * on success the number of elements retrieved is returned, on error 0 (FALSE)
- * is returned.                                                                                    */
-int get_unsorted_list(SampleInfo arr_sample[])
+/* Retrieves all games (including moves) with from_id <= id <= to_id, ordered by id, through
+ * the open connection db. If search_word is not NULL, only games matching it (as in search_data)
+ * are retrieved. games must have room for to_id - from_id + 1 games.
+ * On success the number of games retrieved is returned, on error ERROR (-1). The connection
+ * is left open either way.                                                                        */
+int get_games_in_range(sqlite3 *db, GameInfo games[], int from_id, int to_id, const char search_word[])
 {
-    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt, *moves_stmt;
+    int status, count = 0, return_code;
+
+    status = sqlite3_prepare_v2(db, selectGamesInRange, -1, &stmt, 0);
+    if (status != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return ERROR;
+    }
+
+    status = sqlite3_prepare_v2(db, selectSingleMovesById, -1, &moves_stmt, 0);
+    if (status != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return ERROR;
+    }
 
-    return do_statement(db, arr_sample, NULL, NULL, FALSE, selectAll, NULL);
+    sqlite3_bind_int(stmt, 1, from_id);
+    sqlite3_bind_int(stmt, 2, to_id);
+    if (search_word != NULL)
+        sqlite3_bind_text(stmt, 3, search_word, -1, SQLITE_TRANSIENT);
+
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW && count <= to_id - from_id) {
+        GameInfo *game = &games[count];
+        if (!read_game_row(stmt, game) ||
+            (!game->game_moves.packed && !read_single_moves(db, moves_stmt, &game->game_moves))) {
+            status = SQLITE_ERROR;
+            break;
+        }
+        count++;
+    }
+
+    return_code = (status == SQLITE_DONE) ? count : ERROR;
+    if (status != SQLITE_DONE && status != SQLITE_ERROR)
+        eprintf("Failed to execute statement step: %s\n", sqlite3_errmsg(db));
+
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(moves_stmt);
+    return return_code;
 }
+/* ********** BATCHED FETCH **********
+ * get_games_by_ids reads the headers of any number of games with one query per database, the ids
+ * bound as one JSON array. The moves are only read when get_batch_moves first asks for them, then
+ * for all games of the batch at once: one query per database joining single_move, ordered by
+ * game id, so the rows are merged into the (id ordered) batch in one pass.                        */
 
-/* Retrieves a simplified list of all chess games in the database sorted by either,
- * name, white_name, black_name or date.
- * on success the number of elements retrieved is returned, on error 0 (FALSE)
- * is returned.                                                                                    */
-int get_sorted_list(SampleInfo arr_sample[], int column)
+static int compare_ids(const void *a, const void *b)
 {
-    sqlite3 *db = NULL;
+    int id1 = *(const int *)a, id2 = *(const int *)b;
+    return (id1 > id2) - (id1 < id2);
+}
 
-    switch (column) {
-        case 1:
-            return do_statement(db, arr_sample, NULL, NULL, FALSE,
-                                selectAllOrderByName, NULL);
-        case 2:
-            return do_statement(db, arr_sample, NULL, NULL, FALSE,
-                                selectAllOrderByWhiteName, NULL);
-        case 3:
-            return do_statement(db, arr_sample, NULL, NULL, FALSE,
-                                selectAllOrderByBlackName, NULL);
-        case 4:
-            return do_statement(db, arr_sample, NULL, NULL, FALSE,
-                                selectAllOrderByDate, NULL);
-        default:
-            eprintf("ERROR: invalid column got through first check.\n");
-            return FALSE;
+/* Prepares sql on a new read only connection db to the database of the games ids (all of one
+ * database) and binds the ids to its parameter.
+ * Returns TRUE on success and FALSE on error (db is closed).                                      */
+static int prepare_batch_query(const char *sql, const int ids[], int count, sqlite3 **db, sqlite3_stmt **stmt)
+{
+    char *json = malloc((size_t)count * 12 + 3);
+    int length = 0, status;
+
+    if (json == NULL) {
+        eprintf("ERROR: could not allocate memory for the game ids...\n");
+        return FALSE;
+    }
+    json[length++] = '[';
+    for (int i = 0; i < count; i++)
+        length += sprintf(json + length, (i > 0) ? ",%d" : "%d", ids[i]);
+    json[length++] = ']';
+    json[length] = '\0';
+
+    route_by_id(ids[0]);
+    if (!open_database_readonly(db)) {
+        free(json);
+        return FALSE;
+    }
+
+    status = sqlite3_prepare_v2(*db, sql, -1, stmt, 0);
+    if (status == SQLITE_OK)
+        status = sqlite3_bind_text(*stmt, 1, json, length, SQLITE_TRANSIENT);
+    free(json);
+    if (status != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(*db));
+        sqlite3_finalize(*stmt);
+        sqlite3_close(*db);
+        return FALSE;
     }
+    return TRUE;
 }
 
-/* Gets a data from the database by id. If an error was encountered 0 (FALSE)
- * is returned, TRUE is returned if everything went accordingly and the data
- * information was stored in 'data', FALSE, otherwise.                                             */
-int get_game_by_id(GameInfo *data)
+/* Appends the headers of the games ids (sorted, all of one database) to batch.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int read_batch_headers(GameBatch *batch, const int ids[], int count)
 {
     sqlite3 *db;
     sqlite3_stmt *stmt;
-    int status, moves_num;
+    int status, last = batch->num_of_games + count;
 
-    if(!open_database_conn(&db))
+    if (!prepare_batch_query(selectGameHeadersByIds, ids, count, &db, &stmt))
         return FALSE;
-    printf("INFO: database opened...\n");
 
-    // begin transaction... all or nothing...
-    if (!do_statement(db, NULL, NULL, NULL, FALSE,
-                      beginTransaction, NULL))
-        return FALSE;
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW && batch->num_of_games < last)
+        read_game_header(stmt, &batch->games[batch->num_of_games++]);
 
-    // retrieving game by id...
-    if (!do_statement(db, NULL, data, NULL, TRUE,
-                      selectGameById, "%d", data->game_id))
-        return FALSE;
+    if (status != SQLITE_ROW && status != SQLITE_DONE)
+        eprintf("Failed to execute statement step: %s\n", sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return status == SQLITE_ROW || status == SQLITE_DONE;
+}
 
-    // retrieving all moves related to game via moves_id...
-    if (!do_statement(db, NULL, NULL, &data->game_moves, TRUE,
-                      selectSingleMovesById, "%d", data->game_moves.moves_id))
-        return FALSE;
+/* Reads the moves of the games from..to - 1 of batch (all of one database).
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int read_batch_moves(GameBatch *batch, int from, int to)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    int *ids = malloc(sizeof(int) * (to - from)), status, game = from;
 
-    // committing transaction...
-    if (!do_statement(db, NULL, NULL, NULL, TRUE,
-                      commitTransaction, NULL))
+    if (ids == NULL) {
+        eprintf("ERROR: could not allocate memory for the game ids...\n");
         return FALSE;
+    }
+    for (int i = from; i < to; i++)
+        ids[i - from] = batch->games[i].game_id;
+    if (!prepare_batch_query(selectMovesByGameIds, ids, to - from, &db, &stmt)) {
+        free(ids);
+        return FALSE;
+    }
+    free(ids);
+
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int game_id = sqlite3_column_int(stmt, 0), move;
+        GameMoves *game_moves;
+
+        while (game < to && batch->games[game].game_id < game_id)
+            game++;
+        if (game == to)
+            break;
+        game_moves = &batch->games[game].game_moves;
+
+        // one row per packed game, one per single move otherwise...
+        game_moves->packed = sqlite3_column_type(stmt, 1) != SQLITE_NULL;
+        if (game_moves->packed) {
+            if (!decode_game_moves(sqlite3_column_blob(stmt, 1), sqlite3_column_bytes(stmt, 1), game_moves)) {
+                eprintf("ERROR: packed moves of game id(%d) are corrupt...\n", game_id);
+                status = SQLITE_ERROR;
+                break;
+            }
+        }
+        else if ((move = sqlite3_column_int(stmt, 3)) >= 1 && move <= MOVES_MAX) {
+            copy_column_text(game_moves->moves[move - 1][WHITE_PLAYER], stmt, 4, S_MOVE_MAX);
+            copy_column_text(game_moves->moves[move - 1][BLACK_PLAYER], stmt, 5, S_MOVE_MAX);
+        }
+        load_checkpoints(game_moves, sqlite3_column_blob(stmt, 2), sqlite3_column_bytes(stmt, 2));
+    }
 
-    // closes...
+    if (status != SQLITE_ROW && status != SQLITE_DONE && status != SQLITE_ERROR)
+        eprintf("Failed to execute statement step: %s\n", sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
     sqlite3_close(db);
-    printf("INFO: data retrieved (database - get_game_by_id...\n");
-    return TRUE;
+    return status == SQLITE_ROW || status == SQLITE_DONE;
 }
 
+/* Retrieves the headers (everything but the moves) of the games with the count ids game_ids into
+ * batch, sorted by id. Ids of games that do not exist are skipped, the moves are read on the first
+ * get_batch_moves. The batch must be released with free_game_batch.
+ * On success the number of games retrieved is returned, on error ERROR (-1).                     */
+int get_games_by_ids(GameBatch *batch, const int game_ids[], int count)
+{
+    int *ids = malloc(sizeof(int) * (count + 1)), num_of_ids = 0;
+
+    memset(batch, 0, sizeof(GameBatch));
+    batch->games = calloc((size_t)count + 1, sizeof(GameInfo));
+    if (ids == NULL || batch->games == NULL) {
+        eprintf("ERROR: could not allocate memory for the games...\n");
+        free(ids);
+        free_game_batch(batch);
+        return ERROR;
+    }
+
+    memcpy(ids, game_ids, sizeof(int) * count);
+    qsort(ids, (size_t)count, sizeof(int), compare_ids);
+    for (int i = 0; i < count; i++) {
+        if (num_of_ids == 0 || ids[num_of_ids - 1] != ids[i])
+            ids[num_of_ids++] = ids[i];
+    }
+
+    // the shards hold ascending id spans, so the batch stays in id order...
+    for (int from = 0, to; from < num_of_ids; from = to) {
+        for (to = from + 1; to < num_of_ids && SHARD_OF_ID(ids[to]) == SHARD_OF_ID(ids[from]); to++)
+            ;
+        if (!read_batch_headers(batch, ids + from, to - from)) {
+            free(ids);
+            free_game_batch(batch);
+            return ERROR;
+        }
+    }
+
+    free(ids);
+    return batch->num_of_games;
+}
 
+/* Returns the moves of game index of batch, reading the moves of all games of the batch first if
+ * they have not been read yet. Returns NULL on error.                                             */
+GameMoves *get_batch_moves(GameBatch *batch, int index)
+{
+    if (index < 0 || index >= batch->num_of_games)
+        return NULL;
+
+    for (int from = 0, to; !batch->moves_loaded && from < batch->num_of_games; from = to) {
+        int shard = SHARD_OF_ID(batch->games[from].game_id);
+        for (to = from + 1; to < batch->num_of_games && SHARD_OF_ID(batch->games[to].game_id) == shard; to++)
+            ;
+        if (!read_batch_moves(batch, from, to))
+            return NULL;
+    }
+    batch->moves_loaded = TRUE;
+    return &batch->games[index].game_moves;
+}
 
+void free_game_batch(GameBatch *batch)
+{
+    free(batch->games);
+    memset(batch, 0, sizeof(GameBatch));
+}
@@ -5,17 +5,73 @@
 #ifndef CHESSDATABASE_DATABASE_H
 #define CHESSDATABASE_DATABASE_H
 
+#include <sqlite3.h>
+
 #include "helperFunctions.h"
+#include "tournament.h"
+#include "eco.h"
+#include "shard.h"
+#include "autocomplete.h"
+#include "lineindex.h"
+#include "headerstore.h"
+#include "similar.h"
+
+extern const char beginTransaction[];
+extern const char commitTransaction[];
 
+int is_exec_error(sqlite3 **db, int status, char **error_msg);
+int is_statement_error(sqlite3 **db, sqlite3_stmt **stmt, int status, int transaction_flag);
+int is_statement_step_error(sqlite3 **db, sqlite3_stmt **stmt, int status, int transaction_flag);
+void copy_column_text(char *dst, sqlite3_stmt *stmt, int col, int max_size);
+int do_statement(sqlite3 *db, SampleInfo arr_sample[], GameInfo *game, GameMoves *game_moves,
+                 int transaction_flag, const char *sql, const char *format, ...);
+void route_to_shard(int number);
+void route_by_id(int game_id);
+int route_by_game(const GameInfo *data);
+int open_database_path(const char *path, sqlite3 **db, int readonly);
+int open_database_readonly(sqlite3 **db);
+int attach_database(sqlite3 *db, const char *path, const char *schema);
+int index_game_lines(sqlite3 *db, int game_id, const GameMoves *game_moves, int move_count);
+int index_games_in_range(sqlite3 *db, int from_id, int to_id,
+                         int (*index_game)(sqlite3 *, int, const GameMoves *, int));
+int create_line_index(sqlite3 *db);
+int index_game_signature(sqlite3 *db, int game_id, const GameMoves *game_moves, int move_count);
+int create_similarity_index(sqlite3 *db);
+int get_game_signature(sqlite3 *db, int game_id, unsigned char signature[SIMILAR_SIGNATURE_SIZE]);
+int get_band_candidates(sqlite3 *db, const long long bands[], SignatureRow **rows);
+int get_line_postings(sqlite3 *db, long long hash, int **game_ids);
+int convert_dates(sqlite3 *db, int from_id, int to_id);
+int fill_checkpoints(sqlite3 *db, int from_id, int to_id);
+int create_schema(sqlite3 *db);
+int prepare_database_file(const char *path);
+int create_game_tables(sqlite3 *db);
 int prepare_database();
 int clear_tables();
+int insert_game_rows(sqlite3 *db, GameInfo *data, int id_floor);
 int insert_data(GameInfo *data);
 int update_data(GameInfo *data);
 int update_moves(GameInfo *data, int new_move_count);
-int search_data(SampleInfo arr_sample[], const char search_word[]);
+int search_data(SampleInfo arr_sample[], const char search_word[], int page);
 int delete_game(GameInfo *data);
-int get_unsorted_list(SampleInfo arr_sample[]);
-int get_sorted_list(SampleInfo arr_sample[], int column);
+int get_unsorted_list(SampleInfo arr_sample[], int page);
+int get_sorted_list(SampleInfo arr_sample[], int column, int page);
+int get_games_by_date(SampleInfo arr_sample[], int from_date, int to_date, int page);
+int get_list_window(ListRow rows[], int count, int column, const char *term, const ListRow *from, int backward);
 int get_game_by_id(GameInfo *data);
+int get_tournament_pairings(TournamentPairing **pairings, const char *name, const char *class,
+                            const char *group);
+int update_game_openings(const int game_ids[], const Opening *results[], int count);
+int delete_games_matching(const char *tournament, const char *player, int from_date, int to_date,
+                          BulkCounts *counts);
+int rename_in_games(int kind, const char *old_name, const char *new_name, BulkCounts *counts);
+int get_player_names(char (**names)[NAME_MAX]);
+int get_name_counts(int kind, NameCount **names);
+int get_name_ids(sqlite3 *db, int kind, NameId **names);
+int get_game_headers(sqlite3 *db, GameHeader **headers);
+int get_id_range(int *min_id, int *max_id);
+int get_games_in_range(sqlite3 *db, GameInfo games[], int from_id, int to_id, const char search_word[]);
+int get_games_by_ids(GameBatch *batch, const int game_ids[], int count);
+GameMoves *get_batch_moves(GameBatch *batch, int index);
+void free_game_batch(GameBatch *batch);
 
 #endif //CHESSDATABASE_DATABASE_H
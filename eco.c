@@ -0,0 +1,471 @@
+//
+// Created by flimsy on 3/4/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "eco.h"
+#include "database.h"
+#include "context.h"
+
+/* ********** OPENING TRIE **********
+ * The openings are stored as a trie of SAN moves: every node is the position after the moves on
+ * the path from the root, and nodes that start a named opening point into the opening table.
+ * A game is classified in one pass over its moves, following the trie as long as the moves match
+ * and keeping the deepest opening passed. The nodes live in one array, the children of a node as
+ * a linked list of siblings, so the whole trie is two allocations.
+ * The trie is built once (load_openings at startup) and only read afterwards, so it can be shared
+ * by any number of threads.                                                                       */
+
+#define NO_NODE -1
+#define NO_OPENING -1
+#define ECO_LINE_MAX 1024
+
+typedef struct OpeningNode {
+    char san[S_MOVE_MAX];
+    int first_child;
+    int next_sibling;
+    int opening;
+} OpeningNode;
+
+static OpeningNode *nodes = NULL;
+static int num_of_nodes = 0, nodes_capacity = 0;
+static Opening *openings = NULL;
+static int num_of_openings = 0, openings_capacity = 0;
+
+/* Built-in table, the main lines of the ECO volumes.                                              */
+static const char *builtin_openings[][3] = {
+        {"A00", "Polish Opening", "b4"},
+        {"A00", "Grob Opening", "g4"},
+        {"A00", "Van't Kruijs Opening", "e3"},
+        {"A01", "Nimzo-Larsen Attack", "b3"},
+        {"A02", "Bird Opening", "f4"},
+        {"A03", "Bird Opening: Dutch Variation", "f4 d5"},
+        {"A04", "Zukertort Opening", "Nf3"},
+        {"A05", "Zukertort Opening: Quiet System", "Nf3 Nf6"},
+        {"A06", "Zukertort Opening", "Nf3 d5"},
+        {"A07", "King's Indian Attack", "Nf3 d5 g3"},
+        {"A10", "English Opening", "c4"},
+        {"A13", "English Opening: Agincourt Defense", "c4 e6"},
+        {"A15", "English Opening: Anglo-Indian Defense", "c4 Nf6"},
+        {"A20", "English Opening: King's English Variation", "c4 e5"},
+        {"A30", "English Opening: Symmetrical Variation", "c4 c5"},
+        {"A40", "Queen's Pawn Game", "d4"},
+        {"A43", "Benoni Defense: Old Benoni", "d4 c5"},
+        {"A45", "Indian Defense", "d4 Nf6"},
+        {"A46", "Indian Defense: Knights Variation", "d4 Nf6 Nf3"},
+        {"A48", "East Indian Defense", "d4 Nf6 Nf3 g6"},
+        {"A50", "Indian Defense: Normal Variation", "d4 Nf6 c4"},
+        {"A51", "Budapest Defense", "d4 Nf6 c4 e5"},
+        {"A53", "Old Indian Defense", "d4 Nf6 c4 d6"},
+        {"A56", "Benoni Defense", "d4 Nf6 c4 c5"},
+        {"A57", "Benko Gambit", "d4 Nf6 c4 c5 d5 b5"},
+        {"A60", "Benoni Defense: Modern Variation", "d4 Nf6 c4 c5 d5 e6"},
+        {"A80", "Dutch Defense", "d4 f5"},
+        {"B00", "Nimzowitsch Defense", "e4 Nc6"},
+        {"B00", "Owen Defense", "e4 b6"},
+        {"B01", "Scandinavian Defense", "e4 d5"},
+        {"B02", "Alekhine Defense", "e4 Nf6"},
+        {"B06", "Modern Defense", "e4 g6"},
+        {"B07", "Pirc Defense", "e4 d6 d4 Nf6"},
+        {"B10", "Caro-Kann Defense", "e4 c6"},
+        {"B12", "Caro-Kann Defense: Advance Variation", "e4 c6 d4 d5 e5"},
+        {"B13", "Caro-Kann Defense: Exchange Variation", "e4 c6 d4 d5 exd5 cxd5"},
+        {"B15", "Caro-Kann Defense", "e4 c6 d4 d5 Nc3"},
+        {"B18", "Caro-Kann Defense: Classical Variation", "e4 c6 d4 d5 Nc3 dxe4 Nxe4 Bf5"},
+        {"B20", "Sicilian Defense", "e4 c5"},
+        {"B21", "Sicilian Defense: Smith-Morra Gambit", "e4 c5 d4"},
+        {"B22", "Sicilian Defense: Alapin Variation", "e4 c5 c3"},
+        {"B23", "Sicilian Defense: Closed", "e4 c5 Nc3"},
+        {"B27", "Sicilian Defense", "e4 c5 Nf3"},
+        {"B30", "Sicilian Defense: Old Sicilian", "e4 c5 Nf3 Nc6"},
+        {"B33", "Sicilian Defense: Open", "e4 c5 Nf3 Nc6 d4 cxd4 Nxd4 Nf6"},
+        {"B40", "Sicilian Defense: French Variation", "e4 c5 Nf3 e6"},
+        {"B50", "Sicilian Defense: Modern Variations", "e4 c5 Nf3 d6"},
+        {"B54", "Sicilian Defense: Open", "e4 c5 Nf3 d6 d4 cxd4 Nxd4"},
+        {"B56", "Sicilian Defense: Open", "e4 c5 Nf3 d6 d4 cxd4 Nxd4 Nf6 Nc3"},
+        {"B70", "Sicilian Defense: Dragon Variation", "e4 c5 Nf3 d6 d4 cxd4 Nxd4 Nf6 Nc3 g6"},
+        {"B80", "Sicilian Defense: Scheveningen Variation", "e4 c5 Nf3 d6 d4 cxd4 Nxd4 Nf6 Nc3 e6"},
+        {"B90", "Sicilian Defense: Najdorf Variation", "e4 c5 Nf3 d6 d4 cxd4 Nxd4 Nf6 Nc3 a6"},
+        {"C00", "French Defense", "e4 e6"},
+        {"C01", "French Defense: Exchange Variation", "e4 e6 d4 d5 exd5"},
+        {"C02", "French Defense: Advance Variation", "e4 e6 d4 d5 e5"},
+        {"C03", "French Defense: Tarrasch Variation", "e4 e6 d4 d5 Nd2"},
+        {"C10", "French Defense: Paulsen Variation", "e4 e6 d4 d5 Nc3"},
+        {"C11", "French Defense: Classical Variation", "e4 e6 d4 d5 Nc3 Nf6"},
+        {"C15", "French Defense: Winawer Variation", "e4 e6 d4 d5 Nc3 Bb4"},
+        {"C20", "King's Pawn Game", "e4 e5"},
+        {"C21", "Center Game", "e4 e5 d4 exd4"},
+        {"C23", "Bishop's Opening", "e4 e5 Bc4"},
+        {"C25", "Vienna Game", "e4 e5 Nc3"},
+        {"C30", "King's Gambit", "e4 e5 f4"},
+        {"C33", "King's Gambit Accepted", "e4 e5 f4 exf4"},
+        {"C40", "King's Knight Opening", "e4 e5 Nf3"},
+        {"C41", "Philidor Defense", "e4 e5 Nf3 d6"},
+        {"C42", "Petrov's Defense", "e4 e5 Nf3 Nf6"},
+        {"C44", "King's Pawn Game: Tayler Opening", "e4 e5 Nf3 Nc6"},
+        {"C44", "Scotch Game", "e4 e5 Nf3 Nc6 d4"},
+        {"C45", "Scotch Game", "e4 e5 Nf3 Nc6 d4 exd4 Nxd4"},
+        {"C46", "Three Knights Opening", "e4 e5 Nf3 Nc6 Nc3"},
+        {"C47", "Four Knights Game", "e4 e5 Nf3 Nc6 Nc3 Nf6"},
+        {"C50", "Italian Game", "e4 e5 Nf3 Nc6 Bc4"},
+        {"C50", "Italian Game: Giuoco Piano", "e4 e5 Nf3 Nc6 Bc4 Bc5"},
+        {"C51", "Italian Game: Evans Gambit", "e4 e5 Nf3 Nc6 Bc4 Bc5 b4"},
+        {"C53", "Italian Game: Classical Variation", "e4 e5 Nf3 Nc6 Bc4 Bc5 c3"},
+        {"C55", "Italian Game: Two Knights Defense", "e4 e5 Nf3 Nc6 Bc4 Nf6"},
+        {"C60", "Ruy Lopez", "e4 e5 Nf3 Nc6 Bb5"},
+        {"C65", "Ruy Lopez: Berlin Defense", "e4 e5 Nf3 Nc6 Bb5 Nf6"},
+        {"C68", "Ruy Lopez: Morphy Defense", "e4 e5 Nf3 Nc6 Bb5 a6"},
+        {"C68", "Ruy Lopez: Exchange Variation", "e4 e5 Nf3 Nc6 Bb5 a6 Bxc6"},
+        {"C70", "Ruy Lopez: Morphy Defense", "e4 e5 Nf3 Nc6 Bb5 a6 Ba4"},
+        {"C78", "Ruy Lopez: Morphy Defense", "e4 e5 Nf3 Nc6 Bb5 a6 Ba4 Nf6 O-O"},
+        {"C84", "Ruy Lopez: Closed", "e4 e5 Nf3 Nc6 Bb5 a6 Ba4 Nf6 O-O Be7"},
+        {"C88", "Ruy Lopez: Closed", "e4 e5 Nf3 Nc6 Bb5 a6 Ba4 Nf6 O-O Be7 Re1 b5 Bb3"},
+        {"D00", "Queen's Pawn Game", "d4 d5"},
+        {"D02", "Queen's Pawn Game", "d4 d5 Nf3"},
+        {"D06", "Queen's Gambit", "d4 d5 c4"},
+        {"D07", "Queen's Gambit Declined: Chigorin Defense", "d4 d5 c4 Nc6"},
+        {"D10", "Slav Defense", "d4 d5 c4 c6"},
+        {"D20", "Queen's Gambit Accepted", "d4 d5 c4 dxc4"},
+        {"D30", "Queen's Gambit Declined", "d4 d5 c4 e6"},
+        {"D35", "Queen's Gambit Declined: Normal Defense", "d4 d5 c4 e6 Nc3 Nf6"},
+        {"D37", "Queen's Gambit Declined: Three Knights Variation", "d4 d5 c4 e6 Nc3 Nf6 Nf3"},
+        {"D43", "Semi-Slav Defense", "d4 d5 c4 c6 Nf3 Nf6 Nc3 e6"},
+        {"D80", "Grunfeld Defense", "d4 Nf6 c4 g6 Nc3 d5"},
+        {"D85", "Grunfeld Defense: Exchange Variation", "d4 Nf6 c4 g6 Nc3 d5 cxd5 Nxd5"},
+        {"E00", "Indian Defense", "d4 Nf6 c4 e6"},
+        {"E01", "Catalan Opening", "d4 Nf6 c4 e6 g3"},
+        {"E10", "Indian Defense", "d4 Nf6 c4 e6 Nf3"},
+        {"E11", "Bogo-Indian Defense", "d4 Nf6 c4 e6 Nf3 Bb4+"},
+        {"E12", "Queen's Indian Defense", "d4 Nf6 c4 e6 Nf3 b6"},
+        {"E20", "Nimzo-Indian Defense", "d4 Nf6 c4 e6 Nc3 Bb4"},
+        {"E60", "King's Indian Defense", "d4 Nf6 c4 g6"},
+        {"E61", "King's Indian Defense", "d4 Nf6 c4 g6 Nc3 Bg7"},
+        {"E70", "King's Indian Defense: Normal Variation", "d4 Nf6 c4 g6 Nc3 Bg7 e4 d6"},
+        {"E90", "King's Indian Defense: Normal Variation", "d4 Nf6 c4 g6 Nc3 Bg7 e4 d6 Nf3"},
+};
+
+/* Copies the move san to normalized without check/mate marks and annotations, and with
+ * castling written with the letter O. Returns FALSE if san is too long to be a move.              */
+static int normalize_san(const char *san, char normalized[S_MOVE_MAX])
+{
+    int len = 0;
+
+    for (const char *c = san; *c != '\0'; c++) {
+        if (*c == '+' || *c == '#' || *c == '!' || *c == '?')
+            continue;
+        if (len == S_MOVE_MAX - 1)
+            return FALSE;
+        normalized[len++] = (*c == '0') ? 'O' : *c;
+    }
+    normalized[len] = '\0';
+    return len > 0;
+}
+
+/* Returns the child of node reached by the (normalized) move san, or NO_NODE.                     */
+static int find_child(int node, const char *san)
+{
+    int child = nodes[node].first_child;
+    while (child != NO_NODE && strcmp(nodes[child].san, san) != 0)
+        child = nodes[child].next_sibling;
+    return child;
+}
+
+/* Appends a node for the move san, returns its index or NO_NODE if out of memory.                 */
+static int new_node(const char *san)
+{
+    if (num_of_nodes == nodes_capacity) {
+        int capacity = (nodes_capacity) ? nodes_capacity * 2 : 512;
+        OpeningNode *grown = realloc(nodes, sizeof(OpeningNode) * capacity);
+        if (grown == NULL)
+            return NO_NODE;
+        nodes = grown;
+        nodes_capacity = capacity;
+    }
+    strcpy(nodes[num_of_nodes].san, san);
+    nodes[num_of_nodes].first_child = NO_NODE;
+    nodes[num_of_nodes].next_sibling = NO_NODE;
+    nodes[num_of_nodes].opening = NO_OPENING;
+    return num_of_nodes++;
+}
+
+/* Adds the opening eco/name reached by moves (SAN, separated by spaces, move numbers allowed) to
+ * the trie. Returns TRUE on success, FALSE if the line is invalid or memory ran out.              */
+static int add_opening(const char *eco, const char *name, const char *moves)
+{
+    char line[ECO_LINE_MAX], san[S_MOVE_MAX];
+    int node = 0;
+
+    if (strlen(eco) != ECO_MAX - 1 || strlen(moves) >= ECO_LINE_MAX)
+        return FALSE;
+
+    strcpy(line, moves);
+    for (char *token = strtok(line, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n")) {
+        // skipping move numbers ("1." and "1...") or the number prefix of "1.e4"...
+        char *dot = strrchr(token, '.');
+        if (dot != NULL)
+            token = dot + 1;
+        if (*token == '\0')
+            continue;
+
+        if (!normalize_san(token, san))
+            return FALSE;
+
+        int child = find_child(node, san);
+        if (child == NO_NODE) {
+            if ((child = new_node(san)) == NO_NODE)
+                return FALSE;
+            nodes[child].next_sibling = nodes[node].first_child;
+            nodes[node].first_child = child;
+        }
+        node = child;
+    }
+
+    // the first opening of a line is kept...
+    if (node == 0 || nodes[node].opening != NO_OPENING)
+        return TRUE;
+
+    if (num_of_openings == openings_capacity) {
+        int capacity = (openings_capacity) ? openings_capacity * 2 : 256;
+        Opening *grown = realloc(openings, sizeof(Opening) * capacity);
+        if (grown == NULL)
+            return FALSE;
+        openings = grown;
+        openings_capacity = capacity;
+    }
+    strcpy(openings[num_of_openings].eco, eco);
+    snprintf(openings[num_of_openings].name, OPENING_MAX, "%s", name);
+    nodes[node].opening = num_of_openings++;
+    return TRUE;
+}
+
+/* Frees the opening trie and table.                                                               */
+void free_openings()
+{
+    free(nodes);
+    free(openings);
+    nodes = NULL;
+    openings = NULL;
+    num_of_nodes = nodes_capacity = num_of_openings = openings_capacity = 0;
+}
+
+/* Builds the opening trie from the file path (lines: eco<TAB>name<TAB>moves, a header line is
+ * skipped), or from the built-in table if the file does not exist. The first chessdb_open calls
+ * it with ECO_FILE, calling it again while handles are open is not safe.
+ * Returns the number of openings loaded, or FALSE on error.                                        */
+int load_openings(const char *path)
+{
+    FILE *file = (path != NULL) ? fopen(path, "r") : NULL;
+    char line[ECO_LINE_MAX];
+    int line_number = 0;
+
+    free_openings();
+    if (new_node("") == NO_NODE)
+        return FALSE;
+
+    if (file == NULL) {
+        for (size_t i = 0; i < sizeof(builtin_openings) / sizeof(builtin_openings[0]); i++) {
+            if (!add_opening(builtin_openings[i][0], builtin_openings[i][1], builtin_openings[i][2])) {
+                free_openings();
+                return FALSE;
+            }
+        }
+        return num_of_openings;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *eco = strtok(line, "\t"), *name = strtok(NULL, "\t"), *moves = strtok(NULL, "\t\r\n");
+        line_number++;
+
+        // header and malformed lines are skipped...
+        if (eco == NULL || name == NULL || moves == NULL || eco[0] < 'A' || eco[0] > 'E') {
+            if (line_number > 1)
+                eprintf("WARNING: skipping line %d of %s...\n", line_number, path);
+            continue;
+        }
+        if (!add_opening(eco, name, moves))
+            eprintf("WARNING: skipping line %d of %s...\n", line_number, path);
+    }
+    fclose(file);
+
+    printf("INFO: loaded %d openings from %s...\n", num_of_openings, path);
+    return num_of_openings;
+}
+
+/* Returns the opening of the first move_count moves of game_moves (the longest known line the
+ * game follows), or NULL if the game does not start with a known opening.                         */
+const Opening *classify_opening(const GameMoves *game_moves, int move_count)
+{
+    char san[S_MOVE_MAX];
+    int node = 0, opening = NO_OPENING;
+
+    if (nodes == NULL)
+        return NULL;
+
+    for (int ply = 0; ply < move_count * 2; ply++) {
+        const char *move = game_moves->moves[ply / 2][ply % 2];
+        if (!normalize_san(move, san) || (node = find_child(node, san)) == NO_NODE)
+            break;
+        if (nodes[node].opening != NO_OPENING)
+            opening = nodes[node].opening;
+    }
+    return (opening != NO_OPENING) ? &openings[opening] : NULL;
+}
+
+/* Classifies the first move_count moves of game and stores the ECO code and opening name in game
+ * (empty strings if the opening is unknown).                                                      */
+void set_game_opening(GameInfo *game, int move_count)
+{
+    const Opening *opening = classify_opening(&game->game_moves, move_count);
+
+    strcpy(game->eco, (opening != NULL) ? opening->eco : "");
+    strcpy(game->opening, (opening != NULL) ? opening->name : "");
+}
+
+/* ********** BATCH RECLASSIFICATION **********
+ * Workers claim id chunks, read the games of a chunk through their own read only connection
+ * (decoding packed moves is where the time goes) and classify them. The results are written by
+ * the calling thread in one transaction once all workers are done, as SQLite has one writer.    */
+
+typedef struct ReclassifyJob {
+    pthread_mutex_t lock;
+    ChessDb *db;                // the database handle of the reclassification...
+    int min_id;
+    int num_of_chunks;
+    int next_chunk;
+    int error;
+    int *game_ids;              // per chunk RECLASSIFY_CHUNK_IDS slots, 0 if unused...
+    const Opening **results;
+} ReclassifyJob;
+
+static void *reclassify_worker(void *arg)
+{
+    ReclassifyJob *job = arg;
+    GameInfo *games = malloc(sizeof(GameInfo) * RECLASSIFY_CHUNK_IDS);
+    sqlite3 *db = NULL;
+    int failed;
+
+    use_db(job->db);
+    failed = (games == NULL) || !open_database_readonly(&db);
+
+    while (!failed) {
+        int chunk;
+
+        pthread_mutex_lock(&job->lock);
+        chunk = (job->error) ? job->num_of_chunks : job->next_chunk++;
+        pthread_mutex_unlock(&job->lock);
+        if (chunk >= job->num_of_chunks)
+            break;
+
+        int from_id = job->min_id + chunk * RECLASSIFY_CHUNK_IDS;
+        int count = get_games_in_range(db, games, from_id, from_id + RECLASSIFY_CHUNK_IDS - 1, NULL);
+        if (count == ERROR) {
+            failed = TRUE;
+            break;
+        }
+
+        // every chunk has its own result slots, no locking needed...
+        for (int i = 0; i < count; i++) {
+            int slot = chunk * RECLASSIFY_CHUNK_IDS + i;
+            job->game_ids[slot] = games[i].game_id;
+            job->results[slot] = classify_opening(&games[i].game_moves, games[i].game_moves.move_number);
+        }
+    }
+
+    if (failed) {
+        pthread_mutex_lock(&job->lock);
+        job->error = TRUE;
+        pthread_mutex_unlock(&job->lock);
+    }
+    if (db != NULL)
+        sqlite3_close(db);
+    free(games);
+    return NULL;
+}
+
+/* Classifies every game of the routed database again using num_of_threads worker threads and
+ * stores the results. Adds the number of games classified to count.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int reclassify_shard(int num_of_threads, int *count)
+{
+    ReclassifyJob job;
+    pthread_t threads[RECLASSIFY_THREADS_MAX];
+    int min_id, max_id, started = 0, classified = 0;
+
+    if (!get_id_range(&min_id, &max_id))
+        return TRUE;
+
+    memset(&job, 0, sizeof(job));
+    pthread_mutex_init(&job.lock, NULL);
+    job.db = current_db();
+    job.min_id = min_id;
+    job.num_of_chunks = (max_id - min_id) / RECLASSIFY_CHUNK_IDS + 1;
+    job.game_ids = calloc((size_t)job.num_of_chunks * RECLASSIFY_CHUNK_IDS, sizeof(int));
+    job.results = calloc((size_t)job.num_of_chunks * RECLASSIFY_CHUNK_IDS, sizeof(Opening *));
+    job.error = (job.game_ids == NULL || job.results == NULL);
+
+    for (int i = 0; i < num_of_threads && !job.error; i++) {
+        if (pthread_create(&threads[i], NULL, reclassify_worker, &job) != 0) {
+            eprintf("ERROR: could not start reclassification thread...\n");
+            pthread_mutex_lock(&job.lock);
+            job.error = TRUE;
+            pthread_mutex_unlock(&job.lock);
+            break;
+        }
+        started++;
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    // compacting the used slots and writing them...
+    if (!job.error) {
+        for (int slot = 0; slot < job.num_of_chunks * RECLASSIFY_CHUNK_IDS; slot++) {
+            if (job.game_ids[slot] == 0)
+                continue;
+            job.game_ids[classified] = job.game_ids[slot];
+            job.results[classified] = job.results[slot];
+            classified++;
+        }
+        job.error = !update_game_openings(job.game_ids, job.results, classified);
+    }
+
+    *count += classified;
+    free(job.game_ids);
+    free(job.results);
+    pthread_mutex_destroy(&job.lock);
+    return !job.error;
+}
+
+/* Classifies every game in the database again (e.g. after loading a new opening table) using
+ * num_of_threads worker threads, and stores the results.
+ * Returns the number of games classified, or ERROR on error.                                      */
+int reclassify_games(int num_of_threads)
+{
+    struct timespec start, end;
+    int numbers[SHARDS_MAX + 1], num_of_shards, count = 0, success = TRUE;
+
+    if (num_of_threads < 1 || num_of_threads > RECLASSIFY_THREADS_MAX) {
+        eprintf("ERROR: number of threads must be between 1 and %d...\n", RECLASSIFY_THREADS_MAX);
+        return ERROR;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    num_of_shards = get_shard_numbers(numbers);
+    for (int i = 0; i < num_of_shards && success; i++) {
+        route_to_shard(numbers[i]);
+        success = reclassify_shard(num_of_threads, &count);
+    }
+    route_to_shard(0);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (success)
+        printf("INFO: classified %d games with %d thread(s) in %.3f s...\n", count, num_of_threads,
+               (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9);
+
+    return (success) ? count : ERROR;
+}
@@ -0,0 +1,28 @@
+//
+// Created by flimsy on 3/4/22.
+//
+
+#ifndef CHESSDATABASE_ECO_H
+#define CHESSDATABASE_ECO_H
+
+#include "helperFunctions.h"
+
+// Opening table loaded instead of the built-in one if it exists (lines: eco<TAB>name<TAB>moves).
+#define ECO_FILE "eco.tsv"
+
+// Size values.
+#define RECLASSIFY_CHUNK_IDS 256
+#define RECLASSIFY_THREADS_MAX 64
+
+typedef struct Opening {
+    char eco[ECO_MAX];
+    char name[OPENING_MAX];
+} Opening;
+
+int load_openings(const char *path);
+void free_openings();
+const Opening *classify_opening(const GameMoves *game_moves, int move_count);
+void set_game_opening(GameInfo *game, int move_count);
+int reclassify_games(int num_of_threads);
+
+#endif //CHESSDATABASE_ECO_H
@@ -0,0 +1,429 @@
+//
+// Created by flimsy on 3/2/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "database.h"
+#include "export.h"
+#include "context.h"
+
+/* ********** PARALLEL EXPORT **********
+ * The id range of the database is split into chunks of EXPORT_CHUNK_IDS ids. Worker threads
+ * claim chunks in order, read them through their own read only connection and format them into
+ * a private buffer. The calling thread writes the buffers to the file strictly in chunk order.
+ * A worker may only claim a chunk inside the reorder window (next chunk to write + window size),
+ * which bounds the memory held by formatted but unwritten chunks. Since chunk boundaries do not
+ * depend on the number of threads, the output is identical for any number of threads.            */
+
+typedef struct TextBuffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+    int failed;
+} TextBuffer;
+
+typedef struct ExportJob {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    ChessDb *db;            // the database handle of the export...
+    int format;
+    const char *search_word;
+    int min_id;
+    int num_of_chunks;
+    int next_chunk;         // next chunk to be claimed by a worker...
+    int next_to_write;      // next chunk to be written by the writer...
+    int window;
+    int error;
+    TextBuffer *slots;      // formatted chunks, chunk c in slot c % window...
+    int *ready;
+    long games;
+} ExportJob;
+
+/* ********** TEXT FORMATTING **********                                                           */
+
+static void append_text(TextBuffer *buffer, const char *text, size_t len)
+{
+    if (buffer->failed)
+        return;
+
+    if (buffer->size + len + 1 > buffer->capacity) {
+        size_t capacity = (buffer->capacity) ? buffer->capacity : 4096;
+        while (buffer->size + len + 1 > capacity)
+            capacity *= 2;
+        char *grown = realloc(buffer->data, capacity);
+        if (grown == NULL) {
+            buffer->failed = TRUE;
+            return;
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, text, len);
+    buffer->size += len;
+    buffer->data[buffer->size] = '\0';
+}
+
+static void append_string(TextBuffer *buffer, const char *text)
+{
+    append_text(buffer, text, strlen(text));
+}
+
+/* Returns value, or "?" for fields entered blank ('-') as PGN expects for unknown values.          */
+static const char *pgn_value(const char *value)
+{
+    return (strcmp(value, "-") == 0 || value[0] == '\0') ? "?" : value;
+}
+
+/* Appends a PGN tag pair, escaping '\' and '"' in the value.                                      */
+static void append_tag(TextBuffer *buffer, const char *tag, const char *value)
+{
+    append_string(buffer, "[");
+    append_string(buffer, tag);
+    append_string(buffer, " \"");
+    for (const char *c = value; *c != '\0'; c++) {
+        if (*c == '\\' || *c == '"')
+            append_text(buffer, "\\", 1);
+        append_text(buffer, c, 1);
+    }
+    append_string(buffer, "\"]\n");
+}
+
+/* Converts a stored date (see pack_date) to the PGN date format yyyy.mm.dd, with '?' for
+ * unknown parts.                                                                                  */
+void format_pgn_date(const char *date, char pgn_date[11])
+{
+    int packed = pack_date(date);
+    char part[12];
+
+    strcpy(pgn_date, "????.??.??");
+    if (packed <= 0)
+        return;
+
+    // (each part is formatted on its own and copied over the '?' of its width)...
+    snprintf(part, sizeof(part), "%04d", DATE_YEAR(packed) % 10000);
+    memcpy(pgn_date, part, 4);
+    if (DATE_MONTH(packed)) {
+        snprintf(part, sizeof(part), "%02d", DATE_MONTH(packed));
+        memcpy(pgn_date + 5, part, 2);
+    }
+    if (DATE_DAY(packed)) {
+        snprintf(part, sizeof(part), "%02d", DATE_DAY(packed));
+        memcpy(pgn_date + 8, part, 2);
+    }
+}
+
+static int is_draw_result(const char *result)
+{
+    return strcmp(result, "1/2") == 0 || strcmp(result, "0.5") == 0 ||
+           strcmp(result, "remis") == 0 || strcmp(result, "Remis") == 0;
+}
+
+/* Returns the PGN result (1-0, 0-1, 1/2-1/2 or *) of game.                                        */
+const char *pgn_result(const GameInfo *game)
+{
+    if (strcmp(game->white_result, "1") == 0 || strcmp(game->black_result, "0") == 0)
+        return "1-0";
+    if (strcmp(game->white_result, "0") == 0 || strcmp(game->black_result, "1") == 0)
+        return "0-1";
+    if (is_draw_result(game->white_result) || is_draw_result(game->black_result))
+        return "1/2-1/2";
+    return "*";
+}
+
+/* Appends game in PGN, movetext wrapped at 80 columns.                                            */
+static void append_pgn_game(TextBuffer *buffer, const GameInfo *game)
+{
+    char pgn_date[11], token[24];
+    int column = 0;
+
+    format_pgn_date(game->date, pgn_date);
+    append_tag(buffer, "Event", pgn_value(game->name));
+    append_tag(buffer, "Site", "?");
+    append_tag(buffer, "Date", pgn_date);
+    append_tag(buffer, "Round", pgn_value(game->game_number));
+    append_tag(buffer, "White", pgn_value(game->white_name));
+    append_tag(buffer, "Black", pgn_value(game->black_name));
+    append_tag(buffer, "Result", pgn_result(game));
+    if (strcmp(game->class, "-") != 0)
+        append_tag(buffer, "Class", game->class);
+    if (strcmp(game->group, "-") != 0)
+        append_tag(buffer, "Group", game->group);
+    if (game->eco[0] != '\0') {
+        append_tag(buffer, "ECO", game->eco);
+        append_tag(buffer, "Opening", game->opening);
+    }
+    append_string(buffer, "\n");
+
+    for (int ply = 0; ply <= game->game_moves.move_number * 2; ply++) {
+        const char *move = (ply < game->game_moves.move_number * 2)
+                           ? game->game_moves.moves[ply / 2][ply % 2] : NULL;
+        int len;
+
+        if (move != NULL && strcmp(move, "-") == 0)
+            continue;
+
+        if (move == NULL)
+            len = snprintf(token, sizeof(token), "%s", pgn_result(game));
+        else if (ply % 2 == 0)
+            len = snprintf(token, sizeof(token), "%d. %s", ply / 2 + 1, move);
+        else
+            len = snprintf(token, sizeof(token), "%s", move);
+
+        if (column > 0 && column + 1 + len > 80) {
+            append_string(buffer, "\n");
+            column = 0;
+        } else if (column > 0) {
+            append_string(buffer, " ");
+            column++;
+        }
+        append_text(buffer, token, (size_t)len);
+        column += len;
+    }
+    append_string(buffer, "\n\n");
+}
+
+/* Appends a CSV field, quoted if it contains a separator, quote or line break.                    */
+static void append_csv_field(TextBuffer *buffer, const char *value, int last)
+{
+    if (strpbrk(value, ",\"\r\n") != NULL) {
+        append_string(buffer, "\"");
+        for (const char *c = value; *c != '\0'; c++) {
+            if (*c == '"')
+                append_text(buffer, "\"", 1);
+            append_text(buffer, c, 1);
+        }
+        append_string(buffer, "\"");
+    } else {
+        append_string(buffer, value);
+    }
+    append_string(buffer, (last) ? "\n" : ",");
+}
+
+/* Appends game as a CSV line, all moves in one space separated field.                             */
+static void append_csv_game(TextBuffer *buffer, const GameInfo *game)
+{
+    TextBuffer moves = {NULL, 0, 0, FALSE};
+    char id[12];
+
+    for (int ply = 0; ply < game->game_moves.move_number * 2; ply++) {
+        const char *move = game->game_moves.moves[ply / 2][ply % 2];
+        if (strcmp(move, "-") == 0)
+            continue;
+        if (moves.size > 0)
+            append_string(&moves, " ");
+        append_string(&moves, move);
+    }
+
+    snprintf(id, sizeof(id), "%d", game->game_id);
+    append_csv_field(buffer, id, FALSE);
+    append_csv_field(buffer, game->name, FALSE);
+    append_csv_field(buffer, game->class, FALSE);
+    append_csv_field(buffer, game->group, FALSE);
+    append_csv_field(buffer, game->game_number, FALSE);
+    append_csv_field(buffer, game->date, FALSE);
+    append_csv_field(buffer, game->white_name, FALSE);
+    append_csv_field(buffer, game->black_name, FALSE);
+    append_csv_field(buffer, game->white_result, FALSE);
+    append_csv_field(buffer, game->black_result, FALSE);
+    append_csv_field(buffer, game->eco, FALSE);
+    append_csv_field(buffer, game->opening, FALSE);
+    append_csv_field(buffer, (moves.data != NULL) ? moves.data : "", TRUE);
+
+    buffer->failed |= moves.failed;
+    free(moves.data);
+}
+
+/* ********** WORKERS **********                                                                   */
+
+static void *export_worker(void *arg)
+{
+    ExportJob *job = arg;
+    GameInfo *games = malloc(sizeof(GameInfo) * EXPORT_CHUNK_IDS);
+    sqlite3 *db = NULL;
+    int failed;
+
+    use_db(job->db);
+    failed = (games == NULL) || !open_database_readonly(&db);
+
+    while (TRUE) {
+        int chunk;
+
+        pthread_mutex_lock(&job->lock);
+        while (!job->error && !failed && job->next_chunk < job->num_of_chunks &&
+               job->next_chunk >= job->next_to_write + job->window)
+            pthread_cond_wait(&job->changed, &job->lock);
+
+        if (failed)
+            job->error = TRUE;
+        if (job->error || job->next_chunk >= job->num_of_chunks) {
+            pthread_cond_broadcast(&job->changed);
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        chunk = job->next_chunk++;
+        pthread_mutex_unlock(&job->lock);
+
+        // reading and formatting outside of the lock...
+        TextBuffer buffer = {NULL, 0, 0, FALSE};
+        int from_id = job->min_id + chunk * EXPORT_CHUNK_IDS;
+        int count = get_games_in_range(db, games, from_id, from_id + EXPORT_CHUNK_IDS - 1, job->search_word);
+
+        for (int i = 0; i < count; i++) {
+            if (job->format == FORMAT_PGN)
+                append_pgn_game(&buffer, &games[i]);
+            else
+                append_csv_game(&buffer, &games[i]);
+        }
+        failed = (count == ERROR || buffer.failed);
+
+        pthread_mutex_lock(&job->lock);
+        job->slots[chunk % job->window] = buffer;
+        job->ready[chunk % job->window] = TRUE;
+        job->games += (count > 0) ? count : 0;
+        pthread_cond_broadcast(&job->changed);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    if (db != NULL)
+        sqlite3_close(db);
+    free(games);
+    return NULL;
+}
+
+static double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Exports the games of the routed database (matching search_word) to file with num_of_threads
+ * worker threads. Adds the number of games written to games.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int export_shard(FILE *file, const char *path, int format, const char *search_word,
+                        int num_of_threads, long *games)
+{
+    ExportJob job;
+    pthread_t threads[EXPORT_THREADS_MAX];
+    int min_id, max_id, started = 0;
+
+    if (!get_id_range(&min_id, &max_id))
+        return TRUE;
+
+    memset(&job, 0, sizeof(job));
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+    job.db = current_db();
+    job.format = format;
+    job.search_word = search_word;
+    job.min_id = min_id;
+    job.num_of_chunks = (max_id - min_id) / EXPORT_CHUNK_IDS + 1;
+    job.window = num_of_threads * EXPORT_WINDOW_PER_THREAD;
+    job.slots = calloc((size_t)job.window, sizeof(TextBuffer));
+    job.ready = calloc((size_t)job.window, sizeof(int));
+    job.error = (job.slots == NULL || job.ready == NULL);
+
+    for (int i = 0; i < num_of_threads && !job.error; i++) {
+        if (pthread_create(&threads[i], NULL, export_worker, &job) != 0) {
+            eprintf("ERROR: could not start export thread...\n");
+            pthread_mutex_lock(&job.lock);
+            job.error = TRUE;
+            pthread_cond_broadcast(&job.changed);
+            pthread_mutex_unlock(&job.lock);
+            break;
+        }
+        started++;
+    }
+
+    // writing chunks in order as they become ready...
+    for (int chunk = 0; chunk < job.num_of_chunks; chunk++) {
+        TextBuffer buffer;
+
+        pthread_mutex_lock(&job.lock);
+        while (!job.error && !job.ready[chunk % job.window])
+            pthread_cond_wait(&job.changed, &job.lock);
+        if (job.error) {
+            pthread_mutex_unlock(&job.lock);
+            break;
+        }
+        buffer = job.slots[chunk % job.window];
+        job.ready[chunk % job.window] = FALSE;
+        job.next_to_write = chunk + 1;
+        pthread_cond_broadcast(&job.changed);
+        pthread_mutex_unlock(&job.lock);
+
+        if (buffer.size > 0 && fwrite(buffer.data, 1, buffer.size, file) != buffer.size) {
+            eprintf("ERROR: could not write to %s...\n", path);
+            pthread_mutex_lock(&job.lock);
+            job.error = TRUE;
+            pthread_cond_broadcast(&job.changed);
+            pthread_mutex_unlock(&job.lock);
+        }
+        free(buffer.data);
+    }
+
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    // releasing chunks left behind after an error...
+    for (int i = 0; job.slots != NULL && i < job.window; i++) {
+        if (job.ready != NULL && job.ready[i])
+            free(job.slots[i].data);
+    }
+
+    *games += job.games;
+    free(job.slots);
+    free(job.ready);
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.changed);
+    return !job.error;
+}
+
+/* Exports all games (or the games matching search_word, a LIKE pattern, if not NULL) to path
+ * in format (FORMAT_PGN or FORMAT_CSV), ordered by id, using num_of_threads worker threads.
+ * Returns the number of games exported, or ERROR on error.                                        */
+int export_games(const char *path, int format, const char *search_word, int num_of_threads)
+{
+    struct timespec start;
+    int numbers[SHARDS_MAX + 1], num_of_shards, success = TRUE;
+    long games = 0;
+    FILE *file;
+
+    if (num_of_threads < 1 || num_of_threads > EXPORT_THREADS_MAX) {
+        eprintf("ERROR: number of threads must be between 1 and %d...\n", EXPORT_THREADS_MAX);
+        return ERROR;
+    }
+
+    if ((file = fopen(path, "w")) == NULL) {
+        eprintf("ERROR: cannot open %s for writing...\n", path);
+        return ERROR;
+    }
+
+    if (format == FORMAT_CSV)
+        fputs("id,name,class,group,game_number,date,white_name,black_name,white_result,black_result,eco,opening,moves\n", file);
+
+    // with sharding the shards are exported one after the other, in shard order...
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    num_of_shards = get_shard_numbers(numbers);
+    for (int i = 0; i < num_of_shards && success; i++) {
+        route_to_shard(numbers[i]);
+        success = export_shard(file, path, format, search_word, num_of_threads, &games);
+    }
+    route_to_shard(0);
+
+    if (fclose(file) != 0)
+        success = FALSE;
+
+    double seconds = elapsed_seconds(&start);
+    if (success)
+        printf("INFO: exported %ld games with %d thread(s) in %.3f s (%.0f games/s)...\n",
+               games, num_of_threads, seconds, (seconds > 0) ? (double)games / seconds : 0.0);
+
+    return (success) ? (int)games : ERROR;
+}
@@ -0,0 +1,23 @@
+//
+// Created by flimsy on 3/2/22.
+//
+
+#ifndef CHESSDATABASE_EXPORT_H
+#define CHESSDATABASE_EXPORT_H
+
+#include "helperFunctions.h"
+
+// Export formats.
+#define FORMAT_PGN 1
+#define FORMAT_CSV 2
+
+// Size values.
+#define EXPORT_CHUNK_IDS 256
+#define EXPORT_THREADS_MAX 64
+#define EXPORT_WINDOW_PER_THREAD 4
+
+int export_games(const char *path, int format, const char *search_word, int num_of_threads);
+void format_pgn_date(const char *date, char pgn_date[11]);
+const char *pgn_result(const GameInfo *game);
+
+#endif //CHESSDATABASE_EXPORT_H
@@ -0,0 +1,316 @@
+//
+// Created by flimsy on 3/11/22.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "fuzzy.h"
+#include "database.h"
+#include "cache.h"
+#include "context.h"
+
+/* ********** PLAYER NAME TRIGRAMS **********
+ * Player names are folded before comparing: lower case, accents removed ("Ø" -> "o", "ß" -> "ss"),
+ * Cyrillic transliterated and anything but letters and digits turned into word breaks. Every
+ * folded word is padded ("  word ") and cut into trigrams. A name is as similar to the query as
+ * the share of the query's trigrams it has, so the words of the name not in the query (first
+ * names) cost nothing. Transliterations of the same name share their start: "Nepomnyashchy"
+ * has 6 of its 14 trigrams in "Nepomniachtchi, Ian".
+ * The index holds every distinct white and black name with an inverted list of (trigram, name)
+ * postings sorted by trigram. A lookup only touches the postings of the query's trigrams and
+ * counts the shared trigrams per name, so it does not depend on the number of names that share
+ * nothing with the query. The index is built on the first lookup and again after the games have
+ * changed (data generation of the result cache), every database handle having its own index.     */
+
+#define TRIGRAMS_MAX (FOLDED_NAME_MAX * 2)
+
+typedef struct Posting {
+    unsigned int trigram;
+    int name;
+} Posting;
+
+/* U+00C0 to U+017F (Latin-1 Supplement and Latin Extended-A) without accents.                     */
+static const char *latin_fold[] = {
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i", "d", "n", "o",
+    "o", "o", "o", "o", "", "o", "u", "u", "u", "u", "y", "th", "ss", "a", "a", "a", "a", "a", "a",
+    "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i", "d", "n", "o", "o", "o", "o", "o", "", "o",
+    "u", "u", "u", "u", "y", "th", "y", "a", "a", "a", "a", "a", "a", "c", "c", "c", "c", "c", "c",
+    "c", "c", "d", "d", "d", "d", "e", "e", "e", "e", "e", "e", "e", "e", "e", "e", "g", "g", "g",
+    "g", "g", "g", "g", "g", "h", "h", "h", "h", "i", "i", "i", "i", "i", "i", "i", "i", "i", "i",
+    "ij", "ij", "j", "j", "k", "k", "k", "l", "l", "l", "l", "l", "l", "l", "l", "l", "l", "n",
+    "n", "n", "n", "n", "n", "n", "n", "n", "o", "o", "o", "o", "o", "o", "oe", "oe", "r", "r",
+    "r", "r", "r", "r", "s", "s", "s", "s", "s", "s", "s", "s", "t", "t", "t", "t", "t", "t", "u",
+    "u", "u", "u", "u", "u", "u", "u", "u", "u", "u", "u", "w", "w", "y", "y", "y", "z", "z", "z",
+    "z", "z", "z", "s"
+};
+
+/* U+0410 to U+042F (and the lower case U+0430 to U+044F) transliterated.                          */
+static const char *cyrillic_fold[] = {
+    "a", "b", "v", "g", "d", "e", "zh", "z", "i", "y", "k", "l", "m", "n", "o", "p",
+    "r", "s", "t", "u", "f", "kh", "ts", "ch", "sh", "shch", "", "y", "", "e", "yu", "ya"
+};
+
+/* Decodes the UTF-8 character at src into code_point.
+ * Returns the length of the character, or 0 if it is not valid UTF-8.                            */
+static int decode_utf8(const unsigned char *src, unsigned int *code_point)
+{
+    int length;
+
+    if (src[0] < 0x80) {
+        *code_point = src[0];
+        return 1;
+    }
+    if ((src[0] & 0xE0) == 0xC0)
+        length = 2, *code_point = src[0] & 0x1F;
+    else if ((src[0] & 0xF0) == 0xE0)
+        length = 3, *code_point = src[0] & 0x0F;
+    else if ((src[0] & 0xF8) == 0xF0)
+        length = 4, *code_point = src[0] & 0x07;
+    else
+        return 0;
+
+    for (int i = 1; i < length; i++) {
+        if ((src[i] & 0xC0) != 0x80)
+            return 0;
+        *code_point = (*code_point << 6) | (src[i] & 0x3F);
+    }
+    return length;
+}
+
+/* Folds name (UTF-8) into folded: lower case words of letters and digits separated by single
+ * spaces, accents removed and Cyrillic transliterated. Other scripts are kept as they are.        */
+void fold_name(const char *name, char folded[FOLDED_NAME_MAX])
+{
+    const unsigned char *src = (const unsigned char *)name;
+    int length = 0, word_break = FALSE;
+
+    while (*src != '\0') {
+        unsigned int code_point;
+        const char *replacement = NULL;
+        char ascii[2] = {0};
+        int size = decode_utf8(src, &code_point);
+
+        if (size == 0) {
+            size = 1;                                          // invalid byte, a word break...
+        } else if (code_point < 0x80 && isalnum((int)code_point)) {
+            ascii[0] = (char)tolower((int)code_point);
+            replacement = ascii;
+        } else if (code_point >= 0xC0 && code_point <= 0x17F) {
+            replacement = latin_fold[code_point - 0xC0];
+        } else if (code_point >= 0x410 && code_point <= 0x44F) {
+            replacement = cyrillic_fold[(code_point - 0x410) % 32];
+        } else if (code_point == 0x401 || code_point == 0x451) {
+            replacement = "e";                                 // Ё/ё...
+        } else if (code_point >= 0x80) {
+            // other scripts are copied as they are...
+            if (length + size + 1 < FOLDED_NAME_MAX) {
+                if (word_break && length > 0)
+                    folded[length++] = ' ';
+                memcpy(folded + length, src, (size_t)size);
+                length += size;
+                word_break = FALSE;
+            }
+            src += size;
+            continue;
+        }
+
+        if (replacement == NULL) {
+            word_break = TRUE;
+        } else if (*replacement != '\0' && length + (int)strlen(replacement) + 1 < FOLDED_NAME_MAX) {
+            if (word_break && length > 0)
+                folded[length++] = ' ';
+            strcpy(folded + length, replacement);
+            length += (int)strlen(replacement);
+            word_break = FALSE;
+        }
+        src += size;
+    }
+    folded[length] = '\0';
+}
+
+static int compare_trigrams(const void *a, const void *b)
+{
+    unsigned int t1 = *(const unsigned int *)a, t2 = *(const unsigned int *)b;
+    return (t1 > t2) - (t1 < t2);
+}
+
+/* Stores the distinct trigrams of the folded name in trigrams (TRIGRAMS_MAX) sorted.
+ * Returns the number of trigrams.                                                                 */
+static int get_trigrams(const char *name, unsigned int trigrams[])
+{
+    char folded[FOLDED_NAME_MAX];
+    int count = 0, distinct = 0;
+
+    fold_name(name, folded);
+    for (const char *word = folded; *word != '\0';) {
+        int length = (int)strcspn(word, " ");
+        unsigned char padded[FOLDED_NAME_MAX + 3];
+
+        padded[0] = padded[1] = ' ';
+        memcpy(padded + 2, word, (size_t)length);
+        padded[length + 2] = ' ';
+
+        for (int i = 0; i + 2 < length + 3 && count < TRIGRAMS_MAX; i++)
+            trigrams[count++] = (unsigned int)padded[i] << 16 | (unsigned int)padded[i + 1] << 8 | padded[i + 2];
+
+        word += length;
+        while (*word == ' ')
+            word++;
+    }
+
+    qsort(trigrams, (size_t)count, sizeof(unsigned int), compare_trigrams);
+    for (int i = 0; i < count; i++) {
+        if (distinct == 0 || trigrams[distinct - 1] != trigrams[i])
+            trigrams[distinct++] = trigrams[i];
+    }
+    return distinct;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+static int compare_postings(const void *a, const void *b)
+{
+    const Posting *p1 = a, *p2 = b;
+    if (p1->trigram != p2->trigram)
+        return (p1->trigram > p2->trigram) - (p1->trigram < p2->trigram);
+    return p1->name - p2->name;
+}
+
+/* Frees the player name index, it is built again on the next lookup.                              */
+void free_player_index()
+{
+    PlayerIndex *index = &current_db()->player_index;
+
+    free(index->names);
+    free(index->shared);
+    free(index->touched);
+    free(index->postings);
+    memset(index, 0, sizeof(PlayerIndex));
+}
+
+/* Builds the index over all distinct player names. Returns TRUE on success, FALSE on error.       */
+static int build_player_index(PlayerIndex *index)
+{
+    unsigned int trigrams[TRIGRAMS_MAX];
+    int count, distinct = 0, capacity;
+
+    free_player_index();
+    index->generation = get_data_generation();
+
+    if ((count = get_player_names(&index->names)) == ERROR)
+        return FALSE;
+
+    // the names of several shards may overlap...
+    qsort(index->names, (size_t)count, NAME_MAX, compare_names);
+    for (int i = 0; i < count; i++) {
+        if (distinct == 0 || strcmp(index->names[distinct - 1], index->names[i]) != 0)
+            memmove(index->names[distinct++], index->names[i], NAME_MAX);
+    }
+    index->num_of_names = distinct;
+
+    capacity = index->num_of_names * 8 + 1;
+    index->shared = calloc((size_t)index->num_of_names + 1, sizeof(int));
+    index->touched = malloc(sizeof(int) * (index->num_of_names + 1));
+    index->postings = malloc(sizeof(Posting) * capacity);
+    if (index->shared == NULL || index->touched == NULL || index->postings == NULL) {
+        eprintf("ERROR: could not allocate memory for the player index...\n");
+        free_player_index();
+        return FALSE;
+    }
+
+    for (int name = 0; name < index->num_of_names; name++) {
+        int num_of_trigrams = get_trigrams(index->names[name], trigrams);
+
+        if (index->num_of_postings + num_of_trigrams > capacity) {
+            Posting *grown = realloc(index->postings, sizeof(Posting) * (capacity * 2 + num_of_trigrams));
+            if (grown == NULL) {
+                eprintf("ERROR: could not allocate memory for the player index...\n");
+                free_player_index();
+                return FALSE;
+            }
+            index->postings = grown;
+            capacity = capacity * 2 + num_of_trigrams;
+        }
+
+        for (int i = 0; i < num_of_trigrams; i++)
+            index->postings[index->num_of_postings++] = (Posting){trigrams[i], name};
+    }
+    qsort(index->postings, (size_t)index->num_of_postings, sizeof(Posting), compare_postings);
+
+    index->built = TRUE;
+    return TRUE;
+}
+
+/* Returns the index of the first posting of trigram (or where it would be).                       */
+static int find_postings(const PlayerIndex *index, unsigned int trigram)
+{
+    int low = 0, high = index->num_of_postings;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (index->postings[middle].trigram < trigram)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/* Finds the player names most similar to query (at least FUZZY_THRESHOLD), ignoring case,
+ * accents and punctuation, and stores at most max_matches of them in matches, most similar first.
+ * Returns the number of matches, or ERROR on error.                                               */
+int find_similar_players(const char *query, PlayerMatch matches[], int max_matches)
+{
+    PlayerIndex *index = &current_db()->player_index;
+    unsigned int trigrams[TRIGRAMS_MAX];
+    int num_of_trigrams, num_of_touched = 0, count = 0;
+
+    if (!index->built || index->generation != get_data_generation()) {
+        if (!build_player_index(index))
+            return ERROR;
+    }
+
+    if ((num_of_trigrams = get_trigrams(query, trigrams)) == 0)
+        return 0;
+
+    // counting the shared trigrams of every name that has any...
+    for (int i = 0; i < num_of_trigrams; i++) {
+        for (int p = find_postings(index, trigrams[i]);
+             p < index->num_of_postings && index->postings[p].trigram == trigrams[i]; p++) {
+            if (index->shared[index->postings[p].name]++ == 0)
+                index->touched[num_of_touched++] = index->postings[p].name;
+        }
+    }
+
+    // keeping the best max_matches, most similar first...
+    for (int i = 0; i < num_of_touched; i++) {
+        int name = index->touched[i];
+        int shared = index->shared[name];
+        double similarity = (double)shared / num_of_trigrams;
+        int pos = count;
+
+        index->shared[name] = 0;
+        if (similarity < FUZZY_THRESHOLD)
+            continue;
+
+        while (pos > 0 && (matches[pos - 1].similarity < similarity ||
+                           (matches[pos - 1].similarity == similarity && strcmp(matches[pos - 1].name, index->names[name]) > 0)))
+            pos--;
+        if (pos >= max_matches)
+            continue;
+
+        memmove(&matches[pos + 1], &matches[pos],
+                sizeof(PlayerMatch) * ((count < max_matches) ? count - pos : count - pos - 1));
+        snprintf(matches[pos].name, NAME_MAX, "%s", index->names[name]);
+        matches[pos].similarity = similarity;
+        if (count < max_matches)
+            count++;
+    }
+    return count;
+}
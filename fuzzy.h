@@ -0,0 +1,38 @@
+//
+// Created by flimsy on 3/11/22.
+//
+
+#ifndef CHESSDATABASE_FUZZY_H
+#define CHESSDATABASE_FUZZY_H
+
+#include "helperFunctions.h"
+
+// Least similarity (trigrams of the query the name has / trigrams of the query) of a match.
+#define FUZZY_THRESHOLD 0.3
+
+// Size values.
+#define FOLDED_NAME_MAX (NAME_MAX * 4)
+#define FUZZY_MATCHES_MAX 20
+
+typedef struct PlayerMatch {
+    char name[NAME_MAX];
+    double similarity;
+} PlayerMatch;
+
+/* The player name index of one database handle (postings are private to fuzzy.c).                 */
+typedef struct PlayerIndex {
+    char (*names)[NAME_MAX];
+    int *shared;                // shared trigrams per name during a lookup...
+    int *touched;
+    int num_of_names;
+    struct Posting *postings;
+    int num_of_postings;
+    int built;
+    unsigned long generation;
+} PlayerIndex;
+
+void fold_name(const char *name, char folded[FOLDED_NAME_MAX]);
+int find_similar_players(const char *query, PlayerMatch matches[], int max_matches);
+void free_player_index();
+
+#endif //CHESSDATABASE_FUZZY_H
@@ -0,0 +1,560 @@
+//
+// Created by flimsy on 3/18/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "headerstore.h"
+#include "database.h"
+#include "cache.h"
+#include "context.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HEADER_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/* ********** HEADER STORE **********
+ * A copy of the game headers in memory, stored by column: ids, packed dates, white, black and
+ * tournament as codes into sorted name dictionaries, and the result as an OUTCOME_ byte. Built on
+ * the first filter and again after the games have changed (data generation of the result cache).
+ * A filter starts from a selection bitmap with a bit per game and lets every condition clear the
+ * bits of the games failing it, a block of 64 games (one bitmap word) at a time. Blocks already
+ * cleared are skipped, so the most selective conditions (the names) go first. The kernels compare
+ * 8 (AVX2) or 4 (SSE2) dates or codes, 32 or 16 results per instruction, the instruction set being
+ * chosen on the running CPU. Other CPUs and compilers use the scalar kernels.                     */
+
+#define BLOCK_GAMES 64
+
+/* Clear the bits of the games in blocks whose column value is outside [low, high].                */
+typedef void (*RangeKernel)(const int *column, int low, int high, uint64_t blocks[], int num_of_blocks);
+/* Clear the bits of the games in blocks where neither column is code.                             */
+typedef void (*EitherKernel)(const int *first, const int *second, int code, uint64_t blocks[], int num_of_blocks);
+/* Clear the bits of the games in blocks whose outcome is not in outcomes (OUTCOME_BIT set).       */
+typedef void (*OutcomeKernel)(const unsigned char *column, int outcomes, uint64_t blocks[], int num_of_blocks);
+
+typedef struct HeaderKernels {
+    const char *name;
+    RangeKernel range;
+    EitherKernel either;
+    OutcomeKernel outcome;
+} HeaderKernels;
+
+/* A name of one shard's player or event table, sorted into the dictionary.                        */
+typedef struct NameRef {
+    const char *name;
+    int shard;
+    int id;
+} NameRef;
+
+/* The rows read from one shard, names by the shard's own ids (mapped to dictionary codes).        */
+typedef struct ShardHeaders {
+    GameHeader *headers;
+    int num_of_headers;
+    NameId *names[2];
+    int num_of_names[2];
+    int *codes[2];
+    int max_ids[2];
+} ShardHeaders;
+
+static double elapsed_ms(const struct timespec *from)
+{
+    struct timespec to;
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    return (double)(to.tv_sec - from->tv_sec) * 1e3 + (double)(to.tv_nsec - from->tv_nsec) / 1e6;
+}
+
+static int count_bits(uint64_t bits)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(bits);
+#else
+    int count = 0;
+    for (; bits != 0; bits &= bits - 1)
+        count++;
+    return count;
+#endif
+}
+
+static int lowest_bit(uint64_t bits)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(bits);
+#else
+    int bit = 0;
+    for (; (bits & 1) == 0; bits >>= 1)
+        bit++;
+    return bit;
+#endif
+}
+
+/* ********** SCALAR KERNELS **********                                                            */
+
+static void range_scalar(const int *column, int low, int high, uint64_t blocks[], int num_of_blocks)
+{
+    uint32_t width = (uint32_t)high - (uint32_t)low;
+
+    for (int b = 0; b < num_of_blocks; b++) {
+        const int *values = column + b * BLOCK_GAMES;
+        uint64_t bits = 0;
+
+        if (blocks[b] == 0)
+            continue;
+        for (int i = 0; i < BLOCK_GAMES; i++)
+            bits |= (uint64_t)((uint32_t)values[i] - (uint32_t)low <= width) << i;
+        blocks[b] &= bits;
+    }
+}
+
+static void either_scalar(const int *first, const int *second, int code, uint64_t blocks[], int num_of_blocks)
+{
+    for (int b = 0; b < num_of_blocks; b++) {
+        const int *values1 = first + b * BLOCK_GAMES, *values2 = second + b * BLOCK_GAMES;
+        uint64_t bits = 0;
+
+        if (blocks[b] == 0)
+            continue;
+        for (int i = 0; i < BLOCK_GAMES; i++)
+            bits |= (uint64_t)(values1[i] == code || values2[i] == code) << i;
+        blocks[b] &= bits;
+    }
+}
+
+static void outcome_scalar(const unsigned char *column, int outcomes, uint64_t blocks[], int num_of_blocks)
+{
+    for (int b = 0; b < num_of_blocks; b++) {
+        const unsigned char *values = column + b * BLOCK_GAMES;
+        uint64_t bits = 0;
+
+        if (blocks[b] == 0)
+            continue;
+        for (int i = 0; i < BLOCK_GAMES; i++)
+            bits |= (uint64_t)((outcomes >> values[i]) & 1) << i;
+        blocks[b] &= bits;
+    }
+}
+
+static const HeaderKernels scalar_kernels = {"scalar", range_scalar, either_scalar, outcome_scalar};
+
+#ifdef HEADER_X86_KERNELS
+
+/* ********** SSE2 KERNELS **********                                                              */
+
+__attribute__((target("sse2")))
+static void range_sse2(const int *column, int low, int high, uint64_t blocks[], int num_of_blocks)
+{
+    const __m128i lows = _mm_set1_epi32(low), highs = _mm_set1_epi32(high);
+
+    for (int b = 0; b < num_of_blocks; b++) {
+        const int *values = column + b * BLOCK_GAMES;
+        uint64_t bits = 0;
+
+        if (blocks[b] == 0)
+            continue;
+        for (int i = 0; i < BLOCK_GAMES; i += 4) {
+            __m128i value = _mm_loadu_si128((const __m128i *)(values + i));
+            __m128i outside = _mm_or_si128(_mm_cmplt_epi32(value, lows), _mm_cmpgt_epi32(value, highs));
+            bits |= (uint64_t)(~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF) << i;
+        }
+        blocks[b] &= bits;
+    }
+}
+
+__attribute__((target("sse2")))
+static void either_sse2(const int *first, const int *second, int code, uint64_t blocks[], int num_of_blocks)
+{
+    const __m128i codes = _mm_set1_epi32(code);
+
+    for (int b = 0; b < num_of_blocks; b++) {
+        const int *values1 = first + b * BLOCK_GAMES, *values2 = second + b * BLOCK_GAMES;
+        uint64_t bits = 0;
+
+        if (blocks[b] == 0)
+            continue;
+        for (int i = 0; i < BLOCK_GAMES; i += 4) {
+            __m128i equal = _mm_or_si128(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(values1 + i)), codes),
+                                         _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(values2 + i)), codes));
+            bits |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(equal)) << i;
+        }
+        blocks[b] &= bits;
+    }
+}
+
+__attribute__((target("sse2")))
+static void outcome_sse2(const unsigned char *column, int outcomes, uint64_t blocks[], int num_of_blocks)
+{
+    for (int b = 0; b < num_of_blocks; b++) {
+        const unsigned char *values = column + b * BLOCK_GAMES;
+        uint64_t bits = 0;
+
+        if (blocks[b] == 0)
+            continue;
+        for (int i = 0; i < BLOCK_GAMES; i += 16) {
+            __m128i value = _mm_loadu_si128((const __m128i *)(values + i)), wanted = _mm_setzero_si128();
+
+            for (int outcome = OUTCOME_BLACK_WINS; outcome <= OUTCOME_UNKNOWN; outcome++) {
+                if (outcomes & OUTCOME_BIT(outcome))
+                    wanted = _mm_or_si128(wanted, _mm_cmpeq_epi8(value, _mm_set1_epi8((char)outcome)));
+            }
+            bits |= (uint64_t)(unsigned)_mm_movemask_epi8(wanted) << i;
+        }
+        blocks[b] &= bits;
+    }
+}
+
+static const HeaderKernels sse2_kernels = {"sse2", range_sse2, either_sse2, outcome_sse2};
+
+/* ********** AVX2 KERNELS **********                                                              */
+
+__attribute__((target("avx2")))
+static void range_avx2(const int *column, int low, int high, uint64_t blocks[], int num_of_blocks)
+{
+    const __m256i lows = _mm256_set1_epi32(low), highs = _mm256_set1_epi32(high);
+
+    for (int b = 0; b < num_of_blocks; b++) {
+        const int *values = column + b * BLOCK_GAMES;
+        uint64_t bits = 0;
+
+        if (blocks[b] == 0)
+            continue;
+        for (int i = 0; i < BLOCK_GAMES; i += 8) {
+            __m256i value = _mm256_loadu_si256((const __m256i *)(values + i));
+            __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(lows, value), _mm256_cmpgt_epi32(value, highs));
+            bits |= (uint64_t)(~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF) << i;
+        }
+        blocks[b] &= bits;
+    }
+}
+
+__attribute__((target("avx2")))
+static void either_avx2(const int *first, const int *second, int code, uint64_t blocks[], int num_of_blocks)
+{
+    const __m256i codes = _mm256_set1_epi32(code);
+
+    for (int b = 0; b < num_of_blocks; b++) {
+        const int *values1 = first + b * BLOCK_GAMES, *values2 = second + b * BLOCK_GAMES;
+        uint64_t bits = 0;
+
+        if (blocks[b] == 0)
+            continue;
+        for (int i = 0; i < BLOCK_GAMES; i += 8) {
+            __m256i equal = _mm256_or_si256(
+                    _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(values1 + i)), codes),
+                    _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(values2 + i)), codes));
+            bits |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(equal)) << i;
+        }
+        blocks[b] &= bits;
+    }
+}
+
+__attribute__((target("avx2")))
+static void outcome_avx2(const unsigned char *column, int outcomes, uint64_t blocks[], int num_of_blocks)
+{
+    for (int b = 0; b < num_of_blocks; b++) {
+        const unsigned char *values = column + b * BLOCK_GAMES;
+        uint64_t bits = 0;
+
+        if (blocks[b] == 0)
+            continue;
+        for (int i = 0; i < BLOCK_GAMES; i += 32) {
+            __m256i value = _mm256_loadu_si256((const __m256i *)(values + i)), wanted = _mm256_setzero_si256();
+
+            for (int outcome = OUTCOME_BLACK_WINS; outcome <= OUTCOME_UNKNOWN; outcome++) {
+                if (outcomes & OUTCOME_BIT(outcome))
+                    wanted = _mm256_or_si256(wanted, _mm256_cmpeq_epi8(value, _mm256_set1_epi8((char)outcome)));
+            }
+            bits |= (uint64_t)(unsigned)_mm256_movemask_epi8(wanted) << i;
+        }
+        blocks[b] &= bits;
+    }
+}
+
+static const HeaderKernels avx2_kernels = {"avx2", range_avx2, either_avx2, outcome_avx2};
+
+#endif
+
+/* Returns the kernels for the instruction sets of the running CPU.                                */
+static const HeaderKernels *select_kernels()
+{
+#ifdef HEADER_X86_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+        return &avx2_kernels;
+    if (__builtin_cpu_supports("sse2"))
+        return &sse2_kernels;
+#endif
+    return &scalar_kernels;
+}
+
+/* ********** BUILDING THE STORE **********                                                        */
+
+/* Frees the header store, it is built again on the next filter.                                   */
+void free_header_store()
+{
+    HeaderStore *store = &current_db()->header_store;
+
+    free(store->ids);
+    free(store->dates);
+    free(store->white);
+    free(store->black);
+    free(store->events);
+    free(store->outcomes);
+    free(store->selection);
+    free(store->players);
+    free(store->tournaments);
+    memset(store, 0, sizeof(HeaderStore));
+}
+
+static int compare_name_refs(const void *a, const void *b)
+{
+    return strcmp(((const NameRef *)a)->name, ((const NameRef *)b)->name);
+}
+
+static int compare_numbers(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Sorts the names of kind (0 players, 1 events) of all shards into the dictionary *dictionary,
+ * the same name of several shards (or events) once, and stores the code of every shard's name
+ * id in the shard's codes. Returns the number of names, or ERROR on error.                        */
+static int build_dictionary(ShardHeaders shards[], int num_of_shards, int kind, char (**dictionary)[NAME_MAX])
+{
+    NameRef *refs;
+    int total = 0, count = 0;
+
+    for (int s = 0; s < num_of_shards; s++)
+        total += shards[s].num_of_names[kind];
+
+    refs = malloc(sizeof(NameRef) * (total + 1));
+    *dictionary = malloc(NAME_MAX * (size_t)(total + 1));
+    if (refs == NULL || *dictionary == NULL) {
+        free(refs);
+        return ERROR;
+    }
+
+    for (int s = 0, r = 0; s < num_of_shards; s++) {
+        int max_id = 0;
+
+        for (int i = 0; i < shards[s].num_of_names[kind]; i++) {
+            const NameId *name = &shards[s].names[kind][i];
+            refs[r++] = (NameRef){name->name, s, name->id};
+            if (name->id > max_id)
+                max_id = name->id;
+        }
+
+        // ids no name has stay -1...
+        if ((shards[s].codes[kind] = malloc(sizeof(int) * (max_id + 1))) == NULL) {
+            free(refs);
+            return ERROR;
+        }
+        memset(shards[s].codes[kind], 0xFF, sizeof(int) * (max_id + 1));
+        shards[s].max_ids[kind] = max_id;
+    }
+
+    qsort(refs, (size_t)total, sizeof(NameRef), compare_name_refs);
+    for (int r = 0; r < total; r++) {
+        if (count == 0 || strcmp((*dictionary)[count - 1], refs[r].name) != 0)
+            memcpy((*dictionary)[count++], refs[r].name, NAME_MAX);
+        shards[refs[r].shard].codes[kind][refs[r].id] = count - 1;
+    }
+
+    free(refs);
+    return count;
+}
+
+/* Returns the dictionary code of the name id of kind of shard, -1 if it has none.                 */
+static int shard_code(const ShardHeaders *shard, int kind, int id)
+{
+    return (id >= 0 && id <= shard->max_ids[kind]) ? shard->codes[kind][id] : -1;
+}
+
+/* Stores the headers of shards in the columns of store. Returns TRUE on success, FALSE on error.  */
+static int fill_columns(HeaderStore *store, const ShardHeaders shards[], int num_of_shards)
+{
+    size_t padded;
+    int row = 0;
+
+    store->num_of_games = 0;
+    for (int s = 0; s < num_of_shards; s++)
+        store->num_of_games += shards[s].num_of_headers;
+    store->num_of_blocks = (store->num_of_games + BLOCK_GAMES - 1) / BLOCK_GAMES;
+    padded = (size_t)store->num_of_blocks * BLOCK_GAMES + 1;
+
+    store->ids = calloc(padded, sizeof(int));
+    store->dates = calloc(padded, sizeof(int));
+    store->white = calloc(padded, sizeof(int));
+    store->black = calloc(padded, sizeof(int));
+    store->events = calloc(padded, sizeof(int));
+    store->outcomes = calloc(padded, 1);
+    store->selection = calloc((size_t)store->num_of_blocks + 1, sizeof(uint64_t));
+    if (store->ids == NULL || store->dates == NULL || store->white == NULL || store->black == NULL ||
+        store->events == NULL || store->outcomes == NULL || store->selection == NULL)
+        return FALSE;
+
+    for (int s = 0; s < num_of_shards; s++) {
+        const ShardHeaders *shard = &shards[s];
+
+        for (int i = 0; i < shard->num_of_headers; i++, row++) {
+            const GameHeader *header = &shard->headers[i];
+
+            store->ids[row] = header->id;
+            store->dates[row] = header->date_int;
+            store->white[row] = shard_code(shard, 0, header->white_id);
+            store->black[row] = shard_code(shard, 0, header->black_id);
+            store->events[row] = shard_code(shard, 1, header->event_id);
+            store->outcomes[row] = (unsigned char)header->outcome;
+        }
+    }
+    return TRUE;
+}
+
+static void free_shard_headers(ShardHeaders *shard)
+{
+    free(shard->headers);
+    for (int kind = 0; kind < 2; kind++) {
+        free(shard->names[kind]);
+        free(shard->codes[kind]);
+    }
+}
+
+/* Builds the store from the games of all shards. Returns TRUE on success, FALSE on error.         */
+static int build_header_store(HeaderStore *store)
+{
+    ShardHeaders shards[SHARDS_MAX + 1];
+    int numbers[SHARDS_MAX + 1], num_of_shards, success = TRUE;
+
+    free_header_store();
+    store->generation = get_data_generation();
+    memset(shards, 0, sizeof(shards));
+
+    // shards in number order keep the game ids ascending...
+    num_of_shards = get_shard_numbers(numbers);
+    qsort(numbers, (size_t)num_of_shards, sizeof(int), compare_numbers);
+    for (int s = 0; s < num_of_shards && success; s++) {
+        sqlite3 *db;
+
+        route_to_shard(numbers[s]);
+        if (!open_database_readonly(&db)) {
+            success = FALSE;
+            break;
+        }
+        success = (shards[s].num_of_names[0] = get_name_ids(db, COMPLETE_PLAYER, &shards[s].names[0])) != ERROR &&
+                  (shards[s].num_of_names[1] = get_name_ids(db, COMPLETE_TOURNAMENT, &shards[s].names[1])) != ERROR &&
+                  (shards[s].num_of_headers = get_game_headers(db, &shards[s].headers)) != ERROR;
+        sqlite3_close(db);
+    }
+    route_to_shard(0);
+
+    if (success) {
+        success = (store->num_of_players = build_dictionary(shards, num_of_shards, 0, &store->players)) != ERROR &&
+                  (store->num_of_tournaments = build_dictionary(shards, num_of_shards, 1, &store->tournaments)) != ERROR &&
+                  fill_columns(store, shards, num_of_shards);
+        if (!success)
+            eprintf("ERROR: could not allocate memory for the header store...\n");
+    }
+
+    for (int s = 0; s < num_of_shards; s++)
+        free_shard_headers(&shards[s]);
+    if (!success) {
+        free_header_store();
+        return FALSE;
+    }
+    store->built = TRUE;
+    return TRUE;
+}
+
+/* ********** FILTERING **********                                                                 */
+
+/* Returns the dictionary code of name, or -1 if no game has it.                                   */
+static int find_code(char (*dictionary)[NAME_MAX], int num_of_names, const char *name)
+{
+    int low = 0, high = num_of_names;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        int order = strcmp(dictionary[middle], name);
+
+        if (order == 0)
+            return middle;
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return -1;
+}
+
+/* Finds the games passing filter and stores their ids in *game_ids, an array allocated here and
+ * freed by the caller (NULL if there are none), in id order. Names are compared exactly.
+ * Returns the number of games, or ERROR on error.                                                 */
+int filter_headers(const HeaderFilter *filter, int **game_ids, HeaderFilterStats *stats)
+{
+    HeaderStore *store = &current_db()->header_store;
+    const HeaderKernels *kernels = select_kernels();
+    int from_date = filter->from_date, to_date = (filter->to_date > 0) ? date_range_end(filter->to_date) : HEADER_DATE_MAX;
+    int codes[4] = {0}, count = 0;
+    struct timespec start;
+
+    memset(stats, 0, sizeof(HeaderFilterStats));
+    stats->kernels = kernels->name;
+    *game_ids = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!store->built || store->generation != get_data_generation()) {
+        if (!build_header_store(store))
+            return ERROR;
+        stats->build_ms = elapsed_ms(&start);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+    stats->games = store->num_of_games;
+
+    // a name no game has matches nothing...
+    codes[0] = (filter->tournament != NULL) ? find_code(store->tournaments, store->num_of_tournaments, filter->tournament) : 0;
+    codes[1] = (filter->white != NULL) ? find_code(store->players, store->num_of_players, filter->white) : 0;
+    codes[2] = (filter->black != NULL) ? find_code(store->players, store->num_of_players, filter->black) : 0;
+    codes[3] = (filter->player != NULL) ? find_code(store->players, store->num_of_players, filter->player) : 0;
+    if (codes[0] < 0 || codes[1] < 0 || codes[2] < 0 || codes[3] < 0 || from_date > to_date ||
+        store->num_of_games == 0) {
+        stats->filter_ms = elapsed_ms(&start);
+        return 0;
+    }
+
+    memset(store->selection, 0xFF, sizeof(uint64_t) * store->num_of_blocks);
+    if (store->num_of_games % BLOCK_GAMES != 0)
+        store->selection[store->num_of_blocks - 1] = ((uint64_t)1 << (store->num_of_games % BLOCK_GAMES)) - 1;
+
+    if (filter->tournament != NULL)
+        kernels->range(store->events, codes[0], codes[0], store->selection, store->num_of_blocks);
+    if (filter->white != NULL)
+        kernels->range(store->white, codes[1], codes[1], store->selection, store->num_of_blocks);
+    if (filter->black != NULL)
+        kernels->range(store->black, codes[2], codes[2], store->selection, store->num_of_blocks);
+    if (filter->player != NULL)
+        kernels->either(store->white, store->black, codes[3], store->selection, store->num_of_blocks);
+    if (filter->outcomes != 0)
+        kernels->outcome(store->outcomes, filter->outcomes, store->selection, store->num_of_blocks);
+    if (from_date > 0 || to_date < HEADER_DATE_MAX)
+        kernels->range(store->dates, from_date, to_date, store->selection, store->num_of_blocks);
+
+    for (int b = 0; b < store->num_of_blocks; b++)
+        count += count_bits(store->selection[b]);
+
+    if (count > 0) {
+        if ((*game_ids = malloc(sizeof(int) * count)) == NULL) {
+            eprintf("ERROR: could not allocate memory for the filtered games...\n");
+            return ERROR;
+        }
+        for (int b = 0, i = 0; b < store->num_of_blocks; b++) {
+            for (uint64_t bits = store->selection[b]; bits != 0; bits &= bits - 1)
+                (*game_ids)[i++] = store->ids[b * BLOCK_GAMES + lowest_bit(bits)];
+        }
+    }
+
+    stats->matches = count;
+    stats->filter_ms = elapsed_ms(&start);
+    return count;
+}
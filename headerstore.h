@@ -0,0 +1,81 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#ifndef CHESSDATABASE_HEADERSTORE_H
+#define CHESSDATABASE_HEADERSTORE_H
+
+#include <stdint.h>
+
+#include "helperFunctions.h"
+
+// Game results as stored in the header store (the outcome of the tournament pairings).
+#define OUTCOME_BLACK_WINS 0
+#define OUTCOME_DRAW 1
+#define OUTCOME_WHITE_WINS 2
+#define OUTCOME_UNKNOWN 3
+#define OUTCOME_BIT(outcome) (1 << (outcome))
+
+// Largest packed date, the upper bound of a filter without one.
+#define HEADER_DATE_MAX 99999999
+
+/* The header columns of a game as read from the database, names as ids of the shard's player and
+ * event tables.                                                                                   */
+typedef struct GameHeader {
+    int id;
+    int date_int;
+    int white_id;
+    int black_id;
+    int event_id;
+    int outcome;
+} GameHeader;
+
+typedef struct NameId {
+    int id;
+    char name[NAME_MAX];
+} NameId;
+
+/* The in-memory copy of the game headers of one database handle, a column per header. Names are
+ * codes into the sorted dictionaries players and tournaments. The columns are padded to a whole
+ * number of 64 game blocks.                                                                       */
+typedef struct HeaderStore {
+    int *ids;
+    int *dates;
+    int *white;
+    int *black;
+    int *events;
+    unsigned char *outcomes;
+    uint64_t *selection;        // one bit per game, set for the games passing the filter...
+    int num_of_games;
+    int num_of_blocks;
+    char (*players)[NAME_MAX];
+    int num_of_players;
+    char (*tournaments)[NAME_MAX];
+    int num_of_tournaments;
+    int built;
+    unsigned long generation;
+} HeaderStore;
+
+/* Games matching all given conditions pass a filter.                                              */
+typedef struct HeaderFilter {
+    int from_date;              // packed dates, 0 for no bound...
+    int to_date;                // (a year or month covers all its days)...
+    int outcomes;               // OUTCOME_BIT of every result wanted, 0 for any...
+    const char *player;         // as white or black, NULL for any...
+    const char *white;
+    const char *black;
+    const char *tournament;
+} HeaderFilter;
+
+typedef struct HeaderFilterStats {
+    int games;
+    int matches;
+    const char *kernels;        // instruction set of the filter kernels: "avx2", "sse2" or "scalar"...
+    double build_ms;            // 0 if the store was up to date...
+    double filter_ms;
+} HeaderFilterStats;
+
+int filter_headers(const HeaderFilter *filter, int **game_ids, HeaderFilterStats *stats);
+void free_header_store();
+
+#endif //CHESSDATABASE_HEADERSTORE_H
@@ -21,6 +21,72 @@ int is_number(const char str[])
     return TRUE;
 }
 
+/* Packs date into an integer yyyymmdd with 0 for an unknown month or day (2019 -> 20190000),
+ * so packed dates sort chronologically. Recognized are yyyymmdd, yyyymm and yyyy, or the
+ * fields separated by '.', '-' or '/' as yyyy.mm.dd or dd.mm.yyyy, '?' marking unknown fields.
+ * Returns the packed date, or FALSE (0) if date is not recognized.                           */
+int pack_date(const char date[])
+{
+    int fields[3] = {0, 0, 0}, lengths[3] = {0, 0, 0}, num_of_fields = 1, year, month, day;
+    int length = (int)strlen(date);
+
+    if (length > 0 && is_number(date)) {
+        // yyyymmdd, yyyymm or yyyy...
+        if (length != 8 && length != 6 && length != 4)
+            return FALSE;
+        sscanf(date, "%4d", &year);
+        month = (length >= 6) ? (date[4] - '0') * 10 + (date[5] - '0') : 0;
+        day = (length == 8) ? (date[6] - '0') * 10 + (date[7] - '0') : 0;
+    } else {
+        // separated fields, a field containing '?' is unknown (0)...
+        int unknown[3] = {FALSE, FALSE, FALSE};
+        for (int i = 0; i < length; i++) {
+            int f = num_of_fields - 1;
+            if (isdigit((unsigned char)date[i])) {
+                fields[f] = fields[f] * 10 + (date[i] - '0');
+                lengths[f]++;
+            } else if (date[i] == '?') {
+                unknown[f] = TRUE;
+                lengths[f]++;
+            } else if ((date[i] == '.' || date[i] == '-' || date[i] == '/') && num_of_fields < 3) {
+                num_of_fields++;
+            } else {
+                return FALSE;
+            }
+        }
+        for (int f = 0; f < num_of_fields; f++) {
+            if (unknown[f])
+                fields[f] = 0;
+        }
+
+        if (lengths[0] == 4) {
+            year = fields[0];
+            month = fields[1];
+            day = fields[2];
+        } else if (num_of_fields > 1 && lengths[num_of_fields - 1] == 4) {
+            year = fields[num_of_fields - 1];
+            month = fields[num_of_fields - 2];
+            day = (num_of_fields == 3) ? fields[0] : 0;
+        } else {
+            return FALSE;
+        }
+    }
+
+    if (year <= 0 || month > 12 || day > 31 || (month == 0 && day != 0))
+        return FALSE;
+    return PACK_DATE(year, month, day);
+}
+
+/* Returns the last packed date covered by the packed date to_date as the end of a range: a year
+ * or a year and month covers the whole period (20210000 -> 20211299, 20210300 -> 20210399).
+ * A full date or 0 is returned as it is.                                                     */
+int date_range_end(int to_date)
+{
+    if (to_date <= 0 || DATE_DAY(to_date) != 0)
+        return to_date;
+    return (DATE_MONTH(to_date) == 0) ? to_date + 1299 : to_date + 99;
+}
+
 /* Returns the number of digits in a number.                                                  */
 int count_digits(int num)
 {
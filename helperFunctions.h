@@ -16,6 +16,8 @@
 #define END_WHITE 1
 #define END_BLACK 2
 #define CONTINUE 0
+#define NEXT_PAGE -3
+#define PREVIOUS_PAGE -4
 
 // Size values.
 #define NAME_MAX 50
@@ -23,6 +25,20 @@
 #define RESULT_MAX 10
 #define MOVES_MAX 150
 #define S_MOVE_MAX 6
+#define SAMPLE_MAX 100
+#define ECO_MAX 4
+#define OPENING_MAX 96
+
+// Board checkpoints: the position after every CHECKPOINT_PLIES plies of a game, packed (see checkpoint.c).
+#define CHECKPOINT_PLIES 16
+#define CHECKPOINT_SIZE 37
+#define CHECKPOINTS_MAX (MOVES_MAX * 2 / CHECKPOINT_PLIES)
+
+// Packed dates (yyyymmdd, 0 for an unknown month or day).
+#define PACK_DATE(year, month, day) ((year) * 10000 + (month) * 100 + (day))
+#define DATE_YEAR(date) ((date) / 10000)
+#define DATE_MONTH(date) ((date) / 100 % 100)
+#define DATE_DAY(date) ((date) % 100)
 
 // Comparing/Array-position values.
 #define WHITE_PLAYER 0
@@ -32,7 +48,10 @@
 typedef struct GameMoves {
     int moves_id;
     int move_number;
+    int packed;     // TRUE if the moves are stored packed (moves.packed_moves), FALSE if in single_move.
     char moves[MOVES_MAX][2][S_MOVE_MAX];
+    int num_of_checkpoints;
+    unsigned char checkpoints[CHECKPOINTS_MAX][CHECKPOINT_SIZE];    // after ply 16, 32, ...
 } GameMoves;
 
 typedef struct GameInfo {
@@ -46,6 +65,8 @@ typedef struct GameInfo {
     char black_name[NAME_MAX];
     char white_result[RESULT_MAX];
     char black_result[RESULT_MAX];
+    char eco[ECO_MAX];              // ECO code of the opening, empty if unknown.
+    char opening[OPENING_MAX];      // name of the opening, empty if unknown.
     GameMoves game_moves;
 } GameInfo;
 
@@ -57,7 +78,31 @@ typedef struct SampleInfo {
     char black_name[NAME_MAX];
 } SampleInfo;
 
+/* A row of a game list with its date as packed date (the sample date is cut to DATE_MAX), which
+ * is the sort key of lists in date order.                                                        */
+typedef struct ListRow {
+    int date_int;
+    SampleInfo sample;
+} ListRow;
+
+/* Games fetched by get_games_by_ids, sorted by id. The moves of all games are read together on
+ * the first get_batch_moves, until then only moves_id and move_number of game_moves are set.      */
+typedef struct GameBatch {
+    GameInfo *games;
+    int num_of_games;
+    int moves_loaded;
+} GameBatch;
+
+/* Rows affected by a set based delete or rename.                                                 */
+typedef struct BulkCounts {
+    int games;
+    int moves;
+    int single_moves;
+} BulkCounts;
+
 int is_number(const char str[]);
+int pack_date(const char date[]);
+int date_range_end(int to_date);
 void flush_input();
 void get_string_input(const char *label, char *input_string, int max_size);
 void edit_existing_string(const char *label, char *input_string, int max_size);
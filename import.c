@@ -0,0 +1,728 @@
+//
+// Created by flimsy on 3/18/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "database.h"
+#include "import.h"
+#include "chess.h"
+#include "cache.h"
+#include "context.h"
+#include "maintenance.h"
+
+/* ********** PGN IMPORT **********
+ * The PGN file is split into num_of_processes byte ranges, each moved forward to the start of a
+ * game (a tag line after movetext). A process per range parses its games, checks their moves on a
+ * board (they are stored in canonical SAN) and writes them in batches to a database file of its
+ * own next to chess.db (chess-import-<n>.db), with only the indexes of the table keys, no journal
+ * and no syncing. When all processes are done, their files are merged into chess.db one after the
+ * other in file order, each by a few INSERT ... SELECT statements on the ATTACHed file in one
+ * transaction, the ids shifted above the ids of chess.db and the names looked up by name. If the
+ * import brings more games than chess.db holds, the indexes of chess.db are dropped for the merge
+ * and built once at the end.                                                                      */
+
+const char *mergePart[] = {
+        "INSERT OR IGNORE INTO main.event (name, class, group_name) "
+        "SELECT name, class, group_name FROM part.event;",
+
+        "INSERT OR IGNORE INTO main.player (name) SELECT name FROM part.player;",
+
+        "INSERT INTO main.game (id, event_id, game_number, date, white_id, black_id, white_result, "
+        "black_result, date_int, eco, opening) "
+        "SELECT g.id + ?1, me.id, g.game_number, g.date, mw.id, mb.id, g.white_result, g.black_result, "
+        "g.date_int, g.eco, g.opening "
+        "FROM part.game g "
+        "INNER JOIN part.event e ON e.id = g.event_id "
+        "INNER JOIN main.event me ON me.name = e.name AND me.class = e.class AND me.group_name = e.group_name "
+        "INNER JOIN part.player w ON w.id = g.white_id INNER JOIN main.player mw ON mw.name = w.name "
+        "INNER JOIN part.player b ON b.id = g.black_id INNER JOIN main.player mb ON mb.name = b.name "
+        "ORDER BY g.id;",
+
+        "INSERT INTO main.moves (id, number_of_moves, game_id, packed_moves, checkpoints) "
+        "SELECT id + ?2, number_of_moves, game_id + ?1, packed_moves, checkpoints FROM part.moves ORDER BY id;",
+
+        "INSERT INTO main.single_move (id, move_number, white_move, black_move, moves_id) "
+        "SELECT id + ?3, move_number, white_move, black_move, moves_id + ?2 FROM part.single_move ORDER BY id;",
+
+        "INSERT INTO main.ply_gram (hash, game_id) SELECT hash, game_id + ?1 FROM part.ply_gram;",
+
+        "INSERT INTO main.game_signature (game_id, signature) "
+        "SELECT game_id + ?1, signature FROM part.game_signature;",
+
+        "INSERT INTO main.signature_band (hash, game_id) SELECT hash, game_id + ?1 FROM part.signature_band;",
+};
+
+const char selectMaxGameId[] = "SELECT IFNULL(MAX(id), 0) FROM main.game;";
+
+const char selectMaxMovesId[] = "SELECT IFNULL(MAX(id), 0) FROM main.moves;";
+
+const char selectMaxSingleMoveId[] = "SELECT IFNULL(MAX(id), 0) FROM main.single_move;";
+
+const char selectGameCount[] = "SELECT COUNT(*) FROM main.game;";
+
+// (indexes of keys and UNIQUE constraints have no sql)...
+const char selectIndexes[] = "SELECT name, sql FROM main.sqlite_master WHERE type = 'index' AND sql IS NOT NULL;";
+
+const char importPragmas[] = "PRAGMA journal_mode = OFF;"
+                             "PRAGMA synchronous = OFF;";
+
+/* The indexes of chess.db dropped for the merge, with the statements creating them.               */
+typedef struct DeferredIndexes {
+    char names[IMPORT_INDEXES_MAX][NAME_MAX];
+    char *sql[IMPORT_INDEXES_MAX];
+    int count;
+} DeferredIndexes;
+
+/* Reads the PGN file line by line from a byte offset, keeping the movetext of the current game.   */
+typedef struct PgnReader {
+    FILE *file;
+    long offset;                // of the next line in the file...
+    long end;                   // games starting at or after end are left to the next process...
+    char *line;
+    size_t line_size;
+    ssize_t line_length;
+    long line_start;
+    int pending;                // line is read but belongs to the next game...
+    char *text;                 // movetext...
+    size_t text_size;
+    size_t text_capacity;
+} PgnReader;
+
+static double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* ********** PGN PARSING **********                                                               */
+
+/* Updates comment (TRUE inside a {comment}) for line, a ';' comments out the rest of the line.    */
+static void scan_comments(const char *line, int *comment)
+{
+    for (const char *c = line; *c != '\0'; c++) {
+        if (*comment) {
+            if (*c == '}')
+                *comment = FALSE;
+        } else if (*c == '{') {
+            *comment = TRUE;
+        } else if (*c == ';') {
+            return;
+        }
+    }
+}
+
+static int is_blank(const char *line)
+{
+    while (isspace((unsigned char)*line))
+        line++;
+    return *line == '\0';
+}
+
+/* Returns the offset of the first game starting at or after offset in file (the first tag line
+ * after movetext), or the size of the file if there is none.                                      */
+static long find_game_start(FILE *file, long offset)
+{
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t length;
+    int movetext = FALSE, comment = FALSE;
+
+    if (offset == 0)
+        return 0;
+
+    // (the line offset falls into belongs to the game before)...
+    fseek(file, offset - 1, SEEK_SET);
+    length = getline(&line, &line_size, file);
+    offset += (length > 0) ? length - 1 : 0;
+    while ((length = getline(&line, &line_size, file)) > 0) {
+        if (line[0] == '[' && movetext && !comment)
+            break;
+        if (line[0] != '[' && line[0] != '%' && !is_blank(line)) {
+            movetext = TRUE;
+            scan_comments(line, &comment);
+        }
+        offset += length;
+    }
+    free(line);
+    return offset;
+}
+
+static ssize_t next_line(PgnReader *reader)
+{
+    if (reader->pending) {
+        reader->pending = FALSE;
+        return reader->line_length;
+    }
+    reader->line_start = reader->offset;
+    reader->line_length = getline(&reader->line, &reader->line_size, reader->file);
+    if (reader->line_length > 0)
+        reader->offset += reader->line_length;
+    return reader->line_length;
+}
+
+/* Appends line to the movetext of reader. Returns TRUE on success and FALSE if out of memory.     */
+static int append_movetext(PgnReader *reader, const char *line, size_t length)
+{
+    if (reader->text_size + length + 1 > reader->text_capacity) {
+        size_t capacity = (reader->text_capacity) ? reader->text_capacity : 4096;
+        while (reader->text_size + length + 1 > capacity)
+            capacity *= 2;
+        char *grown = realloc(reader->text, capacity);
+        if (grown == NULL)
+            return FALSE;
+        reader->text = grown;
+        reader->text_capacity = capacity;
+    }
+    memcpy(reader->text + reader->text_size, line, length);
+    reader->text_size += length;
+    reader->text[reader->text_size] = '\0';
+    return TRUE;
+}
+
+/* Parses the tag pair line ([Name "value"], '\' escaping '"' and '\') into name and value.
+ * Returns TRUE on success and FALSE if line is no tag pair.                                       */
+static int parse_tag(const char *line, char name[IMPORT_TAG_MAX], char value[IMPORT_TAG_MAX])
+{
+    const char *c = line + 1;
+    int length = 0;
+
+    while (isspace((unsigned char)*c))
+        c++;
+    while (isalnum((unsigned char)*c) || *c == '_') {
+        if (length < IMPORT_TAG_MAX - 1)
+            name[length++] = *c;
+        c++;
+    }
+    name[length] = '\0';
+    while (isspace((unsigned char)*c))
+        c++;
+    if (length == 0 || *c != '"')
+        return FALSE;
+
+    for (c++, length = 0; *c != '\0' && *c != '"'; c++) {
+        if (*c == '\\' && (c[1] == '"' || c[1] == '\\'))
+            c++;
+        if (length < IMPORT_TAG_MAX - 1)
+            value[length++] = *c;
+    }
+    value[length] = '\0';
+    return *c == '"';
+}
+
+/* Stores the PGN date (yyyy.mm.dd, '?' for unknown parts) in date as yyyymmdd, yyyymm or yyyy,
+ * "-" if unknown.                                                                                 */
+static void set_date(char date[DATE_MAX], const char *pgn_date)
+{
+    int packed = pack_date(pgn_date);
+    // (bounded, so the parts fit in DATE_MAX)...
+    unsigned year = (unsigned)DATE_YEAR(packed) % 10000;
+    unsigned month = (unsigned)DATE_MONTH(packed) % 100, day = (unsigned)DATE_DAY(packed) % 100;
+
+    if (packed <= 0 || year == 0)
+        strcpy(date, "-");
+    else if (month && day)
+        snprintf(date, DATE_MAX, "%04u%02u%02u", year, month, day);
+    else if (month)
+        snprintf(date, DATE_MAX, "%04u%02u", year, month);
+    else
+        snprintf(date, DATE_MAX, "%04u", year);
+}
+
+/* Copies text into field, cut to NAME_MAX - 1 characters. Returns TRUE if it fit, FALSE if cut.   */
+static int copy_tag(char *field, const char *text)
+{
+    int length = snprintf(field, NAME_MAX, "%s", text);
+
+    return length >= 0 && length < NAME_MAX;
+}
+
+/* Stores value in the field of game the tag name is for, "?" and "" as "-", and sets cut to TRUE if
+ * the value had to be cut to fit. Returns FALSE if the game can't be stored (it starts from
+ * another position), TRUE otherwise.                                                              */
+static int set_tag(GameInfo *game, const char *name, const char *value, int *cut)
+{
+    const char *text = (strcmp(value, "?") == 0 || value[0] == '\0') ? "-" : value;
+    int fit = TRUE;
+
+    if (strcmp(name, "Event") == 0)
+        fit = copy_tag(game->name, text);
+    else if (strcmp(name, "Class") == 0)
+        fit = copy_tag(game->class, text);
+    else if (strcmp(name, "Group") == 0)
+        fit = copy_tag(game->group, text);
+    else if (strcmp(name, "Round") == 0)
+        fit = copy_tag(game->game_number, text);
+    else if (strcmp(name, "Date") == 0)
+        set_date(game->date, value);
+    else if (strcmp(name, "White") == 0)
+        fit = copy_tag(game->white_name, text);
+    else if (strcmp(name, "Black") == 0)
+        fit = copy_tag(game->black_name, text);
+    else if (strcmp(name, "Result") == 0) {
+        int result = (strcmp(value, "1-0") == 0) ? 1 : (strcmp(value, "0-1") == 0) ? 2
+                   : (strcmp(value, "1/2-1/2") == 0) ? 3 : 0;
+        strcpy(game->white_result, (const char *[]){"-", "1", "0", "1/2"}[result]);
+        strcpy(game->black_result, (const char *[]){"-", "0", "1", "1/2"}[result]);
+    } else if (strcmp(name, "FEN") == 0)
+        return FALSE;
+    if (!fit)
+        *cut = TRUE;
+    return TRUE;
+}
+
+static int is_result(const char *token)
+{
+    return strcmp(token, "1-0") == 0 || strcmp(token, "0-1") == 0 || strcmp(token, "1/2-1/2") == 0 ||
+           strcmp(token, "*") == 0;
+}
+
+/* Plays the moves of the movetext text (comments, variations and NAGs skipped) into game_moves,
+ * in canonical SAN. Returns TRUE on success and FALSE if a move is illegal, does not fit into
+ * S_MOVE_MAX or the game has more than MOVES_MAX moves.                                           */
+static int parse_movetext(const char *text, GameMoves *game_moves)
+{
+    char token[IMPORT_TAG_MAX], san[SAN_MAX];
+    int plies = 0, depth = 0;
+    Board board;
+    Move move;
+
+    board_init(&board);
+    for (const char *c = text; *c != '\0';) {
+        if (*c == '{') {
+            while (*c != '\0' && *c != '}')
+                c++;
+            c += (*c == '}');
+            continue;
+        }
+        if (*c == ';') {
+            while (*c != '\0' && *c != '\n')
+                c++;
+            continue;
+        }
+        if (*c == '(' || *c == ')' || isspace((unsigned char)*c)) {
+            depth += (*c == '(') ? 1 : (*c == ')' && depth > 0) ? -1 : 0;
+            c++;
+            continue;
+        }
+
+        size_t length = strcspn(c, " \t\r\n{}();");
+        snprintf(token, sizeof(token), "%.*s", (int)((length < sizeof(token)) ? length : sizeof(token) - 1), c);
+        c += length;
+        if (depth > 0 || token[0] == '$' || is_result(token) || strcmp(token, "e.p.") == 0)
+            continue;
+
+        // move numbers ("12." or "12...", maybe without a space before the move)...
+        const char *san_text = token;
+        while (isdigit((unsigned char)*san_text))
+            san_text++;
+        if (san_text > token && *san_text == '.') {
+            while (*san_text == '.')
+                san_text++;
+        } else {
+            san_text = token;
+        }
+        if (*san_text == '\0')
+            continue;
+
+        if (plies >= MOVES_MAX * 2 || !parse_san(&board, san_text, &move))
+            return FALSE;
+        move_to_san(&board, move, san);
+        if (strlen(san) >= S_MOVE_MAX)
+            return FALSE;
+        strcpy(game_moves->moves[plies / 2][plies % 2], san);
+        make_move(&board, move);
+        plies++;
+    }
+
+    if (plies % 2)
+        strcpy(game_moves->moves[plies / 2][BLACK_PLAYER], "-");
+    game_moves->move_number = (plies + 1) / 2;
+    return TRUE;
+}
+
+/* Reads the next game starting before the end of the range of reader into game. valid is set to
+ * FALSE if the game can't be stored, cut to TRUE if a tag value was cut to NAME_MAX - 1 characters.
+ * Returns TRUE if a game was read, FALSE if there is none left and ERROR if out of memory.        */
+static int read_pgn_game(PgnReader *reader, GameInfo *game, int *valid, int *cut)
+{
+    char name[IMPORT_TAG_MAX], value[IMPORT_TAG_MAX];
+    int started = FALSE, movetext = FALSE, comment = FALSE;
+    ssize_t length;
+
+    memset(game, 0, sizeof(GameInfo));
+    strcpy(game->name, "-");
+    strcpy(game->class, "-");
+    strcpy(game->group, "-");
+    strcpy(game->game_number, "-");
+    strcpy(game->date, "-");
+    strcpy(game->white_name, "-");
+    strcpy(game->black_name, "-");
+    strcpy(game->white_result, "-");
+    strcpy(game->black_result, "-");
+    reader->text_size = 0;
+    *valid = TRUE;
+    *cut = FALSE;
+
+    while ((length = next_line(reader)) > 0) {
+        const char *line = reader->line;
+
+        if (!started) {
+            if (is_blank(line) || line[0] == '%')
+                continue;
+            if (reader->line_start >= reader->end)
+                return FALSE;
+            started = TRUE;
+        }
+
+        if (line[0] == '[' && !comment) {
+            if (movetext) {
+                reader->pending = TRUE;
+                break;
+            }
+            if (parse_tag(line, name, value) && !set_tag(game, name, value, cut))
+                *valid = FALSE;
+        } else if (line[0] != '%' && !is_blank(line)) {
+            movetext = TRUE;
+            scan_comments(line, &comment);
+            if (!append_movetext(reader, line, (size_t)length))
+                return ERROR;
+        }
+    }
+
+    if (!started)
+        return FALSE;
+    if (*valid && reader->text_size > 0)
+        *valid = parse_movetext(reader->text, &game->game_moves);
+    return TRUE;
+}
+
+/* ********** IMPORT PROCESSES **********                                                          */
+
+/* Imports the games of pgn_path starting in [from, to) into the new database file part_path and
+ * writes the number of games stored, skipped and stored with a tag cut to result. Runs in a
+ * process of its own.
+ * Returns EXIT_SUCCESS or EXIT_FAILURE.                                                           */
+static int import_part(const char *pgn_path, long from, long to, const char *part_path, int result)
+{
+    PgnReader reader = {.offset = from, .end = to};
+    long counts[3] = {0, 0, 0};
+    int status = TRUE, valid, cut, batch = 0, in_transaction = FALSE;
+    char *err_msg = 0;
+    GameInfo game;
+    sqlite3 *db;
+
+    if ((reader.file = fopen(pgn_path, "r")) == NULL || fseek(reader.file, from, SEEK_SET) != 0) {
+        eprintf("ERROR: cannot read %s...\n", pgn_path);
+        return EXIT_FAILURE;
+    }
+
+    // (a file left by an import that failed)...
+    remove(part_path);
+    if (!open_database_path(part_path, &db, FALSE) ||
+        is_exec_error(&db, sqlite3_exec(db, importPragmas, 0, 0, &err_msg), &err_msg) || !create_game_tables(db)) {
+        fclose(reader.file);
+        return EXIT_FAILURE;
+    }
+
+    // batches of IMPORT_BATCH_GAMES games in one transaction...
+    while (status == TRUE) {
+        if (!in_transaction && !do_statement(db, NULL, NULL, NULL, FALSE, beginTransaction, NULL))
+            return EXIT_FAILURE;
+        in_transaction = TRUE;
+
+        if ((status = read_pgn_game(&reader, &game, &valid, &cut)) == ERROR) {
+            eprintf("ERROR: out of memory reading %s...\n", pgn_path);
+            break;
+        }
+        if (status == TRUE && !valid) {
+            counts[1]++;
+        } else if (status == TRUE) {
+            if (!insert_game_rows(db, &game, 0))
+                return EXIT_FAILURE;
+            counts[0]++;
+            counts[2] += cut;
+            batch++;
+        }
+
+        if (status == FALSE || batch == IMPORT_BATCH_GAMES) {
+            if (!do_statement(db, NULL, NULL, NULL, TRUE, commitTransaction, NULL))
+                return EXIT_FAILURE;
+            in_transaction = FALSE;
+            batch = 0;
+        }
+    }
+
+    sqlite3_close(db);
+    fclose(reader.file);
+    free(reader.line);
+    free(reader.text);
+
+    if (status == ERROR || write(result, counts, sizeof(counts)) != (ssize_t)sizeof(counts))
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+/* ********** MERGE **********                                                                     */
+
+static int select_int(sqlite3 *db, const char *sql, long *value)
+{
+    sqlite3_stmt *stmt;
+    int status = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+
+    if (status == SQLITE_OK && (status = sqlite3_step(stmt)) == SQLITE_ROW)
+        *value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    if (status != SQLITE_ROW) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Runs sql on db with the id bases bound to ?1, ?2 and ?3 (those used).
+ * Returns TRUE on success and FALSE on error (db is left open).                                   */
+static int exec_with_bases(sqlite3 *db, const char *sql, const long bases[3])
+{
+    sqlite3_stmt *stmt;
+    int status = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+
+    if (status == SQLITE_OK) {
+        for (int i = 0; i < sqlite3_bind_parameter_count(stmt); i++)
+            sqlite3_bind_int64(stmt, i + 1, bases[i]);
+        status = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    }
+
+    if (status != SQLITE_OK && status != SQLITE_DONE) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Merges the games of the database file part_path into the (open) chess.db db.
+ * Returns TRUE on success and FALSE on error (db is left open, the merge is rolled back).         */
+static int merge_part(sqlite3 *db, const char *part_path)
+{
+    long bases[3];
+    int success;
+
+    if (!attach_database(db, part_path, "part"))
+        return FALSE;
+
+    success = sqlite3_exec(db, "BEGIN TRANSACTION;", 0, 0, NULL) == SQLITE_OK &&
+              select_int(db, selectMaxGameId, &bases[0]) && select_int(db, selectMaxMovesId, &bases[1]) &&
+              select_int(db, selectMaxSingleMoveId, &bases[2]);
+    for (size_t i = 0; success && i < sizeof(mergePart) / sizeof(mergePart[0]); i++)
+        success = exec_with_bases(db, mergePart[i], bases);
+
+    if (success && sqlite3_exec(db, "COMMIT;", 0, 0, NULL) == SQLITE_OK) {
+        printf("INFO: merged %s...\n", part_path);
+    } else {
+        eprintf("ERROR: merging %s failed, rolling back...\n", part_path);
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+        success = FALSE;
+    }
+
+    sqlite3_exec(db, "DETACH DATABASE part;", 0, 0, NULL);
+    return success;
+}
+
+/* Drops the indexes of db, keeping them in deferred. Returns TRUE on success and FALSE on error
+ * (the indexes dropped so far are kept in deferred).                                              */
+static int drop_indexes(sqlite3 *db, DeferredIndexes *deferred)
+{
+    char sql[NAME_MAX + 32];
+    sqlite3_stmt *stmt;
+
+    deferred->count = 0;
+    if (sqlite3_prepare_v2(db, selectIndexes, -1, &stmt, 0) != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return FALSE;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW && deferred->count < IMPORT_INDEXES_MAX) {
+        copy_column_text(deferred->names[deferred->count], stmt, 0, NAME_MAX);
+        if ((deferred->sql[deferred->count] = strdup((const char *)sqlite3_column_text(stmt, 1))) == NULL)
+            break;
+        deferred->count++;
+    }
+    sqlite3_finalize(stmt);
+
+    for (int i = 0; i < deferred->count; i++) {
+        snprintf(sql, sizeof(sql), "DROP INDEX \"%s\";", deferred->names[i]);
+        if (sqlite3_exec(db, sql, 0, 0, NULL) != SQLITE_OK) {
+            eprintf("Cannot drop index %s: %s\n", deferred->names[i], sqlite3_errmsg(db));
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Creates the indexes in deferred on db again (all of them, also after an error) and frees them.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int create_indexes(sqlite3 *db, DeferredIndexes *deferred)
+{
+    int success = TRUE;
+
+    for (int i = 0; i < deferred->count; i++) {
+        if (sqlite3_exec(db, deferred->sql[i], 0, 0, NULL) != SQLITE_OK) {
+            eprintf("Cannot create index %s: %s\n", deferred->names[i], sqlite3_errmsg(db));
+            success = FALSE;
+        }
+        free(deferred->sql[i]);
+    }
+    deferred->count = 0;
+    return success;
+}
+
+/* Merges the num_of_parts files part_paths into chess.db, which holds existing games, deferring
+ * its indexes if more games (imported) are merged. Returns TRUE on success and FALSE on error.    */
+static int merge_parts(char part_paths[][SHARD_PATH_MAX], int num_of_parts, ImportStats *stats)
+{
+    DeferredIndexes deferred = {.count = 0};
+    struct timespec start;
+    long existing = 0;
+    int success;
+    sqlite3 *db;
+
+    if (!open_database_path(current_db()->catalog_path, &db, FALSE))
+        return FALSE;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    success = select_int(db, selectGameCount, &existing);
+    if (success && stats->games > existing)
+        success = drop_indexes(db, &deferred);
+    stats->deferred_indexes = deferred.count;
+
+    for (int i = 0; i < num_of_parts && success; i++)
+        success = merge_part(db, part_paths[i]);
+    stats->merge_seconds = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!create_indexes(db, &deferred))
+        success = FALSE;
+    stats->index_seconds = elapsed_seconds(&start);
+
+    sqlite3_close(db);
+    return success;
+}
+
+/* Imports the games of the PGN file pgn_path into chess.db with num_of_processes processes (see
+ * above; 0 for one per CPU online, up to IMPORT_PROCESSES) and stores what was imported and how
+ * long it took in stats. Games that can't be stored (illegal moves, not from the start position,
+ * more than MOVES_MAX moves, moves longer than S_MOVE_MAX) are skipped, tag values longer than
+ * NAME_MAX - 1 characters are cut (and the games counted). Returns TRUE on success and FALSE on
+ * error (nothing is imported if a process failed).                                                */
+int import_pgn(const char *pgn_path, int num_of_processes, ImportStats *stats)
+{
+    char part_paths[IMPORT_PROCESSES_MAX][SHARD_PATH_MAX], file[NAME_MAX];
+    long bounds[IMPORT_PROCESSES_MAX + 1], size;
+    int results[IMPORT_PROCESSES_MAX], started = 0, success = TRUE;
+    pid_t pids[IMPORT_PROCESSES_MAX];
+    struct timespec start;
+    FILE *pgn;
+
+    long num_of_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    memset(stats, 0, sizeof(ImportStats));
+    if (num_of_processes < 0 || num_of_processes > IMPORT_PROCESSES_MAX) {
+        eprintf("ERROR: number of processes must be between 1 and %d...\n", IMPORT_PROCESSES_MAX);
+        return FALSE;
+    }
+    // by default as many as CPUs, more processes than CPUs only take turns and add parts to merge...
+    if (num_of_processes == 0)
+        num_of_processes = (num_of_cpus > 0 && num_of_cpus < IMPORT_PROCESSES) ? (int)num_of_cpus : IMPORT_PROCESSES;
+    if (get_sharding_mode() != SHARD_NONE) {
+        eprintf("ERROR: importing into a sharded database is not supported...\n");
+        return FALSE;
+    }
+
+    if ((pgn = fopen(pgn_path, "r")) == NULL || fseek(pgn, 0, SEEK_END) != 0 || (size = ftell(pgn)) < 0) {
+        eprintf("ERROR: cannot read %s...\n", pgn_path);
+        if (pgn != NULL)
+            fclose(pgn);
+        return FALSE;
+    }
+
+    // ranges of (about) equal size, every one starting with a game...
+    bounds[0] = 0;
+    bounds[num_of_processes] = size;
+    for (int i = 1; i < num_of_processes; i++) {
+        bounds[i] = find_game_start(pgn, size / num_of_processes * i);
+        if (bounds[i] < bounds[i - 1])
+            bounds[i] = bounds[i - 1];
+    }
+    fclose(pgn);
+
+    // nothing buffered may be written twice by the processes...
+    fflush(stdout);
+    fflush(stderr);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_of_processes; i++) {
+        int fds[2];
+
+        snprintf(file, sizeof(file), "chess-import-%d.db", i + 1);
+        if (!resolve_db_file(file, part_paths[i])) {
+            eprintf("ERROR: path of import part %d too long...\n", i + 1);
+            success = FALSE;
+            break;
+        }
+        if (pipe(fds) != 0 || (pids[i] = fork()) < 0) {
+            eprintf("ERROR: could not start import process %d...\n", i + 1);
+            success = FALSE;
+            break;
+        }
+        if (pids[i] == 0) {
+            for (int j = 0; j < started; j++)
+                close(results[j]);
+            close(fds[0]);
+            _exit(import_part(pgn_path, bounds[i], bounds[i + 1], part_paths[i], fds[1]));
+        }
+        close(fds[1]);
+        results[started++] = fds[0];
+    }
+
+    for (int i = 0; i < started; i++) {
+        long counts[3];
+        int status;
+
+        if (read(results[i], counts, sizeof(counts)) == (ssize_t)sizeof(counts)) {
+            stats->games += counts[0];
+            stats->skipped += counts[1];
+            stats->cut += counts[2];
+        } else {
+            success = FALSE;
+        }
+        close(results[i]);
+        waitpid(pids[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+            success = FALSE;
+    }
+    stats->processes = started;
+    stats->parse_seconds = elapsed_seconds(&start);
+
+    if (success)
+        success = merge_parts(part_paths, started, stats);
+    else
+        eprintf("ERROR: an import process failed, nothing was imported...\n");
+
+    for (int i = 0; i < started; i++)
+        remove(part_paths[i]);
+
+    if (success) {
+        bump_data_generation();
+        clear_standings_cache();
+        count_writes(stats->games);
+    }
+    return success;
+}
@@ -0,0 +1,30 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#ifndef CHESSDATABASE_IMPORT_H
+#define CHESSDATABASE_IMPORT_H
+
+#include "helperFunctions.h"
+
+// Size values.
+#define IMPORT_PROCESSES 4
+#define IMPORT_PROCESSES_MAX 64
+#define IMPORT_BATCH_GAMES 1000
+#define IMPORT_TAG_MAX 256
+#define IMPORT_INDEXES_MAX 32
+
+typedef struct ImportStats {
+    long games;
+    long skipped;               // games with illegal moves, too many moves or moves too long to store...
+    long cut;                   // games stored with a tag value cut to NAME_MAX - 1 characters...
+    int processes;
+    int deferred_indexes;       // indexes of chess.db dropped for the merge and built again after...
+    double parse_seconds;       // until the last process finished its file...
+    double merge_seconds;
+    double index_seconds;
+} ImportStats;
+
+int import_pgn(const char *pgn_path, int num_of_processes, ImportStats *stats);
+
+#endif //CHESSDATABASE_IMPORT_H
@@ -0,0 +1,292 @@
+//
+// Created by flimsy on 3/14/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "lineindex.h"
+#include "database.h"
+
+/* ********** LINE INDEX **********
+ * Every window of LINE_PLIES consecutive plies of a game is hashed (FNV-1a, 64 bit) and stored
+ * as a (hash, game id) posting in the table ply_gram, written together with the moves of the game.
+ * A line of at least LINE_PLIES plies is covered by windows starting every LINE_PLIES plies (the
+ * last one ending at the end of the line). A game containing the line contains all of them, so
+ * the posting lists of the windows are intersected, smallest first, and only the games left are
+ * read and checked for the whole line (which also rules out hash collisions). Shorter lines have
+ * no window and are searched by reading every game.
+ * Check marks and annotations (+, #, !, ?) are ignored, "Nf3+" and "Nf3" are the same ply.       */
+
+static double elapsed_ms(const struct timespec *from)
+{
+    struct timespec to;
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    return (double)(to.tv_sec - from->tv_sec) * 1e3 + (double)(to.tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/* Copies the move src to dst without check marks and annotations.                                 */
+static void normalize_ply(const char *src, char dst[S_MOVE_MAX])
+{
+    int length = (int)strcspn(src, "+#!?");
+    snprintf(dst, S_MOVE_MAX, "%.*s", length, src);
+}
+
+static int is_ply(const char *move)
+{
+    return *move != '\0' && strcmp(move, "-") != 0 && strcmp(move, "end") != 0;
+}
+
+/* Stores the plies of the first move_count moves of game_moves in plies (LINE_PLIES_MAX),
+ * normalized, up to the first missing move. Returns the number of plies.                          */
+int game_plies(const GameMoves *game_moves, int move_count, char plies[][S_MOVE_MAX])
+{
+    int count = 0;
+
+    for (int move = 0; move < move_count && move < MOVES_MAX; move++) {
+        for (int player = WHITE_PLAYER; player <= BLACK_PLAYER; player++) {
+            if (!is_ply(game_moves->moves[move][player]))
+                return count;
+            normalize_ply(game_moves->moves[move][player], plies[count++]);
+        }
+    }
+    return count;
+}
+
+/* Parses a line of SAN moves separated by spaces ("e4 e5 Nf3" or "1. e4 e5 2. Nf3", move
+ * numbers are skipped) into plies (LINE_PLIES_MAX). Returns the number of plies.                  */
+int parse_line(const char *text, char plies[][S_MOVE_MAX])
+{
+    int count = 0;
+
+    while (*text != '\0' && count < LINE_PLIES_MAX) {
+        int length;
+
+        while (isspace((unsigned char)*text))
+            text++;
+
+        // move numbers: "12." or "12..." (possibly followed by the move, "12.Nf3")...
+        const char *start = text;
+        while (isdigit((unsigned char)*start))
+            start++;
+        if (start != text && *start == '.') {
+            while (*start == '.')
+                start++;
+            text = start;
+        }
+
+        length = (int)strcspn(text, " \t\n");
+        if (length > 0) {
+            char move[S_MOVE_MAX * 2];
+            snprintf(move, sizeof(move), "%.*s", length, text);
+            normalize_ply(move, plies[count++]);
+        }
+        text += length;
+    }
+    return count;
+}
+
+/* Returns the hash (FNV-1a) of num_of_plies plies.                                                */
+long long hash_plies(const char plies[][S_MOVE_MAX], int num_of_plies)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (int i = 0; i < num_of_plies; i++) {
+        for (const char *c = plies[i]; *c != '\0'; c++) {
+            hash ^= (unsigned char)*c;
+            hash *= 1099511628211ULL;
+        }
+        hash ^= ' ';
+        hash *= 1099511628211ULL;
+    }
+    return (long long)hash;
+}
+
+/* Returns TRUE if the plies of a game contain the line of num_of_plies plies.                     */
+static int contains_line(char game[][S_MOVE_MAX], int game_length, char line[][S_MOVE_MAX], int num_of_plies)
+{
+    for (int start = 0; start + num_of_plies <= game_length; start++) {
+        int ply = 0;
+        while (ply < num_of_plies && strcmp(game[start + ply], line[ply]) == 0)
+            ply++;
+        if (ply == num_of_plies)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Intersects the sorted id lists a (count_a ids, the result) and b. Returns the new count of a.   */
+static int intersect(int a[], int count_a, const int b[], int count_b)
+{
+    int count = 0;
+
+    for (int i = 0, j = 0; i < count_a && j < count_b;) {
+        if (a[i] < b[j])
+            i++;
+        else if (a[i] > b[j])
+            j++;
+        else
+            a[count++] = a[i++], j++;
+    }
+    return count;
+}
+
+static int compare_lists(const void *a, const void *b)
+{
+    return ((const int *)a)[1] - ((const int *)b)[1];
+}
+
+/* Retrieves the ids of the games in db whose posting lists contain every window of the line
+ * into *candidates. Returns the number of candidates, or ERROR on error.                          */
+static int get_candidates(sqlite3 *db, char line[][S_MOVE_MAX], int num_of_plies, int **candidates)
+{
+    int *lists[LINE_PLIES_MAX / LINE_PLIES + 1], order[LINE_PLIES_MAX / LINE_PLIES + 1][2];
+    int num_of_lists = 0, count = 0;
+
+    for (int start = 0; start < num_of_plies; start += LINE_PLIES) {
+        // the last window ends with the line...
+        int window = (start + LINE_PLIES <= num_of_plies) ? start : num_of_plies - LINE_PLIES;
+        int length = get_line_postings(db, hash_plies(line + window, LINE_PLIES), &lists[num_of_lists]);
+
+        if (length == ERROR) {
+            for (int i = 0; i < num_of_lists; i++)
+                free(lists[i]);
+            return ERROR;
+        }
+        order[num_of_lists][0] = num_of_lists;
+        order[num_of_lists][1] = length;
+        num_of_lists++;
+    }
+
+    // the smallest list first, it bounds the result...
+    qsort(order, (size_t)num_of_lists, sizeof(order[0]), compare_lists);
+    *candidates = lists[order[0][0]];
+    count = order[0][1];
+    for (int i = 1; i < num_of_lists; i++) {
+        if (count > 0)
+            count = intersect(*candidates, count, lists[order[i][0]], order[i][1]);
+        free(lists[order[i][0]]);
+    }
+    return count;
+}
+
+/* Appends id to the array *ids of *count ids (capacity *capacity).
+ * Returns TRUE on success, FALSE on error.                                                        */
+static int append_id(int **ids, int *count, int *capacity, int id)
+{
+    if (*count == *capacity) {
+        int *grown = realloc(*ids, sizeof(int) * (*capacity * 2 + 16));
+        if (grown == NULL)
+            return FALSE;
+        *ids = grown;
+        *capacity = *capacity * 2 + 16;
+    }
+    (*ids)[(*count)++] = id;
+    return TRUE;
+}
+
+/* Checks the games from_id <= id <= to_id of db for the line and appends the matches to *ids.
+ * If candidates is not NULL, only the games in it (sorted, num_of_candidates ids) are checked.
+ * Returns TRUE on success, FALSE on error.                                                        */
+static int verify_games(sqlite3 *db, GameInfo games[], int from_id, int to_id, const int candidates[],
+                        int num_of_candidates, char line[][S_MOVE_MAX], int num_of_plies,
+                        int **ids, int *count, int *capacity, LineSearchStats *stats)
+{
+    char plies[LINE_PLIES_MAX][S_MOVE_MAX];
+    int num_of_games = get_games_in_range(db, games, from_id, to_id, NULL), next = 0;
+
+    if (num_of_games == ERROR)
+        return FALSE;
+
+    for (int i = 0; i < num_of_games; i++) {
+        if (candidates != NULL) {
+            while (next < num_of_candidates && candidates[next] < games[i].game_id)
+                next++;
+            if (next == num_of_candidates || candidates[next] != games[i].game_id)
+                continue;
+        }
+
+        int length = game_plies(&games[i].game_moves, games[i].game_moves.move_number, plies);
+        stats->candidates++;
+        if (contains_line(plies, length, line, num_of_plies) && !append_id(ids, count, capacity, games[i].game_id))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* Searches all games containing the line (SAN moves, see parse_line) anywhere, through the line
+ * index if use_index is TRUE and the line is long enough, otherwise by reading every game.
+ * The ids of the games are stored in *game_ids (allocated here, freed by the caller) in id order.
+ * Returns the number of games found, or ERROR on error.                                           */
+int find_games_with_line(const char *line, int use_index, int **game_ids, LineSearchStats *stats)
+{
+    char plies[LINE_PLIES_MAX][S_MOVE_MAX];
+    int numbers[SHARDS_MAX + 1], num_of_shards, count = 0, capacity = 0, success = TRUE;
+    GameInfo *games = malloc(sizeof(GameInfo) * LINE_CHUNK_IDS);
+    struct timespec start;
+
+    memset(stats, 0, sizeof(LineSearchStats));
+    *game_ids = NULL;
+    if (games == NULL) {
+        eprintf("ERROR: could not allocate memory for the line search...\n");
+        return ERROR;
+    }
+    if ((stats->num_of_plies = parse_line(line, plies)) == 0) {
+        free(games);
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    num_of_shards = get_shard_numbers(numbers);
+    for (int i = 0; i < num_of_shards && success; i++) {
+        int min_id, max_id;
+        sqlite3 *db;
+
+        route_to_shard(numbers[i]);
+        if (!get_id_range(&min_id, &max_id))
+            continue;
+        if (!open_database_readonly(&db)) {
+            success = FALSE;
+            break;
+        }
+
+        if (use_index && stats->num_of_plies >= LINE_PLIES) {
+            int *candidates, num_of_candidates = get_candidates(db, plies, stats->num_of_plies, &candidates);
+
+            success = (num_of_candidates != ERROR);
+            for (int c = 0, next; success && c < num_of_candidates; c = next) {
+                // dense candidates are read a chunk of ids at a time, sparse ones one by one...
+                for (next = c + 1; next < num_of_candidates && candidates[next] < candidates[c] + LINE_CHUNK_IDS;)
+                    next++;
+                if (next - c < LINE_CHUNK_IDS / 16)
+                    next = c + 1;
+
+                success = verify_games(db, games, candidates[c], (next - c > 1) ? candidates[next - 1] : candidates[c],
+                                       candidates + c, next - c, plies, stats->num_of_plies,
+                                       game_ids, &count, &capacity, stats);
+            }
+            if (num_of_candidates != ERROR)
+                free(candidates);
+        } else {
+            for (int from = min_id; success && from <= max_id; from += LINE_CHUNK_IDS)
+                success = verify_games(db, games, from, from + LINE_CHUNK_IDS - 1, NULL, 0, plies,
+                                       stats->num_of_plies, game_ids, &count, &capacity, stats);
+        }
+        sqlite3_close(db);
+    }
+    route_to_shard(0);
+    free(games);
+
+    stats->matches = count;
+    stats->milliseconds = elapsed_ms(&start);
+    if (!success) {
+        free(*game_ids);
+        *game_ids = NULL;
+        return ERROR;
+    }
+    return count;
+}
@@ -0,0 +1,29 @@
+//
+// Created by flimsy on 3/14/22.
+//
+
+#ifndef CHESSDATABASE_LINEINDEX_H
+#define CHESSDATABASE_LINEINDEX_H
+
+#include "helperFunctions.h"
+
+// Number of plies (half moves) in an indexed window.
+#define LINE_PLIES 4
+
+// Size values.
+#define LINE_PLIES_MAX (MOVES_MAX * 2)
+#define LINE_CHUNK_IDS 256
+
+typedef struct LineSearchStats {
+    int num_of_plies;
+    int candidates;         // games passed to the verification...
+    int matches;
+    double milliseconds;
+} LineSearchStats;
+
+int game_plies(const GameMoves *game_moves, int move_count, char plies[][S_MOVE_MAX]);
+int parse_line(const char *text, char plies[][S_MOVE_MAX]);
+long long hash_plies(const char plies[][S_MOVE_MAX], int num_of_plies);
+int find_games_with_line(const char *line, int use_index, int **game_ids, LineSearchStats *stats);
+
+#endif //CHESSDATABASE_LINEINDEX_H
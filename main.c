@@ -1,22 +1,590 @@
 //
 // Created by flimsy on 1/21/22.
 //
+#define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "console.h"
-#include "database.h"
+#include "chessdb.h"
+#include "movecodec.h"
+#include "checkpoint.h"
+#include "session.h"
 
-int main()
+/* Prints one line per game of the count ids game_ids (one fetch for all of them) followed by its
+ * moves if with_moves is TRUE. Returns the number of games printed, or ERROR on error.            */
+static int print_game_list(ChessDb *db, const int game_ids[], int count, int with_moves)
 {
-    if (!prepare_database()) {
+    struct timespec start, end;
+    GameBatch batch;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if ((count = chessdb_get_games(db, &batch, game_ids, count)) == ERROR)
+        return ERROR;
+
+    for (int i = 0; i < count; i++) {
+        const GameInfo *game = &batch.games[i];
+        const GameMoves *game_moves;
+
+        printf("%8d  %-8s  %-20.20s %-20.20s %-7s  %s\n", game->game_id, game->date, game->white_name,
+               game->black_name, pgn_result(game), game->name);
+        if (!with_moves)
+            continue;
+
+        // the first access reads the moves of all games...
+        if ((game_moves = chessdb_get_batch_moves(db, &batch, i)) == NULL) {
+            chessdb_free_batch(&batch);
+            return ERROR;
+        }
+        printf("         ");
+        for (int move = 0; move < game_moves->move_number; move++)
+            printf(" %d.%s %s", move + 1, game_moves->moves[move][WHITE_PLAYER], game_moves->moves[move][BLACK_PLAYER]);
+        printf("\n");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("INFO: %d games read in %.2f ms...\n", count,
+           (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6);
+    chessdb_free_batch(&batch);
+    return count;
+}
+
+/* Prints the moves of the book file path for the position after the moves (SAN, separated by
+ * spaces) of the count texts, with their weights. Returns EXIT_SUCCESS or EXIT_FAILURE.           */
+static int print_book_moves(const char *path, char *texts[], int count)
+{
+    BookEntry entries[BOOK_MOVES_MAX];
+    int num_of_entries, total = 0;
+    char san[SAN_MAX];
+    Board board;
+    Move move;
+    Book book;
+
+    board_init(&board);
+    for (int i = 0; i < count; i++) {
+        for (char *text = strtok(texts[i], " "); text != NULL; text = strtok(NULL, " ")) {
+            if (!parse_san(&board, text, &move)) {
+                eprintf("ERROR: illegal move: %s\n", text);
+                return EXIT_FAILURE;
+            }
+            make_move(&board, move);
+        }
+    }
+
+    if (!open_book(path, &book))
+        return EXIT_FAILURE;
+    num_of_entries = book_lookup(&book, polyglot_key(&board), entries, BOOK_MOVES_MAX);
+    close_book(&book);
+    if (num_of_entries == ERROR) {
+        eprintf("ERROR: could not read the book %s...\n", path);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < num_of_entries; i++)
+        total += entries[i].weight;
+    printf("INFO: %d book moves (key %016llx)...\n", num_of_entries, (unsigned long long)polyglot_key(&board));
+    for (int i = 0; i < num_of_entries; i++) {
+        if (!book_move(&board, entries[i].move, &move))
+            continue;
+        move_to_san(&board, move, san);
+        printf("\t%-8s %6d  %5.1f%%\n", san, entries[i].weight, (total > 0) ? entries[i].weight * 100.0 / total : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Runs a command given on the command line on the database handle db.
+ * Returns EXIT_SUCCESS or EXIT_FAILURE, or ERROR if there is no such command.                    */
+static int run_database_command(ChessDb *db, int argc, char *argv[])
+{
+    if (strcmp(argv[1], "export") == 0 && argc > 3) {
+        int format = (strcmp(argv[2], "pgn") == 0) ? FORMAT_PGN : (strcmp(argv[2], "csv") == 0) ? FORMAT_CSV : FALSE;
+        int num_of_threads = (argc > 4) ? atoi(argv[4]) : 4;
+        char search_word[NAME_MAX + 2];
+
+        if (!format) {
+            eprintf("ERROR: unknown export format: %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        if (argc > 5)
+            snprintf(search_word, sizeof(search_word), "%%%s%%", argv[5]);
+
+        return (chessdb_export(db, argv[3], format, (argc > 5) ? search_word : NULL, num_of_threads) == ERROR)
+               ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "import") == 0 && argc > 2) {
+        int num_of_processes = (argc > 3) ? atoi(argv[3]) : 0;
+        ImportStats stats;
+        int success = chessdb_import(db, argv[2], num_of_processes, &stats);
+
+        printf("INFO: imported %ld games (%ld skipped) with %d processes - parsing %.2f s, merging %.2f s, "
+               "indexes %.2f s (%d deferred)...\n", stats.games, stats.skipped, stats.processes,
+               stats.parse_seconds, stats.merge_seconds, stats.index_seconds, stats.deferred_indexes);
+        if (stats.cut > 0)
+            printf("INFO: %ld games stored with tag values cut to %d characters...\n", stats.cut, NAME_MAX - 1);
+        return (success) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "reclassify") == 0) {
+        int num_of_threads = (argc > 2) ? atoi(argv[2]) : 4;
+        return (chessdb_reclassify(db, num_of_threads) == ERROR) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "backup") == 0 && argc > 2) {
+        int pages_per_step = (argc > 3) ? atoi(argv[3]) : BACKUP_PAGES_PER_STEP;
+        int sleep_ms = (argc > 4) ? atoi(argv[4]) : BACKUP_SLEEP_MS;
+        return (chessdb_backup(db, argv[2], pages_per_step, sleep_ms)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "snapshot") == 0 && argc > 2) {
+        int interval_s = (argc > 3) ? atoi(argv[3]) : SNAPSHOT_INTERVAL_S;
+        int num_of_rounds = (argc > 4) ? atoi(argv[4]) : 0;
+        return (chessdb_snapshot(db, argv[2], interval_s, num_of_rounds) == ERROR) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "find-player") == 0 && argc > 2) {
+        PlayerMatch matches[FUZZY_MATCHES_MAX];
+        clock_t start;
+        int count;
+
+        // the first lookup builds the index...
+        start = clock();
+        if (chessdb_find_similar_players(db, argv[2], matches, FUZZY_MATCHES_MAX) == ERROR)
+            return EXIT_FAILURE;
+        printf("INFO: player index built in %.1f ms...\n", (double)(clock() - start) * 1e3 / CLOCKS_PER_SEC);
+
+        start = clock();
+        count = chessdb_find_similar_players(db, argv[2], matches, FUZZY_MATCHES_MAX);
+        printf("INFO: lookup took %.3f ms...\n", (double)(clock() - start) * 1e3 / CLOCKS_PER_SEC);
+        for (int i = 0; i < count; i++)
+            printf("\t%-40s %3.0f%%\n", matches[i].name, matches[i].similarity * 100);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "complete") == 0 && argc > 3) {
+        int kind = (strcmp(argv[2], "tournament") == 0) ? COMPLETE_TOURNAMENT : COMPLETE_PLAYER;
+        const char *completions[COMPLETIONS_MAX];
+        struct timespec start, end;
+        CompletionStats stats;
+        int count;
+
+        chessdb_completion_stats(db, &stats);
+        printf("INFO: %d player and %d tournament names loaded in %.1f ms (%zu KiB)...\n",
+               stats.names[COMPLETE_PLAYER], stats.names[COMPLETE_TOURNAMENT], stats.build_ms,
+               stats.bytes_used / 1024);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        count = chessdb_complete_name(db, kind, argv[3], completions, COMPLETIONS_MAX);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        printf("INFO: completion took %.1f us...\n",
+               (double)(end.tv_sec - start.tv_sec) * 1e6 + (double)(end.tv_nsec - start.tv_nsec) / 1e3);
+        for (int i = 0; i < count; i++)
+            printf("\t%s\n", completions[i]);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "delete-games") == 0 && argc > 3) {
+        const char *tournament = NULL, *player = NULL;
+        int from_date = 0, to_date = 0;
+        BulkCounts counts;
+
+        if (strcmp(argv[2], "tournament") == 0)
+            tournament = argv[3];
+        else if (strcmp(argv[2], "player") == 0)
+            player = argv[3];
+        else if (strcmp(argv[2], "date") == 0 && argc > 4) {
+            from_date = pack_date(argv[3]);
+            to_date = pack_date(argv[4]);
+            if (!from_date || !to_date) {
+                eprintf("ERROR: date not recognized (yyyy, yyyymm or yyyymmdd)...\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            eprintf("ERROR: unknown filter: %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+
+        if (!chessdb_delete_games_matching(db, tournament, player, from_date, to_date, &counts))
+            return EXIT_FAILURE;
+        printf("INFO: deleted %d games, %d moves and %d single moves...\n",
+               counts.games, counts.moves, counts.single_moves);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "rename") == 0 && argc > 4) {
+        int kind = (strcmp(argv[2], "player") == 0) ? COMPLETE_PLAYER
+                 : (strcmp(argv[2], "tournament") == 0) ? COMPLETE_TOURNAMENT : ERROR;
+        BulkCounts counts;
+
+        if (kind == ERROR) {
+            eprintf("ERROR: unknown name kind: %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        if (!chessdb_rename(db, kind, argv[3], argv[4], &counts))
+            return EXIT_FAILURE;
+        printf("INFO: renamed '%s' to '%s' in %d games...\n", argv[3], argv[4], counts.games);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "find-line") == 0 && argc > 2) {
+        int use_index = !(argc > 3 && strcmp(argv[3], "scan") == 0), *game_ids, count;
+        LineSearchStats stats;
+
+        if ((count = chessdb_find_games_with_line(db, argv[2], use_index, &game_ids, &stats)) == ERROR)
+            return EXIT_FAILURE;
+
+        printf("INFO: %d games contain the line (%d plies), %d games checked in %.2f ms...\n",
+               count, stats.num_of_plies, stats.candidates, stats.milliseconds);
+        count = print_game_list(db, game_ids, (count < SAMPLE_MAX) ? count : SAMPLE_MAX, FALSE);
+        free(game_ids);
+        return (count == ERROR) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "filter-games") == 0 && argc > 3) {
+        HeaderFilter filter = {0};
+        HeaderFilterStats stats;
+        int *game_ids, count;
+
+        // conditions as pairs ("player <name>"), but "date <from> <to>"...
+        for (int i = 2; i < argc; i += 2) {
+            if (strcmp(argv[i], "date") == 0 && i + 2 < argc) {
+                filter.from_date = pack_date(argv[i + 1]);
+                filter.to_date = pack_date(argv[++i + 1]);
+                if (!filter.from_date || !filter.to_date) {
+                    eprintf("ERROR: date not recognized (yyyy, yyyymm or yyyymmdd)...\n");
+                    return EXIT_FAILURE;
+                }
+            } else if (strcmp(argv[i], "player") == 0 && i + 1 < argc) {
+                filter.player = argv[i + 1];
+            } else if (strcmp(argv[i], "white") == 0 && i + 1 < argc) {
+                filter.white = argv[i + 1];
+            } else if (strcmp(argv[i], "black") == 0 && i + 1 < argc) {
+                filter.black = argv[i + 1];
+            } else if (strcmp(argv[i], "tournament") == 0 && i + 1 < argc) {
+                filter.tournament = argv[i + 1];
+            } else if (strcmp(argv[i], "result") == 0 && i + 1 < argc && strcmp(argv[i + 1], "1-0") == 0) {
+                filter.outcomes |= OUTCOME_BIT(OUTCOME_WHITE_WINS);
+            } else if (strcmp(argv[i], "result") == 0 && i + 1 < argc && strcmp(argv[i + 1], "0-1") == 0) {
+                filter.outcomes |= OUTCOME_BIT(OUTCOME_BLACK_WINS);
+            } else if (strcmp(argv[i], "result") == 0 && i + 1 < argc && strcmp(argv[i + 1], "1/2-1/2") == 0) {
+                filter.outcomes |= OUTCOME_BIT(OUTCOME_DRAW);
+            } else {
+                eprintf("ERROR: unknown condition: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        if ((count = chessdb_filter_headers(db, &filter, &game_ids, &stats)) == ERROR)
+            return EXIT_FAILURE;
+
+        printf("INFO: %d of %d games match (%s kernels), built in %.2f ms, filtered in %.2f ms...\n",
+               count, stats.games, stats.kernels, stats.build_ms, stats.filter_ms);
+        count = print_game_list(db, game_ids, (count < SAMPLE_MAX) ? count : SAMPLE_MAX, FALSE);
+        free(game_ids);
+        return (count == ERROR) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "games") == 0 && argc > 2) {
+        int with_moves = strcmp(argv[argc - 1], "moves") == 0, num_of_ids = 0;
+        int *game_ids = malloc(sizeof(int) * argc);
+
+        // ids ("12") and id ranges ("100-200")...
+        for (int i = 2; game_ids != NULL && i < argc - with_moves; i++) {
+            int from, to;
+            if (sscanf(argv[i], "%d-%d", &from, &to) == 2 && from <= to) {
+                int *grown = realloc(game_ids, sizeof(int) * (num_of_ids + (to - from + 1) + argc));
+                if (grown == NULL) {
+                    free(game_ids);
+                    game_ids = NULL;
+                    break;
+                }
+                game_ids = grown;
+                for (int id = from; id <= to; id++)
+                    game_ids[num_of_ids++] = id;
+            }
+            else
+                game_ids[num_of_ids++] = atoi(argv[i]);
+        }
+        if (game_ids == NULL) {
+            eprintf("ERROR: could not allocate memory for the game ids...\n");
+            return EXIT_FAILURE;
+        }
+
+        int count = print_game_list(db, game_ids, num_of_ids, with_moves);
+        free(game_ids);
+        return (count == ERROR) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "analyse") == 0 && argc > 2) {
+        int num_of_engines = (argc > 3) ? atoi(argv[3]) : ANALYSIS_ENGINES;
+        AnalysisBudget budget = {ANALYSIS_DEPTH, 0, ANALYSIS_TIMEOUT_MS};
+        AnalysisStats stats;
+
+        // the budget is a depth ("16") or a time per position ("500ms")...
+        if (argc > 4) {
+            int value = atoi(argv[4]);
+            if (strstr(argv[4], "ms") != NULL)
+                budget.movetime_ms = value;
+            else
+                budget.depth = value;
+        }
+
+        return (chessdb_analyse(db, argv[2], num_of_engines, budget, &stats) == ERROR) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "evaluations") == 0 && argc > 2) {
+        return (chessdb_print_evaluations(db, atoi(argv[2]))) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "position") == 0 && argc > 3) {
+        GameInfo *game = calloc(1, sizeof(GameInfo));
+        char fen[FEN_MAX];
+        Board board;
+        int success;
+
+        if (game == NULL)
+            return EXIT_FAILURE;
+        game->game_id = atoi(argv[2]);
+        success = chessdb_get_game(db, game) && get_position_at_ply(&game->game_moves, atoi(argv[3]), &board);
+        if (success) {
+            board_to_fen(&board, fen);
+            printf("%s\n", fen);
+        }
+        else
+            eprintf("ERROR: no position at ply %s of game id(%s)...\n", argv[3], argv[2]);
+        free(game);
+        return (success) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "book") == 0 && argc > 2) {
+        BookOptions options;
+        BookStats stats;
+
+        book_default_options(&options);
+        if (argc > 3)
+            options.max_plies = atoi(argv[3]);
+        if (argc > 4)
+            options.min_games = atoi(argv[4]);
+        if (argc > 5)
+            options.memory_budget = (size_t)atoi(argv[5]) << 20;
+        if (options.max_plies <= 0 || options.memory_budget == 0) {
+            eprintf("ERROR: invalid number of plies or memory budget...\n");
+            return EXIT_FAILURE;
+        }
+
+        if (chessdb_build_book(db, argv[2], &options, &stats) == ERROR)
+            return EXIT_FAILURE;
+        printf("INFO: book of %ld entries from %ld moves of %ld games written in %.1f ms (%d runs spilled)...\n",
+               stats.entries, stats.moves, stats.games, stats.milliseconds, stats.runs);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "record") == 0 && argc > 2) {
+        return (record_session(db, argv[2])) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "shard") == 0 && argc > 2) {
+        int mode = (strcmp(argv[2], "year") == 0) ? SHARD_BY_YEAR
+                 : (strcmp(argv[2], "tournament") == 0) ? SHARD_BY_TOURNAMENT : SHARD_NONE;
+        if (mode == SHARD_NONE) {
+            eprintf("ERROR: unknown sharding mode: %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        return (chessdb_enable_sharding(db, mode)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "shards") == 0) {
+        return (chessdb_print_shards(db)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "vacuum") == 0) {
+        return (chessdb_vacuum(db, (argc > 2) ? argv[2] : NULL)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "maintain") == 0) {
+        return (chessdb_maintain(db, TRUE)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    return ERROR;
+}
+
+/* Prints what the maintenance of db did and what it cost.                                         */
+static void print_maintenance_stats(ChessDb *db)
+{
+    MaintenanceStats stats;
+
+    chessdb_maintenance_stats(db, &stats);
+    printf("INFO: maintenance - slices: %ld, analysed tables: %ld, optimizations: %ld, vacuumed pages: %ld, "
+           "locked: %ld (%.1f ms, longest slice %.1f ms)\n", stats.slices, stats.analyzed_tables,
+           stats.optimizations, stats.vacuumed_pages, stats.busy_slices, stats.total_ms, stats.longest_ms);
+}
+
+/* Returns TRUE if argv[1] is a command working on the database (with enough arguments),
+ * FALSE otherwise.                                                                                */
+static int is_database_command(int argc, char *argv[])
+{
+    static const struct {
+        const char *name;
+        int min_argc;
+    } commands[] = {
+        {"export", 4}, {"import", 3}, {"reclassify", 2}, {"backup", 3}, {"snapshot", 3}, {"find-player", 3},
+        {"complete", 4}, {"delete-games", 4}, {"rename", 5}, {"find-line", 3}, {"filter-games", 4},
+        {"analyse", 3}, {"evaluations", 3}, {"position", 4}, {"games", 3}, {"book", 3}, {"record", 3},
+        {"shard", 3}, {"shards", 2}, {"vacuum", 2}, {"maintain", 2}
+    };
+
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (strcmp(argv[1], commands[i].name) == 0 && argc >= commands[i].min_argc)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Runs a command given on the command line instead of the terminal edition.
+ * Returns EXIT_SUCCESS or EXIT_FAILURE.                                                           */
+int run_command(int argc, char *argv[])
+{
+    if (strcmp(argv[1], "bench-codec") == 0) {
+        int num_of_games = (argc > 2) ? atoi(argv[2]) : 1000;
+        if (num_of_games <= 0) {
+            eprintf("ERROR: invalid number of games: %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        benchmark_move_codec(num_of_games);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "replay") == 0 && argc > 2) {
+        int num_of_processes = (argc > 3) ? atoi(argv[3]) : 1;
+        double pace = (argc > 4) ? atof(argv[4]) : 0;
+        ReplayStats stats;
+        Trace trace;
+        int success;
+
+        if (!load_trace(argv[2], &trace))
+            return EXIT_FAILURE;
+        success = replay_sessions(DATABASE_FILE, &trace, num_of_processes, pace, &stats);
+        free_trace(&trace);
+
+        printf("INFO: %d sessions (%d failed), %ld operations in %.3f s (%.1f operations/s)...\n",
+               stats.sessions, stats.failed, stats.operations, stats.seconds,
+               (stats.seconds > 0) ? (double)stats.operations / stats.seconds : 0.0);
+        printf("\t%-32s %8s %10s %10s %10s %10s\n", "operation", "count", "p50 ms", "p90 ms", "p99 ms", "max ms");
+        for (int i = 0; i < stats.num_of_latencies; i++) {
+            const OperationLatency *latency = &stats.latencies[i];
+            printf("\t%-32s %8ld %10.3f %10.3f %10.3f %10.3f\n", latency->operation, latency->count,
+                   latency->p50_ms, latency->p90_ms, latency->p99_ms, latency->max_ms);
+        }
+        return (success && stats.failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "book-moves") == 0 && argc > 2)
+        return print_book_moves(argv[2], argv + 3, argc - 3);
+
+    if (is_database_command(argc, argv)) {
+        ChessDbOptions options;
+        ChessDb *db;
+        int status;
+
+        chessdb_default_options(&options);
+        options.load_completions = (strcmp(argv[1], "complete") == 0 || strcmp(argv[1], "record") == 0);
+        if (strcmp(argv[1], "record") != 0)
+            options.maintenance.interval_ms = 0;
+        if (!chessdb_open(DATABASE_FILE, &options, &db))
+            return EXIT_FAILURE;
+        status = run_database_command(db, argc, argv);
+
+        // a batch command is followed by the maintenance it made due...
+        if (status == EXIT_SUCCESS && !chessdb_maintain(db, FALSE))
+            status = EXIT_FAILURE;
+        if (status != ERROR)
+            print_maintenance_stats(db);
+        chessdb_close(db);
+        if (status != ERROR)
+            return status;
+    }
+
+    eprintf("Usage: %s [command]\n", argv[0]);
+    eprintf("Commands:\n");
+    eprintf("\tbench-codec [games]    benchmark move compression on random games.\n");
+    eprintf("\texport <pgn|csv> <file> [threads] [search]\n"
+            "\t                       export all (or the matching) games ordered by id.\n");
+    eprintf("\timport <pgn> [processes] import the games of a PGN file, parsed by processes in parallel.\n");
+    eprintf("\treclassify [threads]   classify the openings of all games again.\n");
+    eprintf("\tbackup <file> [pages] [sleep ms]\n"
+            "\t                       copy the database while it stays in use.\n");
+    eprintf("\tsnapshot <dir> [interval s] [rounds]\n"
+            "\t                       take a backup every interval, if anything changed.\n");
+    eprintf("\tfind-player <name>     list the player names most similar to name.\n");
+    eprintf("\tcomplete <player|tournament> <prefix>\n"
+            "\t                       list the most used names starting with prefix.\n");
+    eprintf("\tdelete-games <tournament|player> <pattern>, delete-games date <from> <to>\n"
+            "\t                       delete all matching games (LIKE pattern) at once.\n");
+    eprintf("\trename <player|tournament> <old> <new>\n"
+            "\t                       rename a player or tournament in all games.\n");
+    eprintf("\tfind-line <moves> [scan] list the games containing the line (\"e4 e5 Nf3 Nc6\"),\n"
+            "\t                       through the line index or (scan) by reading every game.\n");
+    eprintf("\tfilter-games <condition> <value>...\n"
+            "\t                       list the games matching all conditions, through the in-memory header\n"
+            "\t                       store: date <from> <to>, player, white, black, tournament <name>\n"
+            "\t                       or result <1-0|0-1|1/2-1/2>.\n");
+    eprintf("\tanalyse <engine> [engines] [depth|<ms>ms]\n"
+            "\t                       evaluate the positions of all games with a pool of UCI engines.\n");
+    eprintf("\tevaluations <game id>  list the moves of a game with the stored evaluations.\n");
+    eprintf("\tposition <game id> <ply> print the position (FEN) after ply plies of a game.\n");
+    eprintf("\tgames <id|from-to>... [moves]\n"
+            "\t                       list the games (and their moves) with the given ids.\n");
+    eprintf("\tbook <file> [plies] [min games] [memory MiB]\n"
+            "\t                       write a Polyglot opening book of the first plies of all games.\n");
+    eprintf("\tbook-moves <file> [moves] list the book moves after the moves (\"e4 e5 Nf3\").\n");
+    eprintf("\trecord <trace>         run the terminal edition, recording what is typed to trace.\n");
+    eprintf("\treplay <trace> [processes] [pace]\n"
+            "\t                       replay a recorded session in parallel processes (pace 0: no pauses,\n"
+            "\t                       1: as recorded) and list the latencies of the calls.\n");
+    eprintf("\tshard <year|tournament> split the database into one file per year or tournament bucket.\n");
+    eprintf("\tshards                 list the shards and their number of games.\n");
+    eprintf("\tvacuum [shard]         compact all shards (or one shard, by key).\n");
+    eprintf("\tmaintain               renew the statistics and give back all free pages now.\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    ChessDbOptions options;
+    CompletionStats completion_stats;
+    CacheStats stats;
+    ChessDb *db;
+
+    if (argc > 1)
+        return run_command(argc, argv);
+
+    // names for completion while typing...
+    chessdb_default_options(&options);
+    options.load_completions = TRUE;
+    if (!chessdb_open(DATABASE_FILE, &options, &db)) {
         printf("INFO: database preparations failed!\n");
         exit(EXIT_FAILURE);
     }
 
     printf("INFO: database preparations was successful!\n");
-    run_terminal_edition();
+
+    chessdb_completion_stats(db, &completion_stats);
+    printf("INFO: %d player and %d tournament names loaded in %.1f ms (%zu KiB)...\n",
+           completion_stats.names[COMPLETE_PLAYER], completion_stats.names[COMPLETE_TOURNAMENT],
+           completion_stats.build_ms, completion_stats.bytes_used / 1024);
+
+    run_terminal_edition(db);
+
+    chessdb_cache_stats(db, &stats);
+    printf("INFO: result cache - hits: %lu, misses: %lu, evictions: %lu, entries: %d (%zu/%zu bytes)\n",
+           stats.hits, stats.misses, stats.evictions, stats.entries, stats.bytes_used, stats.budget);
+    printf("INFO: statement cache - hits: %lu, misses: %lu\n", stats.statement_hits, stats.statement_misses);
+    print_maintenance_stats(db);
+    chessdb_close(db);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,420 @@
+//
+// Created by flimsy on 3/18/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sqlite3.h>
+
+#include "maintenance.h"
+#include "context.h"
+#include "database.h"
+
+/* ********** MAINTENANCE **********
+ * The rows written through a handle are counted, and after as many as the policy says the query
+ * planner statistics are renewed (ANALYZE) and PRAGMA optimize is run. Files with more free pages
+ * than free_percent of their pages give them back (incremental vacuum; databases created since,
+ * or rebuilt once by the vacuum command, have auto_vacuum = INCREMENTAL). Files never analysed
+ * are analysed first. The work is done in slices of at most about slice_ms: ANALYZE a table at a
+ * time with analysis_limit set, PRAGMA optimize a file at a time, incremental_vacuum
+ * MAINTENANCE_VACUUM_PAGES pages at a time. Before every file and step the time is checked, a
+ * step is only started if one as long as the recent ones still fits in the slice (the first step
+ * of a slice always is), the work left is continued by the next slice, as is a step finding the
+ * database locked by another connection. The slices run on a background thread every
+ * interval_ms, holding the handle's lock, or one after the other between batch commands. The
+ * counts are kept in memory, a new handle starts at 0.                                            */
+
+static const char selectTableNames[] = "SELECT name FROM sqlite_master "
+                                       "WHERE type = 'table' AND name NOT LIKE 'sqlite_%' ORDER BY name;";
+
+static const char selectStatisticsExist[] = "SELECT 1 FROM sqlite_master WHERE name = 'sqlite_stat1';";
+
+static double elapsed_ms(const struct timespec *from)
+{
+    struct timespec to;
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    return (double)(to.tv_sec - from->tv_sec) * 1e3 + (double)(to.tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/* Ends the running step of the slice started at start, and starts the next one if a step as long
+ * as the recent ones fits in slice_ms. Returns TRUE if the next step may start, FALSE if not.     */
+static int next_step(Maintenance *m, const struct timespec *start, int slice_ms)
+{
+    struct timespec now;
+    double step_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (m->slice_steps > 0) {
+        // a longer step is expected at once, a shorter one is taken in halfway...
+        step_ms = (double)(now.tv_sec - m->step_started.tv_sec) * 1e3 +
+                  (double)(now.tv_nsec - m->step_started.tv_nsec) / 1e6;
+        m->step_ms = (step_ms > m->step_ms) ? step_ms : (m->step_ms + step_ms) / 2;
+        if (elapsed_ms(start) + m->step_ms >= slice_ms)
+            return FALSE;
+    }
+    m->step_started = now;
+    m->slice_steps++;
+    return TRUE;
+}
+
+/* Returns the integer result of the PRAGMA statement sql on db, or ERROR on error.                */
+static int pragma_int(sqlite3 *db, const char *sql)
+{
+    sqlite3_stmt *stmt;
+    int value = ERROR;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+/* Stores the paths of all files of the current handle (chess.db and the shards) in paths.
+ * Returns their number.                                                                           */
+static int get_file_paths(const char *paths[])
+{
+    int count = 0;
+
+    paths[count++] = current_db()->catalog_path;
+    for (int i = 0; i < get_num_of_shards(); i++)
+        paths[count++] = get_shard(i)->path;
+    return count;
+}
+
+/* Adds rows to the rows written through the current handle.                                       */
+void count_writes(long rows)
+{
+    current_db()->maintenance.writes += rows;
+}
+
+/* Opens the file path for maintenance, ANALYZE limited to MAINTENANCE_ANALYSIS_LIMIT rows per
+ * index. Returns TRUE on success and FALSE on error.                                              */
+static int open_for_maintenance(const char *path, sqlite3 **db)
+{
+    char sql[64], *err_msg = 0;
+
+    if (!open_database_path(path, db, FALSE))
+        return FALSE;
+    snprintf(sql, sizeof(sql), "PRAGMA analysis_limit = %d;", MAINTENANCE_ANALYSIS_LIMIT);
+    return !is_exec_error(db, sqlite3_exec(*db, sql, 0, 0, &err_msg), &err_msg);
+}
+
+/* Runs the maintenance step sql on db. Returns TRUE on success, FALSE if the database is locked
+ * (the step is left to a later slice), ERROR on error. db is closed unless TRUE is returned.      */
+static int run_step(Maintenance *m, sqlite3 *db, const char *sql)
+{
+    int status = sqlite3_exec(db, sql, 0, 0, NULL);
+
+    if (status == SQLITE_OK)
+        return TRUE;
+    if (status == SQLITE_BUSY || status == SQLITE_LOCKED) {
+        m->busy = TRUE;
+        m->stats.busy_slices++;
+        sqlite3_close(db);
+        return FALSE;
+    }
+    eprintf("SQL error: %s\n", sqlite3_errmsg(db));
+    sqlite3_close(db);
+    return ERROR;
+}
+
+/* Returns TRUE if a file of paths was never analysed, FALSE otherwise, ERROR on error.            */
+static int is_analysis_missing(const char *paths[], int num_of_paths)
+{
+    for (int i = 0; i < num_of_paths; i++) {
+        sqlite3 *db;
+        sqlite3_stmt *stmt;
+        int exists;
+
+        if (!open_database_path(paths[i], &db, TRUE))
+            return ERROR;
+        if (sqlite3_prepare_v2(db, selectStatisticsExist, -1, &stmt, 0) != SQLITE_OK) {
+            sqlite3_close(db);
+            return ERROR;
+        }
+        exists = (sqlite3_step(stmt) == SQLITE_ROW);
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        if (!exists)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Continues the ANALYZE pass of m over paths, a table at a time, until it is done or slice_ms
+ * passed since start. Returns TRUE if the pass is done, FALSE if not, ERROR on error.             */
+static int analyze_slice(Maintenance *m, const char *paths[], int num_of_paths, const struct timespec *start,
+                         int slice_ms)
+{
+    char names[MAINTENANCE_TABLES_MAX][NAME_MAX], sql[NAME_MAX + 16];
+
+    for (; m->next_file < num_of_paths; m->next_file++, m->next_table = 0) {
+        sqlite3_stmt *stmt;
+        int num_of_tables = 0, status;
+        sqlite3 *db;
+
+        if (!next_step(m, start, slice_ms))
+            return FALSE;
+        if (!open_for_maintenance(paths[m->next_file], &db))
+            return ERROR;
+        if (sqlite3_prepare_v2(db, selectTableNames, -1, &stmt, 0) != SQLITE_OK) {
+            eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+            sqlite3_close(db);
+            return ERROR;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW && num_of_tables < MAINTENANCE_TABLES_MAX)
+            copy_column_text(names[num_of_tables++], stmt, 0, NAME_MAX);
+        sqlite3_finalize(stmt);
+
+        for (; m->next_table < num_of_tables; m->next_table++) {
+            if (!next_step(m, start, slice_ms)) {
+                sqlite3_close(db);
+                return FALSE;
+            }
+            snprintf(sql, sizeof(sql), "ANALYZE \"%s\";", names[m->next_table]);
+            if ((status = run_step(m, db, sql)) != TRUE)
+                return status;
+            m->stats.analyzed_tables++;
+        }
+        sqlite3_close(db);
+    }
+    return TRUE;
+}
+
+/* Continues the optimize pass of m over paths, a file at a time, until it is done or slice_ms
+ * passed since start. Returns TRUE if the pass is done, FALSE if not, ERROR on error.             */
+static int optimize_slice(Maintenance *m, const char *paths[], int num_of_paths, const struct timespec *start,
+                          int slice_ms)
+{
+    for (; m->next_file < num_of_paths; m->next_file++) {
+        sqlite3 *db;
+        int status;
+
+        if (!next_step(m, start, slice_ms))
+            return FALSE;
+        if (!open_for_maintenance(paths[m->next_file], &db))
+            return ERROR;
+        if ((status = run_step(m, db, "PRAGMA optimize;")) != TRUE)
+            return status;
+        sqlite3_close(db);
+        m->stats.optimizations++;
+    }
+    return TRUE;
+}
+
+/* Gives back the free pages of the files of paths with more than free_percent free (every free
+ * page if force is TRUE) until slice_ms passed since start.
+ * Returns TRUE if free pages are left to give back, FALSE if not, ERROR on error.                 */
+static int vacuum_slice(Maintenance *m, const char *paths[], int num_of_paths, int free_percent, int force,
+                        const struct timespec *start, int slice_ms)
+{
+    char sql[64];
+
+    snprintf(sql, sizeof(sql), "PRAGMA incremental_vacuum(%d);", MAINTENANCE_VACUUM_PAGES);
+    for (int i = 0; i < num_of_paths; i++) {
+        int free_pages, page_count;
+        sqlite3 *db;
+
+        // (the files are checked from the first again, the ones done have nothing left)...
+        if (!next_step(m, start, slice_ms))
+            return TRUE;
+        if (!open_database_path(paths[i], &db, FALSE))
+            return ERROR;
+
+        // without auto_vacuum = INCREMENTAL pages are only given back by a full VACUUM...
+        free_pages = pragma_int(db, "PRAGMA freelist_count;");
+        page_count = pragma_int(db, "PRAGMA page_count;");
+        if (pragma_int(db, "PRAGMA auto_vacuum;") != 2 || free_pages <= 0 ||
+            (!force && (long)free_pages * 100 < (long)free_percent * page_count)) {
+            sqlite3_close(db);
+            continue;
+        }
+
+        while (free_pages > 0) {
+            if (!next_step(m, start, slice_ms)) {
+                sqlite3_close(db);
+                return TRUE;
+            }
+            int status = run_step(m, db, sql);
+            if (status != TRUE)
+                return (status == FALSE) ? TRUE : ERROR;
+            int left = pragma_int(db, "PRAGMA freelist_count;");
+            m->stats.vacuumed_pages += free_pages - left;
+            free_pages = left;
+        }
+        sqlite3_close(db);
+    }
+    return FALSE;
+}
+
+/* Runs the maintenance due for the current handle for about slice_ms of the policy (every free
+ * page given back if force is TRUE). Returns TRUE if more is due, FALSE if not, ERROR on error.   */
+static int run_slice(int force)
+{
+    Maintenance *m = &current_db()->maintenance;
+    const MaintenancePolicy *policy = &current_db()->options.maintenance;
+    const char *paths[SHARDS_MAX + 1];
+    int num_of_paths = get_file_paths(paths), worked = FALSE, vacuum_left = FALSE, status;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    m->slice_steps = 0;
+    m->busy = FALSE;
+    if (!m->checked_statistics) {
+        if ((status = is_analysis_missing(paths, num_of_paths)) == ERROR)
+            return ERROR;
+        m->checked_statistics = TRUE;
+        if (status)
+            m->analyzed_writes = m->writes - policy->analyze_writes;
+    }
+
+    if (!m->analyzing && !m->optimizing && m->writes - m->analyzed_writes >= policy->analyze_writes) {
+        m->analyzing = TRUE;
+        m->pass_writes = m->writes;
+        m->next_file = m->next_table = 0;
+    }
+    if (m->analyzing) {
+        if ((status = analyze_slice(m, paths, num_of_paths, &start, policy->slice_ms)) == ERROR)
+            return ERROR;
+        if (status) {
+            m->analyzing = FALSE;
+            m->analyzed_writes = m->optimized_writes = m->pass_writes;
+        }
+        worked = TRUE;
+    }
+
+    if (!m->analyzing && !m->optimizing && m->writes - m->optimized_writes >= policy->optimize_writes) {
+        m->optimizing = TRUE;
+        m->pass_writes = m->writes;
+        m->next_file = 0;
+    }
+    if (!m->analyzing && m->optimizing && elapsed_ms(&start) < policy->slice_ms) {
+        if ((status = optimize_slice(m, paths, num_of_paths, &start, policy->slice_ms)) == ERROR)
+            return ERROR;
+        if (status) {
+            m->optimizing = FALSE;
+            m->optimized_writes = m->pass_writes;
+        }
+        worked = TRUE;
+    }
+
+    if (elapsed_ms(&start) < policy->slice_ms) {
+        long vacuumed = m->stats.vacuumed_pages;
+        if ((vacuum_left = vacuum_slice(m, paths, num_of_paths, policy->free_percent, force, &start,
+                                        policy->slice_ms)) == ERROR)
+            return ERROR;
+        worked = worked || m->stats.vacuumed_pages > vacuumed;
+    }
+
+    if (worked) {
+        double milliseconds = elapsed_ms(&start);
+        m->stats.slices++;
+        m->stats.total_ms += milliseconds;
+        if (milliseconds > m->stats.longest_ms)
+            m->stats.longest_ms = milliseconds;
+    }
+    return m->analyzing || m->optimizing || vacuum_left || m->writes - m->optimized_writes >= policy->optimize_writes;
+}
+
+/* Runs slices until no maintenance is due for the current handle, or until the database is found
+ * locked (the rest is left to later slices). With force TRUE it is all done now: the statistics
+ * are renewed and every free page is given back. Returns TRUE on success and FALSE on error.      */
+int run_maintenance(int force)
+{
+    Maintenance *m = &current_db()->maintenance;
+    int status;
+
+    if (force && !m->analyzing) {
+        m->analyzed_writes = m->writes - current_db()->options.maintenance.analyze_writes;
+        m->checked_statistics = TRUE;
+    }
+    while ((status = run_slice(force)) == TRUE && !m->busy)
+        ;
+    if (status == TRUE)
+        printf("INFO: the database is locked, the maintenance is continued later...\n");
+    return status != ERROR;
+}
+
+static void *maintenance_worker(void *arg)
+{
+    ChessDb *db = arg;
+    Maintenance *m = &db->maintenance;
+
+    pthread_mutex_lock(&m->lock);
+    while (!m->stop) {
+        struct timespec until;
+
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += db->options.maintenance.interval_ms / 1000;
+        until.tv_nsec += (long)(db->options.maintenance.interval_ms % 1000) * 1000000;
+        if (until.tv_nsec >= 1000000000) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&m->wake, &m->lock, &until);
+        if (m->stop)
+            break;
+        pthread_mutex_unlock(&m->lock);
+
+        // a slice is a call on the handle, other calls wait for it...
+        pthread_mutex_lock(&db->lock);
+        ChessDb *previous = use_db(db);
+        int status = run_slice(FALSE);
+        use_db(previous);
+        pthread_mutex_unlock(&db->lock);
+
+        // (a locked database is retried by the next slice, an error is not)...
+        pthread_mutex_lock(&m->lock);
+        if (status == ERROR) {
+            eprintf("ERROR: maintenance of %s failed, the background maintenance is stopped...\n",
+                    db->catalog_path);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&m->lock);
+    return NULL;
+}
+
+/* Starts the background thread running the maintenance of db every interval_ms of its policy.
+ * Returns TRUE on success and FALSE on error.                                                     */
+int start_maintenance(ChessDb *db)
+{
+    Maintenance *m = &db->maintenance;
+
+    if (m->running || db->options.maintenance.interval_ms <= 0)
+        return TRUE;
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->wake, NULL);
+    m->stop = FALSE;
+    if (pthread_create(&m->thread, NULL, maintenance_worker, db) != 0) {
+        eprintf("ERROR: could not start the maintenance thread...\n");
+        pthread_mutex_destroy(&m->lock);
+        pthread_cond_destroy(&m->wake);
+        return FALSE;
+    }
+    m->running = TRUE;
+    return TRUE;
+}
+
+/* Stops the background maintenance thread of db, waiting for a running slice to end. Must not be
+ * called holding the lock of db.                                                                  */
+void stop_maintenance(ChessDb *db)
+{
+    Maintenance *m = &db->maintenance;
+
+    if (!m->running)
+        return;
+    pthread_mutex_lock(&m->lock);
+    m->stop = TRUE;
+    pthread_cond_signal(&m->wake);
+    pthread_mutex_unlock(&m->lock);
+
+    pthread_join(m->thread, NULL);
+    pthread_mutex_destroy(&m->lock);
+    pthread_cond_destroy(&m->wake);
+    m->running = FALSE;
+}
@@ -0,0 +1,75 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#ifndef CHESSDATABASE_MAINTENANCE_H
+#define CHESSDATABASE_MAINTENANCE_H
+
+#include <pthread.h>
+#include <time.h>
+
+#include "helperFunctions.h"
+
+// Default policy.
+#define MAINTENANCE_ANALYZE_WRITES 1000
+#define MAINTENANCE_OPTIMIZE_WRITES 100
+#define MAINTENANCE_FREE_PERCENT 10
+#define MAINTENANCE_SLICE_MS 50
+#define MAINTENANCE_INTERVAL_MS 2000
+
+// Size values. ANALYZE reads about MAINTENANCE_ANALYSIS_LIMIT rows of each index.
+#define MAINTENANCE_ANALYSIS_LIMIT 1000
+#define MAINTENANCE_VACUUM_PAGES 64
+#define MAINTENANCE_TABLES_MAX 32
+
+typedef struct MaintenancePolicy {
+    int analyze_writes;         // rows written before the statistics are renewed (ANALYZE)...
+    int optimize_writes;        // rows written before PRAGMA optimize...
+    int free_percent;           // share of free pages at which a file gives them back...
+    int slice_ms;               // how long a slice may take...
+    int interval_ms;            // between the slices of the background thread, 0 for no thread...
+} MaintenancePolicy;
+
+typedef struct MaintenanceStats {
+    long slices;
+    long analyzed_tables;
+    long optimizations;
+    long vacuumed_pages;
+    long busy_slices;           // slices that found the database locked...
+    double total_ms;
+    double longest_ms;
+} MaintenanceStats;
+
+/* The maintenance state of a database handle. An ANALYZE pass goes through the tables of every
+ * file, an optimize pass through the files, next_file and next_table are where the next slice
+ * continues the running pass. A pass does not start while the other one runs.                     */
+typedef struct Maintenance {
+    long writes;                // rows written through the handle...
+    long analyzed_writes;       // writes when the last ANALYZE pass started...
+    long optimized_writes;
+    int analyzing;
+    int optimizing;
+    long pass_writes;           // writes when the running pass started...
+    int next_file;
+    int next_table;
+    int checked_statistics;     // the files were checked for statistics (sqlite_stat1)...
+    int slice_steps;            // steps started by the running slice...
+    int busy;                   // the running slice found the database locked...
+    struct timespec step_started;
+    double step_ms;             // expected length of a step...
+    pthread_t thread;
+    pthread_mutex_t lock;       // of stop and wake...
+    pthread_cond_t wake;
+    int running;
+    int stop;
+    MaintenanceStats stats;
+} Maintenance;
+
+struct ChessDb;
+
+void count_writes(long rows);
+int run_maintenance(int force);
+int start_maintenance(struct ChessDb *db);
+void stop_maintenance(struct ChessDb *db);
+
+#endif //CHESSDATABASE_MAINTENANCE_H
@@ -0,0 +1,483 @@
+//
+// Created by flimsy on 2/21/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "chess.h"
+#include "movecodec.h"
+
+/* ********** MOVE CODEC **********
+ * A game is packed as: format version (1 byte), number of plies (varint) and the range coded
+ * index of every ply in the legal move list of its position. The legal moves are ordered by a
+ * cheap, deterministic heuristic (captures, promotions, castling, centralization) so that played
+ * moves tend to get small indexes. Indexes are binarized as a bucket number (unary, bucket k holds
+ * indexes 2^k - 1 ... 2^(k+1) - 2) followed by the offset inside the bucket, and every binary
+ * decision is coded with an adaptive probability.
+ *
+ * Only games in canonical SAN (as produced by move_to_san) are packed, so decoding gives back
+ * exactly the stored text. Anything else is left for the single_move table.                      */
+
+#define PROB_BITS 11
+#define PROB_INIT (1 << (PROB_BITS - 1))
+#define PROB_SHIFT 4
+#define RANGE_TOP (1U << 24)
+#define BUCKETS 8
+
+static const int piece_values[7] = {0, 1, 3, 3, 5, 9, 100};
+
+typedef struct MoveModel {
+    uint16_t bucket[BUCKETS];
+    uint16_t offset[BUCKETS][1 << (BUCKETS - 1)];
+} MoveModel;
+
+typedef struct RangeEncoder {
+    uint64_t low;
+    uint32_t range;
+    uint8_t cache;
+    uint64_t cache_size;
+    int first;
+    unsigned char *out;
+    int size;
+    int capacity;
+} RangeEncoder;
+
+typedef struct RangeDecoder {
+    uint32_t code;
+    uint32_t range;
+    const unsigned char *in;
+    int pos;
+    int size;
+} RangeDecoder;
+
+typedef struct ScoredMove {
+    Move move;
+    int score;
+    int order;
+} ScoredMove;
+
+/* ********** MOVE ORDERING **********                                                             */
+
+/* Distance based centralization bonus, 0 in the corners and 6 in the center.                      */
+static int centralization(int square)
+{
+    int file = FILE_OF(square), rank = RANK_OF(square);
+    int file_distance = (file < 4) ? 3 - file : file - 4;
+    int rank_distance = (rank < 4) ? 3 - rank : rank - 4;
+    return 6 - file_distance - rank_distance;
+}
+
+/* Returns TRUE if square is attacked by a pawn of by_color.                                       */
+static int is_pawn_attacked(const Board *board, int square, int by_color)
+{
+    int rank = RANK_OF(square) + ((by_color == WHITE_PLAYER) ? -1 : 1);
+    unsigned char pawn = (unsigned char)((by_color == WHITE_PLAYER) ? PAWN : PAWN | BLACK_PIECE);
+
+    if (rank < 0 || rank > 7)
+        return FALSE;
+    return (FILE_OF(square) > 0 && board->squares[SQUARE(FILE_OF(square) - 1, rank)] == pawn) ||
+           (FILE_OF(square) < 7 && board->squares[SQUARE(FILE_OF(square) + 1, rank)] == pawn);
+}
+
+static int score_move(const Board *board, Move move)
+{
+    int type = PIECE_TYPE(board->squares[move.from]), color = board->side_to_move, score = 0;
+
+    if (move.flags & MOVE_CAPTURE) {
+        int victim = (move.flags & MOVE_EN_PASSANT) ? PAWN : PIECE_TYPE(board->squares[move.to]);
+        score += 1000 + piece_values[victim] * 10 - piece_values[type];
+    }
+    if (move.promotion != EMPTY)
+        score += 900 + piece_values[move.promotion] * 10;
+    if (move.flags & MOVE_CASTLE)
+        score += 600;
+
+    if (type == PAWN) {
+        int advance = (color == WHITE_PLAYER) ? RANK_OF(move.to) : 7 - RANK_OF(move.to);
+        score += advance * 4 + centralization(move.to) * 3;
+    } else if (type == KING) {
+        score -= 100;
+    } else {
+        score += (centralization(move.to) - centralization(move.from)) * 8;
+        if (type != QUEEN && RANK_OF(move.from) == ((color == WHITE_PLAYER) ? 0 : 7))
+            score += 60;    // development...
+        if (is_pawn_attacked(board, move.to, !color))
+            score -= 300;
+    }
+    return score;
+}
+
+static int compare_scored_moves(const void *a, const void *b)
+{
+    const ScoredMove *m1 = a, *m2 = b;
+
+    if (m1->score != m2->score)
+        return (m1->score < m2->score) ? 1 : -1;
+    return m1->order - m2->order;
+}
+
+/* Generates the legal moves of board in codec order. Returns the number of moves.                 */
+static int generate_ordered_moves(const Board *board, Move moves[])
+{
+    ScoredMove scored[LEGAL_MOVES_MAX];
+    int count = generate_legal_moves(board, moves);
+
+    for (int i = 0; i < count; i++) {
+        scored[i].move = moves[i];
+        scored[i].score = score_move(board, moves[i]);
+        scored[i].order = i;
+    }
+    qsort(scored, count, sizeof(ScoredMove), compare_scored_moves);
+    for (int i = 0; i < count; i++)
+        moves[i] = scored[i].move;
+    return count;
+}
+
+/* ********** RANGE CODER **********                                                               */
+
+static void model_init(MoveModel *model)
+{
+    for (int k = 0; k < BUCKETS; k++) {
+        model->bucket[k] = PROB_INIT;
+        for (int i = 0; i < (1 << (BUCKETS - 1)); i++)
+            model->offset[k][i] = PROB_INIT;
+    }
+}
+
+static void shift_low(RangeEncoder *rc)
+{
+    if ((uint32_t)rc->low < 0xFF000000U || (rc->low >> 32) != 0) {
+        uint8_t carry = (uint8_t)(rc->low >> 32), temp = rc->cache;
+        do {
+            // the very first byte is always 0 and is left out...
+            if (!rc->first) {
+                if (rc->size < rc->capacity)
+                    rc->out[rc->size] = (unsigned char)(temp + carry);
+                rc->size++;
+            }
+            rc->first = FALSE;
+            temp = 0xFF;
+        } while (--rc->cache_size != 0);
+        rc->cache = (uint8_t)((uint32_t)rc->low >> 24);
+    }
+    rc->cache_size++;
+    rc->low = (uint32_t)rc->low << 8;
+}
+
+static void encode_bit(RangeEncoder *rc, uint16_t *prob, int bit)
+{
+    uint32_t bound = (rc->range >> PROB_BITS) * *prob;
+
+    if (!bit) {
+        rc->range = bound;
+        *prob += ((1 << PROB_BITS) - *prob) >> PROB_SHIFT;
+    } else {
+        rc->low += bound;
+        rc->range -= bound;
+        *prob -= *prob >> PROB_SHIFT;
+    }
+    while (rc->range < RANGE_TOP) {
+        rc->range <<= 8;
+        shift_low(rc);
+    }
+}
+
+static int decode_bit(RangeDecoder *rc, uint16_t *prob)
+{
+    uint32_t bound = (rc->range >> PROB_BITS) * *prob;
+    int bit;
+
+    if (rc->code < bound) {
+        rc->range = bound;
+        *prob += ((1 << PROB_BITS) - *prob) >> PROB_SHIFT;
+        bit = 0;
+    } else {
+        rc->code -= bound;
+        rc->range -= bound;
+        *prob -= *prob >> PROB_SHIFT;
+        bit = 1;
+    }
+    while (rc->range < RANGE_TOP) {
+        rc->range <<= 8;
+        rc->code = (rc->code << 8) | ((rc->pos < rc->size) ? rc->in[rc->pos] : 0);
+        rc->pos++;
+    }
+    return bit;
+}
+
+/* Encodes index (0 <= index < count) of a move among count legal moves.                          */
+static void encode_index(RangeEncoder *rc, MoveModel *model, int index, int count)
+{
+    int k = 0;
+
+    // unary bucket number, a decision is only coded if the next bucket can exist...
+    while (k < BUCKETS - 1 && (1 << (k + 1)) - 1 < count) {
+        int next = index >= (1 << (k + 1)) - 1;
+        encode_bit(rc, &model->bucket[k], next);
+        if (!next)
+            break;
+        k++;
+    }
+
+    // offset inside the bucket as a bit tree...
+    int offset = index - ((1 << k) - 1), node = 1;
+    for (int bit = k - 1; bit >= 0; bit--) {
+        int b = (offset >> bit) & 1;
+        encode_bit(rc, &model->offset[k][node], b);
+        node = (node << 1) | b;
+    }
+}
+
+static int decode_index(RangeDecoder *rc, MoveModel *model, int count)
+{
+    int k = 0;
+
+    while (k < BUCKETS - 1 && (1 << (k + 1)) - 1 < count) {
+        if (!decode_bit(rc, &model->bucket[k]))
+            break;
+        k++;
+    }
+
+    int node = 1;
+    for (int bit = k - 1; bit >= 0; bit--)
+        node = (node << 1) | decode_bit(rc, &model->offset[k][node]);
+    return (1 << k) - 1 + node - (1 << k);
+}
+
+/* ********** GAME ENCODING **********                                                             */
+
+/* Returns the number of plies stored in the first move_count moves, or ERROR if the moves are
+ * not a plain sequence (only the very last black move may be '-').                                */
+static int count_plies(const GameMoves *game_moves, int move_count)
+{
+    for (int i = 0; i < move_count; i++) {
+        if (strcmp(game_moves->moves[i][WHITE_PLAYER], "-") == 0)
+            return ERROR;
+        if (strcmp(game_moves->moves[i][BLACK_PLAYER], "-") == 0)
+            return (i == move_count - 1) ? move_count * 2 - 1 : ERROR;
+    }
+    return move_count * 2;
+}
+
+/* Packs the first move_count moves of game_moves into buffer.
+ * Returns the number of bytes used, or 0 (FALSE) if the moves are not legal canonical SAN
+ * from the starting position or do not fit into buffer_size bytes.                               */
+int encode_game_moves(const GameMoves *game_moves, int move_count, unsigned char buffer[], int buffer_size)
+{
+    Board board;
+    Move legal[LEGAL_MOVES_MAX], move;
+    MoveModel model;
+    RangeEncoder rc = {0, 0xFFFFFFFFU, 0, 1, TRUE, buffer, 0, buffer_size};
+    char san[SAN_MAX];
+    int plies = count_plies(game_moves, move_count);
+
+    if (plies == ERROR || buffer_size < 4)
+        return FALSE;
+
+    // header: version and varint ply count...
+    rc.out[rc.size++] = PACKED_FORMAT_VERSION;
+    for (int value = plies; ; value >>= 7) {
+        rc.out[rc.size++] = (unsigned char)((value & 0x7F) | ((value > 0x7F) ? 0x80 : 0));
+        if (value <= 0x7F)
+            break;
+    }
+
+    board_init(&board);
+    model_init(&model);
+    for (int ply = 0; ply < plies; ply++) {
+        const char *text = game_moves->moves[ply / 2][ply % 2];
+        int index = 0;
+
+        int count = generate_ordered_moves(&board, legal);
+        if (!parse_san(&board, text, &move))
+            return FALSE;
+        move_to_san_from_list(&board, move, legal, count, san);
+        if (strcmp(san, text) != 0)
+            return FALSE;
+
+        while (!is_same_move(legal[index], move))
+            index++;
+
+        encode_index(&rc, &model, index, count);
+        make_move(&board, move);
+    }
+
+    for (int i = 0; i < 5; i++)
+        shift_low(&rc);
+
+    return (rc.size <= buffer_size) ? rc.size : FALSE;
+}
+
+/* Unpacks moves packed by encode_game_moves into game_moves (moves and move_number).
+ * Returns TRUE on success and FALSE if the data is corrupt.                                       */
+int decode_game_moves(const unsigned char buffer[], int size, GameMoves *game_moves)
+{
+    Board board;
+    Move legal[LEGAL_MOVES_MAX];
+    MoveModel model;
+    RangeDecoder rc = {0, 0xFFFFFFFFU, buffer, 0, size};
+    char san[SAN_MAX];
+    int plies = 0, shift = 0;
+
+    if (size < 2 || buffer[rc.pos++] != PACKED_FORMAT_VERSION)
+        return FALSE;
+    do {
+        if (rc.pos >= size || shift > 21)
+            return FALSE;
+        plies |= (buffer[rc.pos] & 0x7F) << shift;
+        shift += 7;
+    } while (buffer[rc.pos++] & 0x80);
+
+    if (plies > MOVES_MAX * 2)
+        return FALSE;
+
+    for (int i = 0; i < 4; i++) {
+        rc.code = (rc.code << 8) | ((rc.pos < size) ? buffer[rc.pos] : 0);
+        rc.pos++;
+    }
+
+    board_init(&board);
+    model_init(&model);
+    for (int ply = 0; ply < plies; ply++) {
+        int count = generate_ordered_moves(&board, legal);
+        if (count == 0)
+            return FALSE;
+
+        int index = decode_index(&rc, &model, count);
+        if (index >= count)
+            return FALSE;
+
+        move_to_san_from_list(&board, legal[index], legal, count, san);
+        if (strlen(san) >= S_MOVE_MAX)
+            return FALSE;
+        strcpy(game_moves->moves[ply / 2][ply % 2], san);
+        make_move(&board, legal[index]);
+    }
+
+    if (plies % 2)
+        strcpy(game_moves->moves[plies / 2][BLACK_PLAYER], "-");
+    game_moves->move_number = (plies + 1) / 2;
+    return TRUE;
+}
+
+/* ********** BENCHMARK **********                                                                 */
+
+static double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Plays a random legal game (at most MOVES_MAX moves) into game_moves from a xorshift seed.
+ * The game is cut short at a move whose SAN would not fit into S_MOVE_MAX.
+ * Returns the number of plies.                                                                    */
+static int random_game(GameMoves *game_moves, uint32_t *seed)
+{
+    Board board;
+    Move legal[LEGAL_MOVES_MAX];
+    char san[SAN_MAX];
+    int plies = 0, max_plies = 40 + (int)(*seed % 120);
+
+    board_init(&board);
+    while (plies < max_plies) {
+        int count = generate_legal_moves(&board, legal);
+        if (count == 0)
+            break;
+
+        *seed ^= *seed << 13;
+        *seed ^= *seed >> 17;
+        *seed ^= *seed << 5;
+        Move move = legal[*seed % count];
+
+        move_to_san(&board, move, san);
+        if (strlen(san) >= S_MOVE_MAX)
+            break;
+        strcpy(game_moves->moves[plies / 2][plies % 2], san);
+        make_move(&board, move);
+        plies++;
+    }
+
+    if (plies % 2)
+        strcpy(game_moves->moves[plies / 2][BLACK_PLAYER], "-");
+    game_moves->move_number = (plies + 1) / 2;
+    return plies;
+}
+
+/* Encodes and decodes num_of_games random games and reports throughput and compression.
+ * Random games are the worst case for the move ordering, real games pack tighter.                 */
+void benchmark_move_codec(int num_of_games)
+{
+    GameMoves *games = malloc(sizeof(GameMoves) * num_of_games);
+    unsigned char *packed = malloc((size_t)PACKED_MOVES_MAX * num_of_games);
+    int *sizes = malloc(sizeof(int) * num_of_games);
+    long plies = 0, packed_bytes = 0, text_bytes = 0;
+    uint32_t seed = 2463534242U;
+    struct timespec start;
+    GameMoves decoded;
+
+    if (games == NULL || packed == NULL || sizes == NULL) {
+        eprintf("ERROR: could not allocate memory for the benchmark...\n");
+        free(games);
+        free(packed);
+        free(sizes);
+        return;
+    }
+
+    printf("INFO: generating %d random games...\n", num_of_games);
+    for (int i = 0; i < num_of_games; i++) {
+        int game_plies = random_game(&games[i], &seed);
+        plies += game_plies;
+        for (int ply = 0; ply < game_plies; ply++)
+            text_bytes += (long)strlen(games[i].moves[ply / 2][ply % 2]) + 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_of_games; i++) {
+        sizes[i] = encode_game_moves(&games[i], games[i].move_number,
+                                     packed + (size_t)PACKED_MOVES_MAX * i, PACKED_MOVES_MAX);
+        packed_bytes += sizes[i];
+    }
+    double encode_time = elapsed_seconds(&start);
+
+    int errors = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_of_games; i++) {
+        if (!decode_game_moves(packed + (size_t)PACKED_MOVES_MAX * i, sizes[i], &decoded))
+            errors++;
+    }
+    double decode_time = elapsed_seconds(&start);
+
+    // verifying round trip (outside of the timing)...
+    for (int i = 0; i < num_of_games; i++) {
+        decode_game_moves(packed + (size_t)PACKED_MOVES_MAX * i, sizes[i], &decoded);
+        if (decoded.move_number != games[i].move_number) {
+            errors++;
+            continue;
+        }
+        for (int mv = 0; mv < decoded.move_number; mv++) {
+            if (strcmp(decoded.moves[mv][WHITE_PLAYER], games[i].moves[mv][WHITE_PLAYER]) != 0 ||
+                strcmp(decoded.moves[mv][BLACK_PLAYER], games[i].moves[mv][BLACK_PLAYER]) != 0) {
+                errors++;
+                break;
+            }
+        }
+    }
+
+    printf("INFO: %d games, %ld plies, %d round trip errors\n", num_of_games, plies, errors);
+    printf("INFO: text SAN: %ld bytes (%.2f bytes/ply), packed: %ld bytes (%.3f bytes/ply)\n",
+           text_bytes, (double)text_bytes / (double)plies, packed_bytes, (double)packed_bytes / (double)plies);
+    printf("INFO: encode: %.3f s, %.0f plies/s, %.1f us/game\n",
+           encode_time, (double)plies / encode_time, encode_time * 1e6 / num_of_games);
+    printf("INFO: decode: %.3f s, %.0f plies/s, %.1f us/game\n",
+           decode_time, (double)plies / decode_time, decode_time * 1e6 / num_of_games);
+
+    free(games);
+    free(packed);
+    free(sizes);
+}
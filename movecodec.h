@@ -0,0 +1,18 @@
+//
+// Created by flimsy on 2/21/22.
+//
+
+#ifndef CHESSDATABASE_MOVECODEC_H
+#define CHESSDATABASE_MOVECODEC_H
+
+#include "helperFunctions.h"
+
+// Size values.
+#define PACKED_MOVES_MAX (MOVES_MAX * 2 * 12)
+#define PACKED_FORMAT_VERSION 1
+
+int encode_game_moves(const GameMoves *game_moves, int move_count, unsigned char buffer[], int buffer_size);
+int decode_game_moves(const unsigned char buffer[], int size, GameMoves *game_moves);
+void benchmark_move_codec(int num_of_games);
+
+#endif //CHESSDATABASE_MOVECODEC_H
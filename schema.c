@@ -0,0 +1,249 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#include <stdio.h>
+#include <sqlite3.h>
+
+#include "schema.h"
+#include "database.h"
+#include "cache.h"
+
+/* ********** SCHEMA **********
+ * Every file stores the version of its schema in PRAGMA user_version; opening a file of the
+ * current version reads it and does nothing else. Older files (0 for those of versions before it)
+ * are brought up by the migrations after their version, in order. Migrations of the games run in
+ * batches of MIGRATION_BATCH_IDS ids, a transaction each, so the file stays usable in between and
+ * other connections wait a batch at most. The next id of an unfinished one is kept in
+ * schema_migration, an interrupted migration goes on from there at the next start. The version is
+ * stored in the transaction of the last batch. Another process migrating the same file is waited
+ * for a batch at a time, up to MIGRATION_WAIT_MS, each batch checks the version again first.      */
+
+static const char tableSchemaMigration[] = "CREATE TABLE IF NOT EXISTS schema_migration("
+                                           "version INTEGER PRIMARY KEY,"
+                                           "next_id INTEGER NOT NULL"
+                                           ");";
+
+static const char selectMigrationNextId[] = "SELECT next_id FROM schema_migration WHERE version = ?;";
+
+static const char replaceMigrationNextId[] = "INSERT OR REPLACE INTO schema_migration VALUES (?, ?);";
+
+static const char deleteMigrationNextId[] = "DELETE FROM schema_migration WHERE version = ?;";
+
+static const char selectGameIds[] = "SELECT IFNULL(MIN(id), 0), IFNULL(MAX(id), -1) FROM game;";
+
+static const char selectUnconvertedDates[] = "SELECT EXISTS (SELECT 1 FROM game WHERE date_int IS NULL);";
+
+static const char selectUnindexedLines[] = "SELECT EXISTS (SELECT 1 FROM game) "
+                                           "AND NOT EXISTS (SELECT 1 FROM ply_gram);";
+
+static const char selectUnindexedSignatures[] = "SELECT EXISTS (SELECT 1 FROM game) "
+                                                "AND NOT EXISTS (SELECT 1 FROM game_signature);";
+
+static const char selectMissingCheckpoints[] = "SELECT EXISTS (SELECT 1 FROM moves WHERE checkpoints IS NULL);";
+
+static int index_lines_in_range(sqlite3 *db, int from_id, int to_id)
+{
+    return index_games_in_range(db, from_id, to_id, index_game_lines);
+}
+
+static int index_signatures_in_range(sqlite3 *db, int from_id, int to_id)
+{
+    return index_games_in_range(db, from_id, to_id, index_game_signature);
+}
+
+// Files of versions before the user_version one were of version 1 once create_schema ran on them.
+static const Migration migrations[] = {
+        {1, "base schema",        create_schema, NULL,                      NULL},
+        {2, "packed dates",       NULL,          selectUnconvertedDates,    convert_dates},
+        {3, "line index",         NULL,          selectUnindexedLines,      index_lines_in_range},
+        {4, "similar game index", NULL,          selectUnindexedSignatures, index_signatures_in_range},
+        {5, "board checkpoints",  NULL,          selectMissingCheckpoints,  fill_checkpoints},
+};
+
+/* Runs the query sql on db, binding parameter to its parameter if it has one, and stores the first
+ * column of its first row in value and the second one in second (if not NULL).
+ * Returns TRUE if there was a row, FALSE if not and ERROR on error.                               */
+static int select_ints(sqlite3 *db, const char *sql, int parameter, int *value, int *second)
+{
+    sqlite3_stmt *stmt;
+    int status;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) {
+        eprintf("Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return ERROR;
+    }
+    if (sqlite3_bind_parameter_count(stmt) > 0)
+        sqlite3_bind_int(stmt, 1, parameter);
+
+    if ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+        *value = sqlite3_column_int(stmt, 0);
+        if (second != NULL)
+            *second = sqlite3_column_int(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+
+    if (status != SQLITE_ROW && status != SQLITE_DONE) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return ERROR;
+    }
+    return status == SQLITE_ROW;
+}
+
+/* Rolls back the transaction on db and closes it. Returns ERROR.                                  */
+static int abort_migration(sqlite3 *db)
+{
+    sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+    sqlite3_close(db);
+    return ERROR;
+}
+
+/* Begins the transaction of a batch on db, trying again while another connection (another process
+ * migrating the same file) holds the database, for up to MIGRATION_WAIT_MS.
+ * Returns TRUE on success, otherwise FALSE (db is closed).                                        */
+static int begin_batch(sqlite3 *db)
+{
+    int status, waited_ms = 0;
+
+    while ((status = sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL)) == SQLITE_BUSY &&
+           waited_ms < MIGRATION_WAIT_MS) {
+        sqlite3_sleep(MIGRATION_RETRY_MS);
+        waited_ms += MIGRATION_RETRY_MS;
+    }
+    if (status != SQLITE_OK) {
+        eprintf("ERROR: cannot begin migrating: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Returns the schema version of db (0 for files of versions before it), or ERROR on error (db is
+ * closed).                                                                                        */
+int get_schema_version(sqlite3 *db)
+{
+    int version;
+
+    if (select_ints(db, "PRAGMA user_version;", 0, &version, NULL) != TRUE) {
+        sqlite3_close(db);
+        return ERROR;
+    }
+    return version;
+}
+
+/* Stores the version of migration as the schema version of db, inside the transaction on db.
+ * Returns TRUE on success, otherwise FALSE (db is closed, which rolls the transaction back).      */
+static int set_schema_version(sqlite3 *db, const Migration *migration)
+{
+    char sql[64], *err_msg = 0;
+
+    snprintf(sql, sizeof(sql), "PRAGMA user_version = %d;", migration->version);
+    return !is_exec_error(&db, sqlite3_exec(db, sql, 0, 0, &err_msg), &err_msg);
+}
+
+/* Brings db from the version before migration up to its version, a batch of games per transaction
+ * if its games need migrating. Returns the number of batches, or ERROR on error (db is closed).   */
+static long run_migration(sqlite3 *db, const Migration *migration)
+{
+    char *err_msg = 0;
+    long batches = 0;
+
+    if (migration->upgrade != NULL && !migration->upgrade(db))
+        return ERROR;
+
+    while (TRUE) {
+        int version, next_id, min_id, max_id, found, needed;
+
+        if (!begin_batch(db))
+            return ERROR;
+
+        // (another connection may have finished it in the meantime)...
+        if (select_ints(db, "PRAGMA user_version;", 0, &version, NULL) != TRUE)
+            return abort_migration(db);
+        if (version >= migration->version)
+            break;
+
+        found = FALSE;
+        if (migration->migrate_range != NULL) {
+            if (select_ints(db, selectGameIds, 0, &min_id, &max_id) != TRUE)
+                return abort_migration(db);
+
+            // resuming an interrupted migration, or starting it if the games need it...
+            if ((found = select_ints(db, selectMigrationNextId, migration->version, &next_id, NULL)) == ERROR)
+                return abort_migration(db);
+            if (!found) {
+                if (select_ints(db, migration->needs_data, 0, &needed, NULL) != TRUE)
+                    return abort_migration(db);
+                found = needed;
+                next_id = min_id;
+            }
+            found = found && next_id <= max_id;
+        }
+
+        if (!found) {
+            if ((migration->migrate_range != NULL &&
+                 !do_statement(db, NULL, NULL, NULL, TRUE, deleteMigrationNextId, "%d", migration->version)) ||
+                !set_schema_version(db, migration))
+                return ERROR;
+            break;
+        }
+
+        if (!migration->migrate_range(db, next_id, next_id + MIGRATION_BATCH_IDS - 1) ||
+            !do_statement(db, NULL, NULL, NULL, TRUE, replaceMigrationNextId, "%d%d", migration->version,
+                          next_id + MIGRATION_BATCH_IDS))
+            return ERROR;
+
+        if (is_exec_error(&db, sqlite3_exec(db, "COMMIT;", 0, 0, &err_msg), &err_msg))
+            return ERROR;
+        batches++;
+    }
+
+    if (is_exec_error(&db, sqlite3_exec(db, "COMMIT;", 0, 0, &err_msg), &err_msg))
+        return ERROR;
+    return batches;
+}
+
+/* Migrates db from version up to SCHEMA_VERSION. Refuses files of later versions.
+ * Returns TRUE on success, otherwise FALSE (db is closed).                                        */
+int migrate_schema(sqlite3 *db, int version)
+{
+    char *err_msg = 0;
+    long batches;
+
+    if (version > SCHEMA_VERSION) {
+        eprintf("ERROR: the database has schema version %d, this version of the program only knows up to %d...\n",
+                version, SCHEMA_VERSION);
+        sqlite3_close(db);
+        return FALSE;
+    }
+
+    // (only takes effect on a new file, before its first table, and waits for the lock on any file)...
+    int status, pages;
+    if (select_ints(db, "PRAGMA page_count;", 0, &pages, NULL) != TRUE) {
+        sqlite3_close(db);
+        return FALSE;
+    }
+    if (pages == 0) {
+        status = sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL;", 0, 0, &err_msg);
+        if (is_exec_error(&db, status, &err_msg))
+            return FALSE;
+    }
+
+    status = sqlite3_exec(db, tableSchemaMigration, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    for (int i = 0; i < (int)(sizeof(migrations) / sizeof(migrations[0])); i++) {
+        if (migrations[i].version <= version)
+            continue;
+
+        if ((batches = run_migration(db, &migrations[i])) == ERROR)
+            return FALSE;
+        if (batches > 0) {
+            printf("INFO: migrated the games to schema version %d (%s) in %ld batches...\n",
+                   migrations[i].version, migrations[i].name, batches);
+            bump_data_generation();
+        }
+    }
+    return TRUE;
+}
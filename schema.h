@@ -0,0 +1,37 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#ifndef CHESSDATABASE_SCHEMA_H
+#define CHESSDATABASE_SCHEMA_H
+
+#include <sqlite3.h>
+
+#include "helperFunctions.h"
+#include "lineindex.h"
+
+// The version stored in PRAGMA user_version by this program.
+#define SCHEMA_VERSION 5
+
+// Size values. A batch of a data migration covers MIGRATION_BATCH_IDS game ids (read in one chunk).
+#define MIGRATION_BATCH_IDS LINE_CHUNK_IDS
+
+// Time values. How long a batch waits for another process migrating the same file, in steps of.
+#define MIGRATION_WAIT_MS 60000
+#define MIGRATION_RETRY_MS 100
+
+/* A step of the schema. upgrade changes the structure (NULL if none), needs_data is a query telling
+ * if the games of an older file must be migrated (NULL if never) and migrate_range migrates those
+ * with ids from from_id to to_id inside a transaction.                                            */
+typedef struct Migration {
+    int version;
+    const char *name;
+    int (*upgrade)(sqlite3 *db);
+    const char *needs_data;
+    int (*migrate_range)(sqlite3 *db, int from_id, int to_id);
+} Migration;
+
+int get_schema_version(sqlite3 *db);
+int migrate_schema(sqlite3 *db, int version);
+
+#endif //CHESSDATABASE_SCHEMA_H
@@ -0,0 +1,420 @@
+//
+// Created by flimsy on 3/18/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "session.h"
+#include "console.h"
+
+/* ********** SESSION TRACES **********
+ * A session of the terminal edition is recorded by putting a pipe in place of stdin: a thread
+ * reads what is typed, passes it on through the pipe and writes every line to the trace with the
+ * time it was completed ("<ms>\t<line>", after a "#" header line). Menu choices, game headers and
+ * moves are all read from stdin, so the trace holds everything the session did.
+ * A trace is replayed by num_of_processes processes at once, each with its own handle running the
+ * terminal edition on the lines of the trace (output to /dev/null), typed as fast as they are
+ * read (pace 0) or at the recorded pace sped up pace times. Every process times each chessdb_
+ * call and sends its timings to the parent at the end, which reports the latency percentiles of
+ * each operation and the throughput of all processes together.                                    */
+
+#define TRACE_HEADER "# chessdb session trace"
+
+typedef struct Recorder {
+    int input;                  // the real stdin...
+    int output;                 // the pipe the console reads...
+    int stop[2];
+    FILE *trace;
+    struct timespec started;
+} Recorder;
+
+typedef struct Feeder {
+    const Trace *trace;
+    double pace;
+    int output;
+} Feeder;
+
+typedef struct Sample {
+    const char *operation;
+    double milliseconds;
+} Sample;
+
+typedef struct OperationSamples {
+    char operation[NAME_MAX];
+    double *milliseconds;
+    long count;
+    long capacity;
+} OperationSamples;
+
+// the calls timed by a replaying process...
+static Sample *samples = NULL;
+static long num_of_samples = 0;
+static long samples_capacity = 0;
+
+static long elapsed_ms(const struct timespec *from)
+{
+    struct timespec to;
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    return (long)(to.tv_sec - from->tv_sec) * 1000 + (to.tv_nsec - from->tv_nsec) / 1000000;
+}
+
+/* Writes the size bytes of data to fd. Returns TRUE on success and FALSE on error.                */
+static int write_all(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return FALSE;
+        data += written;
+        size -= (size_t)written;
+    }
+    return TRUE;
+}
+
+static void *record_input(void *arg)
+{
+    Recorder *recorder = arg;
+    struct pollfd fds[2] = {{.fd = recorder->input, .events = POLLIN}, {.fd = recorder->stop[0], .events = POLLIN}};
+    char buffer[TRACE_LINE_MAX], line[TRACE_LINE_MAX];
+    size_t length = 0;
+
+    while (poll(fds, 2, -1) > 0 && !(fds[1].revents & POLLIN)) {
+        ssize_t count = read(recorder->input, buffer, sizeof(buffer));
+        if (count <= 0 || !write_all(recorder->output, buffer, (size_t)count))
+            break;
+
+        for (ssize_t i = 0; i < count; i++) {
+            if (buffer[i] != '\n') {
+                if (length < TRACE_LINE_MAX - 1)
+                    line[length++] = buffer[i];
+                continue;
+            }
+            line[length] = '\0';
+            fprintf(recorder->trace, "%ld\t%s\n", elapsed_ms(&recorder->started), line);
+            fflush(recorder->trace);
+            length = 0;
+        }
+    }
+
+    // the console reads end of input once the typed input ended...
+    close(recorder->output);
+    return NULL;
+}
+
+/* Runs the terminal edition on db while recording what is typed to the trace file trace_path.
+ * Returns TRUE on success and FALSE on error.                                                     */
+int record_session(ChessDb *db, const char *trace_path)
+{
+    Recorder recorder;
+    pthread_t thread;
+    int input[2];
+
+    if ((recorder.trace = fopen(trace_path, "w")) == NULL) {
+        eprintf("ERROR: cannot open %s for writing...\n", trace_path);
+        return FALSE;
+    }
+    if (pipe(input) != 0 || pipe(recorder.stop) != 0 || (recorder.input = dup(STDIN_FILENO)) < 0) {
+        eprintf("ERROR: could not redirect the input for recording...\n");
+        fclose(recorder.trace);
+        return FALSE;
+    }
+    fprintf(recorder.trace, "%s\n", TRACE_HEADER);
+    recorder.output = input[1];
+    clock_gettime(CLOCK_MONOTONIC, &recorder.started);
+
+    dup2(input[0], STDIN_FILENO);
+    close(input[0]);
+    if (pthread_create(&thread, NULL, record_input, &recorder) != 0) {
+        eprintf("ERROR: could not start the recording thread...\n");
+        dup2(recorder.input, STDIN_FILENO);
+        fclose(recorder.trace);
+        return FALSE;
+    }
+
+    printf("INFO: recording the session to %s (the browser is not available)...\n", trace_path);
+    run_terminal_edition(db);
+
+    if (!write_all(recorder.stop[1], "", 1))
+        eprintf("ERROR: could not stop the recording thread...\n");
+    pthread_join(thread, NULL);
+    dup2(recorder.input, STDIN_FILENO);
+    close(recorder.input);
+    close(recorder.stop[0]);
+    close(recorder.stop[1]);
+    return fclose(recorder.trace) == 0;
+}
+
+/* Reads the trace file path into trace. Returns TRUE on success and FALSE on error.               */
+int load_trace(const char *path, Trace *trace)
+{
+    char line[TRACE_LINE_MAX + 32];
+    int capacity = 0;
+    FILE *file;
+
+    memset(trace, 0, sizeof(Trace));
+    if ((file = fopen(path, "r")) == NULL) {
+        eprintf("ERROR: cannot open the trace %s...\n", path);
+        return FALSE;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *text = strchr(line, '\t');
+        if (line[0] == '#' || text == NULL)
+            continue;
+
+        if (trace->num_of_lines == capacity) {
+            TraceLine *grown = realloc(trace->lines, sizeof(TraceLine) * (capacity = capacity * 2 + 64));
+            if (grown == NULL) {
+                eprintf("ERROR: could not allocate memory for the trace...\n");
+                free_trace(trace);
+                fclose(file);
+                return FALSE;
+            }
+            trace->lines = grown;
+        }
+
+        text[strcspn(text, "\n")] = '\0';
+        trace->lines[trace->num_of_lines].at_ms = strtol(line, NULL, 10);
+        snprintf(trace->lines[trace->num_of_lines].text, TRACE_LINE_MAX, "%s", text + 1);
+        trace->num_of_lines++;
+    }
+
+    fclose(file);
+    return TRUE;
+}
+
+void free_trace(Trace *trace)
+{
+    free(trace->lines);
+    trace->lines = NULL;
+    trace->num_of_lines = 0;
+}
+
+static void *feed_input(void *arg)
+{
+    Feeder *feeder = arg;
+    struct timespec started;
+    char line[TRACE_LINE_MAX + 1];
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    for (int i = 0; i < feeder->trace->num_of_lines; i++) {
+        const TraceLine *trace_line = &feeder->trace->lines[i];
+        long wait_ms = (feeder->pace > 0) ? (long)(trace_line->at_ms / feeder->pace) - elapsed_ms(&started) : 0;
+
+        if (wait_ms > 0) {
+            struct timespec wait = {wait_ms / 1000, (wait_ms % 1000) * 1000000};
+            nanosleep(&wait, NULL);
+        }
+        snprintf(line, sizeof(line), "%s\n", trace_line->text);
+        if (!write_all(feeder->output, line, strlen(line)))
+            break;
+    }
+    close(feeder->output);
+    return NULL;
+}
+
+static void keep_sample(const char *operation, double milliseconds)
+{
+    if (num_of_samples == samples_capacity) {
+        Sample *grown = realloc(samples, sizeof(Sample) * (samples_capacity * 2 + 256));
+        if (grown == NULL)
+            return;
+        samples = grown;
+        samples_capacity = samples_capacity * 2 + 256;
+    }
+    samples[num_of_samples++] = (Sample){operation, milliseconds};
+}
+
+/* Replays trace on a new handle of db_path and writes the timed calls to result ("<name>\t<ms>"
+ * lines). Runs in a process of its own. Returns EXIT_SUCCESS or EXIT_FAILURE.                     */
+static int replay_process(const char *db_path, const Trace *trace, double pace, int result)
+{
+    Feeder feeder = {trace, pace, -1};
+    ChessDbOptions options;
+    pthread_t thread;
+    ChessDb *db;
+    FILE *file;
+    int input[2];
+
+    // the console may quit before the trace ends...
+    signal(SIGPIPE, SIG_IGN);
+    if (pipe(input) != 0 || freopen("/dev/null", "w", stdout) == NULL)
+        return EXIT_FAILURE;
+    dup2(input[0], STDIN_FILENO);
+    close(input[0]);
+    feeder.output = input[1];
+
+    chessdb_observe_operations(keep_sample);
+    chessdb_default_options(&options);
+    options.load_completions = TRUE;
+    // (a maintenance thread per process would compete with the timed calls for the database)...
+    options.maintenance.interval_ms = 0;
+    if (!chessdb_open(db_path, &options, &db))
+        return EXIT_FAILURE;
+
+    if (pthread_create(&thread, NULL, feed_input, &feeder) != 0) {
+        chessdb_close(db);
+        return EXIT_FAILURE;
+    }
+    run_terminal_edition(db);
+    chessdb_close(db);
+
+    if ((file = fdopen(result, "w")) == NULL)
+        return EXIT_FAILURE;
+    for (long i = 0; i < num_of_samples; i++)
+        fprintf(file, "%s\t%.6f\n", samples[i].operation, samples[i].milliseconds);
+    return (fclose(file) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Adds the sample of operation to the samples of all operations (count of them), dropping it if
+ * the name of operation is too long for a NAME_MAX field. Returns the new count.                  */
+static int add_sample(OperationSamples operations[], int count, const char *operation, double milliseconds)
+{
+    int i = 0;
+
+    while (i < count && strcmp(operations[i].operation, operation) != 0)
+        i++;
+    if (i == count) {
+        int length;
+
+        if (count == REPLAY_OPERATIONS_MAX)
+            return count;
+        memset(&operations[count], 0, sizeof(OperationSamples));
+        length = snprintf(operations[count].operation, NAME_MAX, "%s", operation);
+        if (length < 0 || length >= NAME_MAX)
+            return count;
+        count++;
+    }
+
+    if (operations[i].count == operations[i].capacity) {
+        long capacity = operations[i].capacity * 2 + 256;
+        double *grown = realloc(operations[i].milliseconds, sizeof(double) * capacity);
+        if (grown == NULL)
+            return count;
+        operations[i].milliseconds = grown;
+        operations[i].capacity = capacity;
+    }
+    operations[i].milliseconds[operations[i].count++] = milliseconds;
+    return count;
+}
+
+/* Reads the samples of a replaying process from fd into operations (count of them).
+ * Returns the new count.                                                                          */
+static int read_samples(int fd, OperationSamples operations[], int count)
+{
+    char line[NAME_MAX + 32];
+    FILE *file = fdopen(fd, "r");
+
+    if (file == NULL) {
+        close(fd);
+        return count;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *value = strchr(line, '\t');
+        if (value == NULL)
+            continue;
+        *value = '\0';
+        count = add_sample(operations, count, line, strtod(value + 1, NULL));
+    }
+    fclose(file);
+    return count;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double d1 = *(const double *)a, d2 = *(const double *)b;
+    return (d1 > d2) - (d1 < d2);
+}
+
+/* Returns the percentile (0 to 1, nearest rank) of the count sorted values.                       */
+static double percentile(const double values[], long count, double fraction)
+{
+    long rank = (long)(fraction * (double)count);
+
+    if ((double)rank < fraction * (double)count)
+        rank++;
+    return values[(rank < 1) ? 0 : rank - 1];
+}
+
+/* Replays trace on the database db_path in num_of_processes processes at once (pace 0 for no
+ * pauses between lines, else the recorded pauses divided by pace) and stores the latencies of
+ * the calls and the throughput in stats. Returns TRUE on success and FALSE on error.              */
+int replay_sessions(const char *db_path, const Trace *trace, int num_of_processes, double pace, ReplayStats *stats)
+{
+    OperationSamples operations[REPLAY_OPERATIONS_MAX];
+    int results[REPLAY_PROCESSES_MAX], num_of_operations = 0, started = 0;
+    pid_t pids[REPLAY_PROCESSES_MAX];
+    struct timespec start, end;
+
+    memset(stats, 0, sizeof(ReplayStats));
+    if (num_of_processes < 1 || num_of_processes > REPLAY_PROCESSES_MAX) {
+        eprintf("ERROR: number of processes must be between 1 and %d...\n", REPLAY_PROCESSES_MAX);
+        return FALSE;
+    }
+
+    // nothing buffered may be written twice by the processes...
+    fflush(stdout);
+    fflush(stderr);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_of_processes; i++) {
+        int fds[2];
+
+        if (pipe(fds) != 0 || (pids[i] = fork()) < 0) {
+            eprintf("ERROR: could not start replay process %d...\n", i + 1);
+            break;
+        }
+        if (pids[i] == 0) {
+            for (int j = 0; j < started; j++)
+                close(results[j]);
+            close(fds[0]);
+            _exit(replay_process(db_path, trace, pace, fds[1]));
+        }
+        close(fds[1]);
+        results[started++] = fds[0];
+    }
+
+    for (int i = 0; i < started; i++) {
+        int status;
+
+        num_of_operations = read_samples(results[i], operations, num_of_operations);
+        waitpid(pids[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+            stats->failed++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    stats->sessions = started;
+    stats->seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    for (int i = 0; i < num_of_operations; i++) {
+        OperationSamples *samples_of = &operations[i];
+        OperationLatency *latency = &stats->latencies[stats->num_of_latencies];
+
+        if (samples_of->count == 0)
+            continue;
+        stats->num_of_latencies++;
+        qsort(samples_of->milliseconds, (size_t)samples_of->count, sizeof(double), compare_doubles);
+        // (both fields are NAME_MAX)...
+        strcpy(latency->operation, samples_of->operation);
+        latency->count = samples_of->count;
+        latency->p50_ms = percentile(samples_of->milliseconds, samples_of->count, 0.50);
+        latency->p90_ms = percentile(samples_of->milliseconds, samples_of->count, 0.90);
+        latency->p99_ms = percentile(samples_of->milliseconds, samples_of->count, 0.99);
+        latency->max_ms = samples_of->milliseconds[samples_of->count - 1];
+        stats->operations += samples_of->count;
+    }
+    for (int i = 0; i < num_of_operations; i++)
+        free(operations[i].milliseconds);
+    return started == num_of_processes;
+}
@@ -0,0 +1,50 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#ifndef CHESSDATABASE_SESSION_H
+#define CHESSDATABASE_SESSION_H
+
+#include "chessdb.h"
+
+// Size values.
+#define TRACE_LINE_MAX 256
+#define REPLAY_PROCESSES_MAX 64
+#define REPLAY_OPERATIONS_MAX 64
+
+/* A line typed in a recorded session and when, in milliseconds since the session started.         */
+typedef struct TraceLine {
+    long at_ms;
+    char text[TRACE_LINE_MAX];
+} TraceLine;
+
+typedef struct Trace {
+    TraceLine *lines;
+    int num_of_lines;
+} Trace;
+
+/* The latencies of all calls of one chessdb_ function over all replayed sessions.                 */
+typedef struct OperationLatency {
+    char operation[NAME_MAX];
+    long count;
+    double p50_ms;
+    double p90_ms;
+    double p99_ms;
+    double max_ms;
+} OperationLatency;
+
+typedef struct ReplayStats {
+    int sessions;
+    int failed;                 // sessions whose process did not end normally...
+    long operations;
+    double seconds;
+    OperationLatency latencies[REPLAY_OPERATIONS_MAX];
+    int num_of_latencies;
+} ReplayStats;
+
+int record_session(ChessDb *db, const char *trace_path);
+int load_trace(const char *path, Trace *trace);
+void free_trace(Trace *trace);
+int replay_sessions(const char *db_path, const Trace *trace, int num_of_processes, double pace, ReplayStats *stats);
+
+#endif //CHESSDATABASE_SESSION_H
@@ -0,0 +1,544 @@
+//
+// Created by flimsy on 3/9/22.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "database.h"
+#include "shard.h"
+#include "context.h"
+
+/* ********** SHARD CATALOG **********
+ * With sharding enabled chess.db only holds the catalog: the sharding mode and one row per shard
+ * file. Games are stored in the shard of their year (chess-2019.db, chess-unknown.db) or of
+ * their tournament bucket (chess-t03.db, the tournament name hashed into SHARD_BUCKETS), every
+ * shard being an ordinary database with the full schema. Shards get game ids from their own
+ * id span, so the shard of a game follows from its id alone.                                      */
+
+const char tableShardMode[] = "CREATE TABLE IF NOT EXISTS shard_mode(mode INTEGER);";
+
+const char tableShard[] = "CREATE TABLE IF NOT EXISTS shard("
+                          "id INTEGER PRIMARY KEY,"
+                          "shard_key TEXT UNIQUE,"
+                          "path TEXT"
+                          ");";
+
+const char selectShardMode[] = "SELECT mode FROM shard_mode;";
+
+const char selectShards[] = "SELECT id, shard_key, path FROM shard ORDER BY id;";
+
+const char insertShardMode[] = "INSERT INTO shard_mode VALUES (?);";
+
+const char insertShard[] = "INSERT INTO shard VALUES (?, ?, ?);";
+
+const char selectShardKeys[] = "SELECT DISTINCT shard_key(g_name, date_int) FROM game_view;";
+
+const char selectMaxId[] = "SELECT IFNULL(MAX(id), 0) FROM game;";
+
+const char selectCount[] = "SELECT COUNT(*) FROM game;";
+
+/* Moving the games of one shard key out of chess.db into the attached shard database. The shard
+ * has its own name ids, names are added to it and looked up there by name.                       */
+const char *moveToShard[] = {
+        "INSERT OR IGNORE INTO shard.event (name, class, group_name) "
+        "SELECT DISTINCT g_name, g_class, g_group FROM main.game_view WHERE shard_key(g_name, date_int) = ?1;",
+
+        "INSERT OR IGNORE INTO shard.player (name) "
+        "SELECT white_name FROM main.game_view WHERE shard_key(g_name, date_int) = ?1 "
+        "UNION SELECT black_name FROM main.game_view WHERE shard_key(g_name, date_int) = ?1;",
+
+        "INSERT INTO shard.game (id, event_id, game_number, date, white_id, black_id, white_result, "
+        "black_result, date_int, eco, opening) "
+        "SELECT g.id + ?2, e.id, g.game_number, g.date, w.id, b.id, g.white_result, g.black_result, "
+        "g.date_int, g.eco, g.opening "
+        "FROM main.game_view g "
+        "INNER JOIN shard.event e ON e.name = g.g_name AND e.class = g.g_class AND e.group_name = g.g_group "
+        "INNER JOIN shard.player w ON w.name = g.white_name "
+        "INNER JOIN shard.player b ON b.name = g.black_name "
+        "WHERE shard_key(g.g_name, g.date_int) = ?1;",
+
+        "INSERT INTO shard.moves (id, number_of_moves, game_id, packed_moves, checkpoints) "
+        "SELECT m.id, m.number_of_moves, m.game_id + ?2, m.packed_moves, m.checkpoints "
+        "FROM main.moves m INNER JOIN main.game_view g ON g.id = m.game_id "
+        "WHERE shard_key(g.g_name, g.date_int) = ?1;",
+
+        "INSERT INTO shard.single_move (id, move_number, white_move, black_move, moves_id) "
+        "SELECT s.id, s.move_number, s.white_move, s.black_move, s.moves_id "
+        "FROM main.single_move s INNER JOIN main.moves m ON m.id = s.moves_id "
+        "INNER JOIN main.game_view g ON g.id = m.game_id "
+        "WHERE shard_key(g.g_name, g.date_int) = ?1;",
+
+        "INSERT INTO shard.ply_gram (hash, game_id) "
+        "SELECT p.hash, p.game_id + ?2 FROM main.ply_gram p INNER JOIN main.game_view g ON g.id = p.game_id "
+        "WHERE shard_key(g.g_name, g.date_int) = ?1;",
+
+        "INSERT INTO shard.game_signature (game_id, signature) "
+        "SELECT s.game_id + ?2, s.signature FROM main.game_signature s INNER JOIN main.game_view g ON g.id = s.game_id "
+        "WHERE shard_key(g.g_name, g.date_int) = ?1;",
+
+        "INSERT INTO shard.signature_band (hash, game_id) "
+        "SELECT b.hash, b.game_id + ?2 FROM main.signature_band b INNER JOIN main.game_view g ON g.id = b.game_id "
+        "WHERE shard_key(g.g_name, g.date_int) = ?1;",
+
+        "DELETE FROM main.ply_gram WHERE game_id IN (SELECT id FROM main.game_view "
+        "WHERE shard_key(g_name, date_int) = ?1);",
+
+        "DELETE FROM main.signature_band WHERE game_id IN (SELECT id FROM main.game_view "
+        "WHERE shard_key(g_name, date_int) = ?1);",
+
+        "DELETE FROM main.game_signature WHERE game_id IN (SELECT id FROM main.game_view "
+        "WHERE shard_key(g_name, date_int) = ?1);",
+
+        "DELETE FROM main.single_move WHERE moves_id IN (SELECT m.id FROM main.moves m "
+        "INNER JOIN main.game_view g ON g.id = m.game_id WHERE shard_key(g.g_name, g.date_int) = ?1);",
+
+        "DELETE FROM main.moves WHERE game_id IN (SELECT id FROM main.game_view "
+        "WHERE shard_key(g_name, date_int) = ?1);",
+
+        "DELETE FROM main.game WHERE id IN (SELECT id FROM main.game_view "
+        "WHERE shard_key(g_name, date_int) = ?1);",
+
+        "DELETE FROM main.player WHERE "
+        "NOT EXISTS (SELECT 1 FROM main.game WHERE white_id = player.id) AND "
+        "NOT EXISTS (SELECT 1 FROM main.game WHERE black_id = player.id);",
+
+        "DELETE FROM main.event WHERE NOT EXISTS (SELECT 1 FROM main.game WHERE event_id = event.id);",
+};
+
+/* Reads the shard catalog from the (open) catalog database db, creating the catalog tables if
+ * they don't exist. Returns TRUE on success, otherwise FALSE (db is closed).                       */
+int load_shard_catalog(sqlite3 *db)
+{
+    ShardCatalog *catalog = &current_db()->catalog;
+    char *err_msg = 0;
+    sqlite3_stmt *stmt;
+
+    int status = sqlite3_exec(db, tableShardMode, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_exec(db, tableShard, 0, 0, &err_msg);
+    if (is_exec_error(&db, status, &err_msg))
+        return FALSE;
+
+    status = sqlite3_prepare_v2(db, selectShardMode, -1, &stmt, 0);
+    if (is_statement_error(&db, &stmt, status, FALSE))
+        return FALSE;
+    catalog->mode = (sqlite3_step(stmt) == SQLITE_ROW) ? sqlite3_column_int(stmt, 0) : SHARD_NONE;
+    sqlite3_finalize(stmt);
+
+    status = sqlite3_prepare_v2(db, selectShards, -1, &stmt, 0);
+    if (is_statement_error(&db, &stmt, status, FALSE))
+        return FALSE;
+
+    catalog->num_of_shards = 0;
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW && catalog->num_of_shards < SHARDS_MAX) {
+        Shard *shard = &catalog->shards[catalog->num_of_shards++];
+        char file[SHARD_PATH_MAX];
+        shard->number = sqlite3_column_int(stmt, 0);
+        copy_column_text(shard->key, stmt, 1, NAME_MAX);
+        copy_column_text(file, stmt, 2, SHARD_PATH_MAX);
+        resolve_db_file(file, shard->path);
+    }
+
+    if (status != SQLITE_ROW && is_statement_step_error(&db, &stmt, status, FALSE))
+        return FALSE;
+
+    sqlite3_finalize(stmt);
+    return TRUE;
+}
+
+/* Returns the sharding mode (SHARD_NONE, SHARD_BY_YEAR or SHARD_BY_TOURNAMENT).                   */
+int get_sharding_mode()
+{
+    return current_db()->catalog.mode;
+}
+
+/* Returns the number of shards, 0 if sharding is not enabled.                                     */
+int get_num_of_shards()
+{
+    return current_db()->catalog.num_of_shards;
+}
+
+/* Returns the shard at index (0 <= index < get_num_of_shards()), ordered by shard number.         */
+const Shard *get_shard(int index)
+{
+    return &current_db()->catalog.shards[index];
+}
+
+/* Returns the shard with number, or NULL if there is none.                                        */
+const Shard *find_shard(int number)
+{
+    const ShardCatalog *catalog = &current_db()->catalog;
+
+    for (int i = 0; i < catalog->num_of_shards; i++) {
+        if (catalog->shards[i].number == number)
+            return &catalog->shards[i];
+    }
+    return NULL;
+}
+
+/* Stores the numbers of the databases holding games, in id order, in numbers (room for
+ * SHARDS_MAX). Without sharding that is only chess.db (0). Returns the number of databases.      */
+int get_shard_numbers(int numbers[])
+{
+    const ShardCatalog *catalog = &current_db()->catalog;
+
+    if (catalog->mode == SHARD_NONE) {
+        numbers[0] = 0;
+        return 1;
+    }
+
+    for (int i = 0; i < catalog->num_of_shards; i++)
+        numbers[i] = catalog->shards[i].number;
+    return catalog->num_of_shards;
+}
+
+/* Stores the key of the shard a game of tournament name played at packed_date belongs to in key. */
+void shard_key_of_game(const char *name, int packed_date, char key[NAME_MAX])
+{
+    if (current_db()->catalog.mode == SHARD_BY_TOURNAMENT) {
+        // FNV-1a...
+        unsigned long hash = 2166136261UL;
+        for (const char *c = name; *c != '\0'; c++) {
+            hash ^= (unsigned char)*c;
+            hash = (hash * 16777619UL) & 0xffffffffUL;
+        }
+        snprintf(key, NAME_MAX, "t%02lu", hash % SHARD_BUCKETS);
+    } else if (packed_date > 0) {
+        snprintf(key, NAME_MAX, "%d", DATE_YEAR(packed_date));
+    } else {
+        strcpy(key, "unknown");
+    }
+}
+
+/* SQL function shard_key(g_name, date_int), see shard_key_of_game.                                */
+static void sql_shard_key(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+    char key[NAME_MAX];
+    const unsigned char *name = sqlite3_value_text(argv[0]);
+    (void)argc;
+
+    shard_key_of_game((name != NULL) ? (const char *)name : "", sqlite3_value_int(argv[1]), key);
+    sqlite3_result_text(context, key, -1, SQLITE_TRANSIENT);
+}
+
+/* Returns the shard with key, adding it to the catalog (and creating its database) if it does not
+ * exist yet. Returns NULL on error.                                                               */
+const Shard *get_or_create_shard(const char *key)
+{
+    ShardCatalog *catalog = &current_db()->catalog;
+    char file[SHARD_PATH_MAX];
+    sqlite3 *db;
+    Shard *shard;
+
+    for (int i = 0; i < catalog->num_of_shards; i++) {
+        if (strcmp(catalog->shards[i].key, key) == 0)
+            return &catalog->shards[i];
+    }
+
+    if (catalog->num_of_shards == SHARDS_MAX) {
+        eprintf("ERROR: no more than %d shards are possible...\n", SHARDS_MAX);
+        return NULL;
+    }
+
+    // the catalog holds the file name, next to chess.db...
+    shard = &catalog->shards[catalog->num_of_shards];
+    shard->number = (catalog->num_of_shards > 0) ? catalog->shards[catalog->num_of_shards - 1].number + 1 : 1;
+    snprintf(shard->key, NAME_MAX, "%s", key);
+    snprintf(file, SHARD_PATH_MAX, "chess-%s.db", key);
+    if (!resolve_db_file(file, shard->path)) {
+        eprintf("ERROR: path of shard %s too long...\n", key);
+        return NULL;
+    }
+
+    if (!prepare_database_file(shard->path))
+        return NULL;
+
+    if (!open_database_path(current_db()->catalog_path, &db, FALSE))
+        return NULL;
+    if (!do_statement(db, NULL, NULL, NULL, FALSE, insertShard, "%d%s%s",
+                      shard->number, shard->key, file))
+        return NULL;
+    sqlite3_close(db);
+
+    printf("INFO: created shard %s...\n", shard->path);
+    catalog->num_of_shards++;
+    return shard;
+}
+
+/* ********** FAN OUT **********
+ * Runs a task on every shard, each with its own read only connection, on up to
+ * FANOUT_THREADS_MAX threads claiming shards in turn.                                             */
+
+typedef struct FanOut {
+    pthread_mutex_t lock;
+    ChessDb *db;
+    ShardTask run;
+    char *tasks;
+    size_t task_size;
+    int next_shard;
+    int error;
+} FanOut;
+
+static void *fan_out_worker(void *arg)
+{
+    FanOut *fan = arg;
+    const ShardCatalog *catalog = &fan->db->catalog;
+
+    use_db(fan->db);
+    while (TRUE) {
+        sqlite3 *db;
+        int index;
+
+        pthread_mutex_lock(&fan->lock);
+        index = (fan->error) ? catalog->num_of_shards : fan->next_shard++;
+        pthread_mutex_unlock(&fan->lock);
+        if (index >= catalog->num_of_shards)
+            break;
+
+        int success = open_database_path(catalog->shards[index].path, &db, TRUE);
+        if (success) {
+            success = fan->run(db, fan->tasks + fan->task_size * index);
+            sqlite3_close(db);
+        }
+
+        if (!success) {
+            pthread_mutex_lock(&fan->lock);
+            fan->error = TRUE;
+            pthread_mutex_unlock(&fan->lock);
+        }
+    }
+    return NULL;
+}
+
+/* Runs run on every shard in parallel, shard i (in get_shard order) with the task at
+ * tasks + i * task_size. Returns TRUE if all tasks succeeded, FALSE otherwise.                    */
+int fan_out(ShardTask run, void *tasks, size_t task_size)
+{
+    pthread_t threads[FANOUT_THREADS_MAX];
+    int num_of_shards = get_num_of_shards();
+    int num_of_threads = (num_of_shards < FANOUT_THREADS_MAX) ? num_of_shards : FANOUT_THREADS_MAX;
+    int started = 0;
+    FanOut fan = {.db = current_db(), .run = run, .tasks = tasks, .task_size = task_size, .next_shard = 0,
+                  .error = FALSE};
+
+    pthread_mutex_init(&fan.lock, NULL);
+
+    // the calling thread works as well...
+    for (int i = 1; i < num_of_threads; i++) {
+        if (pthread_create(&threads[started], NULL, fan_out_worker, &fan) != 0)
+            break;
+        started++;
+    }
+    fan_out_worker(&fan);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&fan.lock);
+    return !fan.error;
+}
+
+/* ********** COMMANDS **********                                                                  */
+
+/* Runs sql on db with key bound to ?1 and id_base to ?2 (if used).
+ * Returns TRUE on success and FALSE on error (db is left open).                                   */
+static int exec_for_key(sqlite3 *db, const char *sql, const char *key, int id_base)
+{
+    sqlite3_stmt *stmt;
+    int status = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+
+    if (status == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+        if (sqlite3_bind_parameter_count(stmt) > 1)
+            sqlite3_bind_int(stmt, 2, id_base);
+        status = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    }
+
+    if (status != SQLITE_OK && status != SQLITE_DONE) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Moves the games with key out of the (open) chess.db db into their shard.
+ * Returns TRUE on success and FALSE on error (db is left open, the move is rolled back).          */
+static int move_games_to_shard(sqlite3 *db, const char *key)
+{
+    const Shard *shard = get_or_create_shard(key);
+    int success = (shard != NULL);
+
+    if (!success || !attach_database(db, shard->path, "shard"))
+        return FALSE;
+
+    // one transaction over both databases, all or nothing...
+    success = sqlite3_exec(db, "BEGIN TRANSACTION;", 0, 0, NULL) == SQLITE_OK;
+    for (size_t i = 0; success && i < sizeof(moveToShard) / sizeof(moveToShard[0]); i++)
+        success = exec_for_key(db, moveToShard[i], key, shard->number * SHARD_ID_SPAN);
+
+    if (success && sqlite3_exec(db, "COMMIT;", 0, 0, NULL) == SQLITE_OK) {
+        printf("INFO: moved %s games to %s...\n", key, shard->path);
+    } else {
+        eprintf("ERROR: moving %s games failed, rolling back...\n", key);
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+        success = FALSE;
+    }
+
+    sqlite3_exec(db, "DETACH DATABASE shard;", 0, 0, NULL);
+    return success;
+}
+
+/* Enables sharding by mode (SHARD_BY_YEAR or SHARD_BY_TOURNAMENT) and moves the games of
+ * chess.db into their shards. The mode is stored once all games are moved, after an error the
+ * games left in chess.db are moved by enabling sharding again. Expects prepare_database to have
+ * been called. Returns TRUE on success and FALSE on error.                                        */
+int enable_sharding(int mode)
+{
+    char keys[SHARDS_MAX][NAME_MAX];
+    int num_of_keys = 0, max_id = 0, status, success = TRUE;
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+
+    if (get_sharding_mode() != SHARD_NONE) {
+        eprintf("ERROR: the database is already sharded...\n");
+        return FALSE;
+    }
+
+    if (!open_database_path(current_db()->catalog_path, &db, FALSE))
+        return FALSE;
+
+    // ids are kept, shifted into the id span of the shard...
+    if (sqlite3_prepare_v2(db, selectMaxId, -1, &stmt, 0) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            max_id = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    if (max_id >= SHARD_ID_SPAN) {
+        eprintf("ERROR: game ids up to %d can be sharded, found %d...\n", SHARD_ID_SPAN - 1, max_id);
+        sqlite3_close(db);
+        return FALSE;
+    }
+
+    // (the shard keys are computed by the mode of the catalog)...
+    current_db()->catalog.mode = mode;
+    sqlite3_create_function(db, "shard_key", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                            sql_shard_key, NULL, NULL);
+
+    if (sqlite3_prepare_v2(db, selectShardKeys, -1, &stmt, 0) != SQLITE_OK) {
+        eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        current_db()->catalog.mode = SHARD_NONE;
+        sqlite3_close(db);
+        return FALSE;
+    }
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW && num_of_keys < SHARDS_MAX)
+        copy_column_text(keys[num_of_keys++], stmt, 0, NAME_MAX);
+    sqlite3_finalize(stmt);
+    if (status != SQLITE_DONE) {
+        if (status == SQLITE_ROW)
+            eprintf("ERROR: the games have more than %d shard keys, nothing is moved...\n", SHARDS_MAX);
+        else
+            eprintf("Failed to execute statement: %s\n", sqlite3_errmsg(db));
+        current_db()->catalog.mode = SHARD_NONE;
+        sqlite3_close(db);
+        return FALSE;
+    }
+
+    for (int i = 0; i < num_of_keys && success; i++)
+        success = move_games_to_shard(db, keys[i]);
+
+    if (!success)
+        sqlite3_close(db);
+
+    // games still in chess.db would not be found in a sharded database (db is closed on error)...
+    if (!success || !do_statement(db, NULL, NULL, NULL, FALSE, insertShardMode, "%d", mode)) {
+        eprintf("ERROR: sharding is not enabled, enable it again to move the games left...\n");
+        current_db()->catalog.mode = SHARD_NONE;
+        return FALSE;
+    }
+
+    sqlite3_close(db);
+    return TRUE;
+}
+
+/* Rebuilds (VACUUM) the shard with key, every shard if key is NULL, or chess.db if sharding is
+ * not enabled, switching them to auto_vacuum = INCREMENTAL so the maintenance can give free pages
+ * back later. Other shards stay usable meanwhile. Returns TRUE on success and FALSE on error.     */
+int vacuum_shards(const char *key)
+{
+    const ShardCatalog *catalog = &current_db()->catalog;
+    const char *paths[SHARDS_MAX + 1];
+    int num_of_paths = 0;
+
+    paths[num_of_paths++] = current_db()->catalog_path;
+    for (int i = 0; i < catalog->num_of_shards; i++) {
+        if (key == NULL || strcmp(catalog->shards[i].key, key) == 0)
+            paths[num_of_paths++] = catalog->shards[i].path;
+    }
+
+    // chess.db is only vacuumed with all shards...
+    for (int i = (key == NULL) ? 0 : 1; i < num_of_paths; i++) {
+        sqlite3 *db;
+        char *err_msg = 0;
+
+        if (!open_database_path(paths[i], &db, FALSE))
+            return FALSE;
+        int status = sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", 0, 0, &err_msg);
+        if (is_exec_error(&db, status, &err_msg))
+            return FALSE;
+        sqlite3_close(db);
+        printf("INFO: vacuumed %s...\n", paths[i]);
+    }
+
+    if (key != NULL && num_of_paths == 1) {
+        eprintf("ERROR: no shard with key %s...\n", key);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+typedef struct CountTask {
+    int count;
+} CountTask;
+
+static int count_games(sqlite3 *db, void *arg)
+{
+    CountTask *task = arg;
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(db, selectCount, -1, &stmt, 0) != SQLITE_OK)
+        return FALSE;
+    task->count = (sqlite3_step(stmt) == SQLITE_ROW) ? sqlite3_column_int(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    return TRUE;
+}
+
+/* Prints the shards with their number of games (counted in parallel).
+ * Returns TRUE on success and FALSE on error.                                                     */
+int print_shards()
+{
+    const ShardCatalog *catalog = &current_db()->catalog;
+    CountTask tasks[SHARDS_MAX];
+    int total = 0;
+
+    if (catalog->mode == SHARD_NONE) {
+        printf("INFO: sharding is not enabled, all games are in %s...\n", current_db()->catalog_path);
+        return TRUE;
+    }
+
+    if (!fan_out(count_games, tasks, sizeof(CountTask)))
+        return FALSE;
+
+    printf("\tSharded by %s:\n", (catalog->mode == SHARD_BY_YEAR) ? "year" : "tournament");
+    for (int i = 0; i < catalog->num_of_shards; i++) {
+        printf("\t%3d  %-24s %8d games\n", catalog->shards[i].number, catalog->shards[i].path, tasks[i].count);
+        total += tasks[i].count;
+    }
+    printf("\t     %-24s %8d games\n", "total", total);
+    return TRUE;
+}
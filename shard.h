@@ -0,0 +1,62 @@
+//
+// Created by flimsy on 3/9/22.
+//
+
+#ifndef CHESSDATABASE_SHARD_H
+#define CHESSDATABASE_SHARD_H
+
+#include <stddef.h>
+#include <sqlite3.h>
+
+#include "helperFunctions.h"
+
+// Database file, holding all games or, with sharding, the shard catalog.
+#define DATABASE_FILE "chess.db"
+
+// Sharding modes.
+#define SHARD_NONE 0
+#define SHARD_BY_YEAR 1
+#define SHARD_BY_TOURNAMENT 2
+
+// Size values. Shard n holds the game ids n * SHARD_ID_SPAN + 1 to (n + 1) * SHARD_ID_SPAN - 1,
+// shard 0 being chess.db itself.
+#define SHARDS_MAX 255
+#define SHARD_ID_SPAN (1 << 23)
+#define SHARD_BUCKETS 16
+#define SHARD_PATH_MAX 512
+#define FANOUT_THREADS_MAX 16
+
+#define SHARD_OF_ID(id) ((id) / SHARD_ID_SPAN)
+
+typedef struct Shard {
+    int number;
+    char key[NAME_MAX];
+    char path[SHARD_PATH_MAX];
+} Shard;
+
+/* The shard catalog of one database handle, shard paths resolved against the directory of the
+ * catalog database.                                                                               */
+typedef struct ShardCatalog {
+    int mode;
+    Shard shards[SHARDS_MAX];
+    int num_of_shards;
+} ShardCatalog;
+
+/* A query run by fan_out on one shard through the shard's own read only connection db.
+ * Returns TRUE on success, FALSE on error.                                                        */
+typedef int (*ShardTask)(sqlite3 *db, void *task);
+
+int load_shard_catalog(sqlite3 *db);
+int get_sharding_mode();
+int get_num_of_shards();
+const Shard *get_shard(int index);
+const Shard *find_shard(int number);
+int get_shard_numbers(int numbers[]);
+void shard_key_of_game(const char *name, int packed_date, char key[NAME_MAX]);
+const Shard *get_or_create_shard(const char *key);
+int fan_out(ShardTask run, void *tasks, size_t task_size);
+int enable_sharding(int mode);
+int vacuum_shards(const char *key);
+int print_shards();
+
+#endif //CHESSDATABASE_SHARD_H
@@ -0,0 +1,191 @@
+//
+// Created by flimsy on 3/18/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "similar.h"
+#include "lineindex.h"
+#include "database.h"
+
+/* ********** SIMILAR GAMES **********
+ * Two games are as similar as the Jaccard similarity of their sets of ply windows, the windows of
+ * LINE_PLIES plies of the line index: games following the same course share most windows even if
+ * they leave the opening at different moves or transpose. The set of a game is summarized by a
+ * MinHash signature, the smallest value of each of SIMILAR_HASHES hash functions over the
+ * windows, and the share of equal values of two signatures estimates their similarity.
+ * Signatures are stored with the game, cut into SIMILAR_BANDS bands of SIMILAR_BAND_ROWS values,
+ * and every band is indexed by its hash (locality sensitive hashing). Only the games sharing a
+ * whole band with the game searched for are read and compared, a game of similarity s being one
+ * of them with probability 1 - (1 - s^3)^20: about 0.15 at 0.2, 0.42 at 0.3, 0.93 at 0.5.         */
+
+static double elapsed_ms(const struct timespec *from)
+{
+    struct timespec to;
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    return (double)(to.tv_sec - from->tv_sec) * 1e3 + (double)(to.tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/* Hash function number i of the signature (the splitmix64 finalizer on a seeded value).           */
+static uint32_t hash_window(unsigned long long window, int i)
+{
+    unsigned long long x = window + (unsigned long long)(i + 1) * 0x9E3779B97F4A7C15ULL;
+
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return (uint32_t)((x ^ (x >> 31)) >> 32);
+}
+
+/* Computes the signature of the first move_count moves of game_moves.
+ * Returns TRUE on success, FALSE if the game is shorter than one window.                          */
+int game_signature(const GameMoves *game_moves, int move_count, uint32_t signature[SIMILAR_HASHES])
+{
+    char plies[LINE_PLIES_MAX][S_MOVE_MAX];
+    int num_of_plies = game_plies(game_moves, move_count, plies);
+
+    if (num_of_plies < LINE_PLIES)
+        return FALSE;
+
+    for (int i = 0; i < SIMILAR_HASHES; i++)
+        signature[i] = 0xFFFFFFFFu;
+
+    for (int start = 0; start + LINE_PLIES <= num_of_plies; start++) {
+        unsigned long long window = (unsigned long long)hash_plies(plies + start, LINE_PLIES);
+
+        for (int i = 0; i < SIMILAR_HASHES; i++) {
+            uint32_t value = hash_window(window, i);
+            if (value < signature[i])
+                signature[i] = value;
+        }
+    }
+    return TRUE;
+}
+
+/* Stores signature in packed, 4 bytes per value (little endian).                                  */
+void pack_signature(const uint32_t signature[SIMILAR_HASHES], unsigned char packed[SIMILAR_SIGNATURE_SIZE])
+{
+    for (int i = 0; i < SIMILAR_HASHES; i++) {
+        packed[i * 4] = (unsigned char)signature[i];
+        packed[i * 4 + 1] = (unsigned char)(signature[i] >> 8);
+        packed[i * 4 + 2] = (unsigned char)(signature[i] >> 16);
+        packed[i * 4 + 3] = (unsigned char)(signature[i] >> 24);
+    }
+}
+
+static void unpack_signature(const unsigned char packed[SIMILAR_SIGNATURE_SIZE], uint32_t signature[SIMILAR_HASHES])
+{
+    for (int i = 0; i < SIMILAR_HASHES; i++)
+        signature[i] = (uint32_t)packed[i * 4] | (uint32_t)packed[i * 4 + 1] << 8 |
+                       (uint32_t)packed[i * 4 + 2] << 16 | (uint32_t)packed[i * 4 + 3] << 24;
+}
+
+/* Stores the hash (FNV-1a over the band number and its values) of every band of signature in
+ * bands (SIMILAR_BANDS).                                                                          */
+void signature_bands(const uint32_t signature[SIMILAR_HASHES], long long bands[SIMILAR_BANDS])
+{
+    for (int band = 0; band < SIMILAR_BANDS; band++) {
+        unsigned long long hash = 14695981039346656037ULL;
+
+        hash = (hash ^ (unsigned)band) * 1099511628211ULL;
+        for (int row = 0; row < SIMILAR_BAND_ROWS; row++) {
+            uint32_t value = signature[band * SIMILAR_BAND_ROWS + row];
+            for (int byte = 0; byte < 4; byte++)
+                hash = (hash ^ ((value >> (byte * 8)) & 0xFF)) * 1099511628211ULL;
+        }
+        bands[band] = (long long)hash;
+    }
+}
+
+/* Returns the estimated similarity of the signatures a and b (share of equal values).             */
+static double estimate_similarity(const uint32_t a[SIMILAR_HASHES], const uint32_t b[SIMILAR_HASHES])
+{
+    int equal = 0;
+
+    for (int i = 0; i < SIMILAR_HASHES; i++)
+        equal += (a[i] == b[i]);
+    return (double)equal / SIMILAR_HASHES;
+}
+
+/* Inserts (game_id, similarity) into matches (count of max_matches, most similar first, then by
+ * id) if it is among the best. Returns the new count.                                             */
+static int keep_match(SimilarGame matches[], int count, int max_matches, int game_id, double similarity)
+{
+    int pos = count;
+
+    while (pos > 0 && (matches[pos - 1].similarity < similarity ||
+                       (matches[pos - 1].similarity == similarity && matches[pos - 1].game_id > game_id)))
+        pos--;
+    if (pos >= max_matches)
+        return count;
+
+    memmove(&matches[pos + 1], &matches[pos],
+            sizeof(SimilarGame) * ((count < max_matches) ? count - pos : count - pos - 1));
+    matches[pos] = (SimilarGame){game_id, similarity};
+    return (count < max_matches) ? count + 1 : count;
+}
+
+/* Finds the games most similar to the game game_id (in every shard) and stores at most
+ * max_matches of them in matches, most similar first. Games sharing no band with it are never
+ * read, and games shorter than one window have no signature (and so no similar games).
+ * Returns the number of matches, or ERROR on error.                                               */
+int find_similar_games(int game_id, SimilarGame matches[], int max_matches, SimilarSearchStats *stats)
+{
+    unsigned char packed[SIMILAR_SIGNATURE_SIZE];
+    uint32_t signature[SIMILAR_HASHES], other[SIMILAR_HASHES];
+    long long bands[SIMILAR_BANDS];
+    int numbers[SHARDS_MAX + 1], num_of_shards, count = 0, found, success = TRUE;
+    struct timespec start;
+    sqlite3 *db;
+
+    memset(stats, 0, sizeof(SimilarSearchStats));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    route_by_id(game_id);
+    if (!open_database_readonly(&db)) {
+        route_to_shard(0);
+        return ERROR;
+    }
+    found = get_game_signature(db, game_id, packed);
+    sqlite3_close(db);
+    route_to_shard(0);
+    if (found != TRUE)
+        return (found == ERROR) ? ERROR : 0;
+
+    unpack_signature(packed, signature);
+    signature_bands(signature, bands);
+
+    num_of_shards = get_shard_numbers(numbers);
+    for (int i = 0; i < num_of_shards && success; i++) {
+        SignatureRow *rows;
+        int num_of_rows;
+
+        route_to_shard(numbers[i]);
+        if (!open_database_readonly(&db)) {
+            success = FALSE;
+            break;
+        }
+        num_of_rows = get_band_candidates(db, bands, &rows);
+        sqlite3_close(db);
+        if (num_of_rows == ERROR) {
+            success = FALSE;
+            break;
+        }
+
+        for (int r = 0; r < num_of_rows; r++) {
+            if (rows[r].game_id == game_id)
+                continue;
+            unpack_signature(rows[r].signature, other);
+            count = keep_match(matches, count, max_matches, rows[r].game_id, estimate_similarity(signature, other));
+            stats->candidates++;
+        }
+        free(rows);
+    }
+    route_to_shard(0);
+
+    stats->milliseconds = elapsed_ms(&start);
+    return success ? count : ERROR;
+}
@@ -0,0 +1,42 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#ifndef CHESSDATABASE_SIMILAR_H
+#define CHESSDATABASE_SIMILAR_H
+
+#include <stdint.h>
+
+#include "helperFunctions.h"
+
+// Signature values: SIMILAR_BANDS bands of SIMILAR_BAND_ROWS MinHash values each.
+#define SIMILAR_HASHES 60
+#define SIMILAR_BAND_ROWS 3
+#define SIMILAR_BANDS (SIMILAR_HASHES / SIMILAR_BAND_ROWS)
+#define SIMILAR_SIGNATURE_SIZE (SIMILAR_HASHES * 4)
+
+// Size values.
+#define SIMILAR_MATCHES_MAX 20
+
+typedef struct SimilarGame {
+    int game_id;
+    double similarity;          // estimated Jaccard similarity of the ply windows of both games...
+} SimilarGame;
+
+typedef struct SimilarSearchStats {
+    int candidates;             // games sharing a band with the game, compared by signature...
+    double milliseconds;
+} SimilarSearchStats;
+
+/* A game found in the band index with its signature (packed, see pack_signature).                 */
+typedef struct SignatureRow {
+    int game_id;
+    unsigned char signature[SIMILAR_SIGNATURE_SIZE];
+} SignatureRow;
+
+int game_signature(const GameMoves *game_moves, int move_count, uint32_t signature[SIMILAR_HASHES]);
+void pack_signature(const uint32_t signature[SIMILAR_HASHES], unsigned char packed[SIMILAR_SIGNATURE_SIZE]);
+void signature_bands(const uint32_t signature[SIMILAR_HASHES], long long bands[SIMILAR_BANDS]);
+int find_similar_games(int game_id, SimilarGame matches[], int max_matches, SimilarSearchStats *stats);
+
+#endif //CHESSDATABASE_SIMILAR_H
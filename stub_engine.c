@@ -0,0 +1,126 @@
+//
+// Created by flimsy on 3/18/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chess.h"
+
+/* ********** STUB UCI ENGINE **********
+ * A stand-in UCI engine for the analysis tests. It answers the handshake, and a search with one
+ * info line (depth 1) and the first legal move of the position. STUB_ENGINE_MODE changes how it
+ * searches: "slow" answers only when told to stop, "hang" answers nothing after the handshake (not
+ * even stop or quit) and "exit" exits at its third search.                                        */
+
+/* Reads the position of fen (placement, side to move, castling and en passant) into board.
+ * Returns TRUE on success, FALSE if fen is not understood.                                        */
+static int read_fen(const char *fen, Board *board)
+{
+    static const char fen_letters[] = " PNBRQK  pnbrqk";
+    char placement[FEN_MAX], side[2], castling[5], en_passant[3];
+    int rank = 7, file = 0;
+
+    if (sscanf(fen, "%95s %1s %4s %2s", placement, side, castling, en_passant) != 4)
+        return FALSE;
+
+    memset(board, 0, sizeof(Board));
+    for (const char *c = placement; *c != '\0'; c++) {
+        const char *piece = strchr(fen_letters, *c);
+        if (*c == '/') {
+            rank--;
+            file = 0;
+        } else if (*c >= '1' && *c <= '8') {
+            file += *c - '0';
+        } else if (piece != NULL && *c != ' ' && file < 8 && rank >= 0) {
+            board->squares[SQUARE(file++, rank)] = (unsigned char)(piece - fen_letters);
+        } else {
+            return FALSE;
+        }
+    }
+
+    board->side_to_move = (side[0] == 'b') ? BLACK_PLAYER : WHITE_PLAYER;
+    board->castling = ((strchr(castling, 'K') != NULL) ? CASTLE_WHITE_KING : 0) |
+                      ((strchr(castling, 'Q') != NULL) ? CASTLE_WHITE_QUEEN : 0) |
+                      ((strchr(castling, 'k') != NULL) ? CASTLE_BLACK_KING : 0) |
+                      ((strchr(castling, 'q') != NULL) ? CASTLE_BLACK_QUEEN : 0);
+    board->en_passant = (en_passant[0] == '-') ? NO_SQUARE : SQUARE(en_passant[0] - 'a', en_passant[1] - '1');
+    board->fullmove_number = 1;
+    return TRUE;
+}
+
+/* Answers a search of board: an info line and the first legal move.                               */
+static void answer_search(const Board *board)
+{
+    Move legal[LEGAL_MOVES_MAX];
+    char uci_move[6] = {0};
+
+    if (generate_legal_moves(board, legal) == 0) {
+        printf("info depth 1 score mate 0\nbestmove 0000\n");
+        fflush(stdout);
+        return;
+    }
+
+    uci_move[0] = (char)('a' + FILE_OF(legal[0].from));
+    uci_move[1] = (char)('1' + RANK_OF(legal[0].from));
+    uci_move[2] = (char)('a' + FILE_OF(legal[0].to));
+    uci_move[3] = (char)('1' + RANK_OF(legal[0].to));
+    if (legal[0].promotion != EMPTY)
+        uci_move[4] = " pnbrqk"[legal[0].promotion];
+
+    printf("info depth 1 score cp 10\nbestmove %s\n", uci_move);
+    fflush(stdout);
+}
+
+int main()
+{
+    const char *mode = getenv("STUB_ENGINE_MODE");
+    char line[1024];
+    int searches = 0, searching = FALSE, handshaken = FALSE;
+    Board board;
+
+    if (mode == NULL)
+        mode = "";
+    board_init(&board);
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (handshaken && strcmp(mode, "hang") == 0)
+            continue;
+
+        if (strcmp(line, "uci") == 0) {
+            printf("id name Stub Engine\nuciok\n");
+            fflush(stdout);
+        } else if (strcmp(line, "isready") == 0) {
+            printf("readyok\n");
+            fflush(stdout);
+            handshaken = TRUE;
+        } else if (strncmp(line, "position fen ", 13) == 0) {
+            if (!read_fen(line + 13, &board))
+                return EXIT_FAILURE;
+        } else if (strncmp(line, "position startpos", 17) == 0) {
+            board_init(&board);
+        } else if (strncmp(line, "go", 2) == 0) {
+            if (++searches == 3 && strcmp(mode, "exit") == 0)
+                return EXIT_SUCCESS;
+            if (strcmp(mode, "slow") == 0)
+                searching = TRUE;
+            else
+                answer_search(&board);
+        } else if (strcmp(line, "stop") == 0 && searching) {
+            answer_search(&board);
+            searching = FALSE;
+        } else if (strcmp(line, "quit") == 0) {
+            break;
+        }
+    }
+
+    // (a hanging engine outlives its input too, until it is killed)...
+    while (strcmp(mode, "hang") == 0)
+        sleep(60);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+//
+// Created by flimsy on 3/18/22.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#include "helperFunctions.h"
+#include "terminal.h"
+
+/* ********** TERMINAL **********
+ * Screen control through ANSI escape sequences written to stdout, and a raw (unbuffered,
+ * unechoed) keyboard for full screen views. The terminal settings of the console are saved when
+ * entering full screen and restored when leaving it.                                             */
+
+// How long the rest of an escape sequence is waited for (an ESC alone is the escape key).
+#define ESCAPE_WAIT_MS 30
+
+static struct termios saved_settings;
+static int full_screen = FALSE;
+
+/* Clears the screen and moves the cursor to the top left corner.                                  */
+void clear_screen()
+{
+    fputs("\033[H\033[2J\033[3J", stdout);
+    fflush(stdout);
+}
+
+/* Switches the terminal to the alternate screen with a raw keyboard and a hidden cursor.
+ * Returns TRUE on success, FALSE if stdin is not a terminal.                                      */
+int enter_full_screen()
+{
+    struct termios raw;
+
+    if (full_screen)
+        return TRUE;
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved_settings) != 0)
+        return FALSE;
+
+    // Ctrl-C is read as a key, the terminal is restored by whoever reads it...
+    raw = saved_settings;
+    raw.c_iflag &= ~(tcflag_t)(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_lflag &= ~(tcflag_t)(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+        return FALSE;
+
+    fputs("\033[?1049h\033[?25l", stdout);
+    fflush(stdout);
+    full_screen = TRUE;
+    return TRUE;
+}
+
+/* Restores the screen and the keyboard settings from before enter_full_screen.                    */
+void leave_full_screen()
+{
+    if (!full_screen)
+        return;
+    fputs("\033[?25h\033[?1049l", stdout);
+    fflush(stdout);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_settings);
+    full_screen = FALSE;
+}
+
+/* Stores the size of the terminal in rows and cols (24 x 80 if unknown).                          */
+void get_terminal_size(int *rows, int *cols)
+{
+    struct winsize size;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+        *rows = size.ws_row;
+        *cols = size.ws_col;
+    } else {
+        *rows = 24;
+        *cols = 80;
+    }
+}
+
+/* Returns TRUE if input is waiting for timeout_ms milliseconds at most.                           */
+static int wait_for_input(int timeout_ms)
+{
+    struct pollfd input = {.fd = STDIN_FILENO, .events = POLLIN};
+    return poll(&input, 1, timeout_ms) > 0;
+}
+
+/* Returns TRUE if a key can be read without waiting.                                              */
+int is_key_pending()
+{
+    return wait_for_input(0);
+}
+
+static int read_byte()
+{
+    unsigned char c;
+    return (read(STDIN_FILENO, &c, 1) == 1) ? c : KEY_EOF;
+}
+
+/* Waits for a key and returns it: a character, or one of the KEY_ codes for the keys sending
+ * escape sequences (arrows, page up/down, home and end), enter and backspace. Sequences of
+ * other keys are skipped (KEY_NONE). Returns KEY_EOF on end of input.                              */
+int read_key()
+{
+    int c = read_byte(), next, code = 0;
+
+    if (c == KEY_EOF)
+        return KEY_EOF;
+    if (c == '\r' || c == '\n')
+        return KEY_ENTER;
+    if (c == 127 || c == '\b')
+        return KEY_BACKSPACE;
+    if (c != KEY_ESCAPE)
+        return c;
+    if (!wait_for_input(ESCAPE_WAIT_MS) || ((next = read_byte()) != '[' && next != 'O'))
+        return KEY_ESCAPE;
+
+    // CSI: ESC [ (digits) final, or SS3: ESC O final...
+    while ((c = read_byte()) >= '0' && c <= '9')
+        code = code * 10 + (c - '0');
+    while (c == ';' || (c >= '0' && c <= '9'))
+        c = read_byte();
+
+    switch (c) {
+        case 'A':
+            return KEY_UP;
+        case 'B':
+            return KEY_DOWN;
+        case 'H':
+            return KEY_HOME;
+        case 'F':
+            return KEY_END;
+        case '~':
+            if (code == 1 || code == 7)
+                return KEY_HOME;
+            if (code == 4 || code == 8)
+                return KEY_END;
+            if (code == 5)
+                return KEY_PAGE_UP;
+            if (code == 6)
+                return KEY_PAGE_DOWN;
+            return KEY_NONE;
+        default:
+            return KEY_NONE;
+    }
+}
@@ -0,0 +1,29 @@
+//
+// Created by flimsy on 3/18/22.
+//
+
+#ifndef CHESSDATABASE_TERMINAL_H
+#define CHESSDATABASE_TERMINAL_H
+
+// Keys read by read_key besides plain characters.
+#define KEY_NONE -1
+#define KEY_EOF -2
+#define KEY_ESCAPE 27
+#define KEY_ENTER 1000
+#define KEY_BACKSPACE 1001
+#define KEY_UP 1002
+#define KEY_DOWN 1003
+#define KEY_PAGE_UP 1004
+#define KEY_PAGE_DOWN 1005
+#define KEY_HOME 1006
+#define KEY_END 1007
+#define KEY_CTRL_C 3
+
+void clear_screen();
+int enter_full_screen();
+void leave_full_screen();
+void get_terminal_size(int *rows, int *cols);
+int is_key_pending();
+int read_key();
+
+#endif //CHESSDATABASE_TERMINAL_H
@@ -0,0 +1,311 @@
+//
+// Created by flimsy on 2/3/22.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "database.h"
+#include "tournament.h"
+#include "context.h"
+
+/* ********** STANDINGS CACHE **********
+ * Up to STANDINGS_CACHE_MAX standings per database handle, the least recently used are evicted.   */
+
+/* Returns TRUE if standings belongs to the tournament/class/group given, FALSE otherwise.         */
+static int is_same_tournament(const Standings *standings, const char *name, const char *class,
+                              const char *group)
+{
+    return strcmp(standings->name, name) == 0 &&
+           strcmp(standings->class, class) == 0 &&
+           strcmp(standings->group, group) == 0;
+}
+
+/* Makes a deep copy of src into dst. dst must not hold any allocated data.
+ * Returns TRUE on success and FALSE if memory could not be allocated.                             */
+static int copy_standings(Standings *dst, const Standings *src)
+{
+    int n = src->num_of_players;
+
+    *dst = *src;
+    dst->players = malloc(sizeof(PlayerStanding) * (n > 0 ? n : 1));
+    dst->crosstable = malloc(sizeof(double) * (n > 0 ? n * n : 1));
+    dst->pairings = malloc(sizeof(int) * (n > 0 ? n * n : 1));
+
+    if (dst->players == NULL || dst->crosstable == NULL || dst->pairings == NULL) {
+        eprintf("ERROR: could not allocate memory for standings...\n");
+        free_standings(dst);
+        return FALSE;
+    }
+
+    memcpy(dst->players, src->players, sizeof(PlayerStanding) * n);
+    memcpy(dst->crosstable, src->crosstable, sizeof(double) * n * n);
+    memcpy(dst->pairings, src->pairings, sizeof(int) * n * n);
+    return TRUE;
+}
+
+/* Looks up the tournament in the cache, on a hit the standings are copied into standings
+ * and TRUE is returned. FALSE is returned on a miss.                                              */
+static int lookup_cached_standings(Standings *standings, const char *name, const char *class,
+                                   const char *group)
+{
+    StandingsCache *cache = &current_db()->standings;
+
+    for (int i = 0; i < STANDINGS_CACHE_MAX; i++) {
+        if (cache->entries[i].used &&
+            is_same_tournament(&cache->entries[i].standings, name, class, group)) {
+            cache->entries[i].last_use = ++cache->clock;
+            return copy_standings(standings, &cache->entries[i].standings);
+        }
+    }
+    return FALSE;
+}
+
+/* Stores a copy of standings in the cache, evicting the least recently used entry if full.        */
+static void store_cached_standings(const Standings *standings)
+{
+    StandingsCache *cache = &current_db()->standings;
+    int slot = 0;
+
+    for (int i = 0; i < STANDINGS_CACHE_MAX; i++) {
+        if (!cache->entries[i].used) {
+            slot = i;
+            break;
+        }
+        if (cache->entries[i].last_use < cache->entries[slot].last_use)
+            slot = i;
+    }
+
+    if (cache->entries[slot].used) {
+        free_standings(&cache->entries[slot].standings);
+        cache->entries[slot].used = FALSE;
+    }
+
+    if (copy_standings(&cache->entries[slot].standings, standings)) {
+        cache->entries[slot].used = TRUE;
+        cache->entries[slot].last_use = ++cache->clock;
+    }
+}
+
+/* Drops the cached standings of the tournament/class/group, if any. Should be called
+ * whenever a game of that tournament is inserted, altered or deleted.                             */
+void invalidate_standings(const char *name, const char *class, const char *group)
+{
+    StandingsCache *cache = &current_db()->standings;
+
+    for (int i = 0; i < STANDINGS_CACHE_MAX; i++) {
+        if (cache->entries[i].used &&
+            is_same_tournament(&cache->entries[i].standings, name, class, group)) {
+            free_standings(&cache->entries[i].standings);
+            cache->entries[i].used = FALSE;
+        }
+    }
+}
+
+/* Drops all cached standings.                                                                     */
+void clear_standings_cache()
+{
+    StandingsCache *cache = &current_db()->standings;
+
+    for (int i = 0; i < STANDINGS_CACHE_MAX; i++) {
+        if (cache->entries[i].used) {
+            free_standings(&cache->entries[i].standings);
+            cache->entries[i].used = FALSE;
+        }
+    }
+}
+
+/* ********** STANDINGS CALCULATION **********                                                     */
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+/* Ranking order: score, Buchholz, Sonneborn-Berger (all descending), then name.                   */
+static int compare_standings(const void *a, const void *b)
+{
+    const PlayerStanding *p1 = a, *p2 = b;
+
+    if (p1->score != p2->score)
+        return (p1->score < p2->score) ? 1 : -1;
+    if (p1->buchholz != p2->buchholz)
+        return (p1->buchholz < p2->buchholz) ? 1 : -1;
+    if (p1->sonneborn_berger != p2->sonneborn_berger)
+        return (p1->sonneborn_berger < p2->sonneborn_berger) ? 1 : -1;
+    return strcmp(p1->name, p2->name);
+}
+
+/* Returns TRUE if both players share score and tiebreaks (and therefore rank), FALSE otherwise.   */
+static int is_tied(const PlayerStanding *p1, const PlayerStanding *p2)
+{
+    return p1->score == p2->score && p1->buchholz == p2->buchholz &&
+           p1->sonneborn_berger == p2->sonneborn_berger;
+}
+
+/* Returns the position of name in the sorted names array, or ERROR if not present.                */
+static int find_player(char (*names)[NAME_MAX], int num_of_players, const char *name)
+{
+    char (*found)[NAME_MAX] = bsearch(name, names, num_of_players, NAME_MAX, compare_names);
+    return (found == NULL) ? ERROR : (int)(found - names);
+}
+
+/* Builds the standings from the rows of the grouped pairing query.
+ * Returns TRUE on success and FALSE on error.                                                     */
+static int calculate_standings(Standings *standings, const TournamentPairing pairings[],
+                               int num_of_pairings)
+{
+    int n = 0, return_code = FALSE;
+    char (*names)[NAME_MAX] = malloc(NAME_MAX * (size_t)(num_of_pairings * 2 + 1));
+    int *points = NULL, *games = NULL, *order = NULL;
+    PlayerStanding *players = NULL;
+
+    if (names == NULL)
+        goto cleanup;
+
+    // collecting distinct player names...
+    for (int i = 0; i < num_of_pairings; i++) {
+        strcpy(names[n++], pairings[i].white_name);
+        strcpy(names[n++], pairings[i].black_name);
+    }
+    qsort(names, n, NAME_MAX, compare_names);
+    int distinct = 0;
+    for (int i = 0; i < n; i++) {
+        if (distinct == 0 || strcmp(names[distinct - 1], names[i]) != 0)
+            memmove(names[distinct++], names[i], NAME_MAX);
+    }
+    n = distinct;
+
+    // half-point and game count matrices, indexed by position in names...
+    points = calloc((size_t)(n * n + 1), sizeof(int));
+    games = calloc((size_t)(n * n + 1), sizeof(int));
+    players = calloc((size_t)(n + 1), sizeof(PlayerStanding));
+    order = calloc((size_t)(n + 1), sizeof(int));
+    if (points == NULL || games == NULL || players == NULL || order == NULL)
+        goto cleanup;
+
+    for (int i = 0; i < num_of_pairings; i++) {
+        const TournamentPairing *p = &pairings[i];
+        int w = find_player(names, n, p->white_name);
+        int b = find_player(names, n, p->black_name);
+
+        games[w * n + b] += p->games;
+        games[b * n + w] += p->games;
+        points[w * n + b] += p->white_wins * 2 + p->draws;
+        points[b * n + w] += p->black_wins * 2 + p->draws;
+
+        players[w].wins += p->white_wins;
+        players[w].draws += p->draws;
+        players[w].losses += p->black_wins;
+        players[b].wins += p->black_wins;
+        players[b].draws += p->draws;
+        players[b].losses += p->white_wins;
+    }
+
+    // scores...
+    for (int i = 0; i < n; i++) {
+        int score = 0, played = 0;
+        for (int j = 0; j < n; j++) {
+            score += points[i * n + j];
+            played += games[i * n + j];
+        }
+        strcpy(players[i].name, names[i]);
+        players[i].games = played;
+        players[i].score = score / 2.0;
+    }
+
+    // tiebreaks: Buchholz = sum of the scores of all opponents met,
+    // Sonneborn-Berger = sum of the scores of opponents weighted by the points taken from them...
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            players[i].buchholz += games[i * n + j] * players[j].score;
+            players[i].sonneborn_berger += points[i * n + j] / 2.0 * players[j].score;
+        }
+    }
+
+    // ranking...
+    qsort(players, n, sizeof(PlayerStanding), compare_standings);
+    for (int i = 0; i < n; i++) {
+        players[i].rank = (i > 0 && is_tied(&players[i - 1], &players[i])) ? players[i - 1].rank : i + 1;
+        order[i] = find_player(names, n, players[i].name);
+    }
+
+    // crosstable and pairings matrix in ranking order...
+    standings->num_of_players = n;
+    standings->players = players;
+    standings->crosstable = malloc(sizeof(double) * (n * n + 1));
+    standings->pairings = malloc(sizeof(int) * (n * n + 1));
+    if (standings->crosstable == NULL || standings->pairings == NULL) {
+        free_standings(standings);
+        players = NULL;
+        goto cleanup;
+    }
+
+    for (int row = 0; row < n; row++) {
+        for (int col = 0; col < n; col++) {
+            int g = games[order[row] * n + order[col]];
+            standings->pairings[row * n + col] = g;
+            standings->crosstable[row * n + col] = (g == 0) ? NOT_PAIRED
+                                                            : points[order[row] * n + order[col]] / 2.0;
+        }
+    }
+    players = NULL; // owned by standings...
+    return_code = TRUE;
+
+cleanup:
+    if (!return_code)
+        eprintf("ERROR: could not allocate memory for standings...\n");
+    free(names);
+    free(points);
+    free(games);
+    free(players);
+    free(order);
+    return return_code;
+}
+
+/* Retrieves the standings of a tournament (g_name), class (g_class) and group (g_group),
+ * including Buchholz and Sonneborn-Berger tiebreaks, crosstable and pairings matrix.
+ * Standings are served from the cache when possible, otherwise computed from a single grouped
+ * query and cached until a game of the tournament is written.
+ * The caller owns the returned standings and must release them with free_standings().
+ * Returns TRUE on success, FALSE on error or if the tournament has no finished games.             */
+int get_standings(Standings *standings, const char *name, const char *class, const char *group)
+{
+    TournamentPairing *pairings = NULL;
+    int num_of_pairings;
+
+    memset(standings, 0, sizeof(Standings));
+    if (lookup_cached_standings(standings, name, class, group))
+        return TRUE;
+
+    num_of_pairings = get_tournament_pairings(&pairings, name, class, group);
+    if (!num_of_pairings) {
+        free(pairings);
+        return FALSE;
+    }
+
+    snprintf(standings->name, NAME_MAX, "%s", name);
+    snprintf(standings->class, NAME_MAX, "%s", class);
+    snprintf(standings->group, NAME_MAX, "%s", group);
+
+    if (!calculate_standings(standings, pairings, num_of_pairings)) {
+        free(pairings);
+        return FALSE;
+    }
+    free(pairings);
+
+    store_cached_standings(standings);
+    return TRUE;
+}
+
+/* Releases the memory held by standings.                                                          */
+void free_standings(Standings *standings)
+{
+    free(standings->players);
+    free(standings->crosstable);
+    free(standings->pairings);
+    standings->players = NULL;
+    standings->crosstable = NULL;
+    standings->pairings = NULL;
+    standings->num_of_players = 0;
+}
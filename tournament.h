@@ -0,0 +1,70 @@
+//
+// Created by flimsy on 2/3/22.
+//
+
+#ifndef CHESSDATABASE_TOURNAMENT_H
+#define CHESSDATABASE_TOURNAMENT_H
+
+#include "helperFunctions.h"
+
+// Size values.
+#define STANDINGS_CACHE_MAX 16
+
+// Crosstable value for two players that never met.
+#define NOT_PAIRED -1
+
+/* One row of the grouped pairing query: the finished games between white_name (as white)
+ * and black_name (as black) in a tournament.                                                      */
+typedef struct TournamentPairing {
+    char white_name[NAME_MAX];
+    char black_name[NAME_MAX];
+    int games;
+    int white_wins;
+    int draws;
+    int black_wins;
+} TournamentPairing;
+
+typedef struct PlayerStanding {
+    char name[NAME_MAX];
+    int rank;
+    int games;
+    int wins;
+    int draws;
+    int losses;
+    double score;
+    double buchholz;
+    double sonneborn_berger;
+} PlayerStanding;
+
+/* Standings of a tournament/class/group. players is sorted by rank, crosstable and
+ * pairings are num_of_players x num_of_players matrices in the same order:
+ *     crosstable[row * num_of_players + col] - points row scored against col (NOT_PAIRED if never met).
+ *     pairings[row * num_of_players + col]   - number of games played between row and col.         */
+typedef struct Standings {
+    char name[NAME_MAX];
+    char class[NAME_MAX];
+    char group[NAME_MAX];
+    int num_of_players;
+    PlayerStanding *players;
+    double *crosstable;
+    int *pairings;
+} Standings;
+
+typedef struct CachedStandings {
+    int used;
+    unsigned long last_use;
+    Standings standings;
+} CachedStandings;
+
+/* The standings cache of one database handle.                                                     */
+typedef struct StandingsCache {
+    CachedStandings entries[STANDINGS_CACHE_MAX];
+    unsigned long clock;
+} StandingsCache;
+
+int get_standings(Standings *standings, const char *name, const char *class, const char *group);
+void free_standings(Standings *standings);
+void invalidate_standings(const char *name, const char *class, const char *group);
+void clear_standings_cache();
+
+#endif //CHESSDATABASE_TOURNAMENT_H